@@ -110,11 +110,13 @@ void log_msg(log_level_t level, const char *msg, ...)
     }
 
     if (level >= log_level) {
+        /* log to stdout before log_init() or when the log file failed */
+        FILE *fp = log_fp != NULL ? log_fp : stdout;
         va_list ap;
 
         va_start(ap, msg);
-        fprintf(log_fp, "%s ", level_labels[level]);
-        vfprintf(log_fp, msg, ap);
+        fprintf(fp, "%s ", level_labels[level]);
+        vfprintf(fp, msg, ap);
         va_end(ap);
         printf("\n");
         fflush(stdout);
@@ -35,13 +35,39 @@
 #include "config.h"
 
 #include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#ifdef G_OS_UNIX
+# include <glib-unix.h>
+# include <signal.h>
+#endif
+#include <stdbool.h>
+#include <unistd.h>
 
 #include "app-resources.h"
 #include "appwindow.h"
+#include "logview.h"
 #include "settingsdialog.h"
+#include "basicdialog.h"
+#include "memuploaddialog.h"
+#include "kbdfeeddialog.h"
+#include "autostartdialog.h"
+#include "sessiondialog.h"
 #include "debug.h"
 #include "log.h"
 #include "settings.h"
+#include "cpfile.h"
+#include "symtab.h"
+#include "snapshot.h"
+#include "snapstore.h"
+#include "snapshotdialog.h"
+#include "snapdiff.h"
+#include "snapdiffview.h"
+#include "resources.h"
+#include "session.h"
+#include "latency.h"
+#include "frameprof.h"
+#include "trace.h"
+#include "startup.h"
 
 
 static GtkWidget *main_window = NULL;
@@ -83,6 +109,570 @@ static void on_app_settings(GSimpleAction *action,
 
 
 
+/** \brief  Handler for 'app.checkpoints-import'
+ *
+ * \param[in]   action      action
+ * \param[in]   parameter   action parameter
+ * \param[in]   dat         user data
+ */
+static void on_checkpoints_import(GSimpleAction *action,
+                                  GVariant      *parameter,
+                                  gpointer       data)
+{
+    char *path;
+    GError *err = NULL;
+    int count;
+
+    path = basic_dialog_choose_file(main_window,
+                                    "Import checkpoints",
+                                    GTK_FILE_CHOOSER_ACTION_OPEN);
+    if (path == NULL) {
+        return;
+    }
+    count = cpfile_import(path, &err);
+    if (count < 0) {
+        logview_add("err", "Failed to import checkpoints: %s\n", err->message);
+        g_error_free(err);
+    } else {
+        logview_add("ok", "Imported %d checkpoints from %s.\n", count, path);
+    }
+    g_free(path);
+}
+
+
+/** \brief  Handler for 'app.checkpoints-export'
+ *
+ * \param[in]   action      action
+ * \param[in]   parameter   action parameter
+ * \param[in]   dat         user data
+ */
+static void on_checkpoints_export(GSimpleAction *action,
+                                  GVariant      *parameter,
+                                  gpointer       data)
+{
+    char *path;
+    GError *err = NULL;
+
+    path = basic_dialog_choose_file(main_window,
+                                    "Export checkpoints",
+                                    GTK_FILE_CHOOSER_ACTION_SAVE);
+    if (path == NULL) {
+        return;
+    }
+    if (!cpfile_export(path, &err)) {
+        logview_add("err", "Failed to export checkpoints: %s\n", err->message);
+        g_error_free(err);
+    }
+    g_free(path);
+}
+
+
+/** \brief  Handler for 'app.symbols-load'
+ *
+ * \param[in]   action      action
+ * \param[in]   parameter   action parameter
+ * \param[in]   dat         user data
+ */
+static void on_symbols_load(GSimpleAction *action,
+                            GVariant      *parameter,
+                            gpointer       data)
+{
+    char *path;
+    GError *err = NULL;
+    int count;
+
+    path = basic_dialog_choose_file(main_window,
+                                    "Load symbols",
+                                    GTK_FILE_CHOOSER_ACTION_OPEN);
+    if (path == NULL) {
+        return;
+    }
+    count = symtab_load(path, SYMTAB_FORMAT_AUTO, &err);
+    if (count < 0) {
+        logview_add("err", "Failed to load symbols: %s\n", err->message);
+        g_error_free(err);
+    } else {
+        logview_add("ok", "Loaded %d symbols from %s.\n", count, path);
+    }
+    g_free(path);
+}
+
+
+/** \brief  Create a temporary snapshot file
+ *
+ * VICE reads and writes the snapshot files itself, so this assumes VICE
+ * runs on the same machine. The file is created with a random name and
+ * owner-only permissions, so it can't be replaced by another user.
+ *
+ * \param[out]  error   error (optional)
+ *
+ * \return  path, free with g_free(), or `NULL` on error
+ */
+static char *snapshot_tmp_path(GError **error)
+{
+    char *path = NULL;
+    int fd;
+
+    fd = g_file_open_tmp("gtk3vicemon-XXXXXX.vsf", &path, error);
+    if (fd < 0) {
+        return NULL;
+    }
+    close(fd);
+    return path;
+}
+
+
+/** \brief  Callback for the dump command of 'app.snapshot-take'
+ *
+ * Adds the snapshot to the store and removes the snapshot file.
+ *
+ * \param[in]   path    snapshot file
+ * \param[in]   success dump succeeded
+ * \param[in]   data    snapshot name
+ */
+static void on_snapshot_dumped(const char *path, bool success, void *data)
+{
+    char *name = data;
+    snapstore_stats_t stats;
+    GError *err = NULL;
+
+    if (!success) {
+        logview_add("err", "Failed to save snapshot '%s'.\n", name);
+    } else if (!snapstore_add(path, name, &stats, &err)) {
+        logview_add("err", "Failed to store snapshot: %s\n", err->message);
+        g_error_free(err);
+    } else {
+        logview_add("ok",
+                    "Stored snapshot '%s': %zu of %zu pages new"
+                    " (%zu of %zu bytes).\n",
+                    name,
+                    stats.new_pages, stats.pages,
+                    stats.new_bytes, stats.bytes);
+    }
+    g_unlink(path);
+    g_free(name);
+}
+
+
+/** \brief  Handler for 'app.snapshot-take'
+ *
+ * \param[in]   action      action
+ * \param[in]   parameter   action parameter
+ * \param[in]   dat         user data
+ */
+static void on_snapshot_take(GSimpleAction *action,
+                             GVariant      *parameter,
+                             gpointer       data)
+{
+    GDateTime *now;
+    char *name;
+    char *path;
+    GError *err = NULL;
+
+    path = snapshot_tmp_path(&err);
+    if (path == NULL) {
+        logview_add("err", "Failed to create snapshot file: %s\n",
+                    err->message);
+        g_error_free(err);
+        return;
+    }
+
+    now = g_date_time_new_now_local();
+    name = g_date_time_format(now, "%Y%m%d-%H%M%S");
+    g_date_time_unref(now);
+
+    if (!snapshot_dump(path, false, false, on_snapshot_dumped, name)) {
+        logview_add("err", "Failed to send snapshot command.\n");
+        g_unlink(path);
+        g_free(name);
+    }
+    g_free(path);
+}
+
+
+/** \brief  Callback for the undump command of 'app.snapshot-restore'
+ *
+ * \param[in]   path    snapshot file
+ * \param[in]   success undump succeeded
+ * \param[in]   data    snapshot name
+ */
+static void on_snapshot_undumped(const char *path, bool success, void *data)
+{
+    char *name = data;
+
+    if (success) {
+        logview_add("ok", "Restored snapshot '%s'.\n", name);
+    } else {
+        logview_add("err", "Failed to restore snapshot '%s'.\n", name);
+    }
+    g_unlink(path);
+    g_free(name);
+}
+
+
+/** \brief  Handler for 'app.snapshot-restore'
+ *
+ * \param[in]   action      action
+ * \param[in]   parameter   action parameter
+ * \param[in]   dat         user data
+ */
+static void on_snapshot_restore(GSimpleAction *action,
+                                GVariant      *parameter,
+                                gpointer       data)
+{
+    char *name;
+    char *path;
+    GError *err = NULL;
+
+    name = snapshot_dialog_choose(main_window, "Restore snapshot");
+    if (name == NULL) {
+        return;
+    }
+    path = snapshot_tmp_path(&err);
+    if (path == NULL) {
+        logview_add("err", "Failed to create snapshot file: %s\n",
+                    err->message);
+        g_error_free(err);
+        g_free(name);
+        return;
+    }
+    if (!snapstore_extract(name, path, &err)) {
+        logview_add("err", "Failed to extract snapshot: %s\n", err->message);
+        g_error_free(err);
+        g_unlink(path);
+        g_free(name);
+    } else if (!snapshot_undump(path, on_snapshot_undumped, name)) {
+        logview_add("err", "Failed to send snapshot command.\n");
+        g_unlink(path);
+        g_free(name);
+    }
+    g_free(path);
+}
+
+
+/** \brief  Handler for 'app.snapshot-diff'
+ *
+ * \param[in]   action      action
+ * \param[in]   parameter   action parameter
+ * \param[in]   dat         user data
+ */
+static void on_snapshot_diff(GSimpleAction *action,
+                             GVariant      *parameter,
+                             gpointer       data)
+{
+    char *old_name;
+    char *new_name;
+    char *title;
+    snapdiff_t *diff;
+    GError *err = NULL;
+
+    if (!snapshot_dialog_choose_pair(main_window,
+                                     "Compare snapshots",
+                                     &old_name,
+                                     &new_name)) {
+        return;
+    }
+    diff = snapdiff_new(old_name, new_name, &err);
+    if (diff == NULL) {
+        logview_add("err", "Failed to compare snapshots: %s\n", err->message);
+        g_error_free(err);
+    } else {
+        title = g_strdup_printf("%s -> %s", old_name, new_name);
+        snapdiff_view_show(main_window, title, diff);
+        g_free(title);
+        snapdiff_free(diff);
+    }
+    g_free(old_name);
+    g_free(new_name);
+}
+
+
+/** \brief  Handler for 'app.memory-upload'
+ *
+ * \param[in]   action      action
+ * \param[in]   parameter   action parameter
+ * \param[in]   dat         user data
+ */
+static void on_memory_upload(GSimpleAction *action,
+                             GVariant      *parameter,
+                             gpointer       data)
+{
+    memupload_dialog_show(main_window);
+}
+
+
+/** \brief  Handler for 'app.keyboard-feed'
+ *
+ * \param[in]   action      action
+ * \param[in]   parameter   action parameter
+ * \param[in]   dat         user data
+ */
+static void on_keyboard_feed(GSimpleAction *action,
+                             GVariant      *parameter,
+                             gpointer       data)
+{
+    kbdfeed_dialog_show(main_window);
+}
+
+
+/** \brief  Handler for 'app.autostart'
+ *
+ * \param[in]   action      action
+ * \param[in]   parameter   action parameter
+ * \param[in]   dat         user data
+ */
+static void on_autostart(GSimpleAction *action,
+                         GVariant      *parameter,
+                         gpointer       data)
+{
+    autostart_dialog_show(main_window);
+}
+
+
+/** \brief  Callback for setting WarpMode from 'app.warp-mode'
+ *
+ * Reverts the state of the action when VICE didn't accept the new value.
+ *
+ * \param[in]   name    resource name
+ * \param[in]   success resource was set
+ * \param[in]   data    action
+ */
+static void on_warp_mode_set(const char *name, bool success, void *data)
+{
+    GSimpleAction *action = data;
+    GVariant *state;
+
+    if (success) {
+        return;
+    }
+    logview_add("err", "Failed to set warp mode.\n");
+    state = g_action_get_state(G_ACTION(action));
+    g_simple_action_set_state(action,
+                              g_variant_new_boolean(!g_variant_get_boolean(state)));
+    g_variant_unref(state);
+}
+
+
+/** \brief  Handler for state changes of 'app.warp-mode'
+ *
+ * Sets the WarpMode resource through the resource cache, so the statusbar
+ * shows the new value.
+ *
+ * \param[in]   action  action
+ * \param[in]   value   new state (boolean)
+ * \param[in]   data    user data
+ */
+static void on_warp_mode_change_state(GSimpleAction *action,
+                                      GVariant      *value,
+                                      gpointer       data)
+{
+    if (!resources_set_int("WarpMode", g_variant_get_boolean(value),
+                           on_warp_mode_set, action)) {
+        logview_add("err", "Failed to send warp mode.\n");
+        return;
+    }
+    g_simple_action_set_state(action, value);
+}
+
+
+/** \brief  Handler for resource cache changes, syncs 'app.warp-mode'
+ *
+ * Keeps the state of the action in line with the WarpMode resource of the
+ * active session, also when another session is made active.
+ *
+ * \param[in]   name    resource name, or NULL for all
+ * \param[in]   data    action
+ */
+static void on_warp_mode_resource_changed(const char *name, void *data)
+{
+    GSimpleAction *action = data;
+    const resource_value_t *warp;
+    bool enabled;
+
+    if (session_current() != session_active()
+            || (name != NULL && g_ascii_strcasecmp(name, "WarpMode") != 0)) {
+        return;
+    }
+    warp = resources_lookup("WarpMode");
+    enabled = warp != NULL && warp->type == RESOURCE_TYPE_INT
+              && warp->int_value != 0;
+    g_simple_action_set_state(action, g_variant_new_boolean(enabled));
+}
+
+
+/** \brief  Handler for 'app.session-new'
+ *
+ * \param[in]   action      action
+ * \param[in]   parameter   action parameter
+ * \param[in]   dat         user data
+ */
+static void on_session_new(GSimpleAction *action,
+                           GVariant      *parameter,
+                           gpointer       data)
+{
+    session_dialog_show(main_window);
+}
+
+
+/** \brief  Write latency report to \a path and log the result
+ *
+ * \param[in]   path    path to file
+ */
+static void write_latency_report(const char *path)
+{
+    GError *err = NULL;
+
+    if (latency_report_write(path, &err)) {
+        logview_add(NULL, "Latency report written to '%s'.\n", path);
+        log_msg(LOG_INFO, "Latency report written to '%s'.\n", path);
+    } else {
+        logview_add("err", "Failed to write latency report: %s\n",
+                    err->message);
+        g_error_free(err);
+    }
+}
+
+
+/** \brief  Handler for 'app.latency-report'
+ *
+ * Writes the round trip time histograms per command of all sessions to a
+ * JSON file.
+ *
+ * \param[in]   action      action
+ * \param[in]   parameter   action parameter
+ * \param[in]   dat         user data
+ */
+static void on_latency_report(GSimpleAction *action,
+                              GVariant      *parameter,
+                              gpointer       data)
+{
+    char *path;
+
+    path = basic_dialog_choose_file(main_window,
+                                    "Save latency report",
+                                    GTK_FILE_CHOOSER_ACTION_SAVE);
+    if (path == NULL) {
+        return;
+    }
+    write_latency_report(path);
+    g_free(path);
+}
+
+
+#ifdef G_OS_UNIX
+/** \brief  Handler for SIGUSR1
+ *
+ * Writes the latency report to LATENCY_REPORT_FILE in the settings dir, so
+ * it can be taken without touching the UI, e.g. `kill -USR1 <pid>`.
+ *
+ * \param[in]   data    extra data (unused)
+ *
+ * \return  G_SOURCE_CONTINUE
+ */
+static gboolean on_sigusr1(gpointer data)
+{
+    char *path = latency_report_default_path();
+
+    write_latency_report(path);
+    g_free(path);
+    return G_SOURCE_CONTINUE;
+}
+#endif
+
+
+/** \brief  Handler for state changes of 'app.frame-profiler'
+ *
+ * \param[in]   action  action
+ * \param[in]   value   new state (boolean)
+ * \param[in]   data    user data
+ */
+static void on_frame_profiler_change_state(GSimpleAction *action,
+                                           GVariant      *value,
+                                           gpointer       data)
+{
+    frameprof_set_enabled(g_variant_get_boolean(value));
+    g_simple_action_set_state(action, value);
+}
+
+
+/** \brief  Write the trace buffer to \a path and log the result
+ *
+ * \param[in]   path    path to file
+ */
+static void write_trace_dump(const char *path)
+{
+    GError *err = NULL;
+
+    if (trace_dump_write(path, &err)) {
+        logview_add(NULL, "Trace buffer written to '%s'.\n", path);
+    } else {
+        logview_add("err", "Failed to write trace buffer: %s\n", err->message);
+        g_error_free(err);
+    }
+}
+
+
+/** \brief  Handler for 'app.trace-dump'
+ *
+ * \param[in]   action      action
+ * \param[in]   parameter   action parameter
+ * \param[in]   dat         user data
+ */
+static void on_trace_dump(GSimpleAction *action,
+                          GVariant      *parameter,
+                          gpointer       data)
+{
+    char *path;
+
+    path = basic_dialog_choose_file(main_window,
+                                    "Save trace buffer",
+                                    GTK_FILE_CHOOSER_ACTION_SAVE);
+    if (path == NULL) {
+        return;
+    }
+    write_trace_dump(path);
+    g_free(path);
+}
+
+
+/** \brief  Handler for state changes of 'app.trace'
+ *
+ * Enables all trace points compiled in, or disables tracing.
+ *
+ * \param[in]   action  action
+ * \param[in]   value   new state (boolean)
+ * \param[in]   data    user data
+ */
+static void on_trace_change_state(GSimpleAction *action,
+                                  GVariant      *value,
+                                  gpointer       data)
+{
+    trace_set_level(g_variant_get_boolean(value) ? TRACE_LEVEL_MAX
+                                                 : TRACE_LEVEL_OFF);
+    g_simple_action_set_state(action, value);
+}
+
+
+#ifdef G_OS_UNIX
+/** \brief  Handler for SIGUSR2
+ *
+ * Writes the trace buffer to TRACE_DUMP_FILE in the settings dir.
+ *
+ * \param[in]   data    extra data (unused)
+ *
+ * \return  G_SOURCE_CONTINUE
+ */
+static gboolean on_sigusr2(gpointer data)
+{
+    char *path = trace_dump_default_path();
+
+    write_trace_dump(path);
+    g_free(path);
+    return G_SOURCE_CONTINUE;
+}
+#endif
+
+
 /** \brief  List of event handlers for the 'app' actions
  */
 static const GActionEntry app_actions[] = {
@@ -94,10 +684,228 @@ static const GActionEntry app_actions[] = {
     {
         .name = "settings",
         .activate = on_app_settings
+    },
+
+    {
+        .name = "symbols-load",
+        .activate = on_symbols_load
+    },
+
+    {
+        .name = "checkpoints-import",
+        .activate = on_checkpoints_import
+    },
+
+    {
+        .name = "checkpoints-export",
+        .activate = on_checkpoints_export
+    },
+
+    {
+        .name = "snapshot-take",
+        .activate = on_snapshot_take
+    },
+
+    {
+        .name = "snapshot-restore",
+        .activate = on_snapshot_restore
+    },
+
+    {
+        .name = "snapshot-diff",
+        .activate = on_snapshot_diff
+    },
+
+    {
+        .name = "memory-upload",
+        .activate = on_memory_upload
+    },
+
+    {
+        .name = "keyboard-feed",
+        .activate = on_keyboard_feed
+    },
+
+    {
+        .name = "autostart",
+        .activate = on_autostart
+    },
+
+    {
+        .name = "warp-mode",
+        .state = "false",
+        .change_state = on_warp_mode_change_state
+    },
+
+    {
+        .name = "latency-report",
+        .activate = on_latency_report
+    },
+
+    {
+        .name = "frame-profiler",
+        .state = "false",
+        .change_state = on_frame_profiler_change_state
+    },
+
+    {
+        .name = "trace",
+        .state = "false",
+        .change_state = on_trace_change_state
+    },
+
+    {
+        .name = "trace-dump",
+        .activate = on_trace_dump
+    },
+
+    {
+        .name = "session-new",
+        .activate = on_session_new
     }
 };
 
 
+/** \brief  Command line options
+ */
+static const GOptionEntry cmdline_options[] = {
+    {
+        "snapshot-diff", 0, 0, G_OPTION_ARG_NONE, NULL,
+        "Compare snapshots OLD and NEW (files or names in the store) and exit",
+        NULL
+    },
+    {
+        "symbols", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+        "Load symbols from FILE",
+        "FILE"
+    },
+    {
+        "startup-time", 0, 0, G_OPTION_ARG_NONE, NULL,
+        "Print time to reach startup milestones on stderr",
+        NULL
+    },
+    {
+        G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, NULL,
+        NULL,
+        "[OLD NEW]"
+    },
+    { NULL }
+};
+
+
+/** \brief  Print diff of two snapshots on stdout
+ *
+ * \param[in]   old_name    old snapshot, file or name in the store
+ * \param[in]   new_name    new snapshot, file or name in the store
+ *
+ * \return  0 if equal, 1 if different, 2 on error (like diff(1))
+ */
+static int snapshot_diff_cmdline(const char *old_name, const char *new_name)
+{
+    snapdiff_t *diff;
+    GError *err = NULL;
+    size_t total = 0;
+    int status;
+
+    diff = snapdiff_new(old_name, new_name, &err);
+    if (diff == NULL) {
+        g_printerr("Failed to compare snapshots: %s\n", err->message);
+        g_error_free(err);
+        return 2;
+    }
+    for (guint i = 0; i < diff->ranges->len; i++) {
+        const snapdiff_range_t *range;
+        char *line;
+
+        range = &g_array_index(diff->ranges, snapdiff_range_t, i);
+        line = snapdiff_describe(range);
+        g_print("%s\n", line);
+        g_free(line);
+        total += range->length;
+    }
+    g_print("%u ranges, %zu bytes changed.\n", diff->ranges->len, total);
+    status = diff->ranges->len > 0 ? 1 : 0;
+    snapdiff_free(diff);
+    return status;
+}
+
+
+/** \brief  Handler for the 'handle-local-options' event of the application
+ *
+ * \param[in]   app     Main application
+ * \param[in]   options parsed options
+ * \param[in]   data    extra event data (unused)
+ *
+ * \return  exit status, or -1 to continue running the application
+ */
+static gint on_handle_local_options(GApplication *app,
+                                    GVariantDict *options,
+                                    gpointer      data)
+{
+    const char *symbols;
+    const char **files = NULL;
+    int status;
+
+    if (g_variant_dict_lookup(options, "symbols", "^&ay", &symbols)) {
+        GError *err = NULL;
+
+        if (symtab_load(symbols, SYMTAB_FORMAT_AUTO, &err) < 0) {
+            g_printerr("Failed to load symbols: %s\n", err->message);
+            g_error_free(err);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (g_variant_dict_contains(options, "startup-time")) {
+        startup_set_report(true);
+    }
+    if (!g_variant_dict_contains(options, "snapshot-diff")) {
+        return -1;
+    }
+    if (!g_variant_dict_lookup(options, G_OPTION_REMAINING, "^a&ay", &files)
+            || g_strv_length((char **)files) != 2) {
+        g_printerr("--snapshot-diff needs two snapshots: OLD NEW\n");
+        g_free(files);
+        return 2;
+    }
+    status = snapshot_diff_cmdline(files[0], files[1]);
+    g_free(files);
+    return status;
+}
+
+
+/** \brief  Handler for the 'after-paint' event of the main window's frame clock
+ *
+ * Records the first frame, then disconnects itself.
+ *
+ * \param[in]   clock   frame clock
+ * \param[in]   data    extra data (unused)
+ */
+static void on_first_frame(GdkFrameClock *clock, gpointer data)
+{
+    g_signal_handlers_disconnect_by_func(clock, G_CALLBACK(on_first_frame),
+                                         data);
+    startup_mark("first frame");
+}
+
+
+/** \brief  Handler for the 'startup' event of the application
+ *
+ * Runs once in the primary instance, unlike 'activate'.
+ *
+ * \param[in]   app     Main application
+ * \param[in]   data    extra event data (unused)
+ */
+static void on_app_startup(GtkApplication *app,
+                           gpointer        data)
+{
+#ifdef G_OS_UNIX
+    g_unix_signal_add(SIGUSR1, on_sigusr1, NULL);
+    g_unix_signal_add(SIGUSR2, on_sigusr2, NULL);
+#endif
+}
+
+
 /** \brief  Handler for the 'activate' event of the application
  *
  * \param[in]   app     Main application
@@ -110,6 +918,7 @@ static void on_app_activate(GtkApplication *app,
     GMenuModel *app_menu;
     GtkWidget *window;
 
+    startup_mark("activate");
     log_init();
     log_msg(LOG_DEBUG, "Log init.\n");
     builder = gtk_builder_new_from_resource(
@@ -127,8 +936,18 @@ static void on_app_activate(GtkApplication *app,
             app_actions,
             G_N_ELEMENTS(app_actions),
             window);
+    g_simple_action_set_state(
+            G_SIMPLE_ACTION(g_action_map_lookup_action(G_ACTION_MAP(app),
+                                                       "trace")),
+            g_variant_new_boolean(trace_get_level() > TRACE_LEVEL_OFF));
+    resources_add_listener(on_warp_mode_resource_changed,
+                           g_action_map_lookup_action(G_ACTION_MAP(app),
+                                                      "warp-mode"));
 
     gtk_widget_show_all(window);
+    startup_mark("window shown");
+    g_signal_connect(gtk_widget_get_frame_clock(window), "after-paint",
+                     G_CALLBACK(on_first_frame), NULL);
 }
 
 
@@ -149,23 +968,32 @@ int main(int argc, char *argv[])
     GtkApplication *app;
     int status;
 
+    startup_begin();
     debug_msg("called.");
 
     app = gtk_application_new(
             "org.vice.gtk3vicemon",
             G_APPLICATION_FLAGS_NONE);
+    g_signal_connect(app, "startup", G_CALLBACK(on_app_startup), NULL);
     g_signal_connect(app, "activate", G_CALLBACK(on_app_activate), NULL);
+    g_application_add_main_option_entries(G_APPLICATION(app), cmdline_options);
+    g_signal_connect(app, "handle-local-options",
+                     G_CALLBACK(on_handle_local_options), NULL);
 
     app_register_resource();
     /* create settings dir if it doesn't exist */
     if (!settings_init()) {
         return EXIT_FAILURE;
     }
+    trace_init();
 
 
     status = g_application_run(G_APPLICATION(app), argc, argv);
 
     app_unregister_resource();
+    symtab_exit();
+    snapstore_close();
+    trace_exit();
     settings_exit();
 
     return status;
@@ -0,0 +1,418 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   autostart.c
+ * \brief   Autostart and break
+ *
+ * Sets a temporary checkpoint at the break address and sends the autostart
+ * command in a single write. When the emulation stops at the checkpoint, the
+ * registers and the memory the panes usually show are fetched in a second
+ * single write, so a build-run-debug iteration costs two round trips.
+ *
+ * Other stops, such as VICE entering the monitor because of a command, are
+ * ignored until the PC matches the break address.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "log.h"
+#include "settings.h"
+#include "monitor.h"
+#include "vicemonapi.h"
+#include "connection.h"
+#include "checkpoint.h"
+#include "memcache.h"
+#include "registers.h"
+#include "resources.h"
+#include "session.h"
+
+#include "autostart.h"
+
+
+/** \brief  Number of bytes around the PC to fetch after the break
+ */
+#define PC_WINDOW   0x80
+
+
+/** \brief  Autostart states
+ */
+typedef enum state_e {
+    STATE_IDLE,         /**< nothing in progress */
+    STATE_STARTING,     /**< waiting for MON_RESPONSE_AUTOSTART */
+    STATE_RUNNING,      /**< waiting for the break */
+    STATE_FETCHING      /**< fetching registers and memory */
+} state_t;
+
+
+/** \brief  Current state
+ */
+static state_t state = STATE_IDLE;
+
+/** \brief  Session the autostart runs in
+ */
+static session_t *autostart_session = NULL;
+
+/** \brief  Break address, or AUTOSTART_NO_BREAK
+ */
+static int break_address = AUTOSTART_NO_BREAK;
+
+/** \brief  PC at the break
+ */
+static uint16_t stop_pc = 0;
+
+/** \brief  Function to call when done
+ */
+static autostart_done_cb done_callback = NULL;
+
+/** \brief  Data for \a done_callback
+ */
+static void *done_data = NULL;
+
+/** \brief  Timeout source ID
+ */
+static guint timeout_source = 0;
+
+/** \brief  Number of fetches in progress, plus one while sending
+ */
+static guint outstanding = 0;
+
+
+static void disarm(void);
+
+
+/** \brief  Finish autostart and call the callback
+ *
+ * \param[in]   result  result
+ * \param[in]   pc      program counter
+ */
+static void finish(autostart_result_t result, uint16_t pc)
+{
+    autostart_done_cb callback = done_callback;
+    void *data = done_data;
+
+    disarm();
+    if (result != AUTOSTART_STOPPED && break_address != AUTOSTART_NO_BREAK) {
+        const checkpoint_t *cp = checkpoint_find_at(MON_MEMSPACE_MAIN,
+                                                    (uint16_t)break_address,
+                                                    MON_CPU_OP_EXEC);
+        /* don't leave our checkpoint behind */
+        if (cp != NULL && cp->temporary && !cp->pending) {
+            checkpoint_delete(cp->number);
+        }
+    }
+    state = STATE_IDLE;
+    done_callback = NULL;
+    done_data = NULL;
+    if (callback != NULL) {
+        callback(result, pc, data);
+    }
+}
+
+
+/** \brief  Release a fetch, finish when all are done
+ */
+static void fetch_release(void)
+{
+    if (--outstanding == 0 && state == STATE_FETCHING) {
+        finish(AUTOSTART_STOPPED, stop_pc);
+    }
+}
+
+
+/** \brief  Callback for fetched memory and registers
+ *
+ * \param[in]   success fetch succeeded
+ * \param[in]   data    unused
+ */
+static void on_fetched(bool success, void *data)
+{
+    if (!success) {
+        log_msg(LOG_WARN, "Autostart: failed to fetch state after break.\n");
+    }
+    fetch_release();
+}
+
+
+/** \brief  Mark pages of \a start to \a end in \a pages
+ *
+ * \param[out]  pages   page bitmap
+ * \param[in]   start   start address
+ * \param[in]   end     end address (inclusive)
+ */
+static void mark_pages(uint64_t *pages, int start, int end)
+{
+    start = MAX(start, 0);
+    end = MIN(end, 0xffff);
+    for (int page = start / MEMCACHE_PAGE_SIZE;
+            page <= end / MEMCACHE_PAGE_SIZE;
+            page++) {
+        pages[page >> 6] |= (uint64_t)1 << (page & 63);
+    }
+}
+
+
+/** \brief  Fetch registers and memory after the break
+ */
+static void fetch_state(void)
+{
+    uint64_t pages[MEMCACHE_BITMAP_WORDS] = { 0 };
+
+    mark_pages(pages, 0x0000, 0x01ff);          /* zero page and stack */
+    mark_pages(pages, 0x0400, 0x07ff);          /* default screen */
+    mark_pages(pages, stop_pc - PC_WINDOW, stop_pc + PC_WINDOW);
+
+    state = STATE_FETCHING;
+    outstanding = 1;
+    connection_cork();
+    outstanding++;
+    if (!registers_fetch(on_fetched, NULL)) {
+        outstanding--;
+    }
+    outstanding++;
+    if (!memcache_fetch_pages(MON_MEMSPACE_MAIN, 0, pages, on_fetched, NULL)) {
+        outstanding--;
+    }
+    connection_uncork();
+    fetch_release();
+}
+
+
+/** \brief  Handler for MON_RESPONSE_STOPPED events
+ *
+ * \param[in]   response    response
+ * \param[in]   data        unused
+ */
+static void on_stopped_event(const mon_response_t *response, void *data)
+{
+    uint16_t pc;
+
+    if (state != STATE_RUNNING
+            || session_current() != autostart_session
+            || response_get_body_len(response) < 2) {
+        return;
+    }
+    pc = MON_GET_U16(response->body);
+    if (pc != (uint16_t)break_address) {
+        debug_msg("ignoring stop at $%04x", pc);
+        return;
+    }
+    stop_pc = pc;
+    fetch_state();
+}
+
+
+/** \brief  Handler for MON_RESPONSE_JAM events
+ *
+ * \param[in]   response    response
+ * \param[in]   data        unused
+ */
+static void on_jam_event(const mon_response_t *response, void *data)
+{
+    uint16_t pc = 0;
+
+    if (state != STATE_RUNNING || session_current() != autostart_session) {
+        return;
+    }
+    if (response_get_body_len(response) >= 2) {
+        pc = MON_GET_U16(response->body);
+    }
+    finish(AUTOSTART_JAM, pc);
+}
+
+
+/** \brief  Handler for the timeout
+ *
+ * \param[in]   data    unused
+ *
+ * \return  G_SOURCE_REMOVE
+ */
+static gboolean on_timeout(gpointer data)
+{
+    timeout_source = 0;
+    if (state == STATE_STARTING || state == STATE_RUNNING) {
+        session_push(autostart_session);
+        finish(AUTOSTART_TIMEOUT_EXPIRED, 0);
+        session_pop();
+    }
+    return G_SOURCE_REMOVE;
+}
+
+
+/** \brief  Remove event handlers and the timeout
+ */
+static void disarm(void)
+{
+    if (timeout_source != 0) {
+        g_source_remove(timeout_source);
+        timeout_source = 0;
+    }
+    connection_remove_event_handler(MON_RESPONSE_STOPPED,
+                                    on_stopped_event,
+                                    NULL);
+    connection_remove_event_handler(MON_RESPONSE_JAM, on_jam_event, NULL);
+}
+
+
+/** \brief  Handler for MON_RESPONSE_AUTOSTART
+ *
+ * \param[in]   response    response
+ * \param[in]   data        unused
+ */
+static void on_autostart_response(const mon_response_t *response, void *data)
+{
+    if (state != STATE_STARTING) {
+        return;
+    }
+    if (response->error_code != MON_ERR_OK) {
+        log_msg(LOG_WARN, "Autostart failed (error $%02x).\n",
+                response->error_code);
+        finish(AUTOSTART_FAILED, 0);
+        return;
+    }
+    if (break_address == AUTOSTART_NO_BREAK) {
+        finish(AUTOSTART_STARTED, 0);
+        return;
+    }
+    state = STATE_RUNNING;
+}
+
+
+/** \brief  Autostart file in the current session and stop at \a address
+ *
+ * \param[in]   path        file to autostart, as seen by VICE
+ * \param[in]   file_index  index of the file in an image (0 = first)
+ * \param[in]   address     break address, or AUTOSTART_NO_BREAK
+ * \param[in]   callback    function to call when done (optional)
+ * \param[in]   data        data for \a callback
+ * \param[out]  error       error (optional)
+ *
+ * \return  false on error
+ */
+bool autostart_and_break(const char *path,
+                         int file_index,
+                         int address,
+                         autostart_done_cb callback,
+                         void *data,
+                         GError **error)
+{
+    uint8_t body[4 + 0xff];
+    size_t len = strlen(path);
+    int timeout;
+
+    if (state != STATE_IDLE) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_BUSY,
+                    "an autostart is already in progress");
+        return false;
+    }
+    if (len > 0xff) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_FILENAME,
+                    "path too long");
+        return false;
+    }
+    body[0] = 1;    /* run */
+    MON_SET_U16(body + 1, (uint16_t)file_index);
+    body[3] = (uint8_t)len;
+    memcpy(body + 4, path, len);
+
+    autostart_session = session_current();
+    break_address = address;
+    done_callback = callback;
+    done_data = data;
+    state = STATE_STARTING;
+
+    connection_cork();
+    if (address != AUTOSTART_NO_BREAK
+            && !checkpoint_set(MON_MEMSPACE_MAIN,
+                               (uint16_t)address, (uint16_t)address,
+                               MON_CPU_OP_EXEC,
+                               true, true, true, NULL)) {
+        connection_uncork();
+        state = STATE_IDLE;
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                    "failed to set checkpoint");
+        return false;
+    }
+    if (connection_send_request(MON_CMD_AUTOSTART, body, 4 + len,
+                                on_autostart_response, NULL) == 0) {
+        connection_uncork();
+        state = STATE_IDLE;
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                    "failed to send autostart command");
+        return false;
+    }
+    /* autostarting needs the emulation to run */
+    connection_send_request(MON_CMD_EXIT, NULL, 0, NULL, NULL);
+    connection_uncork();
+
+    /* autostart resets the machine */
+    resources_invalidate_all();
+
+    connection_add_event_handler(MON_RESPONSE_STOPPED, on_stopped_event, NULL);
+    connection_add_event_handler(MON_RESPONSE_JAM, on_jam_event, NULL);
+    if (!settings_get_int("Autostart", "timeout", &timeout)) {
+        timeout = AUTOSTART_TIMEOUT;
+    }
+    timeout_source = g_timeout_add_seconds((guint)MAX(timeout, 1),
+                                           on_timeout,
+                                           NULL);
+    return true;
+}
+
+
+/** \brief  Cancel autostart in progress
+ *
+ * The callback is not called.
+ */
+void autostart_cancel(void)
+{
+    if (state == STATE_IDLE) {
+        return;
+    }
+    done_callback = NULL;
+    session_push(autostart_session);
+    finish(AUTOSTART_FAILED, 0);
+    session_pop();
+}
+
+
+/** \brief  Check if an autostart is in progress
+ *
+ * \return  true if busy
+ */
+bool autostart_busy(void)
+{
+    return state != STATE_IDLE;
+}
@@ -0,0 +1,86 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   autostart.h
+ * \brief   Autostart and break - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#ifndef MON_AUTOSTART_H_
+#define MON_AUTOSTART_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <glib.h>
+
+/** \brief  Break address meaning "don't break"
+ */
+#define AUTOSTART_NO_BREAK  (-1)
+
+/** \brief  Default number of seconds to wait for the break
+ */
+#define AUTOSTART_TIMEOUT   30
+
+
+/** \brief  Autostart results
+ */
+typedef enum autostart_result_e {
+    AUTOSTART_STOPPED,  /**< stopped at the break address */
+    AUTOSTART_STARTED,  /**< started, no break address given */
+    AUTOSTART_JAM,      /**< CPU jammed before reaching the break address */
+    AUTOSTART_TIMEOUT_EXPIRED, /**< break address not reached in time */
+    AUTOSTART_FAILED    /**< VICE failed to autostart the file */
+} autostart_result_t;
+
+
+/** \brief  Callback for finished autostarts
+ *
+ * On AUTOSTART_STOPPED the registers and the memory around the PC, the zero
+ * page, the stack and the default screen are in the register and memory
+ * caches.
+ *
+ * \param[in]   result  result
+ * \param[in]   pc      program counter for AUTOSTART_STOPPED and AUTOSTART_JAM
+ * \param[in]   data    data passed to autostart_and_break()
+ */
+typedef void (*autostart_done_cb)(autostart_result_t result,
+                                  uint16_t pc,
+                                  void *data);
+
+
+bool autostart_and_break(const char *path,
+                         int file_index,
+                         int address,
+                         autostart_done_cb callback,
+                         void *data,
+                         GError **error);
+void autostart_cancel(void);
+bool autostart_busy(void);
+
+#endif
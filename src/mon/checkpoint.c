@@ -0,0 +1,1061 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   checkpoint.c
+ * \brief   Checkpoint management
+ *
+ * Keeps a local copy of the checkpoints in VICE, kept in sync with the
+ * MON_RESPONSE_CHECKPOINT_INFO responses and events sent by VICE.
+ *
+ * Besides the table of checkpoints indexed by checkpoint number, a reference
+ * count per address, CPU operation and memspace is kept, so the UI can check
+ * if an address has a checkpoint without walking the table or asking VICE.
+ *
+ * Setting, deleting and toggling checkpoints is optimistic: the local table is
+ * updated immediately and the change is rolled back when VICE reports an
+ * error.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "log.h"
+#include "../ui/logview.h"
+#include "monitor.h"
+#include "vicemonapi.h"
+#include "connection.h"
+#include "session.h"
+
+#include "checkpoint.h"
+
+
+/** \brief  Number of CPU operation bits
+ */
+#define CPU_OP_COUNT    3
+
+/** \brief  Size of the CHECKPOINT_INFO body without the memspace byte
+ */
+#define CHECKPOINT_INFO_SIZE    22
+
+
+/** \brief  Request data for toggle and condition requests
+ */
+typedef struct cp_request_s {
+    uint32_t number;    /**< checkpoint number */
+    bool enabled;       /**< previous enabled state */
+    char *condition;    /**< previous condition */
+} cp_request_t;
+
+
+/** \brief  Listener object
+ */
+typedef struct listener_s {
+    checkpoint_listener_cb callback;    /**< callback */
+    void *data;                         /**< data for \a callback */
+} listener_t;
+
+
+/** \brief  Checkpoint table of a session
+ *
+ * The reference counts per memspace, CPU operation and address are allocated
+ * on first use.
+ */
+struct checkpoint_ctx_s {
+    GHashTable *checkpoints;    /**< acknowledged by VICE, indexed by number */
+    GHashTable *pending_sets;   /**< waiting for a MON_CMD_CHECKPOINT_SET
+                                     response, indexed by request ID */
+    uint16_t *refcounts[MON_MEMSPACE_COUNT][CPU_OP_COUNT];  /**< refcounts */
+    GPtrArray *unrestored;      /**< waiting to be restored in VICE */
+};
+
+
+/** \brief  List of listeners, shared by all sessions
+ */
+static GSList *listeners = NULL;
+
+
+/** \brief  Free checkpoint
+ *
+ * \param[in]   cp  checkpoint
+ */
+static void checkpoint_free(gpointer cp)
+{
+    g_free(((checkpoint_t *)cp)->condition);
+    g_free(cp);
+}
+
+
+/** \brief  Get checkpoint table of the current session
+ *
+ * \return  checkpoint table
+ */
+static checkpoint_ctx_t *ctx(void)
+{
+    return session_current()->checkpoint;
+}
+
+
+/** \brief  Notify listeners of a change in the checkpoint table
+ */
+static void notify_listeners(void)
+{
+    GSList *node;
+
+    for (node = listeners; node != NULL; node = node->next) {
+        listener_t *listener = node->data;
+
+        listener->callback(listener->data);
+    }
+}
+
+
+/** \brief  Report failed checkpoint operation
+ *
+ * \param[in]   what        description of the operation
+ * \param[in]   response    response containing the error
+ */
+static void report_error(const char *what, const mon_response_t *response)
+{
+    log_msg(LOG_ERR, "%s failed: error $%02x.\n", what, response->error_code);
+    logview_add("err", "%s failed: error $%02x.\n", what, response->error_code);
+}
+
+
+/** \brief  Add \a delta to the reference counts of the range of \a cp
+ *
+ * \param[in]   cp      checkpoint
+ * \param[in]   delta   1 to add, -1 to remove
+ */
+static void index_update(const checkpoint_t *cp, int delta)
+{
+    checkpoint_ctx_t *table = ctx();
+
+    for (int bit = 0; bit < CPU_OP_COUNT; bit++) {
+        uint16_t *counts;
+
+        if ((cp->op & (1 << bit)) == 0) {
+            continue;
+        }
+        counts = table->refcounts[cp->memspace][bit];
+        if (counts == NULL) {
+            counts = g_new0(uint16_t, 0x10000);
+            table->refcounts[cp->memspace][bit] = counts;
+        }
+        for (uint32_t addr = cp->start; addr <= cp->end; addr++) {
+            counts[addr] = (uint16_t)(counts[addr] + delta);
+        }
+    }
+}
+
+
+/** \brief  Store \a cp in the table, replacing any checkpoint with the same number
+ *
+ * The table takes ownership of \a cp.
+ *
+ * \param[in]   cp  checkpoint
+ */
+static void store_checkpoint(checkpoint_t *cp)
+{
+    checkpoint_t *old;
+
+    old = g_hash_table_lookup(ctx()->checkpoints, GUINT_TO_POINTER(cp->number));
+    if (old != NULL) {
+        if (cp->has_condition && cp->condition == NULL) {
+            /* VICE doesn't report the expression, keep ours */
+            cp->condition = old->condition;
+            old->condition = NULL;
+        }
+        index_update(old, -1);
+    }
+    index_update(cp, 1);
+    g_hash_table_replace(ctx()->checkpoints, GUINT_TO_POINTER(cp->number), cp);
+}
+
+
+/** \brief  Store checkpoint info from \a response in the table
+ *
+ * \param[in]   response    MON_RESPONSE_CHECKPOINT_INFO response
+ *
+ * \return  stored checkpoint or `NULL` on error
+ */
+static checkpoint_t *store_info(const mon_response_t *response)
+{
+    checkpoint_t *cp = g_malloc0(sizeof *cp);
+
+    if (!checkpoint_decode_info(response->body,
+                                response_get_body_len(response),
+                                cp)) {
+        log_msg(LOG_WARN, "Invalid checkpoint info.\n");
+        g_free(cp);
+        return NULL;
+    }
+    store_checkpoint(cp);
+    return cp;
+}
+
+
+/** \brief  Handler for MON_RESPONSE_CHECKPOINT_INFO events
+ *
+ * Sent by VICE when a checkpoint is hit.
+ *
+ * \param[in]   response    response
+ * \param[in]   data        extra data (unused)
+ */
+static void on_checkpoint_event(const mon_response_t *response, void *data)
+{
+    checkpoint_t *cp = store_info(response);
+
+    if (cp != NULL && cp->temporary && cp->hit) {
+        /* VICE deletes temporary checkpoints once hit */
+        index_update(cp, -1);
+        g_hash_table_remove(ctx()->checkpoints, GUINT_TO_POINTER(cp->number));
+    }
+    notify_listeners();
+}
+
+
+/** \brief  Handler for MON_RESPONSE_RESUMED events
+ *
+ * Clears the 'hit' state of all checkpoints.
+ *
+ * \param[in]   response    response
+ * \param[in]   data        extra data (unused)
+ */
+static void on_resumed_event(const mon_response_t *response, void *data)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, ctx()->checkpoints);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        ((checkpoint_t *)value)->hit = false;
+    }
+}
+
+
+/** \brief  Create checkpoint table for a session
+ *
+ * \return  checkpoint table
+ */
+checkpoint_ctx_t *checkpoint_ctx_new(void)
+{
+    checkpoint_ctx_t *table = g_malloc0(sizeof *table);
+
+    table->checkpoints = g_hash_table_new_full(NULL, NULL, NULL,
+                                               checkpoint_free);
+    table->pending_sets = g_hash_table_new_full(NULL, NULL, NULL,
+                                                checkpoint_free);
+    return table;
+}
+
+
+/** \brief  Free checkpoint table of a session
+ *
+ * Doesn't touch the checkpoints in VICE.
+ *
+ * \param[in]   table   checkpoint table
+ */
+void checkpoint_ctx_free(checkpoint_ctx_t *table)
+{
+    g_hash_table_destroy(table->checkpoints);
+    g_hash_table_destroy(table->pending_sets);
+    if (table->unrestored != NULL) {
+        g_ptr_array_free(table->unrestored, TRUE);
+    }
+    for (int ms = 0; ms < MON_MEMSPACE_COUNT; ms++) {
+        for (int bit = 0; bit < CPU_OP_COUNT; bit++) {
+            g_free(table->refcounts[ms][bit]);
+        }
+    }
+    g_free(table);
+}
+
+
+/** \brief  Register the event handlers of the checkpoint tables
+ */
+void checkpoint_init(void)
+{
+    connection_add_event_handler(MON_RESPONSE_CHECKPOINT_INFO,
+                                 on_checkpoint_event,
+                                 NULL);
+    connection_add_event_handler(MON_RESPONSE_RESUMED,
+                                 on_resumed_event,
+                                 NULL);
+}
+
+
+/** \brief  Free resources used by the checkpoint table
+ */
+void checkpoint_exit(void)
+{
+    connection_remove_event_handler(MON_RESPONSE_CHECKPOINT_INFO,
+                                    on_checkpoint_event,
+                                    NULL);
+    connection_remove_event_handler(MON_RESPONSE_RESUMED,
+                                    on_resumed_event,
+                                    NULL);
+    g_slist_free_full(listeners, g_free);
+    listeners = NULL;
+}
+
+
+/** \brief  Clear the local checkpoint table
+ *
+ * Doesn't touch the checkpoints in VICE.
+ */
+void checkpoint_clear(void)
+{
+    checkpoint_ctx_t *table = ctx();
+
+    g_hash_table_remove_all(table->checkpoints);
+    g_hash_table_remove_all(table->pending_sets);
+    for (int ms = 0; ms < MON_MEMSPACE_COUNT; ms++) {
+        for (int bit = 0; bit < CPU_OP_COUNT; bit++) {
+            if (table->refcounts[ms][bit] != NULL) {
+                memset(table->refcounts[ms][bit], 0, 0x10000 * sizeof(uint16_t));
+            }
+        }
+    }
+    notify_listeners();
+}
+
+
+/** \brief  Handler for MON_CMD_CHECKPOINT_LIST responses
+ *
+ * Checkpoints not reported by VICE are removed once the final response
+ * arrives.
+ *
+ * \param[in]   response    response
+ * \param[in]   data        set of checkpoint numbers seen so far
+ */
+static void on_list_response(const mon_response_t *response, void *data)
+{
+    GHashTable *seen = data;
+    GHashTableIter iter;
+    gpointer value;
+
+    if (response->error_code != MON_ERR_OK) {
+        report_error("Listing checkpoints", response);
+        g_hash_table_destroy(seen);
+        return;
+    }
+
+    if (response->type == MON_RESPONSE_CHECKPOINT_INFO) {
+        checkpoint_t *cp = store_info(response);
+
+        if (cp != NULL) {
+            g_hash_table_add(seen, GUINT_TO_POINTER(cp->number));
+        }
+        return;
+    }
+
+    /* final response: drop stale checkpoints */
+    g_hash_table_iter_init(&iter, ctx()->checkpoints);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        checkpoint_t *cp = value;
+
+        if (!g_hash_table_contains(seen, GUINT_TO_POINTER(cp->number))) {
+            index_update(cp, -1);
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+    debug_msg("Synced %u checkpoints.", g_hash_table_size(ctx()->checkpoints));
+    g_hash_table_destroy(seen);
+    notify_listeners();
+}
+
+
+/** \brief  Synchronize local checkpoint table with VICE
+ *
+ * Sends MON_CMD_CHECKPOINT_LIST, the table is updated when the responses
+ * arrive.
+ */
+void checkpoint_sync(void)
+{
+    GHashTable *seen = g_hash_table_new(NULL, NULL);
+
+    if (connection_send_request(MON_CMD_CHECKPOINT_LIST, NULL, 0,
+                                on_list_response, seen) == 0) {
+        g_hash_table_destroy(seen);
+    }
+}
+
+
+/** \brief  Check if \a a and \a b cover the same memspace, range and operation
+ *
+ * \param[in]   a   checkpoint
+ * \param[in]   b   checkpoint
+ *
+ * \return  true if the same
+ */
+static bool same_checkpoint(const checkpoint_t *a, const checkpoint_t *b)
+{
+    return a->memspace == b->memspace
+        && a->start == b->start
+        && a->end == b->end
+        && a->op == b->op;
+}
+
+
+/** \brief  Find checkpoint in the table matching \a wanted
+ *
+ * \param[in]   wanted  checkpoint to look for
+ *
+ * \return  checkpoint with the same memspace, range and operation, or NULL
+ */
+static checkpoint_t *find_same(const checkpoint_t *wanted)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, ctx()->checkpoints);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        if (same_checkpoint(value, wanted)) {
+            return value;
+        }
+    }
+    return NULL;
+}
+
+
+/** \brief  Handler for MON_CMD_CHECKPOINT_LIST responses of a restore
+ *
+ * Once VICE's checkpoints are known, the wanted checkpoints VICE doesn't
+ * have are set again.
+ *
+ * \param[in]   response    response
+ * \param[in]   data        extra data (unused)
+ */
+static void on_restore_response(const mon_response_t *response, void *data)
+{
+    checkpoint_ctx_t *table = ctx();
+    int restored = 0;
+
+    if (response->error_code == MON_ERR_OK
+            && response->type == MON_RESPONSE_CHECKPOINT_INFO) {
+        store_info(response);
+        return;
+    }
+    if (response->error_code == CONNECTION_ERR_LOST
+            || table->unrestored == NULL) {
+        /* try again on the next reconnect */
+        return;
+    }
+    if (response->error_code != MON_ERR_OK) {
+        report_error("Listing checkpoints", response);
+    }
+
+    for (guint i = 0; i < table->unrestored->len; i++) {
+        checkpoint_t *want = g_ptr_array_index(table->unrestored, i);
+        checkpoint_t *cp = find_same(want);
+
+        if (cp == NULL) {
+            checkpoint_set(want->memspace, want->start, want->end, want->op,
+                           want->stop, want->enabled, want->temporary,
+                           want->condition);
+            restored++;
+        } else {
+            if (cp->enabled != want->enabled) {
+                checkpoint_toggle(cp->number, want->enabled);
+            }
+            if (want->condition != NULL && !cp->has_condition) {
+                checkpoint_set_condition(cp->number, want->condition);
+            }
+        }
+    }
+    debug_msg("Restored %d of %u checkpoints.", restored, table->unrestored->len);
+    g_ptr_array_free(table->unrestored, TRUE);
+    table->unrestored = NULL;
+    notify_listeners();
+}
+
+
+/** \brief  Add copy of \a value to the checkpoints to restore
+ *
+ * \param[in]   key     unused
+ * \param[in]   value   checkpoint
+ * \param[in]   data    list of checkpoints to restore
+ */
+static void add_unrestored(gpointer key, gpointer value, gpointer data)
+{
+    GPtrArray *unrestored = data;
+    const checkpoint_t *cp = value;
+    checkpoint_t *copy;
+
+    for (guint i = 0; i < unrestored->len; i++) {
+        if (same_checkpoint(g_ptr_array_index(unrestored, i), cp)) {
+            return;
+        }
+    }
+    copy = g_malloc(sizeof *copy);
+    *copy = *cp;
+    copy->condition = g_strdup(cp->condition);
+    g_ptr_array_add(unrestored, copy);
+}
+
+
+/** \brief  Re-apply the local checkpoint table after a reconnect
+ *
+ * VICE may have been restarted and lost its checkpoints, or it may still
+ * have them when only the connection was lost. The checkpoints are listed
+ * first, and only the local checkpoints VICE doesn't have are set again.
+ * Checkpoints that were being set when the connection was lost are
+ * included, and so are the checkpoints of a restore that was interrupted.
+ */
+void checkpoint_restore(void)
+{
+    checkpoint_ctx_t *table = ctx();
+
+    if (table->unrestored == NULL) {
+        table->unrestored = g_ptr_array_new_with_free_func(checkpoint_free);
+    }
+    g_hash_table_foreach(table->checkpoints, add_unrestored, table->unrestored);
+    g_hash_table_foreach(table->pending_sets, add_unrestored, table->unrestored);
+    checkpoint_clear();
+
+    connection_send_request(MON_CMD_CHECKPOINT_LIST, NULL, 0,
+                            on_restore_response, NULL);
+}
+
+
+/** \brief  Handler for MON_CMD_CHECKPOINT_SET responses
+ *
+ * \param[in]   response    response
+ * \param[in]   data        extra data (unused)
+ */
+static void on_set_response(const mon_response_t *response, void *data)
+{
+    gpointer key = GUINT_TO_POINTER(response_get_request_id(response));
+    checkpoint_t *cp;
+    checkpoint_t info;
+    char *condition;
+
+    cp = g_hash_table_lookup(ctx()->pending_sets, key);
+    if (cp == NULL || response->error_code == CONNECTION_ERR_LOST) {
+        /* kept for checkpoint_restore() */
+        return;
+    }
+    g_hash_table_steal(ctx()->pending_sets, key);
+    index_update(cp, -1);
+
+    if (response->error_code != MON_ERR_OK
+            || !checkpoint_decode_info(response->body,
+                                       response_get_body_len(response),
+                                       &info)) {
+        report_error("Setting checkpoint", response);
+        checkpoint_free(cp);
+        notify_listeners();
+        return;
+    }
+
+    /* VICE is authoritative */
+    info.condition = NULL;
+    condition = cp->condition;
+    cp->condition = NULL;
+    *cp = info;
+    store_checkpoint(cp);
+    if (condition != NULL) {
+        /* requested with the checkpoint, now that we know its number */
+        checkpoint_set_condition(cp->number, condition);
+        g_free(condition);
+    }
+    notify_listeners();
+}
+
+
+/** \brief  Set checkpoint
+ *
+ * The checkpoint is added to the local table immediately, and removed again
+ * if VICE reports an error.
+ *
+ * \param[in]   memspace    memspace
+ * \param[in]   start       start address
+ * \param[in]   end         end address (inclusive)
+ * \param[in]   op          CPU operation(s)
+ * \param[in]   stop        stop when hit
+ * \param[in]   enabled     enable checkpoint
+ * \param[in]   temporary   delete checkpoint after first hit
+ * \param[in]   condition   condition expression (optional)
+ *
+ * The condition is set with MON_CMD_CONDITION_SET once VICE has reported the
+ * number of the new checkpoint.
+ *
+ * \return  true if the command was sent
+ */
+bool checkpoint_set(uint8_t memspace,
+                    uint16_t start,
+                    uint16_t end,
+                    uint8_t op,
+                    bool stop,
+                    bool enabled,
+                    bool temporary,
+                    const char *condition)
+{
+    checkpoint_t *cp;
+    uint8_t body[9];
+    size_t len = 8;
+    uint32_t req_id;
+
+    if (memspace >= MON_MEMSPACE_COUNT || end < start) {
+        return false;
+    }
+
+    MON_SET_U16(body, start);
+    MON_SET_U16(body + 2, end);
+    body[4] = stop;
+    body[5] = enabled;
+    body[6] = op;
+    body[7] = temporary;
+    if (memspace != MON_MEMSPACE_MAIN) {
+        /* optional field, only supported by newer VICE versions */
+        body[8] = memspace;
+        len = 9;
+    }
+
+    req_id = connection_send_request(MON_CMD_CHECKPOINT_SET, body, len,
+                                     on_set_response, NULL);
+    if (req_id == 0) {
+        return false;
+    }
+
+    cp = g_malloc0(sizeof *cp);
+    cp->start = start;
+    cp->end = end;
+    cp->op = op;
+    cp->memspace = memspace;
+    cp->stop = stop;
+    cp->enabled = enabled;
+    cp->temporary = temporary;
+    cp->condition = g_strdup(condition);
+    cp->has_condition = condition != NULL;
+    cp->pending = true;
+    g_hash_table_insert(ctx()->pending_sets, GUINT_TO_POINTER(req_id), cp);
+    index_update(cp, 1);
+    notify_listeners();
+    return true;
+}
+
+
+/** \brief  Handler for MON_CMD_CHECKPOINT_DELETE responses
+ *
+ * The checkpoint is only put back when VICE refused to delete it. When the
+ * connection was lost the deletion stands, restoring the checkpoints after
+ * a reconnect would otherwise create it again.
+ *
+ * \param[in]   response    response
+ * \param[in]   data        deleted checkpoint
+ */
+static void on_delete_response(const mon_response_t *response, void *data)
+{
+    checkpoint_t *cp = data;
+
+    if (response->error_code != MON_ERR_OK
+            && response->error_code != CONNECTION_ERR_LOST) {
+        report_error("Deleting checkpoint", response);
+        store_checkpoint(cp);
+        notify_listeners();
+        return;
+    }
+    checkpoint_free(cp);
+}
+
+
+/** \brief  Delete checkpoint \a number
+ *
+ * \param[in]   number  checkpoint number
+ *
+ * \return  true if the command was sent
+ */
+bool checkpoint_delete(uint32_t number)
+{
+    checkpoint_t *cp;
+    uint8_t body[4];
+
+    cp = g_hash_table_lookup(ctx()->checkpoints, GUINT_TO_POINTER(number));
+    if (cp == NULL) {
+        return false;
+    }
+    g_hash_table_steal(ctx()->checkpoints, GUINT_TO_POINTER(number));
+    index_update(cp, -1);
+
+    MON_SET_U32(body, number);
+    if (connection_send_request(MON_CMD_CHECKPOINT_DELETE, body, sizeof(body),
+                                on_delete_response, cp) == 0) {
+        store_checkpoint(cp);
+        return false;
+    }
+    notify_listeners();
+    return true;
+}
+
+
+/** \brief  Handler for MON_CMD_CHECKPOINT_TOGGLE responses
+ *
+ * The old state is only put back when VICE refused the toggle. When the
+ * connection was lost the new state stands, it's applied again when the
+ * checkpoints are restored after a reconnect.
+ *
+ * \param[in]   response    response
+ * \param[in]   data        request data
+ */
+static void on_toggle_response(const mon_response_t *response, void *data)
+{
+    cp_request_t *req = data;
+
+    if (response->error_code != MON_ERR_OK
+            && response->error_code != CONNECTION_ERR_LOST) {
+        checkpoint_t *cp;
+
+        report_error("Toggling checkpoint", response);
+        cp = g_hash_table_lookup(ctx()->checkpoints,
+                                 GUINT_TO_POINTER(req->number));
+        if (cp != NULL) {
+            cp->enabled = req->enabled;
+            notify_listeners();
+        }
+    }
+    g_free(req);
+}
+
+
+/** \brief  Enable or disable checkpoint \a number
+ *
+ * \param[in]   number  checkpoint number
+ * \param[in]   enabled new state
+ *
+ * \return  true if the command was sent
+ */
+bool checkpoint_toggle(uint32_t number, bool enabled)
+{
+    checkpoint_t *cp;
+    cp_request_t *req;
+    uint8_t body[5];
+
+    cp = g_hash_table_lookup(ctx()->checkpoints, GUINT_TO_POINTER(number));
+    if (cp == NULL) {
+        return false;
+    }
+
+    req = g_malloc0(sizeof *req);
+    req->number = number;
+    req->enabled = cp->enabled;
+
+    MON_SET_U32(body, number);
+    body[4] = enabled;
+    if (connection_send_request(MON_CMD_CHECKPOINT_TOGGLE, body, sizeof(body),
+                                on_toggle_response, req) == 0) {
+        g_free(req);
+        return false;
+    }
+    cp->enabled = enabled;
+    notify_listeners();
+    return true;
+}
+
+
+/** \brief  Handler for MON_CMD_CONDITION_SET responses
+ *
+ * \param[in]   response    response
+ * \param[in]   data        request data
+ */
+static void on_condition_response(const mon_response_t *response, void *data)
+{
+    cp_request_t *req = data;
+
+    if (response->error_code != MON_ERR_OK) {
+        checkpoint_t *cp;
+
+        report_error("Setting condition", response);
+        cp = g_hash_table_lookup(ctx()->checkpoints,
+                                 GUINT_TO_POINTER(req->number));
+        if (cp != NULL) {
+            g_free(cp->condition);
+            cp->condition = req->condition;
+            cp->has_condition = req->condition != NULL;
+            req->condition = NULL;
+            notify_listeners();
+        }
+    }
+    g_free(req->condition);
+    g_free(req);
+}
+
+
+/** \brief  Set condition of checkpoint \a number to \a condition
+ *
+ * \param[in]   number      checkpoint number
+ * \param[in]   condition   condition expression, in VICE monitor syntax
+ *
+ * \return  true if the command was sent
+ */
+bool checkpoint_set_condition(uint32_t number, const char *condition)
+{
+    checkpoint_t *cp;
+    cp_request_t *req;
+    uint8_t body[4 + 1 + 255];
+    size_t len = strlen(condition);
+
+    cp = g_hash_table_lookup(ctx()->checkpoints, GUINT_TO_POINTER(number));
+    if (cp == NULL || len > 255) {
+        return false;
+    }
+
+    MON_SET_U32(body, number);
+    body[4] = (uint8_t)len;
+    memcpy(body + 5, condition, len);
+
+    req = g_malloc0(sizeof *req);
+    req->number = number;
+    if (connection_send_request(MON_CMD_CONDITION_SET, body, 5 + len,
+                                on_condition_response, req) == 0) {
+        g_free(req);
+        return false;
+    }
+    req->condition = cp->condition;
+    cp->condition = g_strdup(condition);
+    cp->has_condition = true;
+    notify_listeners();
+    return true;
+}
+
+
+/** \brief  Check if there is a checkpoint at \a addr
+ *
+ * This is a constant time lookup, so it can be used when rendering views.
+ *
+ * \param[in]   memspace    memspace
+ * \param[in]   addr        address
+ * \param[in]   op          CPU operation(s) to check
+ *
+ * \return  true if any checkpoint for \a op covers \a addr
+ */
+bool checkpoint_has_at(uint8_t memspace, uint16_t addr, uint8_t op)
+{
+    if (memspace >= MON_MEMSPACE_COUNT) {
+        return false;
+    }
+    for (int bit = 0; bit < CPU_OP_COUNT; bit++) {
+        const uint16_t *counts = ctx()->refcounts[memspace][bit];
+
+        if ((op & (1 << bit)) && counts != NULL && counts[addr] > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/** \brief  Check if \a cp matches \a memspace, \a addr and \a op
+ */
+static bool matches(const checkpoint_t *cp,
+                    uint8_t memspace,
+                    uint16_t addr,
+                    uint8_t op)
+{
+    return cp->memspace == memspace
+        && (cp->op & op) != 0
+        && addr >= cp->start
+        && addr <= cp->end;
+}
+
+
+/** \brief  Find a checkpoint covering \a addr
+ *
+ * \param[in]   memspace    memspace
+ * \param[in]   addr        address
+ * \param[in]   op          CPU operation(s) to check
+ *
+ * \return  checkpoint or `NULL` when not found
+ */
+const checkpoint_t *checkpoint_find_at(uint8_t memspace,
+                                       uint16_t addr,
+                                       uint8_t op)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    if (!checkpoint_has_at(memspace, addr, op)) {
+        return NULL;
+    }
+
+    g_hash_table_iter_init(&iter, ctx()->checkpoints);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        if (matches(value, memspace, addr, op)) {
+            return value;
+        }
+    }
+    g_hash_table_iter_init(&iter, ctx()->pending_sets);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        if (matches(value, memspace, addr, op)) {
+            return value;
+        }
+    }
+    return NULL;
+}
+
+
+/** \brief  Look up checkpoint by number
+ *
+ * \param[in]   number  checkpoint number
+ *
+ * \return  checkpoint or `NULL` when not found
+ */
+const checkpoint_t *checkpoint_lookup(uint32_t number)
+{
+    return g_hash_table_lookup(ctx()->checkpoints, GUINT_TO_POINTER(number));
+}
+
+
+/** \brief  Get number of checkpoints, including pending ones
+ *
+ * \return  number of checkpoints
+ */
+size_t checkpoint_count(void)
+{
+    checkpoint_ctx_t *table = ctx();
+
+    return g_hash_table_size(table->checkpoints)
+        + g_hash_table_size(table->pending_sets);
+}
+
+
+/** \brief  Compare checkpoints by number
+ */
+static gint compare_number(gconstpointer a, gconstpointer b)
+{
+    const checkpoint_t *cp1 = a;
+    const checkpoint_t *cp2 = b;
+
+    if (cp1->number < cp2->number) {
+        return -1;
+    }
+    return cp1->number > cp2->number;
+}
+
+
+/** \brief  Call \a callback for each checkpoint
+ *
+ * Acknowledged checkpoints are passed in order of their number, pending
+ * checkpoints are passed last.
+ *
+ * \param[in]   callback    function to call
+ * \param[in]   data        data for \a callback
+ */
+void checkpoint_foreach(checkpoint_foreach_cb callback, void *data)
+{
+    checkpoint_ctx_t *table = ctx();
+    GList *list;
+    GList *node;
+
+    list = g_list_sort(g_hash_table_get_values(table->checkpoints),
+                       compare_number);
+    list = g_list_concat(list, g_hash_table_get_values(table->pending_sets));
+    for (node = list; node != NULL; node = node->next) {
+        callback(node->data, data);
+    }
+    g_list_free(list);
+}
+
+
+/** \brief  Decode MON_RESPONSE_CHECKPOINT_INFO body
+ *
+ * \param[in]   body    response body
+ * \param[in]   len     length of \a body
+ * \param[out]  cp      checkpoint
+ *
+ * \return  false if \a body is too short
+ */
+bool checkpoint_decode_info(const uint8_t *body, size_t len, checkpoint_t *cp)
+{
+    if (len < CHECKPOINT_INFO_SIZE) {
+        return false;
+    }
+    cp->number = MON_GET_U32(body);
+    cp->hit = body[4];
+    cp->start = MON_GET_U16(body + 5);
+    cp->end = MON_GET_U16(body + 7);
+    cp->stop = body[9];
+    cp->enabled = body[10];
+    cp->op = body[11];
+    cp->temporary = body[12];
+    cp->hit_count = MON_GET_U32(body + 13);
+    cp->ignore_count = MON_GET_U32(body + 17);
+    cp->has_condition = body[21];
+    cp->memspace = MON_MEMSPACE_MAIN;
+    if (len > CHECKPOINT_INFO_SIZE && body[22] < MON_MEMSPACE_COUNT) {
+        cp->memspace = body[22];
+    }
+    cp->pending = false;
+    cp->condition = NULL;
+    if (cp->end < cp->start) {
+        cp->end = cp->start;
+    }
+    return true;
+}
+
+
+/** \brief  Register \a callback to be called when the table changes
+ *
+ * \param[in]   callback    function to call
+ * \param[in]   data        data for \a callback
+ */
+void checkpoint_add_listener(checkpoint_listener_cb callback, void *data)
+{
+    listener_t *listener = g_malloc(sizeof *listener);
+
+    listener->callback = callback;
+    listener->data = data;
+    listeners = g_slist_append(listeners, listener);
+}
+
+
+/** \brief  Unregister listener
+ *
+ * \param[in]   callback    function registered
+ * \param[in]   data        data registered
+ */
+void checkpoint_remove_listener(checkpoint_listener_cb callback, void *data)
+{
+    GSList *node;
+
+    for (node = listeners; node != NULL; node = node->next) {
+        listener_t *listener = node->data;
+
+        if (listener->callback == callback && listener->data == data) {
+            listeners = g_slist_delete_link(listeners, node);
+            g_free(listener);
+            return;
+        }
+    }
+}
@@ -0,0 +1,116 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   checkpoint.h
+ * \brief   Checkpoint management - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#ifndef MON_CHECKPOINT_H_
+#define MON_CHECKPOINT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+
+/** \brief  Local copy of a checkpoint in VICE
+ */
+typedef struct checkpoint_s {
+    uint32_t number;        /**< checkpoint number, 0 while pending */
+    uint16_t start;         /**< start address */
+    uint16_t end;           /**< end address (inclusive) */
+    uint8_t  op;            /**< CPU operation(s), see vicemon_cpu_op_t */
+    uint8_t  memspace;      /**< memspace, see vicemon_memspace_t */
+    bool     stop;          /**< stop when hit */
+    bool     enabled;       /**< checkpoint is enabled */
+    bool     temporary;     /**< delete checkpoint after first hit */
+    bool     hit;           /**< checkpoint is currently hit */
+    bool     has_condition; /**< checkpoint has a condition */
+    bool     pending;       /**< not yet acknowledged by VICE */
+    uint32_t hit_count;     /**< number of hits */
+    uint32_t ignore_count;  /**< number of hits to ignore */
+    char    *condition;     /**< condition expression, if known */
+} checkpoint_t;
+
+
+/** \brief  Checkpoint table of a session (opaque)
+ */
+typedef struct checkpoint_ctx_s checkpoint_ctx_t;
+
+
+/** \brief  Callback for checkpoint table changes
+ *
+ * \param[in]   data    data passed to checkpoint_add_listener()
+ */
+typedef void (*checkpoint_listener_cb)(void *data);
+
+/** \brief  Callback for checkpoint_foreach()
+ *
+ * \param[in]   cp      checkpoint
+ * \param[in]   data    data passed to checkpoint_foreach()
+ */
+typedef void (*checkpoint_foreach_cb)(const checkpoint_t *cp, void *data);
+
+
+void checkpoint_init(void);
+void checkpoint_exit(void);
+
+checkpoint_ctx_t *checkpoint_ctx_new(void);
+void checkpoint_ctx_free(checkpoint_ctx_t *table);
+
+void checkpoint_sync(void);
+void checkpoint_clear(void);
+void checkpoint_restore(void);
+
+bool checkpoint_set(uint8_t memspace,
+                    uint16_t start,
+                    uint16_t end,
+                    uint8_t op,
+                    bool stop,
+                    bool enabled,
+                    bool temporary,
+                    const char *condition);
+bool checkpoint_delete(uint32_t number);
+bool checkpoint_toggle(uint32_t number, bool enabled);
+bool checkpoint_set_condition(uint32_t number, const char *condition);
+
+bool checkpoint_has_at(uint8_t memspace, uint16_t addr, uint8_t op);
+const checkpoint_t *checkpoint_find_at(uint8_t memspace,
+                                       uint16_t addr,
+                                       uint8_t op);
+const checkpoint_t *checkpoint_lookup(uint32_t number);
+size_t checkpoint_count(void);
+void checkpoint_foreach(checkpoint_foreach_cb callback, void *data);
+
+bool checkpoint_decode_info(const uint8_t *body, size_t len, checkpoint_t *cp);
+
+void checkpoint_add_listener(checkpoint_listener_cb callback, void *data);
+void checkpoint_remove_listener(checkpoint_listener_cb callback, void *data);
+
+#endif
@@ -38,20 +38,36 @@
 
 #include <glib.h>
 #include <gio/gio.h>
+#ifdef HAVE_GIO_UNIX
+# include <gio/gunixsocketaddress.h>
+#endif
 
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
 #include <netinet/ip.h>
+#ifdef HAVE_NETINET_TCP_H
+# include <netinet/tcp.h>
+#endif
+#ifdef HAVE_SYS_UN_H
+# include <sys/un.h>
+#endif
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include "settings.h"
 #include "monitor.h"
 
 #include "log.h"
+#include "trace.h"
 #include "../ui/logview.h"
+#include "../ui/frameprof.h"
 #include "vicemonapi.h"
-#include "hexdump.h"
+#include "kbdfeed.h"
+#include "resources.h"
+
+#include "session.h"
 
 #include "connection.h"
 
@@ -61,20 +77,44 @@
 static int connection_fd = 0;
 
 
+/** \brief  Get printable address of \a host and \a port
+ *
+ * \param[in]   host    host name, address or "unix:/path"
+ * \param[in]   port    port, ignored for unix domain sockets
+ *
+ * \return  "host:port" or "unix:/path", free with g_free()
+ */
+static char *format_address(const char *host, int port)
+{
+    if (g_str_has_prefix(host, CONNECTION_UNIX_PREFIX)) {
+        return g_strdup(host);
+    }
+    return g_strdup_printf("%s:%d", host, port);
+}
+
+
 
 
 /** \brief  Connection to the binary monitor interface
  *
- * Uses the settings 'VICE/host' (str) and 'VICE/port' (int).
+ * Uses the settings 'VICE/host' (str) and 'VICE/port' (int). A host of
+ * "unix:/path" connects to a unix domain socket.
  *
  * \return  TRUE on success
  */
 bool connection_open(void)
 {
     struct sockaddr_in sa;
+#ifdef HAVE_SYS_UN_H
+    struct sockaddr_un sun;
+#endif
+    struct sockaddr *addr = (struct sockaddr *)&sa;
+    socklen_t addr_len = sizeof(sa);
+    int family = AF_INET;
     int result;
     const char *host = NULL;
     int port = 6502;
+    char *name;
 
     /* get host and port from settings */
 
@@ -94,34 +134,61 @@ bool connection_open(void)
         port = 6502;
     }
 
-    logview_add(NULL, "Connecting to %s:%d: ", host, port);
-
-
-    sa.sin_family = AF_INET;
-    sa.sin_port = htons((uint16_t)port);
-    inet_pton(AF_INET, host, &sa.sin_addr);
+    name = format_address(host, port);
+    logview_add(NULL, "Connecting to %s: ", name);
+
+
+#ifdef HAVE_SYS_UN_H
+    if (g_str_has_prefix(host, CONNECTION_UNIX_PREFIX)) {
+        const char *path = host + strlen(CONNECTION_UNIX_PREFIX);
+
+        memset(&sun, 0, sizeof(sun));
+        sun.sun_family = AF_UNIX;
+        g_strlcpy(sun.sun_path, path, sizeof(sun.sun_path));
+        addr = (struct sockaddr *)&sun;
+        addr_len = sizeof(sun);
+        family = AF_UNIX;
+    } else
+#endif
+    {
+        memset(&sa, 0, sizeof(sa));
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons((uint16_t)port);
+        inet_pton(AF_INET, host, &sa.sin_addr);
+    }
     connection_fd = -1;
 
-    log_msg(LOG_INFO, "Connecting to %s:%d\n", host, port);
+    log_msg(LOG_INFO, "Connecting to %s\n", name);
 
-    debug_msg("Trying to connect to %s:%d.", host, port);
+    debug_msg("Trying to connect to %s.", name);
 
-    connection_fd = socket(AF_INET, SOCK_STREAM, 0);
+    connection_fd = socket(family, SOCK_STREAM, 0);
     if (connection_fd < 0) {
         debug_msg("Failed to open socket.");
         log_msg(LOG_ERR, "Failed open socket.\n");
         logview_add("err", "Failed to open socket.\n");
+        g_free(name);
         return false;
     }
 
-    result = connect(connection_fd, (struct sockaddr *)&sa, sizeof(sa));
+#ifdef TCP_NODELAY
+    if (family == AF_INET) {
+        int one = 1;
+
+        /* commands are small, don't let Nagle hold them back */
+        setsockopt(connection_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+#endif
+    result = connect(connection_fd, addr, addr_len);
     if (result < 0) {
         debug_msg("failed to connect.");
-        log_msg(LOG_ERR, "Failed to connect to %s:%d\n", host, port);
+        log_msg(LOG_ERR, "Failed to connect to %s\n", name);
         logview_add("err", "Failed to connect.\n");
         close(connection_fd);
+        g_free(name);
         return false;
     }
+    g_free(name);
     debug_msg("OK, connected.");
     log_msg(LOG_INFO, "OK\n");
     logview_add("ok", "OK.\n");
@@ -135,6 +202,7 @@ void connection_close(void)
         close(connection_fd);
         connection_fd = -1;
     }
+    connection_close_gio();
 }
 
 
@@ -172,29 +240,22 @@ void connection_send_reset(void)
     };
     uint32_t req_id;
 
+    resources_invalidate_all();
     connection_send_cmd(reset_command, sizeof(reset_command), &req_id);
 
 }
 
 
+/** \brief  Clear the screen of the emulated machine
+ *
+ * Types CLR/HOME followed by RETURN.
+ */
 void connection_send_clearscreen(void)
 {
-    const uint8_t clear_cmd[] = {
-        0x0f, 0x00, 0x00, 0x00,
-        0x00, 0x00, 0x00, 0x00,
-
-        0x72, 0x06,
-        '\\', 'x', '9' ,'3',
-        '\\', 'r'
-    };
-    uint32_t req_id;
-
-    connection_send_cmd(clear_cmd, sizeof(clear_cmd), &req_id);
+    kbdfeed_text("{clr}\n", false, NULL, NULL, NULL);
 }
 
 
-
-
 mon_cmd_t *create_command(uint8_t type, const uint8_t *data, size_t len)
 {
     mon_cmd_t *cmd = malloc(sizeof *cmd + len);
@@ -238,7 +299,7 @@ ssize_t connection_get_response(void)
         response.request_id[2] = buffer[10];
         response.request_id[3] = buffer[11];
 
-        debug_msg("response API: %02x", response.api_version);
+        trace(TRACE_LEVEL_DEBUG, "response API: %02x", response.api_version);
     }
 
     return result;
@@ -252,78 +313,385 @@ void free_command(mon_cmd_t *cmd)
 }
 
 
-static GSocketConnection *connection;
-static GSocketClient *client;
+/** \brief  Pending request object
+ */
+typedef struct pending_request_s {
+    uint8_t cmd_type;                   /**< command type */
+    connection_response_cb callback;    /**< response callback (optional) */
+    void *data;                         /**< data for \a callback */
+    gint64 sent;                        /**< monotonic time the command was
+                                             written, 0 while corked */
+} pending_request_t;
+
+
+/** \brief  Event handler object
+ */
+typedef struct event_handler_s {
+    uint8_t type;                       /**< response type */
+    connection_response_cb callback;    /**< event callback */
+    void *data;                         /**< data for \a callback */
+    bool removed;                       /**< removed while dispatching */
+} event_handler_t;
+
+
+/** \brief  Connection state listener object
+ */
+typedef struct state_listener_s {
+    connection_state_cb callback;       /**< state callback */
+    void *data;                         /**< data for \a callback */
+} state_listener_t;
 
 
-/** \brief  Connect to the VICE binary monitor socket
+/** \brief  Connection to the binary monitor of a VICE instance
  *
- * \return  bool
+ * \a vice_running is updated from the MON_RESPONSE_STOPPED, MON_RESPONSE_JAM
+ * and MON_RESPONSE_RESUMED events.
  */
-gboolean connect_gio(void)
+struct connection_s {
+    session_t *session;             /**< session owning the connection */
+    char *host;                     /**< host */
+    int port;                       /**< port */
+    GSocketClient *client;          /**< socket client */
+    GSocketConnection *socket;      /**< socket connection, NULL when lost */
+    GHashTable *pending_requests;   /**< pending requests by request ID */
+    uint32_t next_request_id;       /**< request ID for the next request */
+    GByteArray *recv_buffer;        /**< buffer for incoming data */
+    GByteArray *send_buffer;        /**< outgoing data while corked */
+    int cork_level;                 /**< cork nesting level */
+    GSource *recv_source;           /**< source dispatching incoming data */
+    bool vice_running;              /**< emulation is running */
+    bool is_tcp;                    /**< socket is a TCP socket */
+    connection_state_t state;       /**< connection state */
+    guint reconnect_source;         /**< reconnect timeout source ID */
+    guint lost_source;              /**< source ID for a write error */
+    int reconnect_delay;            /**< delay (ms) before next attempt */
+    GCancellable *reconnect_cancellable;    /**< reconnect in progress */
+    connstats_t stats;              /**< statistics */
+    viceinfo_t info;                /**< VICE version and capabilities */
+    unsigned int connects;          /**< number of successful connects */
+};
+
+
+/** \brief  List of event handlers, shared by all connections
+ */
+static GSList *event_handlers = NULL;
+
+/** \brief  Nesting level of event dispatching
+ *
+ * Handlers removed while events are dispatched are only marked as removed,
+ * they're freed by sweep_event_handlers() when dispatching is done.
+ */
+static int event_dispatch_depth = 0;
+
+/** \brief  Event handlers have been marked as removed
+ */
+static bool event_handlers_removed = false;
+
+/** \brief  List of state listeners, shared by all connections
+ */
+static GSList *state_listeners = NULL;
+
+
+/** \brief  Get connection of the current session
+ *
+ * \return  connection
+ */
+static connection_t *current(void)
+{
+    return session_current()->connection;
+}
+
+
+/** \brief  Create connection object for \a session
+ *
+ * Called by session_new(), the connection isn't opened yet.
+ *
+ * \param[in]   session session, its host and port are used to connect
+ *
+ * \return  connection
+ */
+connection_t *connection_new(session_t *session)
+{
+    connection_t *conn = g_malloc0(sizeof *conn);
+
+    conn->session = session;
+    conn->host = g_strdup(session->host);
+    conn->port = session->port;
+    conn->next_request_id = 1;
+    conn->vice_running = true;
+    conn->state = CONNECTION_DISCONNECTED;
+    viceinfo_reset(&conn->info);
+    conn->pending_requests = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+    conn->recv_buffer = g_byte_array_new();
+    conn->send_buffer = g_byte_array_new();
+    connstats_reset(&conn->stats);
+    return conn;
+}
+
+
+static void set_state(connection_t *conn, connection_state_t new_state);
+
+
+/** \brief  Update the statistics with the number of pending requests
+ *
+ * \param[in,out]   conn    connection
+ */
+static void update_in_flight(connection_t *conn)
+{
+    g_atomic_int_set(&conn->stats.in_flight,
+                     (gint)g_hash_table_size(conn->pending_requests));
+}
+
+
+/** \brief  Ask the kernel to ACK incoming TCP data immediately
+ *
+ * Linux leaves quick-ACK mode after a while, so this is repeated after each
+ * read. Delayed ACKs of responses otherwise stall the next command when it
+ * doesn't fit in the first segment.
+ *
+ * \param[in]   conn    connection
+ */
+static void quickack(connection_t *conn)
+{
+#ifdef TCP_QUICKACK
+    if (conn->is_tcp && conn->socket != NULL) {
+        GSocket *socket = g_socket_connection_get_socket(conn->socket);
+
+        g_socket_set_option(socket, IPPROTO_TCP, TCP_QUICKACK, 1, NULL);
+    }
+#endif
+}
+
+
+/** \brief  Get address to connect \a conn to
+ *
+ * \param[in]   conn    connection
+ *
+ * \return  unix socket address for "unix:/path" hosts, network address
+ *          otherwise (free with g_object_unref())
+ */
+static GSocketConnectable *get_connectable(const connection_t *conn)
+{
+#ifdef HAVE_GIO_UNIX
+    if (g_str_has_prefix(conn->host, CONNECTION_UNIX_PREFIX)) {
+        return G_SOCKET_CONNECTABLE(g_unix_socket_address_new(
+                    conn->host + strlen(CONNECTION_UNIX_PREFIX)));
+    }
+#endif
+    return G_SOCKET_CONNECTABLE(g_network_address_new(conn->host,
+                                                      (guint16)conn->port));
+}
+
+
+/** \brief  Set socket option, logging failures
+ *
+ * \param[in]   socket  socket
+ * \param[in]   level   option level
+ * \param[in]   option  option
+ * \param[in]   value   value
+ * \param[in]   name    option name for the log
+ */
+static void set_option(GSocket *socket,
+                       int level,
+                       int option,
+                       int value,
+                       const char *name)
 {
-    const char *host = NULL;
-    int port = 6502;
     GError *error = NULL;
 
-    /* get host and port from settings */
-    debug_msg("Getting host from settings ('VICE/host'):");
-    if (settings_get_str("VICE", "host", &host)) {
-        debug_msg("OK, got '%s'.", host);
-    } else {
-        debug_msg("Couldn't find key, defaulting to '127.0.0.1'.");
-        host = "127.0.0.1";
+    if (!g_socket_set_option(socket, level, option, value, &error)) {
+        log_msg(LOG_WARN, "Failed to set %s: %s\n", name, error->message);
+        g_error_free(error);
     }
-    debug_msg("Getting port from settings ('VICE/port):");
-    if (settings_get_int("VICE", "port", &port)) {
-        debug_msg("OK, got %d.", port);
-    } else {
-        debug_msg("Couldn't find key, defaulting to 6502.");
-        port = 6502;
+}
+
+
+/** \brief  Tune the socket of \a conn for small, latency-bound commands
+ *
+ * Disables Nagle's algorithm for TCP, so small commands like MON_CMD_PING
+ * and MON_CMD_ADVANCE_INSTRUCTIONS aren't held back waiting for the ACK of
+ * the previous segment, and enlarges the socket buffers so memory dumps and
+ * display frames need fewer round trips through the main loop. The buffer
+ * size is taken from 'Connection/socket_buffer' (bytes).
+ *
+ * \param[in,out]   conn    connection
+ */
+static void tune_socket(connection_t *conn)
+{
+    GSocket *socket = g_socket_connection_get_socket(conn->socket);
+    int size;
+
+    if (!settings_get_int("Connection", "socket_buffer", &size)) {
+        size = CONNECTION_SOCKET_BUFFER_SIZE;
     }
+    if (size > 0) {
+        set_option(socket, SOL_SOCKET, SO_SNDBUF, size, "SO_SNDBUF");
+        set_option(socket, SOL_SOCKET, SO_RCVBUF, size, "SO_RCVBUF");
+    }
+    conn->is_tcp = g_socket_get_family(socket) != G_SOCKET_FAMILY_UNIX;
+#ifdef TCP_NODELAY
+    if (conn->is_tcp) {
+        set_option(socket, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY");
+    }
+#endif
+    quickack(conn);
+}
 
-    logview_add(NULL, "Connecting to %s:%d: ", host, port);
 
+/** \brief  Get printable address of \a conn
+ *
+ * \param[in]   conn    connection
+ *
+ * \return  "host:port" or "unix:/path", free with g_free()
+ */
+static char *get_address_name(const connection_t *conn)
+{
+    return format_address(conn->host, conn->port);
+}
 
-    client = g_socket_client_new();
-    connection = g_socket_client_connect_to_host(
-            client,
-            host,
-            (guint16)port,
-            NULL,
-            &error);
+
+/** \brief  Connect the current session to its VICE binary monitor socket
+ *
+ * \return  bool
+ */
+gboolean connect_gio(void)
+{
+    connection_t *conn = current();
+    GSocketConnectable *address;
+    GError *error = NULL;
+    char *name;
+
+    name = get_address_name(conn);
+    logview_add(NULL, "Connecting to %s: ", name);
+    g_free(name);
+
+    if (conn->client == NULL) {
+        conn->client = g_socket_client_new();
+    }
+    address = get_connectable(conn);
+    conn->socket = g_socket_client_connect(conn->client, address, NULL, &error);
+    g_object_unref(address);
     if (error != NULL) {
         debug_msg("Error: %s\n", error->message);
         logview_add("err", "failed: %s\n", error->message);
+        g_error_free(error);
         return FALSE;
     }
     logview_add("ok", "OK");
+    tune_socket(conn);
+    set_state(conn, CONNECTION_CONNECTED);
     return TRUE;
 }
 
 
-void connection_send_gio_reset(void)
+/** \brief  Asynchronous connect request
+ */
+typedef struct connect_job_s {
+    connection_t *conn;             /**< connection */
+    connection_connect_cb callback; /**< function to call when done */
+    void *data;                     /**< data for \a callback */
+} connect_job_t;
+
+
+/** \brief  Handle completion of connection_connect_async()
+ *
+ * \param[in]   source  socket client
+ * \param[in]   result  result
+ * \param[in]   data    connect job
+ */
+static void on_connected(GObject *source, GAsyncResult *result, gpointer data)
 {
-    GOutputStream *ostream;
+    connect_job_t *job = data;
+    connection_t *conn = job->conn;
+    GSocketConnection *socket;
     GError *error = NULL;
-    const uint8_t msg[] = {
-        MON_STX, MON_API,
-        1, 0, 0, 0, /* length = 1*/
-        0, 1, 2, 3, /* req-id */
-        0xcc,
-        0x00
-    };
+    char *name;
+
+    socket = g_socket_client_connect_finish(G_SOCKET_CLIENT(source),
+                                            result,
+                                            &error);
+    if (socket == NULL
+            && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        /* connection closed, possibly freed */
+        g_error_free(error);
+        g_free(job);
+        return;
+    }
+    g_clear_object(&conn->reconnect_cancellable);
+
+    name = get_address_name(conn);
+    session_push(conn->session);
+    if (socket == NULL) {
+        log_msg(LOG_ERR, "Failed to connect to %s: %s\n", name, error->message);
+        logview_add("err", "Connecting to %s failed: %s\n",
+                    name, error->message);
+        g_error_free(error);
+        set_state(conn, CONNECTION_DISCONNECTED);
+        job->callback(false, job->data);
+    } else {
+        conn->socket = socket;
+        conn->connects++;
+        tune_socket(conn);
+        logview_add("ok", "Connected to %s.\n", name);
+        connection_start_dispatch();
+        set_state(conn, CONNECTION_CONNECTED);
+        job->callback(true, job->data);
+    }
+    session_pop();
+    g_free(name);
+    g_free(job);
+}
 
 
-    ostream = g_io_stream_get_output_stream(G_IO_STREAM(connection));
-    g_output_stream_write(
-            ostream,
-            msg,
-            sizeof(msg),
-            NULL,
-            &error);
-    if (error != NULL) {
-        debug_msg("error: %s\n", error->message);
+/** \brief  Connect the current session without blocking
+ *
+ * The connection is in the CONNECTION_CONNECTING state until \a callback is
+ * called, with the session as the current session. Closing the connection
+ * cancels the attempt, \a callback isn't called then.
+ *
+ * \param[in]   callback    function to call when done
+ * \param[in]   data        data for \a callback
+ */
+void connection_connect_async(connection_connect_cb callback, void *data)
+{
+    connection_t *conn = current();
+    connect_job_t *job;
+    GSocketConnectable *address;
+
+    if (conn->client == NULL) {
+        conn->client = g_socket_client_new();
+    }
+    job = g_malloc(sizeof *job);
+    job->conn = conn;
+    job->callback = callback;
+    job->data = data;
+
+    g_clear_object(&conn->reconnect_cancellable);
+    conn->reconnect_cancellable = g_cancellable_new();
+    set_state(conn, CONNECTION_CONNECTING);
+    address = get_connectable(conn);
+    g_socket_client_connect_async(conn->client,
+                                  address,
+                                  conn->reconnect_cancellable,
+                                  on_connected,
+                                  job);
+    g_object_unref(address);
+}
+
+
+/** \brief  Soft reset the machine of the current session
+ *
+ * Sent as a normal request, so it goes through the dispatcher like all other
+ * commands instead of being written behind its back.
+ */
+void connection_send_gio_reset(void)
+{
+    const uint8_t body[] = { 0x00 };    /* soft reset */
+
+    resources_invalidate_all();
+    if (connection_send_request(MON_CMD_RESET, body, sizeof body,
+                                NULL, NULL) == 0) {
+        debug_msg("error: failed to send reset\n");
     }
 }
 
@@ -335,73 +703,1020 @@ int connection_wait_for_response_type(int type, uint8_t *buffer, size_t *len)
 
 
 
-uint32_t connection_get_vice_version(void)
+static void connection_lost(connection_t *conn);
+static void fail_pending_requests(connection_t *conn);
+static void sweep_event_handlers(void);
+static void schedule_lost(connection_t *conn);
+static void schedule_reconnect(connection_t *conn);
+
+
+/** \brief  Get body length of \a response
+ *
+ * \param[in]   response    response
+ *
+ * \return  body length in bytes
+ */
+uint32_t response_get_body_len(const mon_response_t *response)
 {
-    GOutputStream *ostream;
-    GInputStream *istream;
-    GError *error = NULL;
-    const uint8_t msg[] = {
-        MON_STX, MON_API,
-        0, 0, 0, 0, /* length = 00 */
-        0, 1, 2, 3, /* req-id */
-        0x85,
+    return MON_GET_U32(response->body_len);
+}
 
-    };
-    uint8_t response[256] = { 0 };
 
+/** \brief  Get request ID of \a response
+ *
+ * \param[in]   response    response
+ *
+ * \return  request ID
+ */
+uint32_t response_get_request_id(const mon_response_t *response)
+{
+    return MON_GET_U32(response->request_id);
+}
 
-    ostream = g_io_stream_get_output_stream(G_IO_STREAM(connection));
 
-    g_output_stream_write(
-            ostream,
-            msg,
-            sizeof(msg),
-            NULL,
-            &error);
-    if (error != NULL) {
-        debug_msg("error: %s\n", error->message);
+/** \brief  Get the response type that terminates a command of \a cmd_type
+ *
+ * Most commands are answered with a response of the same type, the
+ * exceptions are mapped here.
+ *
+ * \param[in]   cmd_type    command type
+ *
+ * \return  response type
+ */
+static uint8_t final_response_type(uint8_t cmd_type)
+{
+    switch (cmd_type) {
+        case MON_CMD_CHECKPOINT_GET:    /* fall through */
+        case MON_CMD_CHECKPOINT_SET:
+            return MON_RESPONSE_CHECKPOINT_INFO;
+        case MON_CMD_REGISTERS_GET:     /* fall through */
+        case MON_CMD_REGISTERS_SET:
+            return MON_RESPONSE_REGISTER_INFO;
+        default:
+            return cmd_type;
     }
+}
 
-    if (error != NULL) {
+
+/** \brief  Write \a len bytes of \a data to the monitor socket
+ *
+ * \param[in,out]   conn    connection
+ * \param[in]       data    data to write
+ * \param[in]       len     length of \a data
+ *
+ * \return  TRUE on success
+ */
+static gboolean write_data(connection_t *conn, const uint8_t *data, size_t len)
+{
+    GOutputStream *ostream;
+    GError *error = NULL;
+
+    if (conn->socket == NULL) {
+        return FALSE;
+    }
+    ostream = g_io_stream_get_output_stream(G_IO_STREAM(conn->socket));
+    if (!g_output_stream_write_all(ostream, data, len, NULL, NULL, &error)) {
+        log_msg(LOG_ERR, "Failed to send data: %s\n", error->message);
+        logview_add("err", "Connection lost: %s\n", error->message);
         g_error_free(error);
-        error = NULL;
+        /* the reader notices too, but only after the next poll */
+        schedule_lost(conn);
+        return FALSE;
     }
+    trace(TRACE_LEVEL_VERBOSE, "wrote %u bytes", len);
+    connstats_add_out(&conn->stats, len);
+    return TRUE;
+}
 
 
-    istream = g_io_stream_get_input_stream(G_IO_STREAM(connection));
-    g_input_stream_read(
-            istream,
-            response,
-            sizeof(response),
+/** \brief  Dispatch a single response
+ *
+ * Events are passed to the registered event handlers, responses to requests
+ * are passed to the callback registered with the request. The request is
+ * removed once its final response (or an error) has been received, this
+ * allows commands like MON_CMD_CHECKPOINT_LIST to report multiple responses.
+ *
+ * \param[in,out]   conn        connection
+ * \param[in]       response    response
+ */
+static void dispatch_response(connection_t *conn, const mon_response_t *response)
+{
+    uint32_t req_id = response_get_request_id(response);
+    pending_request_t *pending;
+    GSList *node;
+
+    trace(TRACE_LEVEL_DEBUG, "response $%02x, request ID %08x, error $%02x",
+          response->type, req_id, response->error_code);
+    if (req_id == MON_EVENT_REQUEST_ID) {
+        switch (response->type) {
+            case MON_RESPONSE_STOPPED:  /* fall through */
+            case MON_RESPONSE_JAM:
+                conn->vice_running = false;
+                break;
+            case MON_RESPONSE_RESUMED:
+                conn->vice_running = true;
+                break;
+            default:
+                break;
+        }
+
+        /* handlers removed meanwhile are swept when done */
+        event_dispatch_depth++;
+        for (node = event_handlers; node != NULL; node = node->next) {
+            event_handler_t *handler = node->data;
+
+            if (!handler->removed && handler->type == response->type) {
+                handler->callback(response, handler->data);
+            }
+        }
+        if (--event_dispatch_depth == 0 && event_handlers_removed) {
+            sweep_event_handlers();
+        }
+        return;
+    }
+
+    pending = g_hash_table_lookup(conn->pending_requests,
+                                  GUINT_TO_POINTER(req_id));
+    if (pending == NULL) {
+        trace(TRACE_LEVEL_DEBUG,
+              "response $%02x for unknown request ID %08x",
+              response->type, req_id);
+        return;
+    }
+    if (response->error_code != MON_ERR_OK
+            || response->type == final_response_type(pending->cmd_type)) {
+        /* record the round trip before the callback adds its own time */
+        connstats_add_rtt(&conn->stats,
+                          pending->cmd_type,
+                          g_get_monotonic_time() - pending->sent);
+        g_hash_table_steal(conn->pending_requests, GUINT_TO_POINTER(req_id));
+        update_in_flight(conn);
+        if (pending->callback != NULL) {
+            pending->callback(response, pending->data);
+        }
+        g_free(pending);
+    } else if (pending->callback != NULL) {
+        pending->callback(response, pending->data);
+    }
+}
+
+
+/** \brief  Handle data becoming available on the monitor socket
+ *
+ * Appends the data to the receive buffer and dispatches any complete
+ * responses in it, with the session owning the connection as the current
+ * session.
+ *
+ * \param[in]   stream  input stream
+ * \param[in]   data    session
+ *
+ * \return  G_SOURCE_REMOVE when the connection was lost
+ */
+static gboolean on_input_ready(GObject *stream, gpointer data)
+{
+    session_t *session = data;
+    connection_t *conn = session->connection;
+    uint8_t chunk[4096];
+    gssize result;
+    guint offset = 0;
+    GError *error = NULL;
+    gint64 prof;
+
+    result = g_pollable_input_stream_read_nonblocking(
+            G_POLLABLE_INPUT_STREAM(stream),
+            chunk,
+            sizeof(chunk),
             NULL,
             &error);
-    if (error != NULL) {
-        debug_msg("Error: %s\n", error->message);
+    if (result < 0) {
+        if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+            g_error_free(error);
+            return G_SOURCE_CONTINUE;
+        }
+        log_msg(LOG_ERR, "Failed to read from monitor: %s\n", error->message);
+        logview_add("err", "Connection lost: %s\n", error->message);
         g_error_free(error);
+        conn->recv_source = NULL;
+        connection_lost(conn);
+        return G_SOURCE_REMOVE;
+    }
+    if (result == 0) {
+        log_msg(LOG_INFO, "Connection closed by VICE.\n");
+        logview_add("err", "Connection closed by VICE.\n");
+        conn->recv_source = NULL;
+        connection_lost(conn);
+        return G_SOURCE_REMOVE;
     }
 
-    hexdump(response, sizeof(response));
+    g_byte_array_append(conn->recv_buffer, chunk, (guint)result);
+    trace(TRACE_LEVEL_VERBOSE, "read %d bytes", result);
+    connstats_add_in(&conn->stats, (gsize)result);
+    quickack(conn);
+
+    /* batch commands sent by the response handlers */
+    prof = frameprof_begin();
+    session_push(session);
+    connection_cork();
+    while (conn->recv_buffer->len - offset >= MON_RESPONSE_HEADER_SIZE) {
+        const uint8_t *frame = conn->recv_buffer->data + offset;
+        uint32_t body_len;
+
+        if (frame[0] != MON_STX) {
+            /* out of sync, skip byte */
+            offset++;
+            continue;
+        }
+        body_len = MON_GET_U32(frame + 2);
+        if (conn->recv_buffer->len - offset < MON_RESPONSE_HEADER_SIZE + body_len) {
+            break;  /* incomplete */
+        }
+        dispatch_response(conn, (const mon_response_t *)(frame + 1));
+        offset += MON_RESPONSE_HEADER_SIZE + body_len;
+    }
+    g_byte_array_remove_range(conn->recv_buffer, 0, offset);
+    connection_uncork();
+    session_pop();
+    frameprof_end(FRAMEPROF_DISPATCH, prof);
 
-    uint8_t main_ver_len = response[12];
-    debug_msg("main version len = %d\n", main_ver_len);
+    return G_SOURCE_CONTINUE;
+}
 
-    debug_msg("version = %d.%d.%d.%d\n",
-            response[12] + '0',
-            response[13] + '0',
-            response[14] + '0',
-            response[15] + '0');
 
-    return 0;
+/** \brief  Start dispatching responses from the binary monitor
+ *
+ * Attaches a source to the main loop that reads responses and passes them
+ * to the callbacks registered with connection_send_request() and
+ * connection_add_event_handler().
+ */
+void connection_start_dispatch(void)
+{
+    connection_t *conn = current();
+    GInputStream *istream;
 
+    if (conn->socket == NULL || conn->recv_source != NULL) {
+        return;
+    }
 
+    istream = g_io_stream_get_input_stream(G_IO_STREAM(conn->socket));
+    conn->recv_source = g_pollable_input_stream_create_source(
+            G_POLLABLE_INPUT_STREAM(istream), NULL);
+    g_source_set_callback(conn->recv_source,
+                          G_SOURCE_FUNC(on_input_ready),
+                          conn->session,
+                          NULL);
+    g_source_attach(conn->recv_source, NULL);
+    g_source_unref(conn->recv_source);
+}
 
 
+/** \brief  Send command to the binary monitor
+ *
+ * Sends a command of \a type with \a body and registers \a callback to be
+ * called for each response to the command. Commands are not waited on, so
+ * multiple commands can be in flight at the same time.
+ *
+ * \param[in]   type        command type
+ * \param[in]   body        command body (can be `NULL` when \a len is 0)
+ * \param[in]   len         length of \a body
+ * \param[in]   callback    function to call for responses (optional)
+ * \param[in]   data        data for \a callback
+ *
+ * \return  request ID, or 0 on failure
+ */
+uint32_t connection_send_request(uint8_t type,
+                                 const uint8_t *body,
+                                 size_t len,
+                                 connection_response_cb callback,
+                                 void *data)
+{
+    uint8_t header[11];
+    pending_request_t *pending;
+    uint32_t req_id;
+    connection_t *conn = current();
+
+    if (conn->socket == NULL) {
+        return 0;
+    }
+
+    req_id = conn->next_request_id++;
+    if (conn->next_request_id == MON_EVENT_REQUEST_ID) {
+        conn->next_request_id = 1;
+    }
+
+    header[0] = MON_STX;
+    header[1] = MON_API;
+    MON_SET_U32(header + 2, (uint32_t)len);
+    MON_SET_U32(header + 6, req_id);
+    header[10] = type;
+    trace(TRACE_LEVEL_DEBUG, "command $%02x, request ID %08x, %u bytes, cork %d",
+          type, req_id, len, conn->cork_level);
+
+    /* always build the complete command before writing, so a command never
+     * ends up in more than one segment */
+    g_byte_array_append(conn->send_buffer, header, sizeof(header));
+    if (len > 0) {
+        g_byte_array_append(conn->send_buffer, body, (guint)len);
+    }
+
+    pending = g_malloc(sizeof *pending);
+    pending->cmd_type = type;
+    pending->callback = callback;
+    pending->data = data;
+    pending->sent = conn->cork_level == 0 ? g_get_monotonic_time() : 0;
+    g_hash_table_insert(conn->pending_requests, GUINT_TO_POINTER(req_id), pending);
+    update_in_flight(conn);
+
+    if (conn->cork_level == 0) {
+        gboolean ok = write_data(conn, conn->send_buffer->data, conn->send_buffer->len);
+
+        g_byte_array_set_size(conn->send_buffer, 0);
+        if (!ok) {
+            g_hash_table_remove(conn->pending_requests, GUINT_TO_POINTER(req_id));
+            update_in_flight(conn);
+            return 0;
+        }
+    } else {
+        g_atomic_int_inc(&conn->stats.queued);
+    }
+    return req_id;
 }
 
 
+/** \brief  Send command to the binary monitor, keeping the emulation running
+ *
+ * Like connection_send_request(), but if the emulation is running the
+ * command is followed by MON_CMD_EXIT, so the emulation is only stopped for
+ * the duration of the command.
+ *
+ * \param[in]   type        command type
+ * \param[in]   body        command body (can be `NULL` when \a len is 0)
+ * \param[in]   len         length of \a body
+ * \param[in]   callback    function to call for responses (optional)
+ * \param[in]   data        data for \a callback
+ *
+ * \return  request ID, or 0 on failure
+ */
+uint32_t connection_send_request_resume(uint8_t type,
+                                        const uint8_t *body,
+                                        size_t len,
+                                        connection_response_cb callback,
+                                        void *data)
+{
+    bool running = current()->vice_running;
+    uint32_t req_id;
+
+    connection_cork();
+    req_id = connection_send_request(type, body, len, callback, data);
+    if (req_id != 0 && running) {
+        connection_send_request(MON_CMD_EXIT, NULL, 0, NULL, NULL);
+    }
+    connection_uncork();
+    return req_id;
+}
+
+
+/** \brief  Set the send time of requests buffered while corked
+ *
+ * Called right before the buffer is written, so the round trip times don't
+ * include the time spent corked.
+ *
+ * \param[in,out]   conn    connection
+ */
+static void stamp_pending_requests(connection_t *conn)
+{
+    GHashTableIter iter;
+    gpointer value;
+    gint64 now = g_get_monotonic_time();
+
+    g_hash_table_iter_init(&iter, conn->pending_requests);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        pending_request_t *pending = value;
+
+        if (pending->sent == 0) {
+            pending->sent = now;
+        }
+    }
+}
+
+
+/** \brief  Cork the connection
+ *
+ * Commands sent while the connection is corked are buffered and written in
+ * one go by the matching connection_uncork() call. Calls can be nested.
+ */
+void connection_cork(void)
+{
+    current()->cork_level++;
+}
+
+
+/** \brief  Uncork the connection
+ *
+ * Writes all buffered commands when the outermost cork is removed.
+ */
+void connection_uncork(void)
+{
+    connection_t *conn = current();
+
+    if (conn->cork_level == 0) {
+        return;
+    }
+    conn->cork_level--;
+    if (conn->cork_level == 0 && conn->send_buffer->len > 0) {
+        stamp_pending_requests(conn);
+        write_data(conn, conn->send_buffer->data, conn->send_buffer->len);
+        g_byte_array_set_size(conn->send_buffer, 0);
+        g_atomic_int_set(&conn->stats.queued, 0);
+    }
+}
+
+
+/** \brief  Get a sample of the statistics of the current session's connection
+ *
+ * \param[out]  sample  sample
+ */
+void connection_get_stats(connstats_sample_t *sample)
+{
+    connstats_sample(&current()->stats, sample);
+}
+
+
+/** \brief  Get round trip time histogram of command \a type
+ *
+ * For the connection of the current session.
+ *
+ * \param[in]   type    command type
+ *
+ * \return  histogram or `NULL` when no command of \a type completed yet
+ */
+const histogram_t *connection_get_histogram(uint8_t type)
+{
+    return connstats_get_histogram(&current()->stats, type);
+}
+
+
+/** \brief  Handler for the MON_CMD_VICE_INFO response of the probe
+ *
+ * \param[in]   response    response
+ * \param[in]   data        extra data (unused)
+ */
+static void on_vice_info_response(const mon_response_t *response, void *data)
+{
+    connection_t *conn = current();
+    char *text;
+
+    if (response->error_code == MON_ERR_OK) {
+        if (!viceinfo_decode(&conn->info,
+                             response->api_version,
+                             response->body,
+                             response_get_body_len(response))) {
+            log_msg(LOG_WARN, "Invalid VICE info.\n");
+            return;
+        }
+    } else if (response->error_code == MON_ERR_CMD_INVALID_TYPE) {
+        viceinfo_set_legacy(&conn->info, response->api_version);
+    } else {
+        /* connection lost or other error, keep assuming everything works */
+        return;
+    }
+    text = viceinfo_to_string(&conn->info);
+    log_msg(LOG_INFO, "%s: %s.\n", conn->session->name, text);
+    logview_add("ok", "Detected %s.\n", text);
+    g_free(text);
+}
+
+
+/** \brief  Probe version and capabilities of VICE
+ *
+ * Sends MON_CMD_VICE_INFO, until the response arrives all commands are
+ * assumed to be supported and memory is fetched in small chunks. To be
+ * called on each (re)connect, VICE might have been replaced.
+ */
+void connection_probe_vice(void)
+{
+    viceinfo_reset(&current()->info);
+    connection_send_request_resume(MON_CMD_VICE_INFO, NULL, 0,
+                                   on_vice_info_response, NULL);
+}
+
+
+/** \brief  Get VICE version and capabilities
+ *
+ * For the connection of the current session.
+ *
+ * \return  VICE info
+ */
+const viceinfo_t *connection_get_vice_info(void)
+{
+    return &current()->info;
+}
+
+
+/** \brief  Check if VICE supports \a command
+ *
+ * For the connection of the current session.
+ *
+ * \param[in]   command command type
+ *
+ * \return  true if supported, or when VICE hasn't been probed yet
+ */
+bool connection_supports(uint8_t command)
+{
+    return viceinfo_supports(&current()->info, command);
+}
+
+
+/** \brief  Check if the emulation is running
+ *
+ * Any command sent to the binary monitor stops the emulation, so commands
+ * sent while the emulation is running should be followed by MON_CMD_EXIT to
+ * keep it running.
+ *
+ * \return  true if running
+ */
+bool connection_vice_running(void)
+{
+    return current()->vice_running;
+}
+
+
+/** \brief  Free the event handlers marked as removed during dispatching
+ */
+static void sweep_event_handlers(void)
+{
+    GSList *node = event_handlers;
+
+    while (node != NULL) {
+        GSList *next = node->next;
+        event_handler_t *handler = node->data;
+
+        if (handler->removed) {
+            event_handlers = g_slist_delete_link(event_handlers, node);
+            g_free(handler);
+        }
+        node = next;
+    }
+    event_handlers_removed = false;
+}
+
+
+/** \brief  Register \a callback for events of \a type
+ *
+ * Events are responses with request ID MON_EVENT_REQUEST_ID, such as
+ * MON_RESPONSE_STOPPED or MON_RESPONSE_CHECKPOINT_INFO on a checkpoint hit.
+ *
+ * \param[in]   type        response type
+ * \param[in]   callback    function to call
+ * \param[in]   data        data for \a callback
+ */
+void connection_add_event_handler(uint8_t type,
+                                  connection_response_cb callback,
+                                  void *data)
+{
+    event_handler_t *handler = g_malloc(sizeof *handler);
 
+    handler->type = type;
+    handler->callback = callback;
+    handler->data = data;
+    handler->removed = false;
+    event_handlers = g_slist_append(event_handlers, handler);
+}
+
+
+/** \brief  Unregister event handler
+ *
+ * Safe to call from an event handler, for any handler.
+ *
+ * \param[in]   type        response type
+ * \param[in]   callback    function registered
+ * \param[in]   data        data registered
+ */
+void connection_remove_event_handler(uint8_t type,
+                                     connection_response_cb callback,
+                                     void *data)
+{
+    GSList *node;
+
+    for (node = event_handlers; node != NULL; node = node->next) {
+        event_handler_t *handler = node->data;
+
+        if (!handler->removed
+                && handler->type == type
+                && handler->callback == callback
+                && handler->data == data) {
+            if (event_dispatch_depth > 0) {
+                handler->removed = true;
+                event_handlers_removed = true;
+            } else {
+                event_handlers = g_slist_delete_link(event_handlers, node);
+                g_free(handler);
+            }
+            return;
+        }
+    }
+}
 
 
+/** \brief  Tear down the GIO connection
+ *
+ * Pending requests are dropped without calling their callbacks.
+ *
+ * \param[in,out]   conn    connection
+ */
+static void teardown(connection_t *conn)
+{
+    if (conn->recv_source != NULL) {
+        g_source_destroy(conn->recv_source);
+        conn->recv_source = NULL;
+    }
+    if (conn->socket != NULL) {
+        g_io_stream_close(G_IO_STREAM(conn->socket), NULL, NULL);
+        g_object_unref(conn->socket);
+        conn->socket = NULL;
+    }
+    g_byte_array_set_size(conn->recv_buffer, 0);
+    g_byte_array_set_size(conn->send_buffer, 0);
+    g_atomic_int_set(&conn->stats.queued, 0);
+    conn->vice_running = true;
+}
+
+
+/** \brief  Close \a conn and stop reconnecting
+ *
+ * Pending requests are failed with CONNECTION_ERR_LOST, so their callbacks
+ * get a chance to free their data.
+ *
+ * \param[in,out]   conn    connection
+ */
+static void close_connection(connection_t *conn)
+{
+    if (conn->reconnect_source != 0) {
+        g_source_remove(conn->reconnect_source);
+        conn->reconnect_source = 0;
+    }
+    if (conn->lost_source != 0) {
+        g_source_remove(conn->lost_source);
+        conn->lost_source = 0;
+    }
+    if (conn->reconnect_cancellable != NULL) {
+        g_cancellable_cancel(conn->reconnect_cancellable);
+        g_object_unref(conn->reconnect_cancellable);
+        conn->reconnect_cancellable = NULL;
+    }
+    teardown(conn);
+    fail_pending_requests(conn);
+    if (conn->client != NULL) {
+        g_object_unref(conn->client);
+        conn->client = NULL;
+    }
+    conn->state = CONNECTION_DISCONNECTED;
+}
+
+
+/** \brief  Close the GIO connection of the current session
+ *
+ * Also stops reconnecting. Callbacks of pending requests are called with
+ * CONNECTION_ERR_LOST, so this should be called before the modules using the
+ * connection are shut down.
+ */
 void connection_close_gio(void)
 {
+    close_connection(current());
+}
+
+
+/** \brief  Close and free connection
+ *
+ * Called by session_free().
+ *
+ * \param[in]   conn    connection
+ */
+void connection_free(connection_t *conn)
+{
+    close_connection(conn);
+    g_hash_table_destroy(conn->pending_requests);
+    g_byte_array_unref(conn->recv_buffer);
+    g_byte_array_unref(conn->send_buffer);
+    connstats_free(&conn->stats);
+    g_free(conn->host);
+    g_free(conn);
+}
+
+
+/** \brief  Free the event handlers and state listeners
+ *
+ * Call after all sessions have been freed.
+ */
+void connection_exit(void)
+{
+    g_slist_free_full(event_handlers, g_free);
+    event_handlers = NULL;
+    g_slist_free_full(state_listeners, g_free);
+    state_listeners = NULL;
+}
+
+
+/** \brief  Set state of \a conn and notify state listeners
+ *
+ * The session of \a conn is the current session during the notification.
+ *
+ * \param[in,out]   conn        connection
+ * \param[in]       new_state   new state
+ */
+static void set_state(connection_t *conn, connection_state_t new_state)
+{
+    GSList *node;
+
+    conn->state = new_state;
+    session_push(conn->session);
+    node = state_listeners;
+    while (node != NULL) {
+        state_listener_t *listener = node->data;
+
+        node = node->next;
+        listener->callback(new_state, listener->data);
+    }
+    session_pop();
+}
+
+
+/** \brief  Fail all pending requests
+ *
+ * Each callback gets a response with error code CONNECTION_ERR_LOST, so
+ * modules waiting for responses don't wait forever.
+ *
+ * \param[in,out]   conn    connection
+ */
+static void fail_pending_requests(connection_t *conn)
+{
+    GList *keys;
+    GList *node;
+
+    keys = g_hash_table_get_keys(conn->pending_requests);
+    session_push(conn->session);
+    for (node = keys; node != NULL; node = node->next) {
+        pending_request_t *pending;
+        mon_response_t response;
+
+        pending = g_hash_table_lookup(conn->pending_requests, node->data);
+        if (pending == NULL) {
+            continue;
+        }
+        g_hash_table_steal(conn->pending_requests, node->data);
+        if (pending->callback != NULL) {
+            memset(&response, 0, sizeof response);
+            response.api_version = MON_API;
+            response.type = final_response_type(pending->cmd_type);
+            response.error_code = CONNECTION_ERR_LOST;
+            MON_SET_U32(response.request_id, GPOINTER_TO_UINT(node->data));
+            pending->callback(&response, pending->data);
+        }
+        g_free(pending);
+    }
+    session_pop();
+    g_list_free(keys);
+    update_in_flight(conn);
+}
+
+
+/** \brief  Handle a lost connection
+ *
+ * Fails pending requests and starts reconnecting.
+ *
+ * \param[in,out]   conn    connection
+ */
+static void connection_lost(connection_t *conn)
+{
+    if (conn->socket == NULL) {
+        return;
+    }
+    teardown(conn);
+    fail_pending_requests(conn);
+    set_state(conn, CONNECTION_DISCONNECTED);
+    schedule_reconnect(conn);
+}
+
+
+/** \brief  Handler for a write error, run from the main loop
+ *
+ * \param[in]   data    connection
+ *
+ * \return  G_SOURCE_REMOVE
+ */
+static gboolean on_lost(gpointer data)
+{
+    connection_t *conn = data;
+
+    conn->lost_source = 0;
+    connection_lost(conn);
+    return G_SOURCE_REMOVE;
+}
+
+
+/** \brief  Handle a lost connection once the writer has returned
+ *
+ * Callers of write_data() are in the middle of updating their own state, so
+ * failing their requests right away would call them re-entrantly.
+ *
+ * \param[in,out]   conn    connection
+ */
+static void schedule_lost(connection_t *conn)
+{
+    if (conn->lost_source == 0) {
+        conn->lost_source = g_idle_add(on_lost, conn);
+    }
+}
+
+
+/** \brief  Callback for the asynchronous reconnect attempt
+ *
+ * \param[in]   source  GSocketClient
+ * \param[in]   result  result
+ * \param[in]   data    connection
+ */
+static void on_reconnected(GObject *source, GAsyncResult *result, gpointer data)
+{
+    connection_t *conn = data;
+    GSocketConnection *socket;
+    GError *error = NULL;
+    char *name;
+
+    socket = g_socket_client_connect_finish(G_SOCKET_CLIENT(source),
+                                            result,
+                                            &error);
+    if (socket == NULL) {
+        if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            /* connection closed, possibly freed */
+            g_error_free(error);
+            return;
+        }
+        name = get_address_name(conn);
+        debug_msg("reconnect to %s failed: %s", name, error->message);
+        g_free(name);
+        g_error_free(error);
+        g_clear_object(&conn->reconnect_cancellable);
+        set_state(conn, CONNECTION_DISCONNECTED);
+        schedule_reconnect(conn);
+        return;
+    }
+    g_clear_object(&conn->reconnect_cancellable);
+
+    conn->socket = socket;
+    conn->connects++;
+    conn->reconnect_delay = 0;
+    tune_socket(conn);
+    name = get_address_name(conn);
+    log_msg(LOG_INFO, "Reconnected to VICE at %s.\n", name);
+    logview_add("ok", "Reconnected to %s.\n", name);
+    g_free(name);
+    session_push(conn->session);
+    connection_start_dispatch();
+    session_pop();
+    set_state(conn, CONNECTION_CONNECTED);
+}
+
+
+/** \brief  Handler for the reconnect timeout
+ *
+ * \param[in]   data    connection
+ *
+ * \return  G_SOURCE_REMOVE
+ */
+static gboolean on_reconnect_timeout(gpointer data)
+{
+    connection_t *conn = data;
+    GSocketConnectable *address;
+
+    conn->reconnect_source = 0;
+    if (conn->client == NULL) {
+        conn->client = g_socket_client_new();
+    }
+    g_clear_object(&conn->reconnect_cancellable);
+    conn->reconnect_cancellable = g_cancellable_new();
+    set_state(conn, CONNECTION_CONNECTING);
+    address = get_connectable(conn);
+    g_socket_client_connect_async(conn->client,
+                                  address,
+                                  conn->reconnect_cancellable,
+                                  on_reconnected,
+                                  conn);
+    g_object_unref(address);
+    return G_SOURCE_REMOVE;
+}
+
+
+/** \brief  Schedule the next reconnect attempt
+ *
+ * The delay starts at 'Reconnect/min_delay' and doubles with each failed
+ * attempt up to 'Reconnect/max_delay' (both in milliseconds).
+ *
+ * \param[in,out]   conn    connection
+ */
+static void schedule_reconnect(connection_t *conn)
+{
+    int min_delay;
+    int max_delay;
+    char *name;
+
+    if (conn->reconnect_source != 0) {
+        return;
+    }
+    if (!settings_get_int("Reconnect", "min_delay", &min_delay)) {
+        min_delay = CONNECTION_RECONNECT_MIN_DELAY;
+    }
+    if (!settings_get_int("Reconnect", "max_delay", &max_delay)) {
+        max_delay = CONNECTION_RECONNECT_MAX_DELAY;
+    }
+    min_delay = MAX(min_delay, 1);
+    max_delay = MAX(max_delay, min_delay);
+    if (conn->reconnect_delay == 0) {
+        conn->reconnect_delay = min_delay;
+    } else {
+        conn->reconnect_delay = MIN(conn->reconnect_delay * 2, max_delay);
+    }
+    name = get_address_name(conn);
+    debug_msg("reconnecting to %s in %d ms", name, conn->reconnect_delay);
+    g_free(name);
+    conn->reconnect_source = g_timeout_add((guint)conn->reconnect_delay,
+                                           on_reconnect_timeout,
+                                           conn);
+}
+
+
+/** \brief  Start reconnecting the current session with exponential backoff
+ *
+ * Does nothing when connected or already reconnecting. Listeners registered
+ * with connection_add_state_listener() are notified on success.
+ */
+void connection_start_reconnect(void)
+{
+    connection_t *conn = current();
+
+    if (conn->socket != NULL || conn->reconnect_cancellable != NULL) {
+        return;
+    }
+    schedule_reconnect(conn);
+}
+
+
+/** \brief  Get connection state of the current session
+ *
+ * \return  state
+ */
+connection_state_t connection_get_state(void)
+{
+    return current()->state;
+}
+
+
+/** \brief  Check if the current session has been connected before
+ *
+ * For state listeners, to tell the first connect of a session apart from a
+ * reconnect.
+ *
+ * \return  true if the connection was established more than once
+ */
+bool connection_is_reconnect(void)
+{
+    return current()->connects > 1;
+}
+
+
+/** \brief  Register \a callback to be called on connection state changes
+ *
+ * The callback is called for all sessions, with the session whose state
+ * changed as the current session.
+ *
+ * \param[in]   callback    function to call
+ * \param[in]   data        data for \a callback
+ */
+void connection_add_state_listener(connection_state_cb callback, void *data)
+{
+    state_listener_t *listener = g_malloc(sizeof *listener);
+
+    listener->callback = callback;
+    listener->data = data;
+    state_listeners = g_slist_append(state_listeners, listener);
+}
+
+
+/** \brief  Unregister state listener
+ *
+ * \param[in]   callback    function registered
+ * \param[in]   data        data registered
+ */
+void connection_remove_state_listener(connection_state_cb callback,
+                                      void *data)
+{
+    GSList *node;
+
+    for (node = state_listeners; node != NULL; node = node->next) {
+        state_listener_t *listener = node->data;
+
+        if (listener->callback == callback && listener->data == data) {
+            state_listeners = g_slist_delete_link(state_listeners, node);
+            g_free(listener);
+            return;
+        }
+    }
 }
@@ -41,6 +41,9 @@
 #include <glib.h>
 #include <gio/gio.h>
 
+#include "connstats.h"
+#include "viceinfo.h"
+
 /** \brief  Monitor command object
  */
 typedef struct mon_cmd_s {
@@ -61,9 +64,84 @@ typedef struct mon_response_s {
 } mon_response_t;
 
 
+/** \brief  Connection to the binary monitor of a VICE instance (opaque)
+ */
+typedef struct connection_s connection_t;
+
+struct session_s;
+
+
+/** \brief  Error code of the responses synthesized for pending requests
+ *          when the connection is lost
+ */
+#define CONNECTION_ERR_LOST     0xff
+
+
+/** \brief  Default delay in milliseconds before the first reconnect attempt
+ */
+#define CONNECTION_RECONNECT_MIN_DELAY  500
+
+/** \brief  Default maximum delay in milliseconds between reconnect attempts
+ */
+#define CONNECTION_RECONNECT_MAX_DELAY  30000
+
+
+/** \brief  Host prefix for connecting to a unix domain socket
+ *
+ * A host of "unix:/path/to/socket" connects to that socket, the port is
+ * ignored.
+ */
+#define CONNECTION_UNIX_PREFIX  "unix:"
+
+/** \brief  Default socket send and receive buffer size in bytes
+ */
+#define CONNECTION_SOCKET_BUFFER_SIZE   (256 * 1024)
+
+
+/** \brief  Connection states
+ */
+typedef enum connection_state_e {
+    CONNECTION_DISCONNECTED,    /**< not connected */
+    CONNECTION_CONNECTING,      /**< (re)connect in progress */
+    CONNECTION_CONNECTED        /**< connected */
+} connection_state_t;
+
+
+/** \brief  Callback for connection state changes
+ *
+ * \param[in]   state   new state
+ * \param[in]   data    data passed to connection_add_state_listener()
+ */
+typedef void (*connection_state_cb)(connection_state_t state, void *data);
+
+
+/** \brief  Callback for connection_connect_async()
+ *
+ * \param[in]   success connected
+ * \param[in]   data    data passed to connection_connect_async()
+ */
+typedef void (*connection_connect_cb)(bool success, void *data);
+
+
+/** \brief  Callback for responses and events
+ *
+ * The response is only valid for the duration of the callback.
+ *
+ * \param[in]   response    response from the binary monitor
+ * \param[in]   data        data passed when registering the callback
+ */
+typedef void (*connection_response_cb)(const mon_response_t *response,
+                                       void *data);
+
+
+
+connection_t *connection_new(struct session_s *session);
+void connection_free(connection_t *conn);
+void connection_exit(void);
 
 bool connection_open(void);
 void connection_close(void);
+void connection_close_gio(void);
 
 bool connection_send_cmd(const uint8_t *cmd, size_t len, uint32_t *req_id);
 void connection_send_reset(void);
@@ -78,8 +156,44 @@ ssize_t connection_get_response(void);
 
 /* GIO interface */
 gboolean connect_gio(void);
+void connection_connect_async(connection_connect_cb callback, void *data);
 
 void connection_send_gio_reset(void);
-uint32_t connection_get_vice_version(void);
+
+void connection_start_dispatch(void);
+uint32_t connection_send_request(uint8_t type,
+                                 const uint8_t *body,
+                                 size_t len,
+                                 connection_response_cb callback,
+                                 void *data);
+uint32_t connection_send_request_resume(uint8_t type,
+                                        const uint8_t *body,
+                                        size_t len,
+                                        connection_response_cb callback,
+                                        void *data);
+void connection_add_event_handler(uint8_t type,
+                                  connection_response_cb callback,
+                                  void *data);
+void connection_remove_event_handler(uint8_t type,
+                                     connection_response_cb callback,
+                                     void *data);
+void connection_cork(void);
+void connection_uncork(void);
+bool connection_vice_running(void);
+void connection_get_stats(connstats_sample_t *sample);
+const histogram_t *connection_get_histogram(uint8_t type);
+void connection_probe_vice(void);
+const viceinfo_t *connection_get_vice_info(void);
+bool connection_supports(uint8_t command);
+
+connection_state_t connection_get_state(void);
+bool connection_is_reconnect(void);
+void connection_start_reconnect(void);
+void connection_add_state_listener(connection_state_cb callback, void *data);
+void connection_remove_state_listener(connection_state_cb callback,
+                                      void *data);
+
+uint32_t response_get_body_len(const mon_response_t *response);
+uint32_t response_get_request_id(const mon_response_t *response);
 
 #endif
@@ -0,0 +1,219 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   connstats.c
+ * \brief   Connection statistics
+ *
+ * Rolling statistics of a connection: bytes sent and received, commands in
+ * flight and queued, the round trip times of the last commands and a
+ * histogram of the round trip times per command type. The connection
+ * updates them, the UI samples them.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "connstats.h"
+
+
+/** \brief  Reset \a stats
+ *
+ * Only valid while nothing else accesses \a stats, and \a stats must not
+ * hold any histograms.
+ *
+ * \param[out]  stats   statistics
+ */
+void connstats_reset(connstats_t *stats)
+{
+    memset(stats, 0, sizeof *stats);
+}
+
+
+/** \brief  Free the histograms of \a stats
+ *
+ * \param[in,out]   stats   statistics
+ */
+void connstats_free(connstats_t *stats)
+{
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS(stats->histograms); i++) {
+        if (stats->histograms[i] != NULL) {
+            histogram_free(stats->histograms[i]);
+            stats->histograms[i] = NULL;
+        }
+    }
+}
+
+
+/** \brief  Add \a bytes to the received byte count
+ *
+ * \param[in,out]   stats   statistics
+ * \param[in]       bytes   bytes received
+ */
+void connstats_add_in(connstats_t *stats, gsize bytes)
+{
+    g_atomic_int_add((gint *)&stats->bytes_in, (gint)bytes);
+}
+
+
+/** \brief  Add \a bytes to the sent byte count
+ *
+ * \param[in,out]   stats   statistics
+ * \param[in]       bytes   bytes sent
+ */
+void connstats_add_out(connstats_t *stats, gsize bytes)
+{
+    g_atomic_int_add((gint *)&stats->bytes_out, (gint)bytes);
+}
+
+
+/** \brief  Add round trip time of a command
+ *
+ * The last CONNSTATS_RTT_SAMPLES times are kept for the percentiles of the
+ * statusbar, all times are recorded in the histogram of \a type.
+ *
+ * Must be called from the main thread.
+ *
+ * \param[in,out]   stats   statistics
+ * \param[in]       type    command type
+ * \param[in]       usec    round trip time in microseconds
+ */
+void connstats_add_rtt(connstats_t *stats, uint8_t type, gint64 usec)
+{
+    histogram_t *hist;
+    guint pos;
+
+    if (usec < 0) {
+        usec = 0;
+    } else if (usec > G_MAXINT) {
+        usec = G_MAXINT;
+    }
+    pos = (guint)g_atomic_int_add((gint *)&stats->rtt_pos, 1);
+    g_atomic_int_set((gint *)&stats->rtt[pos & (CONNSTATS_RTT_SAMPLES - 1)],
+                     (gint)usec);
+
+    hist = stats->histograms[type];
+    if (hist == NULL) {
+        hist = histogram_new();
+        g_atomic_pointer_set(&stats->histograms[type], hist);
+    }
+    histogram_record(hist, (guint)usec);
+}
+
+
+/** \brief  Get round trip time histogram of command \a type
+ *
+ * \param[in]   stats   statistics
+ * \param[in]   type    command type
+ *
+ * \return  histogram or `NULL` when no command of \a type completed yet
+ */
+const histogram_t *connstats_get_histogram(connstats_t *stats, uint8_t type)
+{
+    return g_atomic_pointer_get(&stats->histograms[type]);
+}
+
+
+/** \brief  Compare two round trip times for qsort()
+ *
+ * \param[in]   p1  first time
+ * \param[in]   p2  second time
+ *
+ * \return  <0, 0 or >0
+ */
+static int compare_rtt(const void *p1, const void *p2)
+{
+    guint a = *(const guint *)p1;
+    guint b = *(const guint *)p2;
+
+    return (a > b) - (a < b);
+}
+
+
+/** \brief  Take a sample of \a stats
+ *
+ * \param[in]   stats   statistics
+ * \param[out]  sample  sample
+ */
+void connstats_sample(connstats_t *stats, connstats_sample_t *sample)
+{
+    guint times[CONNSTATS_RTT_SAMPLES];
+    guint count;
+    guint i;
+
+    sample->time = g_get_monotonic_time();
+    sample->bytes_in = (guint)g_atomic_int_get((gint *)&stats->bytes_in);
+    sample->bytes_out = (guint)g_atomic_int_get((gint *)&stats->bytes_out);
+    sample->in_flight = g_atomic_int_get(&stats->in_flight);
+    sample->queued = g_atomic_int_get(&stats->queued);
+
+    count = MIN((guint)g_atomic_int_get((gint *)&stats->rtt_pos),
+                CONNSTATS_RTT_SAMPLES);
+    for (i = 0; i < count; i++) {
+        times[i] = (guint)g_atomic_int_get((gint *)&stats->rtt[i]);
+    }
+    sample->rtt_count = count;
+    if (count == 0) {
+        sample->rtt_p50 = 0;
+        sample->rtt_p99 = 0;
+        return;
+    }
+    qsort(times, count, sizeof times[0], compare_rtt);
+    sample->rtt_p50 = times[count * 50 / 100];
+    sample->rtt_p99 = times[count * 99 / 100];
+}
+
+
+/** \brief  Calculate bytes per second between two samples
+ *
+ * \param[in]   bytes_new   byte count of the newer sample
+ * \param[in]   bytes_old   byte count of the older sample
+ * \param[in]   time_new    time of the newer sample
+ * \param[in]   time_old    time of the older sample
+ *
+ * \return  bytes per second
+ */
+double connstats_rate(guint bytes_new,
+                      guint bytes_old,
+                      gint64 time_new,
+                      gint64 time_old)
+{
+    if (time_new <= time_old) {
+        return 0.0;
+    }
+    /* unsigned subtraction handles the counter wrapping around */
+    return (double)(guint)(bytes_new - bytes_old) * G_USEC_PER_SEC
+        / (double)(time_new - time_old);
+}
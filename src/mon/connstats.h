@@ -0,0 +1,95 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   connstats.h
+ * \brief   Connection statistics - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+
+#ifndef MON_CONNSTATS_H_
+#define MON_CONNSTATS_H_
+
+#include <stdint.h>
+#include <glib.h>
+
+#include "histogram.h"
+
+/** \brief  Number of round trip times kept for the percentiles
+ *
+ * Must be a power of two.
+ */
+#define CONNSTATS_RTT_SAMPLES   256
+
+
+/** \brief  Connection statistics
+ *
+ * All members are only accessed with g_atomic_*() so the statistics can be
+ * sampled from anywhere without locking. The byte counters wrap
+ * around, only the difference between two samples is meaningful.
+ */
+typedef struct connstats_s {
+    guint bytes_in;                     /**< bytes received */
+    guint bytes_out;                    /**< bytes sent */
+    gint in_flight;                     /**< commands awaiting a response */
+    gint queued;                        /**< commands buffered while corked */
+    guint rtt_pos;                      /**< next slot in \a rtt */
+    guint rtt[CONNSTATS_RTT_SAMPLES];   /**< round trip times (usec) */
+    histogram_t *histograms[256];       /**< round trip times (usec) per
+                                             command type, allocated on
+                                             first use */
+} connstats_t;
+
+
+/** \brief  Sample of the connection statistics
+ */
+typedef struct connstats_sample_s {
+    gint64 time;            /**< monotonic time of the sample (usec) */
+    guint bytes_in;         /**< bytes received */
+    guint bytes_out;        /**< bytes sent */
+    int in_flight;          /**< commands awaiting a response */
+    int queued;             /**< commands buffered while corked */
+    guint rtt_count;        /**< number of round trip times sampled */
+    guint rtt_p50;          /**< median round trip time (usec) */
+    guint rtt_p99;          /**< 99th percentile round trip time (usec) */
+} connstats_sample_t;
+
+
+void connstats_reset(connstats_t *stats);
+void connstats_free(connstats_t *stats);
+void connstats_add_in(connstats_t *stats, gsize bytes);
+void connstats_add_out(connstats_t *stats, gsize bytes);
+void connstats_add_rtt(connstats_t *stats, uint8_t type, gint64 usec);
+const histogram_t *connstats_get_histogram(connstats_t *stats, uint8_t type);
+void connstats_sample(connstats_t *stats, connstats_sample_t *sample);
+double connstats_rate(guint bytes_new,
+                      guint bytes_old,
+                      gint64 time_new,
+                      gint64 time_old);
+
+#endif
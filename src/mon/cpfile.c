@@ -0,0 +1,617 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   cpfile.c
+ * \brief   Checkpoint import/export
+ *
+ * Imports checkpoints from files and sends them to VICE in a single batch,
+ * and exports the local checkpoint table.
+ *
+ * Supported formats for importing:
+ *
+ * - VICE monitor command files, as written by cpfile_export() or assemblers
+ *   like KickAssembler (`.vs`): `break`, `watch` and `trace` commands (and
+ *   their short forms) are imported, `al` commands define labels which can
+ *   be used as addresses
+ * - ca65/ld65 debug info (`.dbg`)
+ *
+ * In both formats labels starting with CPFILE_BREAK_PREFIX are imported as
+ * breakpoints, labels starting with CPFILE_WATCH_PREFIX as load/store
+ * watchpoints.
+ *
+ * Files are exported as VICE monitor command files, which can also be loaded
+ * into VICE directly with `-moncommands`.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "log.h"
+#include "vicemonapi.h"
+#include "connection.h"
+#include "checkpoint.h"
+#include "symtab.h"
+
+#include "cpfile.h"
+
+
+/** \brief  Checkpoint parsed from a file
+ */
+typedef struct cpfile_entry_s {
+    uint8_t memspace;   /**< memspace */
+    uint16_t start;     /**< start address */
+    uint16_t end;       /**< end address */
+    uint8_t op;         /**< CPU operation(s) */
+    bool stop;          /**< stop when hit */
+    char *condition;    /**< condition (optional) */
+} cpfile_entry_t;
+
+
+/** \brief  Checkpoint commands in VICE monitor command files
+ */
+static const struct {
+    const char *name;   /**< command */
+    uint8_t op;         /**< default CPU operation(s) */
+    bool stop;          /**< stop when hit */
+} commands[] = {
+    { "break",  MON_CPU_OP_EXEC,                    true },
+    { "bk",     MON_CPU_OP_EXEC,                    true },
+    { "watch",  MON_CPU_OP_LOAD|MON_CPU_OP_STORE,   true },
+    { "w",      MON_CPU_OP_LOAD|MON_CPU_OP_STORE,   true },
+    { "trace",  MON_CPU_OP_EXEC,                    false },
+    { "tr",     MON_CPU_OP_EXEC,                    false }
+};
+
+
+/** \brief  Parse memspace prefix of \a token
+ *
+ * \param[in]   token       address token
+ * \param[out]  memspace    memspace
+ *
+ * \return  pointer to the token after the prefix
+ */
+static const char *parse_memspace(const char *token, uint8_t *memspace)
+{
+    *memspace = MON_MEMSPACE_MAIN;
+
+    if (token[0] != '\0' && token[1] == ':') {
+        switch (token[0]) {
+            case 'c':   /* fall through */
+            case 'C':
+                return token + 2;
+            case '8':
+                *memspace = MON_MEMSPACE_DRIVE8;
+                return token + 2;
+            case '9':
+                *memspace = MON_MEMSPACE_DRIVE9;
+                return token + 2;
+            default:
+                return NULL;
+        }
+    }
+    if (strncmp(token, "10:", 3) == 0) {
+        *memspace = MON_MEMSPACE_DRIVE10;
+        return token + 3;
+    }
+    if (strncmp(token, "11:", 3) == 0) {
+        *memspace = MON_MEMSPACE_DRIVE11;
+        return token + 3;
+    }
+    return token;
+}
+
+
+/** \brief  Parse address token
+ *
+ * Addresses are hexadecimal, with an optional '$' prefix and memspace prefix,
+ * or a label defined with `al` in the same file or in the symbol table.
+ *
+ * \param[in]   token       token
+ * \param[in]   labels      labels (name -> address)
+ * \param[out]  memspace    memspace
+ * \param[out]  addr        address
+ *
+ * \return  true on success
+ */
+static bool parse_address(const char *token,
+                          GHashTable *labels,
+                          uint8_t *memspace,
+                          uint16_t *addr)
+{
+    const char *s = parse_memspace(token, memspace);
+    char *endptr;
+    unsigned long value;
+
+    if (s == NULL) {
+        return false;
+    }
+    if (*s == '.') {
+        gpointer result;
+
+        if (g_hash_table_lookup_extended(labels, s + 1, NULL, &result)) {
+            *addr = (uint16_t)GPOINTER_TO_UINT(result);
+            return true;
+        }
+        /* fall back to the loaded symbols */
+        return symtab_lookup_name(s + 1, addr);
+    }
+    if (*s == '$') {
+        s++;
+    }
+    value = strtoul(s, &endptr, 16);
+    if (*s == '\0' || *endptr != '\0' || value > 0xffff) {
+        return false;
+    }
+    *addr = (uint16_t)value;
+    return true;
+}
+
+
+/** \brief  Split \a line into tokens
+ *
+ * \param[in]   line    line of text
+ *
+ * \return  NULL-terminated list of non-empty tokens, free with g_strfreev()
+ */
+static char **tokenize(const char *line)
+{
+    char **tokens = g_strsplit_set(line, " \t", -1);
+    int i;
+    int j = 0;
+
+    for (i = 0; tokens[i] != NULL; i++) {
+        if (*tokens[i] == '\0') {
+            g_free(tokens[i]);
+        } else {
+            tokens[j++] = tokens[i];
+        }
+    }
+    tokens[j] = NULL;
+    return tokens;
+}
+
+
+/** \brief  Collect `al` labels from VICE monitor command \a lines
+ *
+ * \param[in]   lines   lines of the file
+ *
+ * \return  hash table mapping label names to addresses
+ */
+static GHashTable *collect_labels(char **lines)
+{
+    GHashTable *labels = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                               g_free, NULL);
+
+    for (int i = 0; lines[i] != NULL; i++) {
+        char **tokens = tokenize(lines[i]);
+        uint8_t memspace;
+        uint16_t addr;
+
+        if (tokens[0] != NULL
+                && g_ascii_strcasecmp(tokens[0], "al") == 0
+                && tokens[1] != NULL
+                && tokens[2] != NULL
+                && tokens[2][0] == '.'
+                && parse_address(tokens[1], labels, &memspace, &addr)) {
+            g_hash_table_replace(labels, g_strdup(tokens[2] + 1),
+                                 GUINT_TO_POINTER(addr));
+        }
+        g_strfreev(tokens);
+    }
+    return labels;
+}
+
+
+/** \brief  Parse a checkpoint command
+ *
+ * \param[in]   line    line of text
+ * \param[in]   labels  labels defined in the file
+ * \param[out]  entry   checkpoint
+ *
+ * \return  1 on success, 0 if \a line isn't a checkpoint command, -1 on error
+ */
+static int parse_command(const char *line, GHashTable *labels, cpfile_entry_t *entry)
+{
+    char *head = g_strdup(line);
+    char *cond = NULL;
+    char **tokens;
+    char *lower;
+    char *p;
+    size_t c;
+    int t;
+    int naddr = 0;
+    uint8_t op = 0;
+
+    /* split off condition */
+    lower = g_ascii_strdown(head, -1);
+    p = strstr(lower, " if ");
+    if (p != NULL) {
+        cond = g_strstrip(g_strdup(head + (p - lower) + 4));
+        head[p - lower] = '\0';
+    }
+    g_free(lower);
+
+    tokens = tokenize(head);
+    g_free(head);
+    if (tokens[0] == NULL) {
+        g_strfreev(tokens);
+        g_free(cond);
+        return 0;
+    }
+    for (c = 0; c < G_N_ELEMENTS(commands); c++) {
+        if (g_ascii_strcasecmp(tokens[0], commands[c].name) == 0) {
+            break;
+        }
+    }
+    if (c == G_N_ELEMENTS(commands)) {
+        g_strfreev(tokens);
+        g_free(cond);
+        return 0;
+    }
+
+    entry->stop = commands[c].stop;
+    entry->condition = NULL;
+    for (t = 1; tokens[t] != NULL; t++) {
+        uint8_t memspace;
+        uint16_t addr;
+
+        if (g_ascii_strcasecmp(tokens[t], "load") == 0) {
+            op |= MON_CPU_OP_LOAD;
+        } else if (g_ascii_strcasecmp(tokens[t], "store") == 0) {
+            op |= MON_CPU_OP_STORE;
+        } else if (g_ascii_strcasecmp(tokens[t], "exec") == 0) {
+            op |= MON_CPU_OP_EXEC;
+        } else if (naddr < 2
+                && parse_address(tokens[t], labels, &memspace, &addr)) {
+            if (naddr == 0) {
+                entry->memspace = memspace;
+                entry->start = addr;
+            }
+            entry->end = addr;
+            naddr++;
+        } else {
+            naddr = -1;
+            break;
+        }
+    }
+    g_strfreev(tokens);
+
+    if (naddr <= 0 || entry->end < entry->start) {
+        g_free(cond);
+        return -1;
+    }
+    entry->op = op != 0 ? op : commands[c].op;
+    entry->condition = cond;
+    return 1;
+}
+
+
+/** \brief  Create checkpoint for label \a name if it has a checkpoint prefix
+ *
+ * \param[in]   name        label name
+ * \param[in]   memspace    memspace
+ * \param[in]   addr        address
+ * \param[out]  entry       checkpoint
+ *
+ * \return  true if \a name starts with CPFILE_BREAK_PREFIX or
+ *          CPFILE_WATCH_PREFIX
+ */
+static bool parse_label(const char *name,
+                        uint8_t memspace,
+                        uint16_t addr,
+                        cpfile_entry_t *entry)
+{
+    if (g_str_has_prefix(name, CPFILE_BREAK_PREFIX)) {
+        entry->op = MON_CPU_OP_EXEC;
+    } else if (g_str_has_prefix(name, CPFILE_WATCH_PREFIX)) {
+        entry->op = MON_CPU_OP_LOAD|MON_CPU_OP_STORE;
+    } else {
+        return false;
+    }
+    entry->memspace = memspace;
+    entry->start = addr;
+    entry->end = addr;
+    entry->stop = true;
+    entry->condition = NULL;
+    return true;
+}
+
+
+/** \brief  Parse an `al` command defining a checkpoint label
+ *
+ * \param[in]   line    line of text
+ * \param[in]   labels  labels defined in the file
+ * \param[out]  entry   checkpoint
+ *
+ * \return  true if \a line defines a label with a checkpoint prefix
+ */
+static bool parse_label_command(const char *line,
+                                GHashTable *labels,
+                                cpfile_entry_t *entry)
+{
+    char **tokens = tokenize(line);
+    uint8_t memspace;
+    uint16_t addr;
+    bool result = false;
+
+    if (tokens[0] != NULL
+            && g_ascii_strcasecmp(tokens[0], "al") == 0
+            && tokens[1] != NULL
+            && tokens[2] != NULL
+            && tokens[2][0] == '.'
+            && parse_address(tokens[1], labels, &memspace, &addr)) {
+        result = parse_label(tokens[2] + 1, memspace, addr, entry);
+    }
+    g_strfreev(tokens);
+    return result;
+}
+
+
+/** \brief  Parse VICE monitor command file
+ *
+ * \param[in]   path        path to file (for messages)
+ * \param[in]   lines       lines of the file
+ * \param[out]  entries     checkpoints
+ */
+static void parse_vice_commands(const char *path, char **lines, GArray *entries)
+{
+    GHashTable *labels = collect_labels(lines);
+
+    for (int i = 0; lines[i] != NULL; i++) {
+        cpfile_entry_t entry;
+        int result = parse_command(lines[i], labels, &entry);
+
+        if (result > 0) {
+            g_array_append_val(entries, entry);
+        } else if (result == 0
+                && parse_label_command(lines[i], labels, &entry)) {
+            g_array_append_val(entries, entry);
+        } else if (result < 0) {
+            log_msg(LOG_WARN, "%s:%d: invalid checkpoint command '%s'.\n",
+                    path, i + 1, lines[i]);
+        }
+    }
+    g_hash_table_destroy(labels);
+}
+
+
+/** \brief  Get value of field \a key in a ca65 debug info line
+ *
+ * \param[in]   line    line of text, after the record type
+ * \param[in]   key     field name
+ *
+ * \return  value (without quotes), free with g_free(), or `NULL` if not found
+ */
+static char *dbg_field(const char *line, const char *key)
+{
+    size_t keylen = strlen(key);
+    const char *p = line;
+
+    while (*p != '\0') {
+        const char *end;
+
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            p++;
+        }
+        if (strncmp(p, key, keylen) == 0 && p[keylen] == '=') {
+            p += keylen + 1;
+            if (*p == '"') {
+                p++;
+                end = strchr(p, '"');
+            } else {
+                end = strchr(p, ',');
+            }
+            return end != NULL ? g_strndup(p, (gsize)(end - p)) : g_strdup(p);
+        }
+        /* skip to next field, minding quoted strings */
+        while (*p != '\0' && *p != ',') {
+            if (*p == '"') {
+                p = strchr(p + 1, '"');
+                if (p == NULL) {
+                    return NULL;
+                }
+            }
+            p++;
+        }
+    }
+    return NULL;
+}
+
+
+/** \brief  Parse ca65/ld65 debug info
+ *
+ * \param[in]   lines       lines of the file
+ * \param[out]  entries     checkpoints
+ */
+static void parse_ca65_dbg(char **lines, GArray *entries)
+{
+    for (int i = 0; lines[i] != NULL; i++) {
+        cpfile_entry_t entry;
+        char *name;
+        char *type;
+        char *val;
+
+        if (strncmp(lines[i], "sym", 3) != 0
+                || (lines[i][3] != ' ' && lines[i][3] != '\t')) {
+            continue;
+        }
+        name = dbg_field(lines[i] + 4, "name");
+        type = dbg_field(lines[i] + 4, "type");
+        val = dbg_field(lines[i] + 4, "val");
+
+        if (name != NULL && val != NULL
+                && type != NULL && strcmp(type, "lab") == 0
+                && parse_label(name,
+                               MON_MEMSPACE_MAIN,
+                               (uint16_t)strtoul(val, NULL, 0),
+                               &entry)) {
+            g_array_append_val(entries, entry);
+        }
+        g_free(name);
+        g_free(type);
+        g_free(val);
+    }
+}
+
+
+/** \brief  Import checkpoints from \a path
+ *
+ * All checkpoints are sent to VICE in a single batch of MON_CMD_CHECKPOINT_SET
+ * commands, conditions are sent as soon as VICE reports the checkpoint
+ * numbers.
+ *
+ * \param[in]   path    path to file
+ * \param[out]  error   error (optional)
+ *
+ * \return  number of checkpoints sent, or -1 on error
+ */
+int cpfile_import(const char *path, GError **error)
+{
+    gchar *contents;
+    char **lines;
+    GArray *entries;
+    int sent = 0;
+
+    if (!g_file_get_contents(path, &contents, NULL, error)) {
+        return -1;
+    }
+    lines = g_strsplit_set(contents, "\r\n", -1);
+    g_free(contents);
+
+    entries = g_array_new(FALSE, FALSE, sizeof(cpfile_entry_t));
+    if (g_str_has_suffix(path, ".dbg")) {
+        parse_ca65_dbg(lines, entries);
+    } else {
+        parse_vice_commands(path, lines, entries);
+    }
+    g_strfreev(lines);
+
+    connection_cork();
+    for (guint i = 0; i < entries->len; i++) {
+        cpfile_entry_t *entry = &g_array_index(entries, cpfile_entry_t, i);
+
+        if (checkpoint_set(entry->memspace,
+                           entry->start,
+                           entry->end,
+                           entry->op,
+                           entry->stop,
+                           true,
+                           false,
+                           entry->condition)) {
+            sent++;
+        }
+        g_free(entry->condition);
+    }
+    connection_uncork();
+
+    log_msg(LOG_INFO, "Imported %d of %u checkpoints from '%s'.\n",
+            sent, entries->len, path);
+    if (sent < (int)entries->len) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED,
+                    "Failed to send %u checkpoints.",
+                    entries->len - (guint)sent);
+        sent = -1;
+    }
+    g_array_free(entries, TRUE);
+    return sent;
+}
+
+
+/** \brief  Prefixes for memspaces in VICE monitor syntax
+ */
+static const char *memspace_prefixes[MON_MEMSPACE_COUNT] = {
+    "c", "8", "9", "10", "11"
+};
+
+
+/** \brief  Append checkpoint \a cp to \a str as VICE monitor command
+ *
+ * \param[in]   cp      checkpoint
+ * \param[in]   str     GString to append to
+ */
+static void append_command(const checkpoint_t *cp, void *str)
+{
+    const char *prefix = memspace_prefixes[cp->memspace];
+
+    if (cp->temporary) {
+        return;
+    }
+    if (!cp->stop) {
+        g_string_append(str, "trace");
+    } else if (cp->op & MON_CPU_OP_EXEC) {
+        g_string_append(str, "break");
+    } else {
+        g_string_append(str, "watch");
+    }
+    if (cp->op & MON_CPU_OP_LOAD) {
+        g_string_append(str, " load");
+    }
+    if (cp->op & MON_CPU_OP_STORE) {
+        g_string_append(str, " store");
+    }
+    if (cp->op & MON_CPU_OP_EXEC) {
+        g_string_append(str, " exec");
+    }
+    g_string_append_printf(str, " %s:$%04x", prefix, cp->start);
+    if (cp->end != cp->start) {
+        g_string_append_printf(str, " %s:$%04x", prefix, cp->end);
+    }
+    if (cp->condition != NULL) {
+        g_string_append_printf(str, " if %s", cp->condition);
+    }
+    g_string_append_c(str, '\n');
+}
+
+
+/** \brief  Export the local checkpoint table to \a path
+ *
+ * Temporary checkpoints are not exported.
+ *
+ * \param[in]   path    path to file
+ * \param[out]  error   error (optional)
+ *
+ * \return  true on success
+ */
+bool cpfile_export(const char *path, GError **error)
+{
+    GString *str = g_string_new(NULL);
+    bool result;
+
+    checkpoint_foreach(append_command, str);
+    result = g_file_set_contents(path, str->str, (gssize)str->len, error);
+    g_string_free(str, TRUE);
+    return result;
+}
@@ -0,0 +1,52 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   cpfile.h
+ * \brief   Checkpoint import/export - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#ifndef MON_CPFILE_H_
+#define MON_CPFILE_H_
+
+#include <stdbool.h>
+#include <glib.h>
+
+/** \brief  Prefix of labels that are imported as breakpoints
+ */
+#define CPFILE_BREAK_PREFIX "bp_"
+
+/** \brief  Prefix of labels that are imported as watchpoints
+ */
+#define CPFILE_WATCH_PREFIX "wp_"
+
+
+int  cpfile_import(const char *path, GError **error);
+bool cpfile_export(const char *path, GError **error);
+
+#endif
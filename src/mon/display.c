@@ -0,0 +1,252 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   display.c
+ * \brief   Display capture
+ *
+ * Requests the emulated screen with MON_CMD_DISPLAY_GET and the palette with
+ * MON_CMD_PALETTE_GET.
+ *
+ * Any command stops the emulation, so when the emulation is running the
+ * request is followed by MON_CMD_EXIT in the same write to keep it running.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "log.h"
+#include "monitor.h"
+#include "vicemonapi.h"
+#include "connection.h"
+
+#include "display.h"
+
+
+/** \brief  Display format: 8-bit palette indexes
+ */
+#define DISPLAY_FORMAT_INDEXED8 0x00
+
+
+/** \brief  Request data
+ */
+typedef struct display_request_s {
+    display_frame_cb frame_cb;      /**< frame callback */
+    display_palette_cb palette_cb;  /**< palette callback */
+    void *data;                     /**< data for the callbacks */
+} display_request_t;
+
+
+/** \brief  Default palette: VICE's 'pepto-pal' for the C64
+ *
+ * Used when the connected VICE doesn't support MON_CMD_PALETTE_GET.
+ */
+static const uint32_t default_palette[16] = {
+    0x000000, 0xffffff, 0x68372b, 0x70a4b2,
+    0x6f3d86, 0x588d43, 0x352879, 0xb8c76f,
+    0x6f4f25, 0x433900, 0x9a6759, 0x444444,
+    0x6c6c6c, 0x9ad284, 0x6c5eb5, 0x959595
+};
+
+
+/** \brief  Decode MON_RESPONSE_DISPLAY_GET body
+ *
+ * \param[in]   body    response body
+ * \param[in]   len     length of \a body
+ * \param[out]  frame   frame, \a frame->pixels points into \a body
+ *
+ * \return  false if \a body is invalid
+ */
+bool display_decode_frame(const uint8_t *body, size_t len, display_frame_t *frame)
+{
+    uint32_t info_len;
+    const uint8_t *info;
+
+    if (len < 4) {
+        return false;
+    }
+    info_len = MON_GET_U32(body);
+    info = body + 4;
+    if (info_len < 13 || len < 4 + (size_t)info_len + 4) {
+        return false;
+    }
+    frame->debug_width = MON_GET_U16(info);
+    frame->debug_height = MON_GET_U16(info + 2);
+    frame->offset_x = MON_GET_U16(info + 4);
+    frame->offset_y = MON_GET_U16(info + 6);
+    frame->inner_width = MON_GET_U16(info + 8);
+    frame->inner_height = MON_GET_U16(info + 10);
+    frame->bpp = info[12];
+    frame->pixels_len = MON_GET_U32(info + info_len);
+    frame->pixels = info + info_len + 4;
+
+    if ((size_t)(frame->pixels - body) + frame->pixels_len > len
+            || (size_t)frame->debug_width * frame->debug_height
+               > frame->pixels_len) {
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Handler for MON_CMD_DISPLAY_GET responses
+ *
+ * \param[in]   response    response
+ * \param[in]   data        request data
+ */
+static void on_display_response(const mon_response_t *response, void *data)
+{
+    display_request_t *req = data;
+    display_frame_t frame;
+
+    if (response->error_code != MON_ERR_OK) {
+        log_msg(LOG_ERR, "Display get failed: error $%02x.\n",
+                response->error_code);
+        req->frame_cb(NULL, req->data);
+    } else if (!display_decode_frame(response->body,
+                                     response_get_body_len(response),
+                                     &frame)) {
+        log_msg(LOG_ERR, "Invalid display data.\n");
+        req->frame_cb(NULL, req->data);
+    } else {
+        req->frame_cb(&frame, req->data);
+    }
+    g_free(req);
+}
+
+
+/** \brief  Request the display buffer
+ *
+ * \param[in]   vicii       use VIC-II instead of VDC (C128 only)
+ * \param[in]   callback    function to call with the frame
+ * \param[in]   data        data for \a callback
+ *
+ * \return  true if the command was sent
+ */
+bool display_request_frame(bool vicii, display_frame_cb callback, void *data)
+{
+    display_request_t *req = g_malloc0(sizeof *req);
+    uint8_t body[2] = { vicii, DISPLAY_FORMAT_INDEXED8 };
+
+    req->frame_cb = callback;
+    req->data = data;
+    if (connection_send_request_resume(MON_CMD_DISPLAY_GET,
+                                       body,
+                                       sizeof(body),
+                                       on_display_response,
+                                       req) == 0) {
+        g_free(req);
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Handler for MON_CMD_PALETTE_GET responses
+ *
+ * \param[in]   response    response
+ * \param[in]   data        request data
+ */
+static void on_palette_response(const mon_response_t *response, void *data)
+{
+    display_request_t *req = data;
+    const uint8_t *body = response->body;
+    uint32_t len = response_get_body_len(response);
+    uint32_t palette[256];
+    size_t count = 0;
+
+    if (response->error_code == MON_ERR_OK && len >= 2) {
+        uint16_t items = MON_GET_U16(body);
+        uint32_t offset = 2;
+
+        while (count < items && count < G_N_ELEMENTS(palette)
+                && offset < len
+                && offset + 1 + body[offset] <= len) {
+            uint8_t size = body[offset];
+
+            if (size >= 3) {
+                palette[count++] = ((uint32_t)body[offset + 1] << 16)
+                                 | ((uint32_t)body[offset + 2] << 8)
+                                 | body[offset + 3];
+            }
+            offset += 1 + size;
+        }
+    }
+    if (count > 0) {
+        req->palette_cb(palette, count, req->data);
+    } else {
+        debug_msg("Palette get failed: error $%02x.", response->error_code);
+        req->palette_cb(NULL, 0, req->data);
+    }
+    g_free(req);
+}
+
+
+/** \brief  Request the palette
+ *
+ * \param[in]   vicii       use VIC-II instead of VDC (C128 only)
+ * \param[in]   callback    function to call with the palette
+ * \param[in]   data        data for \a callback
+ *
+ * \return  true if the command was sent
+ */
+bool display_request_palette(bool vicii, display_palette_cb callback, void *data)
+{
+    display_request_t *req = g_malloc0(sizeof *req);
+    uint8_t body[1] = { vicii };
+
+    req->palette_cb = callback;
+    req->data = data;
+    if (connection_send_request_resume(MON_CMD_PALETTE_GET,
+                                       body,
+                                       sizeof(body),
+                                       on_palette_response,
+                                       req) == 0) {
+        g_free(req);
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Get default palette
+ *
+ * \param[out]  count   number of entries in the palette
+ *
+ * \return  palette as 0x00RRGGBB values
+ */
+const uint32_t *display_default_palette(size_t *count)
+{
+    *count = G_N_ELEMENTS(default_palette);
+    return default_palette;
+}
@@ -0,0 +1,80 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   display.h
+ * \brief   Display capture - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#ifndef MON_DISPLAY_H_
+#define MON_DISPLAY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+
+/** \brief  Display buffer as returned by MON_CMD_DISPLAY_GET
+ */
+typedef struct display_frame_s {
+    uint16_t debug_width;   /**< width of the complete buffer */
+    uint16_t debug_height;  /**< height of the complete buffer */
+    uint16_t offset_x;      /**< X offset of the inner (visible) area */
+    uint16_t offset_y;      /**< Y offset of the inner (visible) area */
+    uint16_t inner_width;   /**< width of the inner area */
+    uint16_t inner_height;  /**< height of the inner area */
+    uint8_t  bpp;           /**< bits per pixel */
+    const uint8_t *pixels;  /**< pixel data, one palette index per byte */
+    uint32_t pixels_len;    /**< size of \a pixels in bytes */
+} display_frame_t;
+
+
+/** \brief  Callback for display_request_frame()
+ *
+ * \param[in]   frame   frame, or `NULL` on error (only valid during the call)
+ * \param[in]   data    data passed to display_request_frame()
+ */
+typedef void (*display_frame_cb)(const display_frame_t *frame, void *data);
+
+/** \brief  Callback for display_request_palette()
+ *
+ * \param[in]   palette palette as 0x00RRGGBB values, or `NULL` on error
+ * \param[in]   count   number of entries in \a palette
+ * \param[in]   data    data passed to display_request_palette()
+ */
+typedef void (*display_palette_cb)(const uint32_t *palette,
+                                   size_t count,
+                                   void *data);
+
+
+bool display_request_frame(bool vicii, display_frame_cb callback, void *data);
+bool display_request_palette(bool vicii, display_palette_cb callback, void *data);
+bool display_decode_frame(const uint8_t *body, size_t len, display_frame_t *frame);
+const uint32_t *display_default_palette(size_t *count);
+
+#endif
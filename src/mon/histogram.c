@@ -0,0 +1,201 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   histogram.c
+ * \brief   Latency histogram
+ *
+ * Log-linear histogram in the style of HdrHistogram, with a fixed precision
+ * of HISTOGRAM_SUB_BITS bits over the full guint32 range. Used to record
+ * round trip times of binary monitor commands in microseconds.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "histogram.h"
+
+
+/** \brief  Create new histogram
+ *
+ * \return  histogram, free with histogram_free()
+ */
+histogram_t *histogram_new(void)
+{
+    histogram_t *hist = g_malloc0(sizeof *hist);
+
+    hist->min = G_MAXUINT32;
+    return hist;
+}
+
+
+/** \brief  Free \a hist
+ *
+ * \param[in]   hist    histogram
+ */
+void histogram_free(histogram_t *hist)
+{
+    g_free(hist);
+}
+
+
+/** \brief  Get bucket index of \a value
+ *
+ * \param[in]   value   value
+ *
+ * \return  bucket index
+ */
+static guint bucket_index(guint value)
+{
+    guint msb;
+    guint shift;
+
+    if (value < 2 * HISTOGRAM_SUB_COUNT) {
+        return value;
+    }
+    msb = (guint)g_bit_nth_msf(value, -1);
+    shift = msb - HISTOGRAM_SUB_BITS;
+    return (shift + 1) * HISTOGRAM_SUB_COUNT
+        + (value >> shift) - HISTOGRAM_SUB_COUNT;
+}
+
+
+/** \brief  Get highest value that ends up in bucket \a index
+ *
+ * \param[in]   index   bucket index
+ *
+ * \return  value
+ */
+static guint bucket_value(guint index)
+{
+    guint shift;
+    guint64 sub;
+
+    if (index < 2 * HISTOGRAM_SUB_COUNT) {
+        return index;
+    }
+    shift = index / HISTOGRAM_SUB_COUNT - 1;
+    sub = index % HISTOGRAM_SUB_COUNT + HISTOGRAM_SUB_COUNT;
+    return (guint)MIN(((sub + 1) << shift) - 1, G_MAXUINT32);
+}
+
+
+/** \brief  Record \a value in \a hist
+ *
+ * \param[in,out]   hist    histogram
+ * \param[in]       value   value
+ */
+void histogram_record(histogram_t *hist, guint value)
+{
+    guint old;
+
+    g_atomic_int_inc((gint *)&hist->buckets[bucket_index(value)]);
+    g_atomic_int_inc((gint *)&hist->count);
+    hist->sum += value;
+
+    do {
+        old = (guint)g_atomic_int_get((gint *)&hist->min);
+    } while (value < old && !g_atomic_int_compare_and_exchange(
+                (gint *)&hist->min, (gint)old, (gint)value));
+    do {
+        old = (guint)g_atomic_int_get((gint *)&hist->max);
+    } while (value > old && !g_atomic_int_compare_and_exchange(
+                (gint *)&hist->max, (gint)old, (gint)value));
+}
+
+
+/** \brief  Get value at \a percentile
+ *
+ * \param[in]   hist        histogram
+ * \param[in]   percentile  percentile (0.0-100.0)
+ *
+ * \return  upper bound of the bucket containing the percentile, clamped to
+ *          the largest value recorded
+ */
+guint histogram_percentile(const histogram_t *hist, double percentile)
+{
+    guint64 target;
+    guint64 total = 0;
+    guint i;
+
+    if (hist->count == 0) {
+        return 0;
+    }
+    target = (guint64)(percentile / 100.0 * hist->count + 0.5);
+    if (target < 1) {
+        target = 1;
+    }
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        total += hist->buckets[i];
+        if (total >= target) {
+            return MIN(bucket_value(i), hist->max);
+        }
+    }
+    return hist->max;
+}
+
+
+/** \brief  Append \a hist as JSON object to \a json
+ *
+ * Values are in the unit recorded (microseconds for round trip times). The
+ * "buckets" member lists [upper bound, count] pairs of non-empty buckets.
+ *
+ * \param[in]       hist    histogram
+ * \param[in,out]   json    string to append to
+ */
+void histogram_to_json(const histogram_t *hist, GString *json)
+{
+    bool first = true;
+    guint i;
+
+    g_string_append_printf(json,
+            "{\"count\": %u, \"min\": %u, \"mean\": %.1f, "
+            "\"p50\": %u, \"p90\": %u, \"p99\": %u, \"p99.9\": %u, "
+            "\"max\": %u, \"buckets\": [",
+            hist->count,
+            hist->count > 0 ? hist->min : 0,
+            hist->count > 0 ? (double)hist->sum / hist->count : 0.0,
+            histogram_percentile(hist, 50.0),
+            histogram_percentile(hist, 90.0),
+            histogram_percentile(hist, 99.0),
+            histogram_percentile(hist, 99.9),
+            hist->max);
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (hist->buckets[i] > 0) {
+            g_string_append_printf(json, "%s[%u, %u]",
+                                   first ? "" : ", ",
+                                   bucket_value(i), hist->buckets[i]);
+            first = false;
+        }
+    }
+    g_string_append(json, "]}");
+}
@@ -0,0 +1,79 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   histogram.h
+ * \brief   Latency histogram - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+
+#ifndef MON_HISTOGRAM_H_
+#define MON_HISTOGRAM_H_
+
+#include <stdint.h>
+#include <glib.h>
+
+/** \brief  Number of sub-buckets per power of two (as bits)
+ *
+ * 5 bits gives 32 sub-buckets, so values are recorded with a relative error
+ * of at most 1/32 (about 3%).
+ */
+#define HISTOGRAM_SUB_BITS      5
+
+/** \brief  Number of sub-buckets per power of two
+ */
+#define HISTOGRAM_SUB_COUNT     (1 << HISTOGRAM_SUB_BITS)
+
+/** \brief  Number of buckets, covering the full guint32 range
+ */
+#define HISTOGRAM_BUCKETS       ((33 - HISTOGRAM_SUB_BITS) * HISTOGRAM_SUB_COUNT)
+
+
+/** \brief  HDR-style latency histogram
+ *
+ * Buckets are log-linear: values below 2 * HISTOGRAM_SUB_COUNT each get
+ * their own bucket, above that every power of two is split into
+ * HISTOGRAM_SUB_COUNT buckets. Recording is constant time and lock-free.
+ */
+typedef struct histogram_s {
+    guint count;                        /**< number of values recorded */
+    guint min;                          /**< smallest value */
+    guint max;                          /**< largest value */
+    guint64 sum;                        /**< sum of the values (for the mean,
+                                             main thread only) */
+    guint buckets[HISTOGRAM_BUCKETS];   /**< bucket counts */
+} histogram_t;
+
+
+histogram_t *histogram_new(void);
+void histogram_free(histogram_t *hist);
+void histogram_record(histogram_t *hist, guint value);
+guint histogram_percentile(const histogram_t *hist, double percentile);
+void histogram_to_json(const histogram_t *hist, GString *json);
+
+#endif
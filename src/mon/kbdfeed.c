@@ -0,0 +1,526 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   kbdfeed.c
+ * \brief   Keyboard feed
+ *
+ * Text is split into MON_CMD_KEYBOARD_FEED commands of at most 255 bytes,
+ * never splitting an escape sequence. The next chunk is only sent after VICE
+ * responded to the previous one.
+ *
+ * With \a drain set, chunks are limited to the size of the keyboard buffer
+ * of the emulated machine, and the buffer count is polled until the program
+ * consumed all keys before the next chunk is sent. This keeps long input
+ * from outrunning slow BASIC input loops. Draining only happens while the
+ * emulation is running.
+ *
+ * Supported escapes, besides plain printable ASCII:
+ *   - newline: RETURN
+ *   - `{name}`: PETSCII control codes, e.g. `{clr}`, `{home}`, `{down}`,
+ *     `{rvs on}`, `{f1}`, `{red}`
+ *   - `{$xx}`: PETSCII code in hex
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "log.h"
+#include "settings.h"
+#include "vicemonapi.h"
+#include "connection.h"
+#include "session.h"
+
+#include "kbdfeed.h"
+
+
+/** \brief  Interval in milliseconds for polling the keyboard buffer
+ */
+#define DRAIN_POLL_INTERVAL 20
+
+
+/** \brief  PETSCII escape
+ */
+typedef struct kbd_escape_s {
+    const char *name;   /**< name between braces */
+    uint8_t code;       /**< PETSCII code */
+} kbd_escape_t;
+
+
+/** \brief  Keyboard feed job
+ */
+typedef struct kbd_job_s {
+    session_t *session;         /**< session to type into */
+    GPtrArray *chunks;          /**< chunks (GByteArray) */
+    guint next;                 /**< index of next chunk */
+    bool drain;                 /**< wait for the keyboard buffer */
+    kbdfeed_done_cb callback;   /**< function to call when done */
+    void *data;                 /**< data for \a callback */
+} kbd_job_t;
+
+
+/** \brief  PETSCII escapes
+ */
+static const kbd_escape_t escapes[] = {
+    { "clr",        0x93 },
+    { "clear",      0x93 },
+    { "home",       0x13 },
+    { "return",     0x0d },
+    { "del",        0x14 },
+    { "inst",       0x94 },
+    { "up",         0x91 },
+    { "down",       0x11 },
+    { "left",       0x9d },
+    { "right",      0x1d },
+    { "rvs on",     0x12 },
+    { "rvs off",    0x92 },
+    { "stop",       0x03 },
+    { "f1",         0x85 },
+    { "f3",         0x86 },
+    { "f5",         0x87 },
+    { "f7",         0x88 },
+    { "f2",         0x89 },
+    { "f4",         0x8a },
+    { "f6",         0x8b },
+    { "f8",         0x8c },
+    { "blk",        0x90 },
+    { "wht",        0x05 },
+    { "red",        0x1c },
+    { "cyn",        0x9f },
+    { "pur",        0x9c },
+    { "grn",        0x1e },
+    { "blu",        0x1f },
+    { "yel",        0x9e },
+    { "orng",       0x81 },
+    { "brn",        0x95 },
+    { "lred",       0x96 },
+    { "gry1",       0x97 },
+    { "gry2",       0x98 },
+    { "lgrn",       0x99 },
+    { "lblu",       0x9a },
+    { "gry3",       0x9b },
+    { NULL,         0x00 }
+};
+
+
+/** \brief  Jobs, the head is being sent
+ */
+static GQueue jobs = G_QUEUE_INIT;
+
+/** \brief  Drain poll timeout source ID
+ */
+static guint poll_source = 0;
+
+/** \brief  Request in flight for the head job
+ */
+static bool in_flight = false;
+
+/** \brief  Generation of the job queue, incremented by kbdfeed_cancel()
+ *
+ * Passed as callback data with each request, so responses to requests sent
+ * before a cancel are dropped instead of advancing the next job.
+ */
+static guint generation = 0;
+
+
+static void send_next(void);
+static void on_count_response(const mon_response_t *response, void *data);
+
+
+/** \brief  Look up PETSCII escape
+ *
+ * \param[in]   name    name, without braces
+ * \param[out]  code    PETSCII code
+ *
+ * \return  false if unknown
+ */
+static bool lookup_escape(const char *name, uint8_t *code)
+{
+    if (name[0] == '$') {
+        char *endptr;
+        guint64 value = g_ascii_strtoull(name + 1, &endptr, 16);
+
+        if (endptr == name + 1 || *endptr != '\0' || value > 0xff) {
+            return false;
+        }
+        *code = (uint8_t)value;
+        return true;
+    }
+    for (int i = 0; escapes[i].name != NULL; i++) {
+        if (g_ascii_strcasecmp(escapes[i].name, name) == 0) {
+            *code = escapes[i].code;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/** \brief  Encode text as keyboard feed tokens
+ *
+ * Each token is the text VICE unescapes into a single key.
+ *
+ * \param[in]   text    text
+ * \param[out]  tokens  tokens (strings, freed by the array's free func)
+ * \param[out]  error   error (optional)
+ *
+ * \return  false on invalid input
+ */
+bool kbdfeed_encode(const char *text, GPtrArray *tokens, GError **error)
+{
+    const char *s = text;
+
+    while (*s != '\0') {
+        if (*s == '\n') {
+            g_ptr_array_add(tokens, g_strdup("\\r"));
+            s++;
+        } else if (*s == '\\') {
+            g_ptr_array_add(tokens, g_strdup("\\\\"));
+            s++;
+        } else if (*s == '{') {
+            const char *end = strchr(s, '}');
+            char *name;
+            uint8_t code;
+
+            if (end == NULL) {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                            "unterminated escape at offset %d",
+                            (int)(s - text));
+                return false;
+            }
+            name = g_strndup(s + 1, (gsize)(end - s - 1));
+            if (!lookup_escape(name, &code)) {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                            "unknown escape '{%s}'", name);
+                g_free(name);
+                return false;
+            }
+            g_free(name);
+            if (code == 0x0d) {
+                g_ptr_array_add(tokens, g_strdup("\\r"));
+            } else {
+                g_ptr_array_add(tokens, g_strdup_printf("\\x%02x", code));
+            }
+            s = end + 1;
+        } else if (g_ascii_isprint(*s)) {
+            g_ptr_array_add(tokens, g_strndup(s, 1));
+            s++;
+        } else {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                        "unsupported character $%02x at offset %d",
+                        (unsigned int)(unsigned char)*s, (int)(s - text));
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Split tokens into command bodies
+ *
+ * \param[in]   tokens      tokens
+ * \param[in]   max_keys    maximum number of keys per chunk
+ *
+ * \return  chunks, each a MON_CMD_KEYBOARD_FEED body
+ */
+static GPtrArray *make_chunks(GPtrArray *tokens, guint max_keys)
+{
+    GPtrArray *chunks = g_ptr_array_new_with_free_func(
+            (GDestroyNotify)g_byte_array_unref);
+    GByteArray *chunk = NULL;
+    guint keys = 0;
+
+    for (guint i = 0; i < tokens->len; i++) {
+        const char *token = g_ptr_array_index(tokens, i);
+        size_t len = strlen(token);
+
+        if (chunk != NULL
+                && (chunk->len - 1 + len > KBDFEED_CHUNK_SIZE
+                    || keys == max_keys)) {
+            chunk = NULL;
+        }
+        if (chunk == NULL) {
+            uint8_t zero = 0;
+
+            chunk = g_byte_array_new();
+            g_byte_array_append(chunk, &zero, 1);
+            g_ptr_array_add(chunks, chunk);
+            keys = 0;
+        }
+        g_byte_array_append(chunk, (const guint8 *)token, (guint)len);
+        chunk->data[0] = (uint8_t)(chunk->len - 1);
+        keys++;
+    }
+    return chunks;
+}
+
+
+/** \brief  Free job
+ *
+ * \param[in]   job job
+ */
+static void job_free(kbd_job_t *job)
+{
+    g_ptr_array_unref(job->chunks);
+    g_free(job);
+}
+
+
+/** \brief  Finish the head job and start the next one
+ *
+ * \param[in]   success job succeeded
+ */
+static void finish_job(bool success)
+{
+    kbd_job_t *job = g_queue_pop_head(&jobs);
+
+    if (job == NULL) {
+        return;
+    }
+    if (!success) {
+        log_msg(LOG_WARN, "Keyboard feed failed after %u of %u chunks.\n",
+                job->next, job->chunks->len);
+    }
+    if (job->callback != NULL) {
+        job->callback(success, job->data);
+    }
+    job_free(job);
+    send_next();
+}
+
+
+/** \brief  Poll the keyboard buffer count
+ *
+ * \param[in]   data    unused
+ *
+ * \return  G_SOURCE_REMOVE
+ */
+static gboolean poll_buffer(gpointer data)
+{
+    kbd_job_t *job = g_queue_peek_head(&jobs);
+    int addr;
+    uint8_t body[8];
+
+    poll_source = 0;
+    if (job == NULL) {
+        return G_SOURCE_REMOVE;
+    }
+    session_push(job->session);
+    if (!connection_vice_running()) {
+        /* nothing drains while stopped, VICE queues the keys */
+        session_pop();
+        send_next();
+        return G_SOURCE_REMOVE;
+    }
+    if (!settings_get_int("Keyboard", "buffer_count", &addr)) {
+        addr = KBDFEED_BUFFER_COUNT;
+    }
+    body[0] = 0;    /* no side effects */
+    body[1] = (uint8_t)(addr & 0xff);
+    body[2] = (uint8_t)((addr >> 8) & 0xff);
+    body[3] = body[1];
+    body[4] = body[2];
+    body[5] = MON_MEMSPACE_MAIN;
+    body[6] = 0;
+    body[7] = 0;
+    in_flight = true;
+    if (connection_send_request_resume(MON_CMD_MEM_GET, body, sizeof(body),
+                                       on_count_response,
+                                       GUINT_TO_POINTER(generation)) == 0) {
+        in_flight = false;
+        session_pop();
+        finish_job(false);
+        return G_SOURCE_REMOVE;
+    }
+    session_pop();
+    return G_SOURCE_REMOVE;
+}
+
+
+/** \brief  Handler for the MON_CMD_MEM_GET response of the buffer count
+ *
+ * \param[in]   response    response
+ * \param[in]   data        generation when sent
+ */
+static void on_count_response(const mon_response_t *response, void *data)
+{
+    if (GPOINTER_TO_UINT(data) != generation) {
+        return;
+    }
+    in_flight = false;
+    if (response->error_code != MON_ERR_OK
+            || response_get_body_len(response) < 3) {
+        finish_job(false);
+        return;
+    }
+    if (response->body[2] != 0) {
+        poll_source = g_timeout_add(DRAIN_POLL_INTERVAL, poll_buffer, NULL);
+    } else {
+        send_next();
+    }
+}
+
+
+/** \brief  Handler for the MON_CMD_KEYBOARD_FEED response
+ *
+ * \param[in]   response    response
+ * \param[in]   data        generation when sent
+ */
+static void on_feed_response(const mon_response_t *response, void *data)
+{
+    kbd_job_t *job = g_queue_peek_head(&jobs);
+
+    if (GPOINTER_TO_UINT(data) != generation) {
+        /* sent for a cancelled job */
+        return;
+    }
+    in_flight = false;
+    if (response->error_code != MON_ERR_OK) {
+        finish_job(false);
+        return;
+    }
+    if (job != NULL && job->drain) {
+        poll_source = g_timeout_add(DRAIN_POLL_INTERVAL, poll_buffer, NULL);
+    } else {
+        send_next();
+    }
+}
+
+
+/** \brief  Send the next chunk of the head job
+ *
+ * The chunk is sent to the session the job was queued for.
+ */
+static void send_next(void)
+{
+    kbd_job_t *job = g_queue_peek_head(&jobs);
+    GByteArray *chunk;
+    uint32_t req_id;
+
+    if (job == NULL || in_flight || poll_source != 0) {
+        return;
+    }
+    if (job->next == job->chunks->len) {
+        finish_job(true);
+        return;
+    }
+    chunk = g_ptr_array_index(job->chunks, job->next++);
+    in_flight = true;
+    session_push(job->session);
+    req_id = connection_send_request_resume(MON_CMD_KEYBOARD_FEED,
+                                            chunk->data,
+                                            chunk->len,
+                                            on_feed_response,
+                                            GUINT_TO_POINTER(generation));
+    session_pop();
+    if (req_id == 0) {
+        in_flight = false;
+        finish_job(false);
+    }
+}
+
+
+/** \brief  Type text into the emulated machine
+ *
+ * Jobs are queued and sent one after another, to the current session.
+ *
+ * \param[in]   text        text, see the file description for escapes
+ * \param[in]   drain       wait for the program to read the keyboard buffer
+ * \param[in]   callback    function to call when done (optional)
+ * \param[in]   data        data for \a callback
+ * \param[out]  error       error (optional)
+ *
+ * \return  false on invalid input
+ */
+bool kbdfeed_text(const char *text,
+                  bool drain,
+                  kbdfeed_done_cb callback,
+                  void *data,
+                  GError **error)
+{
+    GPtrArray *tokens = g_ptr_array_new_with_free_func(g_free);
+    kbd_job_t *job;
+    int buffer_size = KBDFEED_CHUNK_SIZE;
+
+    if (!kbdfeed_encode(text, tokens, error)) {
+        g_ptr_array_unref(tokens);
+        return false;
+    }
+    if (drain && !settings_get_int("Keyboard", "buffer_size", &buffer_size)) {
+        buffer_size = KBDFEED_BUFFER_SIZE;
+    }
+
+    job = g_malloc0(sizeof *job);
+    job->session = session_current();
+    job->chunks = make_chunks(tokens, (guint)MAX(buffer_size, 1));
+    job->drain = drain;
+    job->callback = callback;
+    job->data = data;
+    g_ptr_array_unref(tokens);
+
+    debug_msg("queueing %u keyboard feed chunks", job->chunks->len);
+    g_queue_push_tail(&jobs, job);
+    send_next();
+    return true;
+}
+
+
+/** \brief  Cancel all keyboard feeds
+ *
+ * Callbacks are not called. A response still in flight is ignored.
+ */
+void kbdfeed_cancel(void)
+{
+    kbd_job_t *job;
+
+    if (poll_source != 0) {
+        g_source_remove(poll_source);
+        poll_source = 0;
+    }
+    while ((job = g_queue_pop_head(&jobs)) != NULL) {
+        job_free(job);
+    }
+    generation++;
+    in_flight = false;
+}
+
+
+/** \brief  Check if keyboard feeds are in progress
+ *
+ * \return  true if busy
+ */
+bool kbdfeed_busy(void)
+{
+    return !g_queue_is_empty(&jobs);
+}
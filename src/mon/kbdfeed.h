@@ -0,0 +1,72 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   kbdfeed.h
+ * \brief   Keyboard feed - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#ifndef MON_KBDFEED_H_
+#define MON_KBDFEED_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <glib.h>
+
+/** \brief  Maximum size of the text of a MON_CMD_KEYBOARD_FEED command
+ */
+#define KBDFEED_CHUNK_SIZE      0xff
+
+/** \brief  Default address of the keyboard buffer count (C64/VIC-20)
+ */
+#define KBDFEED_BUFFER_COUNT    0x00c6
+
+/** \brief  Default size of the keyboard buffer (C64/VIC-20)
+ */
+#define KBDFEED_BUFFER_SIZE     10
+
+
+/** \brief  Callback for finished keyboard feeds
+ *
+ * \param[in]   success all text was sent
+ * \param[in]   data    data passed to kbdfeed_text()
+ */
+typedef void (*kbdfeed_done_cb)(bool success, void *data);
+
+
+bool kbdfeed_encode(const char *text, GPtrArray *tokens, GError **error);
+bool kbdfeed_text(const char *text,
+                  bool drain,
+                  kbdfeed_done_cb callback,
+                  void *data,
+                  GError **error);
+void kbdfeed_cancel(void);
+bool kbdfeed_busy(void);
+
+#endif
@@ -0,0 +1,230 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   latency.c
+ * \brief   Command latency report
+ *
+ * Writes the round trip time histograms of all sessions, per command type,
+ * as JSON:
+ *
+ * \code{.json}
+ * {"sessions": [{"name": "127.0.0.1:6502", "commands": [
+ *     {"command": "MEM_GET", "type": 1, "unit": "usec",
+ *      "histogram": {"count": 12, "min": 180, ...}}]}]}
+ * \endcode
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "connection.h"
+#include "histogram.h"
+#include "session.h"
+#include "settings.h"
+#include "vicemonapi.h"
+
+#include "latency.h"
+
+
+/** \brief  Command type and name
+ */
+typedef struct command_name_s {
+    uint8_t type;       /**< command type */
+    const char *name;   /**< name, MON_CMD_ prefix stripped */
+} command_name_t;
+
+
+/** \brief  Names of the binary monitor commands
+ */
+static const command_name_t command_names[] = {
+    { MON_CMD_MEM_GET,              "MEM_GET" },
+    { MON_CMD_MEM_SET,              "MEM_SET" },
+    { MON_CMD_CHECKPOINT_GET,       "CHECKPOINT_GET" },
+    { MON_CMD_CHECKPOINT_SET,       "CHECKPOINT_SET" },
+    { MON_CMD_CHECKPOINT_DELETE,    "CHECKPOINT_DELETE" },
+    { MON_CMD_CHECKPOINT_LIST,      "CHECKPOINT_LIST" },
+    { MON_CMD_CHECKPOINT_TOGGLE,    "CHECKPOINT_TOGGLE" },
+    { MON_CMD_CONDITION_SET,        "CONDITION_SET" },
+    { MON_CMD_REGISTERS_GET,        "REGISTERS_GET" },
+    { MON_CMD_REGISTERS_SET,        "REGISTERS_SET" },
+    { MON_CMD_DUMP,                 "DUMP" },
+    { MON_CMD_UNDUMP,               "UNDUMP" },
+    { MON_CMD_RESOURCE_GET,         "RESOURCE_GET" },
+    { MON_CMD_RESOURCE_SET,         "RESOURCE_SET" },
+    { MON_CMD_ADVANCE_INSTRUCTIONS, "ADVANCE_INSTRUCTIONS" },
+    { MON_CMD_KEYBOARD_FEED,        "KEYBOARD_FEED" },
+    { MON_CMD_EXECUTE_UNTIL_RETURN, "EXECUTE_UNTIL_RETURN" },
+    { MON_CMD_PING,                 "PING" },
+    { MON_CMD_BANKS_AVAILABLE,      "BANKS_AVAILABLE" },
+    { MON_CMD_REGISTERS_AVAILABLE,  "REGISTERS_AVAILABLE" },
+    { MON_CMD_DISPLAY_GET,          "DISPLAY_GET" },
+    { MON_CMD_VICE_INFO,            "VICE_INFO" },
+    { MON_CMD_PALETTE_GET,          "PALETTE_GET" },
+    { MON_CMD_EXIT,                 "EXIT" },
+    { MON_CMD_QUIT,                 "QUIT" },
+    { MON_CMD_RESET,                "RESET" },
+    { MON_CMD_AUTOSTART,            "AUTOSTART" }
+};
+
+
+/** \brief  Get name of command \a type
+ *
+ * \param[in]   type    command type
+ *
+ * \return  name or `NULL` for unknown commands
+ */
+const char *latency_command_name(uint8_t type)
+{
+    size_t i;
+
+    for (i = 0; i < G_N_ELEMENTS(command_names); i++) {
+        if (command_names[i].type == type) {
+            return command_names[i].name;
+        }
+    }
+    return NULL;
+}
+
+
+/** \brief  Append JSON string literal of \a text to \a json
+ *
+ * \param[in,out]   json    string to append to
+ * \param[in]       text    text
+ */
+static void append_string(GString *json, const char *text)
+{
+    g_string_append_c(json, '"');
+    for (; *text != '\0'; text++) {
+        if (*text == '"' || *text == '\\') {
+            g_string_append_c(json, '\\');
+            g_string_append_c(json, *text);
+        } else if ((unsigned char)*text < 0x20) {
+            g_string_append_printf(json, "\\u%04x", (unsigned char)*text);
+        } else {
+            g_string_append_c(json, *text);
+        }
+    }
+    g_string_append_c(json, '"');
+}
+
+
+/** \brief  Append report of a session
+ *
+ * \param[in]   session session
+ * \param[in]   data    JSON string
+ */
+static void append_session(session_t *session, void *data)
+{
+    GString *json = data;
+    bool first = true;
+    guint type;
+
+    if (json->str[json->len - 1] == '}') {
+        g_string_append(json, ",");
+    }
+    g_string_append(json, "\n  {\"name\": ");
+    append_string(json, session->name);
+    g_string_append(json, ", \"commands\": [");
+
+    session_push(session);
+    for (type = 0; type < 256; type++) {
+        const histogram_t *hist = connection_get_histogram((uint8_t)type);
+        const char *name;
+
+        if (hist == NULL) {
+            continue;
+        }
+        name = latency_command_name((uint8_t)type);
+        g_string_append(json, first ? "\n    " : ",\n    ");
+        g_string_append(json, "{\"command\": ");
+        if (name != NULL) {
+            append_string(json, name);
+        } else {
+            g_string_append(json, "null");
+        }
+        g_string_append_printf(json,
+                ", \"type\": %u, \"unit\": \"usec\", \"histogram\": ",
+                type);
+        histogram_to_json(hist, json);
+        g_string_append(json, "}");
+        first = false;
+    }
+    session_pop();
+    g_string_append(json, "]}");
+}
+
+
+/** \brief  Create latency report of all sessions
+ *
+ * \return  JSON, free with g_free()
+ */
+char *latency_report_json(void)
+{
+    GString *json = g_string_new("{\"sessions\": [");
+
+    session_foreach(append_session, json);
+    g_string_append(json, "\n]}\n");
+    return g_string_free(json, FALSE);
+}
+
+
+/** \brief  Write latency report of all sessions to \a path
+ *
+ * \param[in]   path    path to file
+ * \param[out]  error   error (optional)
+ *
+ * \return  true on success
+ */
+bool latency_report_write(const char *path, GError **error)
+{
+    char *json = latency_report_json();
+    bool result;
+
+    result = g_file_set_contents(path, json, -1, error);
+    g_free(json);
+    return result;
+}
+
+
+/** \brief  Get default path of the latency report
+ *
+ * \return  path in the settings dir, free with g_free()
+ */
+char *latency_report_default_path(void)
+{
+    char *dir = settings_get_dir();
+    char *path = g_build_filename(dir, LATENCY_REPORT_FILE, NULL);
+
+    g_free(dir);
+    return path;
+}
@@ -0,0 +1,719 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   memcache.c
+ * \brief   Local mirror of VICE memory
+ *
+ * Keeps a 64KiB mirror per memspace and bank, divided in pages of
+ * MEMCACHE_PAGE_SIZE bytes with a valid bit and a generation per page.
+ *
+ * Pages are only fetched when they're stale, consecutive stale pages are
+ * fetched with a single MON_CMD_MEM_GET, all commands of a fetch are sent
+ * in one go. Memory can only change while the emulation runs or when it's
+ * written through the monitor, so all pages are invalidated on
+ * MON_RESPONSE_RESUMED and writers call memcache_invalidate().
+ *
+ * The generation of a page is bumped on each invalidation, so users can
+ * tell whether data they derived from a page is still current.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "log.h"
+#include "monitor.h"
+#include "vicemonapi.h"
+#include "connection.h"
+#include "session.h"
+
+#include "memcache.h"
+
+
+/** \brief  Mirror of a memspace and bank
+ */
+typedef struct mirror_s {
+    uint8_t memspace;                           /**< memspace */
+    uint16_t bank;                              /**< bank */
+    uint64_t valid[MEMCACHE_BITMAP_WORDS];      /**< valid pages */
+    uint32_t generation[MEMCACHE_PAGE_COUNT];   /**< page generations */
+    uint8_t mem[MEMCACHE_PAGE_SIZE * MEMCACHE_PAGE_COUNT];  /**< memory */
+} mirror_t;
+
+
+/** \brief  Fetch in progress
+ */
+typedef struct fetch_s {
+    memcache_ready_cb callback; /**< function to call when done */
+    void *data;                 /**< data for \a callback */
+    guint remaining;            /**< number of commands in flight */
+    bool failed;                /**< a command failed */
+} fetch_t;
+
+
+/** \brief  Single MON_CMD_MEM_GET of a fetch
+ */
+typedef struct run_s {
+    fetch_t *fetch;         /**< fetch */
+    uint8_t memspace;       /**< memspace */
+    uint16_t bank;          /**< bank */
+    int first_page;         /**< first page */
+    int page_count;         /**< number of pages */
+    uint32_t epoch;         /**< invalidation epoch when sent */
+} run_t;
+
+
+/** \brief  Listener for invalidated pages
+ */
+typedef struct listener_s {
+    memcache_listener_cb callback;  /**< function to call */
+    void *data;                     /**< data for \a callback */
+} listener_t;
+
+
+/** \brief  Memory cache of a session
+ *
+ * The invalidation epoch is incremented on each invalidation, invalidated
+ * pages get the new value as their generation.
+ */
+struct memcache_ctx_s {
+    GHashTable *mirrors;    /**< mirrors, keyed by memspace << 16 | bank */
+    uint32_t epoch;         /**< invalidation epoch */
+};
+
+
+/** \brief  List of listeners, shared by all sessions
+ */
+static GSList *listeners = NULL;
+
+
+/** \brief  Get memory cache of the current session
+ *
+ * \return  memory cache
+ */
+static memcache_ctx_t *ctx(void)
+{
+    return session_current()->memcache;
+}
+
+
+/** \brief  Create memory cache for a session
+ *
+ * \return  memory cache
+ */
+memcache_ctx_t *memcache_ctx_new(void)
+{
+    memcache_ctx_t *cache = g_malloc0(sizeof *cache);
+
+    cache->mirrors = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+    return cache;
+}
+
+
+/** \brief  Free memory cache of a session
+ *
+ * \param[in]   cache   memory cache
+ */
+void memcache_ctx_free(memcache_ctx_t *cache)
+{
+    g_hash_table_destroy(cache->mirrors);
+    g_free(cache);
+}
+
+
+/** \brief  Get mirror
+ *
+ * \param[in]   memspace    memspace
+ * \param[in]   bank        bank
+ * \param[in]   create      create the mirror if it doesn't exist
+ *
+ * \return  mirror or `NULL`
+ */
+static mirror_t *get_mirror(uint8_t memspace, uint16_t bank, bool create)
+{
+    GHashTable *mirrors = ctx()->mirrors;
+    guint key = ((guint)memspace << 16) | bank;
+    mirror_t *mirror;
+
+    mirror = g_hash_table_lookup(mirrors, GUINT_TO_POINTER(key));
+    if (mirror == NULL && create) {
+        mirror = g_malloc0(sizeof *mirror);
+        mirror->memspace = memspace;
+        mirror->bank = bank;
+        g_hash_table_insert(mirrors, GUINT_TO_POINTER(key), mirror);
+    }
+    return mirror;
+}
+
+
+/** \brief  Test page bit
+ *
+ * \param[in]   bitmap  page bitmap
+ * \param[in]   page    page number
+ *
+ * \return  bit is set
+ */
+static inline bool page_bit(const uint64_t *bitmap, int page)
+{
+    return (bitmap[page >> 6] >> (page & 63)) & 1;
+}
+
+
+/** \brief  Notify listeners of changed pages of a mirror
+ *
+ * \param[in]   mirror  mirror
+ * \param[in]   first   first page
+ * \param[in]   last    last page (inclusive)
+ */
+static void notify_listeners(mirror_t *mirror, int first, int last)
+{
+    GSList *node;
+
+    node = listeners;
+    while (node != NULL) {
+        listener_t *listener = node->data;
+
+        /* listener might remove itself */
+        node = node->next;
+        listener->callback(mirror->memspace, mirror->bank, first, last,
+                           listener->data);
+    }
+}
+
+
+/** \brief  Invalidate pages of a mirror
+ *
+ * \param[in]   mirror  mirror
+ * \param[in]   first   first page
+ * \param[in]   last    last page (inclusive)
+ */
+static void invalidate_pages(mirror_t *mirror, int first, int last)
+{
+    memcache_ctx_t *cache = ctx();
+
+    cache->epoch++;
+    for (int page = first; page <= last; page++) {
+        mirror->valid[page >> 6] &= ~((uint64_t)1 << (page & 63));
+        mirror->generation[page] = cache->epoch;
+    }
+    notify_listeners(mirror, first, last);
+}
+
+
+/** \brief  Handler for MON_RESPONSE_RESUMED events
+ *
+ * \param[in]   response    response
+ * \param[in]   data        extra data (unused)
+ */
+static void on_resumed_event(const mon_response_t *response, void *data)
+{
+    memcache_invalidate_all();
+}
+
+
+/** \brief  Initialize memory cache
+ */
+void memcache_init(void)
+{
+    connection_add_event_handler(MON_RESPONSE_RESUMED, on_resumed_event, NULL);
+}
+
+
+/** \brief  Free resources used by the memory cache
+ */
+void memcache_exit(void)
+{
+    connection_remove_event_handler(MON_RESPONSE_RESUMED,
+                                    on_resumed_event,
+                                    NULL);
+    g_slist_free_full(listeners, g_free);
+    listeners = NULL;
+}
+
+
+/** \brief  Invalidate memory range
+ *
+ * To be called after writing to memory.
+ *
+ * \param[in]   memspace    memspace
+ * \param[in]   bank        bank
+ * \param[in]   start       start address
+ * \param[in]   end         end address (inclusive)
+ */
+void memcache_invalidate(uint8_t memspace,
+                         uint16_t bank,
+                         uint16_t start,
+                         uint16_t end)
+{
+    mirror_t *mirror = get_mirror(memspace, bank, false);
+
+    if (mirror != NULL) {
+        invalidate_pages(mirror,
+                         start / MEMCACHE_PAGE_SIZE,
+                         end / MEMCACHE_PAGE_SIZE);
+    }
+}
+
+
+/** \brief  Invalidate all mirrors
+ */
+void memcache_invalidate_all(void)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, ctx()->mirrors);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        invalidate_pages(value, 0, MEMCACHE_PAGE_COUNT - 1);
+    }
+}
+
+
+/** \brief  Invalidate all mirrors and fetch the pages that were valid
+ *
+ * Used after a reconnect: VICE may have been restarted, so nothing cached
+ * can be trusted, but the pages in use are fetched again in a single write.
+ */
+void memcache_revalidate(void)
+{
+    GHashTableIter iter;
+    gpointer value;
+    GPtrArray *list;
+
+    list = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, ctx()->mirrors);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_ptr_array_add(list, value);
+    }
+
+    connection_cork();
+    for (guint i = 0; i < list->len; i++) {
+        mirror_t *mirror = g_ptr_array_index(list, i);
+        uint64_t pages[MEMCACHE_BITMAP_WORDS];
+
+        memcpy(pages, mirror->valid, sizeof(pages));
+        invalidate_pages(mirror, 0, MEMCACHE_PAGE_COUNT - 1);
+        memcache_fetch_pages(mirror->memspace, mirror->bank, pages, NULL, NULL);
+    }
+    connection_uncork();
+    g_ptr_array_free(list, TRUE);
+}
+
+
+/** \brief  Finish run, call the fetch callback when it was the last one
+ *
+ * \param[in]   run     run
+ */
+static void run_finish(run_t *run)
+{
+    fetch_t *fetch = run->fetch;
+
+    g_free(run);
+    if (--fetch->remaining == 0) {
+        if (fetch->callback != NULL) {
+            fetch->callback(!fetch->failed, fetch->data);
+        }
+        g_free(fetch);
+    }
+}
+
+
+/** \brief  Handler for MON_CMD_MEM_GET responses
+ *
+ * Pages invalidated after the command was sent are stored, but not marked
+ * valid.
+ *
+ * \param[in]   response    response
+ * \param[in]   data        run
+ */
+static void on_mem_get_response(const mon_response_t *response, void *data)
+{
+    run_t *run = data;
+    mirror_t *mirror;
+    size_t size = (size_t)run->page_count * MEMCACHE_PAGE_SIZE;
+
+    mirror = get_mirror(run->memspace, run->bank, false);
+    if (response->error_code != MON_ERR_OK
+            || response_get_body_len(response) < 2 + size
+            || MON_GET_U16(response->body) != size) {
+        log_msg(LOG_ERR, "Memory fetch of $%04x-$%04x failed: error $%02x.\n",
+                run->first_page * MEMCACHE_PAGE_SIZE,
+                (unsigned int)(run->first_page * MEMCACHE_PAGE_SIZE + size - 1),
+                response->error_code);
+        run->fetch->failed = true;
+    } else if (mirror != NULL) {
+        memcpy(mirror->mem + run->first_page * MEMCACHE_PAGE_SIZE,
+               response->body + 2,
+               size);
+        for (int page = run->first_page;
+                page < run->first_page + run->page_count;
+                page++) {
+            if (mirror->generation[page] <= run->epoch) {
+                mirror->valid[page >> 6] |= (uint64_t)1 << (page & 63);
+            }
+        }
+    }
+    run_finish(run);
+}
+
+
+/** \brief  Send MON_CMD_MEM_GET for a run of pages
+ *
+ * \param[in]   fetch       fetch
+ * \param[in]   mirror      mirror
+ * \param[in]   first       first page
+ * \param[in]   count       number of pages
+ *
+ * \return  false if sending failed
+ */
+static bool send_run(fetch_t *fetch, mirror_t *mirror, int first, int count)
+{
+    uint8_t body[8];
+    run_t *run;
+    uint16_t start = (uint16_t)(first * MEMCACHE_PAGE_SIZE);
+
+    run = g_malloc(sizeof *run);
+    run->fetch = fetch;
+    run->memspace = mirror->memspace;
+    run->bank = mirror->bank;
+    run->first_page = first;
+    run->page_count = count;
+    run->epoch = ctx()->epoch;
+
+    body[0] = 0;    /* no side effects */
+    MON_SET_U16(body + 1, start);
+    MON_SET_U16(body + 3, start + count * MEMCACHE_PAGE_SIZE - 1);
+    body[5] = mirror->memspace;
+    MON_SET_U16(body + 6, mirror->bank);
+    if (connection_send_request(MON_CMD_MEM_GET, body, sizeof(body),
+                                on_mem_get_response, run) == 0) {
+        g_free(run);
+        return false;
+    }
+    fetch->remaining++;
+    return true;
+}
+
+
+/** \brief  Fetch stale pages
+ *
+ * Requests the pages set in \a pages that aren't valid. If all pages are
+ * valid \a callback is called before this function returns.
+ *
+ * \param[in]   memspace    memspace
+ * \param[in]   bank        bank
+ * \param[in]   pages       bitmap of MEMCACHE_BITMAP_WORDS words
+ * \param[in]   callback    function to call when done (optional)
+ * \param[in]   data        data for \a callback
+ *
+ * \return  false if nothing could be sent, \a callback isn't called then
+ */
+bool memcache_fetch_pages(uint8_t memspace,
+                          uint16_t bank,
+                          const uint64_t *pages,
+                          memcache_ready_cb callback,
+                          void *data)
+{
+    mirror_t *mirror;
+    fetch_t *fetch;
+    bool running;
+    int max_pages;
+    int page = 0;
+
+    mirror = get_mirror(memspace, bank, true);
+    if (mirror == NULL) {
+        return false;
+    }
+    max_pages = (int)(connection_get_vice_info()->mem_get_max
+                      / MEMCACHE_PAGE_SIZE);
+
+    fetch = g_malloc0(sizeof *fetch);
+    fetch->callback = callback;
+    fetch->data = data;
+    /* hold a reference so responses can't finish the fetch while sending */
+    fetch->remaining = 1;
+
+    running = connection_vice_running();
+    connection_cork();
+    while (page < MEMCACHE_PAGE_COUNT) {
+        int first;
+
+        if (!page_bit(pages, page) || page_bit(mirror->valid, page)) {
+            page++;
+            continue;
+        }
+        first = page;
+        while (page < MEMCACHE_PAGE_COUNT
+                && page - first < max_pages
+                && page_bit(pages, page)
+                && !page_bit(mirror->valid, page)) {
+            page++;
+        }
+        if (!send_run(fetch, mirror, first, page - first)) {
+            fetch->failed = true;
+            break;
+        }
+    }
+    if (running && fetch->remaining > 1) {
+        connection_send_request(MON_CMD_EXIT, NULL, 0, NULL, NULL);
+    }
+    connection_uncork();
+
+    if (fetch->failed && fetch->remaining == 1) {
+        g_free(fetch);
+        return false;
+    }
+    /* drop our reference */
+    if (--fetch->remaining == 0) {
+        if (callback != NULL) {
+            callback(!fetch->failed, data);
+        }
+        g_free(fetch);
+    }
+    return true;
+}
+
+
+/** \brief  Fetch stale pages of a memory range
+ *
+ * \param[in]   memspace    memspace
+ * \param[in]   bank        bank
+ * \param[in]   start       start address
+ * \param[in]   end         end address (inclusive)
+ * \param[in]   callback    function to call when done (optional)
+ * \param[in]   data        data for \a callback
+ *
+ * \return  false if nothing could be sent, \a callback isn't called then
+ *
+ * \see memcache_fetch_pages()
+ */
+bool memcache_fetch(uint8_t memspace,
+                    uint16_t bank,
+                    uint16_t start,
+                    uint16_t end,
+                    memcache_ready_cb callback,
+                    void *data)
+{
+    uint64_t pages[MEMCACHE_BITMAP_WORDS] = { 0 };
+
+    for (int page = start / MEMCACHE_PAGE_SIZE;
+            page <= end / MEMCACHE_PAGE_SIZE;
+            page++) {
+        pages[page >> 6] |= (uint64_t)1 << (page & 63);
+    }
+    return memcache_fetch_pages(memspace, bank, pages, callback, data);
+}
+
+
+/** \brief  Get mirror memory
+ *
+ * Only the pages for which memcache_is_valid() returns true are current.
+ *
+ * \param[in]   memspace    memspace
+ * \param[in]   bank        bank
+ *
+ * \return  64KiB of memory, or `NULL` if nothing was fetched for
+ *          \a memspace and \a bank
+ */
+const uint8_t *memcache_get(uint8_t memspace, uint16_t bank)
+{
+    mirror_t *mirror = get_mirror(memspace, bank, false);
+
+    return mirror != NULL ? mirror->mem : NULL;
+}
+
+
+/** \brief  Check if a memory range is valid
+ *
+ * \param[in]   memspace    memspace
+ * \param[in]   bank        bank
+ * \param[in]   start       start address
+ * \param[in]   end         end address (inclusive)
+ *
+ * \return  true if all pages of the range are valid
+ */
+bool memcache_is_valid(uint8_t memspace,
+                       uint16_t bank,
+                       uint16_t start,
+                       uint16_t end)
+{
+    mirror_t *mirror = get_mirror(memspace, bank, false);
+
+    if (mirror == NULL) {
+        return false;
+    }
+    for (int page = start / MEMCACHE_PAGE_SIZE;
+            page <= end / MEMCACHE_PAGE_SIZE;
+            page++) {
+        if (!page_bit(mirror->valid, page)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Get generation of a page
+ *
+ * \param[in]   memspace    memspace
+ * \param[in]   bank        bank
+ * \param[in]   page        page number
+ *
+ * \return  generation, changes each time the page is invalidated
+ */
+uint32_t memcache_page_generation(uint8_t memspace, uint16_t bank, int page)
+{
+    mirror_t *mirror = get_mirror(memspace, bank, false);
+
+    return mirror != NULL ? mirror->generation[page] : 0;
+}
+
+
+/** \brief  Call \a callback for each mirror of the current session
+ *
+ * \param[in]   callback    function to call
+ * \param[in]   data        data for \a callback
+ */
+void memcache_foreach_mirror(memcache_mirror_cb callback, void *data)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, ctx()->mirrors);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        mirror_t *mirror = value;
+
+        callback(mirror->memspace, mirror->bank, mirror->valid, mirror->mem,
+                 data);
+    }
+}
+
+
+/** \brief  Get the invalidation epoch of the current session
+ *
+ * Record this before checking memory outside the cache and pass it to
+ * memcache_import(), so pages invalidated meanwhile aren't imported.
+ *
+ * \return  epoch
+ */
+uint32_t memcache_get_epoch(void)
+{
+    return ctx()->epoch;
+}
+
+
+/** \brief  Import pages from outside the binary monitor
+ *
+ * Copies the pages set in \a pages from \a mem and marks them valid. Pages
+ * that are already valid are left alone, those are more recent, and so are
+ * pages invalidated after \a epoch. The caller is responsible for making
+ * sure the pages matched the memory of VICE at \a epoch.
+ *
+ * Imported pages get a new generation and the listeners are notified, so
+ * data derived from the old contents is refreshed.
+ *
+ * \param[in]   memspace    memspace
+ * \param[in]   bank        bank
+ * \param[in]   pages       bitmap of MEMCACHE_BITMAP_WORDS words
+ * \param[in]   mem         64KiB of memory
+ * \param[in]   epoch       epoch from memcache_get_epoch()
+ */
+void memcache_import(uint8_t memspace,
+                     uint16_t bank,
+                     const uint64_t *pages,
+                     const uint8_t *mem,
+                     uint32_t epoch)
+{
+    memcache_ctx_t *cache = ctx();
+    mirror_t *mirror = get_mirror(memspace, bank, true);
+    int first = -1;
+
+    cache->epoch++;
+    for (int page = 0; page <= MEMCACHE_PAGE_COUNT; page++) {
+        if (page < MEMCACHE_PAGE_COUNT
+                && page_bit(pages, page)
+                && !page_bit(mirror->valid, page)
+                && mirror->generation[page] <= epoch) {
+            memcpy(mirror->mem + page * MEMCACHE_PAGE_SIZE,
+                   mem + page * MEMCACHE_PAGE_SIZE,
+                   MEMCACHE_PAGE_SIZE);
+            mirror->valid[page >> 6] |= (uint64_t)1 << (page & 63);
+            mirror->generation[page] = cache->epoch;
+            if (first < 0) {
+                first = page;
+            }
+        } else if (first >= 0) {
+            notify_listeners(mirror, first, page - 1);
+            first = -1;
+        }
+    }
+}
+
+
+/** \brief  Register \a callback to be called for invalidated pages
+ *
+ * The callback is called for all sessions, with the session owning the
+ * pages as the current session.
+ *
+ * \param[in]   callback    function to call
+ * \param[in]   data        data for \a callback
+ */
+void memcache_add_listener(memcache_listener_cb callback, void *data)
+{
+    listener_t *listener = g_malloc(sizeof *listener);
+
+    listener->callback = callback;
+    listener->data = data;
+    listeners = g_slist_append(listeners, listener);
+}
+
+
+/** \brief  Unregister listener
+ *
+ * \param[in]   callback    function registered
+ * \param[in]   data        data registered
+ */
+void memcache_remove_listener(memcache_listener_cb callback, void *data)
+{
+    GSList *node;
+
+    for (node = listeners; node != NULL; node = node->next) {
+        listener_t *listener = node->data;
+
+        if (listener->callback == callback && listener->data == data) {
+            listeners = g_slist_delete_link(listeners, node);
+            g_free(listener);
+            return;
+        }
+    }
+}
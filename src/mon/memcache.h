@@ -0,0 +1,138 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   memcache.h
+ * \brief   Local mirror of VICE memory - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#ifndef MON_MEMCACHE_H_
+#define MON_MEMCACHE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/** \brief  Size of a cache page
+ */
+#define MEMCACHE_PAGE_SIZE  256
+
+/** \brief  Number of pages in a mirror
+ */
+#define MEMCACHE_PAGE_COUNT 256
+
+/** \brief  Number of 64-bit words in a page bitmap
+ */
+#define MEMCACHE_BITMAP_WORDS   (MEMCACHE_PAGE_COUNT / 64)
+
+
+/** \brief  Memory cache of a session (opaque)
+ */
+typedef struct memcache_ctx_s memcache_ctx_t;
+
+
+/** \brief  Callback for memcache_fetch()
+ *
+ * \param[in]   success all requested pages were fetched
+ * \param[in]   data    data passed to memcache_fetch()
+ */
+typedef void (*memcache_ready_cb)(bool success, void *data);
+
+/** \brief  Callback for invalidated or imported pages
+ *
+ * \param[in]   memspace    memspace
+ * \param[in]   bank        bank
+ * \param[in]   first_page  first changed page
+ * \param[in]   last_page   last changed page (inclusive)
+ * \param[in]   data        data passed to memcache_add_listener()
+ */
+typedef void (*memcache_listener_cb)(uint8_t memspace,
+                                     uint16_t bank,
+                                     int first_page,
+                                     int last_page,
+                                     void *data);
+
+
+/** \brief  Callback for memcache_foreach_mirror()
+ *
+ * \param[in]   memspace    memspace
+ * \param[in]   bank        bank
+ * \param[in]   valid       bitmap of valid pages
+ * \param[in]   mem         64KiB of memory
+ * \param[in]   data        data passed to memcache_foreach_mirror()
+ */
+typedef void (*memcache_mirror_cb)(uint8_t memspace,
+                                   uint16_t bank,
+                                   const uint64_t *valid,
+                                   const uint8_t *mem,
+                                   void *data);
+
+
+void memcache_init(void);
+void memcache_exit(void);
+
+memcache_ctx_t *memcache_ctx_new(void);
+void memcache_ctx_free(memcache_ctx_t *cache);
+
+void memcache_invalidate(uint8_t memspace,
+                         uint16_t bank,
+                         uint16_t start,
+                         uint16_t end);
+void memcache_invalidate_all(void);
+void memcache_revalidate(void);
+
+bool memcache_fetch(uint8_t memspace,
+                    uint16_t bank,
+                    uint16_t start,
+                    uint16_t end,
+                    memcache_ready_cb callback,
+                    void *data);
+bool memcache_fetch_pages(uint8_t memspace,
+                          uint16_t bank,
+                          const uint64_t *pages,
+                          memcache_ready_cb callback,
+                          void *data);
+
+const uint8_t *memcache_get(uint8_t memspace, uint16_t bank);
+bool memcache_is_valid(uint8_t memspace,
+                       uint16_t bank,
+                       uint16_t start,
+                       uint16_t end);
+uint32_t memcache_page_generation(uint8_t memspace, uint16_t bank, int page);
+void memcache_foreach_mirror(memcache_mirror_cb callback, void *data);
+uint32_t memcache_get_epoch(void);
+void memcache_import(uint8_t memspace,
+                     uint16_t bank,
+                     const uint64_t *pages,
+                     const uint8_t *mem,
+                     uint32_t epoch);
+
+void memcache_add_listener(memcache_listener_cb callback, void *data);
+void memcache_remove_listener(memcache_listener_cb callback, void *data);
+
+#endif
@@ -0,0 +1,495 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   memsearch.c
+ * \brief   Memory search
+ *
+ * Searches run on the memory cache, only stale pages are fetched before
+ * scanning.
+ *
+ * The scan looks for the first byte of the pattern without wildcards with
+ * memchr(), which the C library implements with vector instructions, and
+ * only compares the full pattern at those positions.
+ *
+ * memsearch_refine() only fetches the pages holding the previous results and
+ * keeps the results that still match, so a search can be repeated cheaply
+ * after stepping the emulation.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "log.h"
+#include "memcache.h"
+#include "petscii.h"
+
+#include "memsearch.h"
+
+
+/** \brief  Create search
+ *
+ * \param[in]   memspace    memspace
+ * \param[in]   bank        bank
+ * \param[in]   start       start address
+ * \param[in]   end         end address (inclusive)
+ *
+ * \return  search, free with memsearch_free()
+ */
+memsearch_t *memsearch_new(uint8_t memspace,
+                           uint16_t bank,
+                           uint16_t start,
+                           uint16_t end)
+{
+    memsearch_t *search = g_malloc0(sizeof *search);
+
+    search->memspace = memspace;
+    search->bank = bank;
+    search->start = start;
+    search->end = end;
+    search->anchor = -1;
+    search->results = g_array_new(FALSE, FALSE, sizeof(uint16_t));
+    return search;
+}
+
+
+/** \brief  Free search
+ *
+ * When the search is waiting for memory, it is freed when the memory
+ * arrives and the callback won't be called.
+ *
+ * \param[in]   search  search
+ */
+void memsearch_free(memsearch_t *search)
+{
+    if (search == NULL) {
+        return;
+    }
+    if (search->busy) {
+        search->destroyed = true;
+        return;
+    }
+    g_array_free(search->results, TRUE);
+    g_free(search);
+}
+
+
+/** \brief  Parse hex nibble or wildcard
+ *
+ * \param[in]   ch      character
+ * \param[out]  value   nibble value
+ * \param[out]  mask    nibble mask
+ *
+ * \return  false if \a ch is invalid
+ */
+static bool parse_nibble(char ch, uint8_t *value, uint8_t *mask)
+{
+    if (ch == '?') {
+        *value = 0;
+        *mask = 0;
+        return true;
+    }
+    if (!g_ascii_isxdigit(ch)) {
+        return false;
+    }
+    *value = (uint8_t)g_ascii_xdigit_value(ch);
+    *mask = 0x0f;
+    return true;
+}
+
+
+/** \brief  Parse hex bytes with wildcards
+ *
+ * Bytes can be separated by whitespace, "a9 ?? 8d 2?" and "a9??8d2?" are
+ * the same pattern.
+ *
+ * \param[in,out]   search  search
+ * \param[in]       text    pattern text
+ *
+ * \return  false if \a text is invalid
+ */
+static bool parse_bytes(memsearch_t *search, const char *text)
+{
+    while (*text != '\0') {
+        uint8_t hi;
+        uint8_t lo;
+        uint8_t hi_mask;
+        uint8_t lo_mask;
+
+        if (g_ascii_isspace(*text)) {
+            text++;
+            continue;
+        }
+        if (search->length == MEMSEARCH_PATTERN_MAX
+                || !parse_nibble(text[0], &hi, &hi_mask)
+                || !parse_nibble(text[1], &lo, &lo_mask)) {
+            return false;
+        }
+        search->pattern[search->length] = (uint8_t)((hi << 4) | lo);
+        search->mask[search->length] = (uint8_t)((hi_mask << 4) | lo_mask);
+        search->length++;
+        text += 2;
+    }
+    return true;
+}
+
+
+/** \brief  Parse 16-bit value
+ *
+ * Accepts "$hex", "0xhex" and decimal.
+ *
+ * \param[in,out]   search  search
+ * \param[in]       text    value text
+ *
+ * \return  false if \a text is invalid
+ */
+static bool parse_word(memsearch_t *search, const char *text)
+{
+    char *endptr;
+    guint64 value;
+
+    if (*text == '$') {
+        value = g_ascii_strtoull(text + 1, &endptr, 16);
+    } else {
+        value = g_ascii_strtoull(text, &endptr, 0);
+    }
+    if (endptr == text || *endptr != '\0' || value > 0xffff) {
+        return false;
+    }
+    search->pattern[0] = (uint8_t)(value & 0xff);
+    search->pattern[1] = (uint8_t)(value >> 8);
+    search->mask[0] = 0xff;
+    search->mask[1] = 0xff;
+    search->length = 2;
+    return true;
+}
+
+
+/** \brief  Set search pattern
+ *
+ * Clears the results.
+ *
+ * \param[in,out]   search  search
+ * \param[in]       type    pattern type
+ * \param[in]       text    pattern text
+ * \param[out]      error   error (optional)
+ *
+ * \return  false if \a text is invalid for \a type
+ */
+bool memsearch_set_pattern(memsearch_t *search,
+                           memsearch_type_t type,
+                           const char *text,
+                           GError **error)
+{
+    const char *s = text;
+    bool ok = true;
+
+    search->length = 0;
+    switch (type) {
+        case MEMSEARCH_BYTES:
+            ok = parse_bytes(search, text);
+            break;
+        case MEMSEARCH_WORD:
+            ok = parse_word(search, text);
+            break;
+        case MEMSEARCH_PETSCII:
+        case MEMSEARCH_SCREEN:
+            for (; *s != '\0'; s++) {
+                uint8_t ch = petscii_from_ascii(*s);
+
+                if (search->length == MEMSEARCH_PATTERN_MAX) {
+                    ok = false;
+                    break;
+                }
+                if (type == MEMSEARCH_SCREEN) {
+                    ch = petscii_to_screencode(ch);
+                }
+                search->pattern[search->length] = ch;
+                search->mask[search->length] = 0xff;
+                search->length++;
+            }
+            break;
+        default:
+            ok = false;
+            break;
+    }
+    if (!ok || search->length == 0) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                    "invalid search pattern '%s'", text);
+        search->length = 0;
+        return false;
+    }
+
+    search->anchor = -1;
+    for (size_t i = 0; i < search->length; i++) {
+        search->pattern[i] &= search->mask[i];
+        if (search->anchor < 0 && search->mask[i] == 0xff) {
+            search->anchor = (int)i;
+        }
+    }
+    g_array_set_size(search->results, 0);
+    return true;
+}
+
+
+/** \brief  Check if the pattern matches at \a mem
+ *
+ * \param[in]   search  search
+ * \param[in]   mem     memory
+ *
+ * \return  true on match
+ */
+static inline bool matches(const memsearch_t *search, const uint8_t *mem)
+{
+    for (size_t i = 0; i < search->length; i++) {
+        if ((mem[i] & search->mask[i]) != search->pattern[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/** \brief  Scan memory range for the pattern
+ *
+ * \param[in,out]   search  search
+ * \param[in]       mem     mirror memory
+ */
+static void scan(memsearch_t *search, const uint8_t *mem)
+{
+    size_t pos = search->start;
+    size_t last;
+
+    g_array_set_size(search->results, 0);
+    if ((size_t)search->end + 1 - search->start < search->length) {
+        return;
+    }
+    last = (size_t)search->end + 1 - search->length;
+
+    if (search->anchor < 0) {
+        /* only wildcard nibbles: check every position */
+        for (; pos <= last; pos++) {
+            if (matches(search, mem + pos)) {
+                uint16_t addr = (uint16_t)pos;
+
+                g_array_append_val(search->results, addr);
+            }
+        }
+        return;
+    }
+
+    while (pos <= last) {
+        const uint8_t *hit;
+        uint16_t addr;
+
+        hit = memchr(mem + pos + search->anchor,
+                     search->pattern[search->anchor],
+                     last - pos + 1);
+        if (hit == NULL) {
+            break;
+        }
+        pos = (size_t)(hit - mem) - (size_t)search->anchor;
+        if (matches(search, mem + pos)) {
+            addr = (uint16_t)pos;
+            g_array_append_val(search->results, addr);
+        }
+        pos++;
+    }
+}
+
+
+/** \brief  Keep the results that still match
+ *
+ * \param[in,out]   search  search
+ * \param[in]       mem     mirror memory
+ */
+static void filter(memsearch_t *search, const uint8_t *mem)
+{
+    guint kept = 0;
+
+    for (guint i = 0; i < search->results->len; i++) {
+        uint16_t addr = g_array_index(search->results, uint16_t, i);
+
+        if (matches(search, mem + addr)) {
+            g_array_index(search->results, uint16_t, kept++) = addr;
+        }
+    }
+    g_array_set_size(search->results, kept);
+}
+
+
+/** \brief  Finish search
+ *
+ * \param[in]   search  search
+ * \param[in]   success memory was fetched
+ */
+static void finish(memsearch_t *search, bool success)
+{
+    search->busy = false;
+    if (search->destroyed) {
+        memsearch_free(search);
+        return;
+    }
+    if (search->callback != NULL) {
+        search->callback(search, success, search->data);
+    }
+}
+
+
+/** \brief  Handler for memory fetched by memsearch_run()
+ *
+ * \param[in]   success memory was fetched
+ * \param[in]   data    search
+ */
+static void on_run_ready(bool success, void *data)
+{
+    memsearch_t *search = data;
+
+    if (success && !search->destroyed) {
+        gint64 t = g_get_monotonic_time();
+
+        scan(search, memcache_get(search->memspace, search->bank));
+        debug_msg("Scanned $%04x-$%04x in %" G_GINT64_FORMAT " usec.",
+                  search->start, search->end, g_get_monotonic_time() - t);
+    }
+    finish(search, success);
+}
+
+
+/** \brief  Handler for memory fetched by memsearch_refine()
+ *
+ * \param[in]   success memory was fetched
+ * \param[in]   data    search
+ */
+static void on_refine_ready(bool success, void *data)
+{
+    memsearch_t *search = data;
+
+    if (success && !search->destroyed) {
+        filter(search, memcache_get(search->memspace, search->bank));
+    }
+    finish(search, success);
+}
+
+
+/** \brief  Start search
+ *
+ * \param[in]   search      search with pattern set
+ * \param[in]   callback    function to call when done (optional)
+ * \param[in]   data        data for \a callback
+ *
+ * \return  false if the search couldn't be started
+ */
+bool memsearch_run(memsearch_t *search, memsearch_done_cb callback, void *data)
+{
+    if (search->busy || search->length == 0) {
+        return false;
+    }
+    search->callback = callback;
+    search->data = data;
+    search->busy = true;
+    if (!memcache_fetch(search->memspace, search->bank,
+                        search->start, search->end,
+                        on_run_ready, search)) {
+        search->busy = false;
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Repeat search on the previous results
+ *
+ * Only the pages containing previous results are fetched.
+ *
+ * \param[in]   search      search
+ * \param[in]   callback    function to call when done (optional)
+ * \param[in]   data        data for \a callback
+ *
+ * \return  false if the search couldn't be started
+ */
+bool memsearch_refine(memsearch_t *search,
+                      memsearch_done_cb callback,
+                      void *data)
+{
+    uint64_t pages[MEMCACHE_BITMAP_WORDS] = { 0 };
+
+    if (search->busy || search->length == 0) {
+        return false;
+    }
+    for (guint i = 0; i < search->results->len; i++) {
+        unsigned int addr = g_array_index(search->results, uint16_t, i);
+        int first = (int)(addr / MEMCACHE_PAGE_SIZE);
+        int last = (int)((addr + search->length - 1) / MEMCACHE_PAGE_SIZE);
+
+        for (int page = first; page <= last; page++) {
+            pages[page >> 6] |= (uint64_t)1 << (page & 63);
+        }
+    }
+    search->callback = callback;
+    search->data = data;
+    search->busy = true;
+    if (!memcache_fetch_pages(search->memspace, search->bank, pages,
+                              on_refine_ready, search)) {
+        search->busy = false;
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Get number of results
+ *
+ * \param[in]   search  search
+ *
+ * \return  number of results
+ */
+size_t memsearch_count(const memsearch_t *search)
+{
+    return search->results->len;
+}
+
+
+/** \brief  Get result
+ *
+ * \param[in]   search  search
+ * \param[in]   index   index of the result
+ *
+ * \return  address
+ */
+uint16_t memsearch_result(const memsearch_t *search, size_t index)
+{
+    return g_array_index(search->results, uint16_t, index);
+}
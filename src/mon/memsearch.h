@@ -0,0 +1,104 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   memsearch.h
+ * \brief   Memory search - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#ifndef MON_MEMSEARCH_H_
+#define MON_MEMSEARCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <glib.h>
+
+/** \brief  Maximum length of a search pattern
+ */
+#define MEMSEARCH_PATTERN_MAX   64
+
+
+/** \brief  Pattern types
+ */
+typedef enum memsearch_type_e {
+    MEMSEARCH_BYTES,    /**< hex bytes, '?' is a wildcard nibble */
+    MEMSEARCH_PETSCII,  /**< text as PETSCII */
+    MEMSEARCH_SCREEN,   /**< text as screen codes */
+    MEMSEARCH_WORD      /**< 16-bit little endian value */
+} memsearch_type_t;
+
+
+typedef struct memsearch_s memsearch_t;
+
+/** \brief  Callback for finished searches
+ *
+ * \param[in]   search  search
+ * \param[in]   success memory could be fetched
+ * \param[in]   data    data passed when starting the search
+ */
+typedef void (*memsearch_done_cb)(memsearch_t *search, bool success, void *data);
+
+
+/** \brief  Memory search
+ */
+struct memsearch_s {
+    uint8_t pattern[MEMSEARCH_PATTERN_MAX]; /**< pattern, masked */
+    uint8_t mask[MEMSEARCH_PATTERN_MAX];    /**< mask per byte */
+    size_t length;                          /**< pattern length */
+    int anchor;                             /**< index of first full byte */
+    uint8_t memspace;                       /**< memspace */
+    uint16_t bank;                          /**< bank */
+    uint16_t start;                         /**< start address */
+    uint16_t end;                           /**< end address (inclusive) */
+    GArray *results;                        /**< matching addresses */
+    bool busy;                              /**< waiting for memory */
+    bool destroyed;                         /**< freed while busy */
+    memsearch_done_cb callback;             /**< function to call when done */
+    void *data;                             /**< data for \a callback */
+};
+
+
+memsearch_t *memsearch_new(uint8_t memspace,
+                           uint16_t bank,
+                           uint16_t start,
+                           uint16_t end);
+void memsearch_free(memsearch_t *search);
+
+bool memsearch_set_pattern(memsearch_t *search,
+                           memsearch_type_t type,
+                           const char *text,
+                           GError **error);
+bool memsearch_run(memsearch_t *search, memsearch_done_cb callback, void *data);
+bool memsearch_refine(memsearch_t *search,
+                      memsearch_done_cb callback,
+                      void *data);
+size_t memsearch_count(const memsearch_t *search);
+uint16_t memsearch_result(const memsearch_t *search, size_t index);
+
+#endif
@@ -0,0 +1,322 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   memupload.c
+ * \brief   Upload files to memory via MON_CMD_MEM_SET
+ *
+ * The file is mapped into memory and sent in chunks of the size VICE
+ * negotiated for MON_CMD_MEM_GET (see viceinfo.h), with up to
+ * MEMUPLOAD_WINDOW commands in flight, so the transfer
+ * isn't limited by the round trip time per chunk. An optional verify pass
+ * reads the memory back the same way and compares it with the file.
+ *
+ * The emulation is stopped during the upload and resumed afterwards if it
+ * was running.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "log.h"
+#include "monitor.h"
+#include "vicemonapi.h"
+#include "connection.h"
+#include "memcache.h"
+
+#include "memupload.h"
+
+
+/** \brief  Size of the MEM_GET/MEM_SET header
+ */
+#define MEM_HEADER_SIZE 8
+
+
+/** \brief  Upload state
+ */
+typedef struct memupload_s {
+    GMappedFile *mapped;        /**< mapped file */
+    const uint8_t *bytes;       /**< bytes to upload */
+    size_t length;              /**< number of bytes to upload */
+    uint16_t start;             /**< start address */
+    uint8_t memspace;           /**< memspace */
+    bool verify;                /**< verify after uploading */
+    bool verifying;             /**< in the verify pass */
+    bool failed;                /**< a command failed */
+    bool resume;                /**< resume emulation when done */
+    size_t chunk_size;          /**< bytes per command */
+    uint8_t *body;              /**< command body buffer */
+    size_t next;                /**< offset of next chunk to send */
+    guint in_flight;            /**< number of commands in flight */
+    gint64 started;             /**< start time (monotonic, usec) */
+    memupload_done_cb callback; /**< function to call when done */
+    void *data;                 /**< data for \a callback */
+} memupload_t;
+
+
+/** \brief  Chunk request data
+ */
+typedef struct chunk_s {
+    memupload_t *upload;    /**< upload */
+    size_t offset;          /**< offset of the chunk */
+    size_t size;            /**< size of the chunk */
+} chunk_t;
+
+
+static void pump(memupload_t *upload);
+
+
+/** \brief  Finish upload and free upload state
+ *
+ * \param[in]   upload  upload
+ */
+static void finish(memupload_t *upload)
+{
+    gint64 elapsed = g_get_monotonic_time() - upload->started;
+
+    if (!upload->failed) {
+        log_msg(LOG_INFO,
+                "Uploaded %zu bytes to $%04x in %" G_GINT64_FORMAT " ms.\n",
+                upload->length, upload->start, elapsed / 1000);
+    }
+    if (upload->resume) {
+        connection_send_request(MON_CMD_EXIT, NULL, 0, NULL, NULL);
+    }
+    if (upload->callback != NULL) {
+        upload->callback(!upload->failed,
+                         upload->start,
+                         upload->length,
+                         upload->data);
+    }
+    g_mapped_file_unref(upload->mapped);
+    g_free(upload->body);
+    g_free(upload);
+}
+
+
+/** \brief  Handle response to a chunk
+ *
+ * \param[in]   response    response
+ * \param[in]   data        chunk
+ */
+static void on_chunk_response(const mon_response_t *response, void *data)
+{
+    chunk_t *chunk = data;
+    memupload_t *upload = chunk->upload;
+    uint16_t addr = (uint16_t)(upload->start + chunk->offset);
+
+    upload->in_flight--;
+    if (!upload->verifying) {
+        memcache_invalidate(upload->memspace,
+                            0,
+                            addr,
+                            (uint16_t)(addr + chunk->size - 1));
+    }
+    if (response->error_code != MON_ERR_OK) {
+        log_msg(LOG_ERR, "Memory %s at $%04x failed: error $%02x.\n",
+                upload->verifying ? "read" : "write",
+                addr, response->error_code);
+        upload->failed = true;
+    } else if (upload->verifying && !upload->failed) {
+        uint32_t len = response_get_body_len(response);
+
+        if (len < 2 + chunk->size
+                || MON_GET_U16(response->body) != chunk->size
+                || memcmp(response->body + 2,
+                          upload->bytes + chunk->offset,
+                          chunk->size) != 0) {
+            log_msg(LOG_ERR, "Verify failed in chunk at $%04x.\n", addr);
+            upload->failed = true;
+        }
+    }
+    g_free(chunk);
+    pump(upload);
+}
+
+
+/** \brief  Send command for the next chunk
+ *
+ * \param[in]   upload  upload
+ *
+ * \return  false if sending failed
+ */
+static bool send_chunk(memupload_t *upload)
+{
+    uint8_t *body = upload->body;
+    chunk_t *chunk;
+    uint16_t start;
+    size_t len;
+
+    chunk = g_malloc(sizeof *chunk);
+    chunk->upload = upload;
+    chunk->offset = upload->next;
+    chunk->size = MIN(upload->length - upload->next, upload->chunk_size);
+
+    start = (uint16_t)(upload->start + chunk->offset);
+    body[0] = 0;    /* no side effects */
+    MON_SET_U16(body + 1, start);
+    MON_SET_U16(body + 3, start + chunk->size - 1);
+    body[5] = upload->memspace;
+    MON_SET_U16(body + 6, 0);    /* bank: default */
+    len = MEM_HEADER_SIZE;
+    if (!upload->verifying) {
+        memcpy(body + MEM_HEADER_SIZE,
+               upload->bytes + chunk->offset,
+               chunk->size);
+        len += chunk->size;
+    }
+
+    if (connection_send_request(upload->verifying ? MON_CMD_MEM_GET
+                                                  : MON_CMD_MEM_SET,
+                                body,
+                                len,
+                                on_chunk_response,
+                                chunk) == 0) {
+        g_free(chunk);
+        return false;
+    }
+    upload->next += chunk->size;
+    upload->in_flight++;
+    return true;
+}
+
+
+/** \brief  Keep the window of commands filled, move to the next pass
+ *
+ * \param[in]   upload  upload
+ */
+static void pump(memupload_t *upload)
+{
+    connection_cork();
+    while (!upload->failed
+            && upload->in_flight < MEMUPLOAD_WINDOW
+            && upload->next < upload->length) {
+        if (!send_chunk(upload)) {
+            upload->failed = true;
+        }
+    }
+    connection_uncork();
+
+    if (upload->in_flight > 0) {
+        return;
+    }
+    if (!upload->failed && upload->verify && !upload->verifying) {
+        upload->verifying = true;
+        upload->next = 0;
+        pump(upload);
+        return;
+    }
+    finish(upload);
+}
+
+
+/** \brief  Upload file to memory
+ *
+ * \param[in]   path        file to upload
+ * \param[in]   address     load address, or MEMUPLOAD_PRG to use the first
+ *                          two bytes of the file as load address
+ * \param[in]   memspace    memspace
+ * \param[in]   verify      read back and compare after uploading
+ * \param[in]   callback    function to call when done (optional)
+ * \param[in]   data        data for \a callback
+ * \param[out]  error       error (optional)
+ *
+ * \return  false if the upload couldn't be started, \a callback isn't called
+ *          in that case
+ */
+bool memupload_file(const char *path,
+                    int address,
+                    uint8_t memspace,
+                    bool verify,
+                    memupload_done_cb callback,
+                    void *data,
+                    GError **error)
+{
+    memupload_t *upload;
+    GMappedFile *mapped;
+    const uint8_t *bytes;
+    size_t length;
+
+    mapped = g_mapped_file_new(path, FALSE, error);
+    if (mapped == NULL) {
+        return false;
+    }
+    bytes = (const uint8_t *)g_mapped_file_get_contents(mapped);
+    length = g_mapped_file_get_length(mapped);
+
+    if (address == MEMUPLOAD_PRG) {
+        if (length < 3) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                        "file too short for a PRG file");
+            g_mapped_file_unref(mapped);
+            return false;
+        }
+        address = MON_GET_U16(bytes);
+        bytes += 2;
+        length -= 2;
+    }
+    if (length == 0 || address < 0 || (size_t)address + length > 0x10000) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                    "%zu bytes don't fit in memory at $%04x",
+                    length, (unsigned int)address);
+        g_mapped_file_unref(mapped);
+        return false;
+    }
+
+    upload = g_malloc0(sizeof *upload);
+    upload->mapped = mapped;
+    upload->bytes = bytes;
+    upload->length = length;
+    upload->start = (uint16_t)address;
+    upload->memspace = memspace;
+    upload->verify = verify;
+    upload->chunk_size = connection_get_vice_info()->mem_get_max;
+    upload->body = g_malloc(MEM_HEADER_SIZE + upload->chunk_size);
+    upload->resume = connection_vice_running();
+    upload->started = g_get_monotonic_time();
+    upload->callback = callback;
+    upload->data = data;
+
+    /* the first command decides if we're connected at all */
+    if (!send_chunk(upload)) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED,
+                    "not connected to VICE");
+        g_mapped_file_unref(mapped);
+        g_free(upload->body);
+        g_free(upload);
+        return false;
+    }
+    pump(upload);
+    return true;
+}
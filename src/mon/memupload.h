@@ -0,0 +1,72 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   memupload.h
+ * \brief   Upload files to memory via MON_CMD_MEM_SET - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#ifndef MON_MEMUPLOAD_H_
+#define MON_MEMUPLOAD_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <glib.h>
+
+/** \brief  Maximum number of commands in flight
+ */
+#define MEMUPLOAD_WINDOW        4
+
+/** \brief  Load address meaning "use the PRG header"
+ */
+#define MEMUPLOAD_PRG           (-1)
+
+
+/** \brief  Callback for finished uploads
+ *
+ * \param[in]   success upload (and verification) succeeded
+ * \param[in]   start   start address
+ * \param[in]   length  number of bytes uploaded
+ * \param[in]   data    data passed to memupload_file()
+ */
+typedef void (*memupload_done_cb)(bool success,
+                                  uint16_t start,
+                                  size_t length,
+                                  void *data);
+
+
+bool memupload_file(const char *path,
+                    int address,
+                    uint8_t memspace,
+                    bool verify,
+                    memupload_done_cb callback,
+                    void *data,
+                    GError **error);
+
+#endif
@@ -43,4 +43,34 @@
 #define MON_API 0x01
 
 
+/** \brief  Get 16-bit little endian value at \a p
+ */
+#define MON_GET_U16(p) \
+    ((uint16_t)((uint16_t)(p)[0] | ((uint16_t)(p)[1] << 8)))
+
+/** \brief  Get 32-bit little endian value at \a p
+ */
+#define MON_GET_U32(p) \
+    ((uint32_t)(p)[0] | ((uint32_t)(p)[1] << 8) | \
+     ((uint32_t)(p)[2] << 16) | ((uint32_t)(p)[3] << 24))
+
+/** \brief  Store 16-bit value \a v at \a p in little endian order
+ */
+#define MON_SET_U16(p, v) \
+    do { \
+        (p)[0] = (uint8_t)((v) & 0xff); \
+        (p)[1] = (uint8_t)(((v) >> 8) & 0xff); \
+    } while (0)
+
+/** \brief  Store 32-bit value \a v at \a p in little endian order
+ */
+#define MON_SET_U32(p, v) \
+    do { \
+        (p)[0] = (uint8_t)((v) & 0xff); \
+        (p)[1] = (uint8_t)(((v) >> 8) & 0xff); \
+        (p)[2] = (uint8_t)(((v) >> 16) & 0xff); \
+        (p)[3] = (uint8_t)(((v) >> 24) & 0xff); \
+    } while (0)
+
+
 #endif
@@ -0,0 +1,454 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   registers.c
+ * \brief   CPU register cache
+ *
+ * Keeps the names of the main CPU's registers, from
+ * MON_CMD_REGISTERS_AVAILABLE, and their values, from MON_RESPONSE_REGISTER_INFO.
+ * VICE sends the register values as an event when the emulation stops, so
+ * usually no request is needed to get them. The values are invalidated when
+ * the emulation resumes.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "log.h"
+#include "monitor.h"
+#include "vicemonapi.h"
+#include "connection.h"
+#include "session.h"
+
+#include "registers.h"
+
+
+/** \brief  Number of possible register IDs
+ */
+#define REGISTER_ID_COUNT   256
+
+
+/** \brief  Register
+ */
+typedef struct cpu_register_s {
+    char name[REGISTERS_NAME_MAX + 1];  /**< name, empty if unknown */
+    uint16_t value;                     /**< cached value */
+    bool has_value;                     /**< value is known */
+} cpu_register_t;
+
+
+/** \brief  Pending fetch
+ */
+typedef struct fetch_s {
+    registers_ready_cb callback;    /**< function to call */
+    void *data;                     /**< data for \a callback */
+} fetch_t;
+
+
+/** \brief  Listener
+ */
+typedef struct listener_s {
+    registers_listener_cb callback; /**< function to call */
+    void *data;                     /**< data for \a callback */
+} listener_t;
+
+
+/** \brief  Register cache of a session
+ */
+struct registers_ctx_s {
+    cpu_register_t registers[REGISTER_ID_COUNT];    /**< registers by ID */
+    bool values_valid;                              /**< values are current */
+};
+
+
+/** \brief  List of listeners, shared by all sessions
+ */
+static GSList *listeners = NULL;
+
+
+/** \brief  Get register cache of the current session
+ *
+ * \return  register cache
+ */
+static registers_ctx_t *ctx(void)
+{
+    return session_current()->registers;
+}
+
+
+/** \brief  Create register cache for a session
+ *
+ * \return  register cache
+ */
+registers_ctx_t *registers_ctx_new(void)
+{
+    return g_malloc0(sizeof(registers_ctx_t));
+}
+
+
+/** \brief  Free register cache of a session
+ *
+ * \param[in]   cache   register cache
+ */
+void registers_ctx_free(registers_ctx_t *cache)
+{
+    g_free(cache);
+}
+
+
+/** \brief  Notify listeners of a change
+ */
+static void notify_listeners(void)
+{
+    GSList *node = listeners;
+
+    while (node != NULL) {
+        listener_t *listener = node->data;
+
+        node = node->next;
+        listener->callback(listener->data);
+    }
+}
+
+
+/** \brief  Store values of a MON_RESPONSE_REGISTER_INFO body
+ *
+ * \param[in]   response    response
+ *
+ * \return  false if the body is invalid
+ */
+static bool store_values(const mon_response_t *response)
+{
+    registers_ctx_t *cache = ctx();
+    uint32_t len = response_get_body_len(response);
+    const uint8_t *body = response->body;
+    uint32_t pos = 2;
+    uint16_t count;
+
+    if (len < 2) {
+        return false;
+    }
+    count = MON_GET_U16(body);
+    for (uint16_t i = 0; i < count; i++) {
+        uint8_t size;
+
+        if (pos >= len || (size = body[pos]) < 3 || pos + 1 + size > len) {
+            return false;
+        }
+        cache->registers[body[pos + 1]].value = MON_GET_U16(body + pos + 2);
+        cache->registers[body[pos + 1]].has_value = true;
+        pos += 1 + size;
+    }
+    cache->values_valid = true;
+    return true;
+}
+
+
+/** \brief  Handler for MON_RESPONSE_REGISTER_INFO events
+ *
+ * \param[in]   response    response
+ * \param[in]   data        extra data (unused)
+ */
+static void on_register_info_event(const mon_response_t *response, void *data)
+{
+    /* only the main CPU's registers are sent as events */
+    if (store_values(response)) {
+        notify_listeners();
+    }
+}
+
+
+/** \brief  Handler for MON_RESPONSE_RESUMED events
+ *
+ * \param[in]   response    response
+ * \param[in]   data        extra data (unused)
+ */
+static void on_resumed_event(const mon_response_t *response, void *data)
+{
+    registers_invalidate();
+}
+
+
+/** \brief  Initialize register cache
+ */
+void registers_init(void)
+{
+    connection_add_event_handler(MON_RESPONSE_REGISTER_INFO,
+                                 on_register_info_event,
+                                 NULL);
+    connection_add_event_handler(MON_RESPONSE_RESUMED,
+                                 on_resumed_event,
+                                 NULL);
+}
+
+
+/** \brief  Free resources used by the register cache
+ */
+void registers_exit(void)
+{
+    connection_remove_event_handler(MON_RESPONSE_REGISTER_INFO,
+                                    on_register_info_event,
+                                    NULL);
+    connection_remove_event_handler(MON_RESPONSE_RESUMED,
+                                    on_resumed_event,
+                                    NULL);
+    g_slist_free_full(listeners, g_free);
+    listeners = NULL;
+}
+
+
+/** \brief  Handler for MON_CMD_REGISTERS_AVAILABLE responses
+ *
+ * \param[in]   response    response
+ * \param[in]   data        extra data (unused)
+ */
+static void on_available_response(const mon_response_t *response, void *data)
+{
+    uint32_t len = response_get_body_len(response);
+    const uint8_t *body = response->body;
+    uint32_t pos = 2;
+    uint16_t count;
+
+    if (response->error_code != MON_ERR_OK || len < 2) {
+        log_msg(LOG_ERR, "Failed to get register names: error $%02x.\n",
+                response->error_code);
+        return;
+    }
+    count = MON_GET_U16(body);
+    for (uint16_t i = 0; i < count; i++) {
+        uint8_t size;
+        uint8_t namelen;
+        cpu_register_t *reg;
+
+        /* size, ID, bits, name length, name */
+        if (pos >= len || (size = body[pos]) < 3 || pos + 1 + size > len) {
+            log_msg(LOG_ERR, "Invalid register list.\n");
+            return;
+        }
+        reg = &ctx()->registers[body[pos + 1]];
+        namelen = MIN(body[pos + 3], (uint8_t)(size - 3));
+        namelen = MIN(namelen, REGISTERS_NAME_MAX);
+        memcpy(reg->name, body + pos + 4, namelen);
+        reg->name[namelen] = '\0';
+        pos += 1 + size;
+    }
+    debug_msg("Got %u register names.", count);
+    notify_listeners();
+}
+
+
+/** \brief  Get register names and values from VICE
+ */
+void registers_sync(void)
+{
+    uint8_t memspace = MON_MEMSPACE_MAIN;
+
+    connection_cork();
+    connection_send_request(MON_CMD_REGISTERS_AVAILABLE, &memspace, 1,
+                            on_available_response, NULL);
+    registers_fetch(NULL, NULL);
+    connection_uncork();
+}
+
+
+/** \brief  Handler for MON_CMD_REGISTERS_GET responses
+ *
+ * \param[in]   response    response
+ * \param[in]   data        fetch
+ */
+static void on_get_response(const mon_response_t *response, void *data)
+{
+    fetch_t *fetch = data;
+    bool ok;
+
+    ok = response->error_code == MON_ERR_OK && store_values(response);
+    if (!ok) {
+        log_msg(LOG_ERR, "Failed to get registers: error $%02x.\n",
+                response->error_code);
+    } else {
+        notify_listeners();
+    }
+    if (fetch->callback != NULL) {
+        fetch->callback(ok, fetch->data);
+    }
+    g_free(fetch);
+}
+
+
+/** \brief  Make sure the register values are current
+ *
+ * If the cached values are current \a callback is called before this
+ * function returns.
+ *
+ * \param[in]   callback    function to call when done (optional)
+ * \param[in]   data        data for \a callback
+ *
+ * \return  false if the request couldn't be sent, \a callback isn't called
+ *          in that case
+ */
+bool registers_fetch(registers_ready_cb callback, void *data)
+{
+    uint8_t memspace = MON_MEMSPACE_MAIN;
+    fetch_t *fetch;
+
+    if (ctx()->values_valid) {
+        if (callback != NULL) {
+            callback(true, data);
+        }
+        return true;
+    }
+    fetch = g_malloc(sizeof *fetch);
+    fetch->callback = callback;
+    fetch->data = data;
+    if (connection_send_request_resume(MON_CMD_REGISTERS_GET, &memspace, 1,
+                                       on_get_response, fetch) == 0) {
+        g_free(fetch);
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Invalidate cached register values
+ */
+void registers_invalidate(void)
+{
+    registers_ctx_t *cache = ctx();
+
+    if (cache->values_valid) {
+        cache->values_valid = false;
+        notify_listeners();
+    }
+}
+
+
+/** \brief  Check if the cached register values are current
+ *
+ * \return  true if current
+ */
+bool registers_valid(void)
+{
+    return ctx()->values_valid;
+}
+
+
+/** \brief  Look up register by name (case-insensitive)
+ *
+ * \param[in]   name    register name
+ * \param[out]  id      register ID
+ *
+ * \return  true if found
+ */
+bool registers_lookup_name(const char *name, uint8_t *id)
+{
+    const cpu_register_t *registers = ctx()->registers;
+
+    for (int i = 0; i < REGISTER_ID_COUNT; i++) {
+        if (registers[i].name[0] != '\0'
+                && g_ascii_strcasecmp(registers[i].name, name) == 0) {
+            *id = (uint8_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/** \brief  Get register name
+ *
+ * \param[in]   id  register ID
+ *
+ * \return  name or `NULL` if unknown
+ */
+const char *registers_name(uint8_t id)
+{
+    const cpu_register_t *reg = &ctx()->registers[id];
+
+    return reg->name[0] != '\0' ? reg->name : NULL;
+}
+
+
+/** \brief  Get cached register value
+ *
+ * \param[in]   id      register ID
+ * \param[out]  value   value
+ *
+ * \return  false if the value isn't current
+ */
+bool registers_get(uint8_t id, uint16_t *value)
+{
+    registers_ctx_t *cache = ctx();
+
+    if (!cache->values_valid || !cache->registers[id].has_value) {
+        return false;
+    }
+    *value = cache->registers[id].value;
+    return true;
+}
+
+
+/** \brief  Register \a callback to be called when the registers change
+ *
+ * \param[in]   callback    function to call
+ * \param[in]   data        data for \a callback
+ */
+void registers_add_listener(registers_listener_cb callback, void *data)
+{
+    listener_t *listener = g_malloc(sizeof *listener);
+
+    listener->callback = callback;
+    listener->data = data;
+    listeners = g_slist_append(listeners, listener);
+}
+
+
+/** \brief  Unregister listener
+ *
+ * \param[in]   callback    function registered
+ * \param[in]   data        data registered
+ */
+void registers_remove_listener(registers_listener_cb callback, void *data)
+{
+    GSList *node;
+
+    for (node = listeners; node != NULL; node = node->next) {
+        listener_t *listener = node->data;
+
+        if (listener->callback == callback && listener->data == data) {
+            listeners = g_slist_delete_link(listeners, node);
+            g_free(listener);
+            return;
+        }
+    }
+}
@@ -0,0 +1,85 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   registers.h
+ * \brief   CPU register cache - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#ifndef MON_REGISTERS_H_
+#define MON_REGISTERS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/** \brief  Maximum length of a register name
+ */
+#define REGISTERS_NAME_MAX  15
+
+
+/** \brief  Register cache of a session (opaque)
+ */
+typedef struct registers_ctx_s registers_ctx_t;
+
+
+/** \brief  Callback for registers_fetch()
+ *
+ * \param[in]   success registers were fetched
+ * \param[in]   data    data passed to registers_fetch()
+ */
+typedef void (*registers_ready_cb)(bool success, void *data);
+
+/** \brief  Callback for register cache changes
+ *
+ * Called when the registers are updated or invalidated.
+ *
+ * \param[in]   data    data passed to registers_add_listener()
+ */
+typedef void (*registers_listener_cb)(void *data);
+
+
+void registers_init(void);
+void registers_exit(void);
+
+registers_ctx_t *registers_ctx_new(void);
+void registers_ctx_free(registers_ctx_t *cache);
+
+void registers_sync(void);
+bool registers_fetch(registers_ready_cb callback, void *data);
+void registers_invalidate(void);
+bool registers_valid(void);
+
+bool registers_lookup_name(const char *name, uint8_t *id);
+const char *registers_name(uint8_t id);
+bool registers_get(uint8_t id, uint16_t *value);
+
+void registers_add_listener(registers_listener_cb callback, void *data);
+void registers_remove_listener(registers_listener_cb callback, void *data);
+
+#endif
@@ -0,0 +1,766 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   resources.c
+ * \brief   Resource cache
+ *
+ * Values returned by MON_CMD_RESOURCE_GET are cached by resource name
+ * (case-insensitive, like VICE). Concurrent requests for the same resource
+ * share a single MON_CMD_RESOURCE_GET, and the resources listed in the
+ * `prefetch` key of the [Resources] settings group are fetched in one corked
+ * batch on connect.
+ *
+ * Entries are invalidated when set through this module and when the machine
+ * is reset. A response that arrives for an entry invalidated while the
+ * request was in flight is discarded and the resource is requested again.
+ *
+ * Resources set through this module are remembered and set again by
+ * resources_restore() after a reconnect.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "log.h"
+#include "settings.h"
+#include "vicemonapi.h"
+#include "connection.h"
+#include "session.h"
+
+#include "resources.h"
+
+
+/** \brief  Maximum length of a resource name or string value
+ */
+#define RESOURCE_STRING_MAX 0xff
+
+
+/** \brief  Waiter for a resource value
+ */
+typedef struct waiter_s {
+    resources_get_cb callback;  /**< function to call */
+    void *data;                 /**< data for \a callback */
+} waiter_t;
+
+
+/** \brief  Cache entry
+ */
+typedef struct entry_s {
+    char *name;                 /**< name as first requested */
+    resource_value_t value;     /**< cached value */
+    bool valid;                 /**< \a value is valid */
+    bool in_flight;             /**< MON_CMD_RESOURCE_GET sent */
+    bool stale;                 /**< invalidated while in flight */
+    GSList *waiters;            /**< waiters for the value */
+} entry_t;
+
+
+/** \brief  Setter context
+ */
+typedef struct setter_s {
+    char *name;                 /**< resource name */
+    resources_set_cb callback;  /**< function to call */
+    void *data;                 /**< data for \a callback */
+} setter_t;
+
+
+/** \brief  Resource set through this module
+ */
+typedef struct override_s {
+    char *name;             /**< resource name */
+    resource_type_t type;   /**< value type */
+    GBytes *value;          /**< value bytes as sent */
+} override_t;
+
+
+/** \brief  Listener
+ */
+typedef struct listener_s {
+    resources_listener_cb callback; /**< function to call */
+    void *data;                     /**< data for \a callback */
+} listener_t;
+
+
+/** \brief  Resource cache of a session
+ *
+ * The overrides are the resources set through this module, re-applied by
+ * resources_restore().
+ */
+struct resources_ctx_s {
+    GHashTable *cache;      /**< entries, indexed by lower case name */
+    GHashTable *overrides;  /**< override_t, indexed by lower case name */
+};
+
+
+/** \brief  List of listeners, shared by all sessions
+ */
+static GSList *listeners = NULL;
+
+
+/** \brief  Get resource cache of the current session
+ *
+ * \return  resource cache
+ */
+static resources_ctx_t *ctx(void)
+{
+    return session_current()->resources;
+}
+
+
+static bool send_get(entry_t *entry);
+static bool send_set(const char *name,
+                     resource_type_t type,
+                     const uint8_t *value,
+                     size_t vlen,
+                     resources_set_cb callback,
+                     void *data);
+
+
+/** \brief  Notify listeners of a change
+ *
+ * \param[in]   name    resource name, or NULL for all
+ */
+static void notify_listeners(const char *name)
+{
+    GSList *node = listeners;
+
+    while (node != NULL) {
+        listener_t *listener = node->data;
+
+        node = node->next;
+        listener->callback(name, listener->data);
+    }
+}
+
+
+/** \brief  Free cached value of \a entry
+ *
+ * \param[in,out]   entry   entry
+ */
+static void entry_clear_value(entry_t *entry)
+{
+    g_free(entry->value.str_value);
+    entry->value.str_value = NULL;
+    entry->valid = false;
+}
+
+
+/** \brief  Free entry
+ *
+ * \param[in]   data    entry
+ */
+static void entry_free(gpointer data)
+{
+    entry_t *entry = data;
+
+    entry_clear_value(entry);
+    g_slist_free_full(entry->waiters, g_free);
+    g_free(entry->name);
+    g_free(entry);
+}
+
+
+/** \brief  Get entry for \a name, creating it if needed
+ *
+ * \param[in]   name    resource name
+ *
+ * \return  entry
+ */
+static entry_t *entry_get(const char *name)
+{
+    GHashTable *cache = ctx()->cache;
+    char *key = g_ascii_strdown(name, -1);
+    entry_t *entry = g_hash_table_lookup(cache, key);
+
+    if (entry == NULL) {
+        entry = g_malloc0(sizeof *entry);
+        entry->name = g_strdup(name);
+        g_hash_table_insert(cache, key, entry);
+    } else {
+        g_free(key);
+    }
+    return entry;
+}
+
+
+/** \brief  Find entry for \a name
+ *
+ * \param[in]   name    resource name
+ *
+ * \return  entry or NULL
+ */
+static entry_t *entry_find(const char *name)
+{
+    char *key = g_ascii_strdown(name, -1);
+    entry_t *entry = g_hash_table_lookup(ctx()->cache, key);
+
+    g_free(key);
+    return entry;
+}
+
+
+/** \brief  Call and remove waiters of \a entry
+ *
+ * \param[in,out]   entry   entry
+ * \param[in]       value   value or NULL on failure
+ */
+static void entry_wake(entry_t *entry, const resource_value_t *value)
+{
+    GSList *waiters = entry->waiters;
+    GSList *node;
+
+    entry->waiters = NULL;
+    for (node = waiters; node != NULL; node = node->next) {
+        waiter_t *waiter = node->data;
+
+        if (waiter->callback != NULL) {
+            waiter->callback(entry->name, value, waiter->data);
+        }
+    }
+    g_slist_free_full(waiters, g_free);
+}
+
+
+/** \brief  Parse MON_RESPONSE_RESOURCE_GET body
+ *
+ * \param[in]   response    response
+ * \param[out]  value       value
+ *
+ * \return  false if malformed
+ */
+static bool parse_value(const mon_response_t *response,
+                        resource_value_t *value)
+{
+    uint32_t len = response_get_body_len(response);
+    const uint8_t *body = response->body;
+    uint8_t vlen;
+
+    if (len < 2) {
+        return false;
+    }
+    vlen = body[1];
+    if (len < 2u + vlen) {
+        return false;
+    }
+    value->type = body[0];
+    value->str_value = NULL;
+    value->int_value = 0;
+    if (value->type == RESOURCE_TYPE_STRING) {
+        value->str_value = g_strndup((const char *)body + 2, vlen);
+    } else if (value->type == RESOURCE_TYPE_INT) {
+        uint32_t v = 0;
+
+        for (int i = vlen - 1; i >= 0; i--) {
+            v = (v << 8) | body[2 + i];
+        }
+        value->int_value = (int)v;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Handler for MON_RESPONSE_RESOURCE_GET
+ *
+ * \param[in]   response    response
+ * \param[in]   data        resource name (freed)
+ */
+static void on_get_response(const mon_response_t *response, void *data)
+{
+    char *name = data;
+    entry_t *entry;
+    resource_value_t value;
+
+    entry = entry_find(name);
+    g_free(name);
+    if (entry == NULL) {
+        return;
+    }
+    entry->in_flight = false;
+
+    if (entry->stale) {
+        entry->stale = false;
+        if (send_get(entry)) {
+            return;
+        }
+        entry_wake(entry, NULL);
+        return;
+    }
+
+    if (response->error_code != MON_ERR_OK || !parse_value(response, &value)) {
+        log_msg(LOG_WARN, "Failed to get resource '%s' (error $%02x).\n",
+                entry->name, response->error_code);
+        entry_wake(entry, NULL);
+        return;
+    }
+    entry_clear_value(entry);
+    entry->value = value;
+    entry->valid = true;
+    entry_wake(entry, &entry->value);
+    notify_listeners(entry->name);
+}
+
+
+/** \brief  Send MON_CMD_RESOURCE_GET for \a entry
+ *
+ * \param[in,out]   entry   entry
+ *
+ * \return  false if the command could not be sent
+ */
+static bool send_get(entry_t *entry)
+{
+    uint8_t body[1 + RESOURCE_STRING_MAX];
+    size_t len = strlen(entry->name);
+    char *name;
+
+    if (len > RESOURCE_STRING_MAX) {
+        return false;
+    }
+    body[0] = (uint8_t)len;
+    memcpy(body + 1, entry->name, len);
+    name = g_strdup(entry->name);
+    if (connection_send_request_resume(MON_CMD_RESOURCE_GET,
+                                       body,
+                                       len + 1,
+                                       on_get_response,
+                                       name) == 0) {
+        g_free(name);
+        return false;
+    }
+    entry->in_flight = true;
+    return true;
+}
+
+
+/** \brief  Free override
+ *
+ * \param[in]   data    override
+ */
+static void override_free(gpointer data)
+{
+    override_t *override = data;
+
+    g_free(override->name);
+    g_bytes_unref(override->value);
+    g_free(override);
+}
+
+
+/** \brief  Copy override
+ *
+ * \param[in]   override    override
+ *
+ * \return  copy, free with override_free()
+ */
+static override_t *override_new_copy(const override_t *override)
+{
+    override_t *copy = g_malloc(sizeof *copy);
+
+    copy->name = g_strdup(override->name);
+    copy->type = override->type;
+    copy->value = g_bytes_ref(override->value);
+    return copy;
+}
+
+
+/** \brief  Create resource cache for a session
+ *
+ * \return  resource cache
+ */
+resources_ctx_t *resources_ctx_new(void)
+{
+    resources_ctx_t *res = g_malloc(sizeof *res);
+
+    res->cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                       g_free, entry_free);
+    res->overrides = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           g_free, override_free);
+    return res;
+}
+
+
+/** \brief  Free resource cache of a session
+ *
+ * \param[in]   res     resource cache
+ */
+void resources_ctx_free(resources_ctx_t *res)
+{
+    g_hash_table_destroy(res->cache);
+    g_hash_table_destroy(res->overrides);
+    g_free(res);
+}
+
+
+/** \brief  Free resources used by the resource cache
+ */
+void resources_exit(void)
+{
+    g_slist_free_full(listeners, g_free);
+    listeners = NULL;
+}
+
+
+/** \brief  Fetch the resources listed in the settings
+ *
+ * Reads a list of names separated by commas or semicolons from the
+ * `prefetch` key of the [Resources] group and fetches all resources that
+ * aren't cached in a single write.
+ */
+void resources_prefetch(void)
+{
+    const char *list = NULL;
+    char **names;
+    int count = 0;
+
+    if (!settings_get_str("Resources", "prefetch", &list) || list == NULL) {
+        return;
+    }
+    names = g_strsplit_set(list, ",;", -1);
+    connection_cork();
+    for (int i = 0; names[i] != NULL; i++) {
+        char *name = g_strstrip(names[i]);
+        entry_t *entry;
+
+        if (*name == '\0') {
+            continue;
+        }
+        entry = entry_get(name);
+        if (!entry->valid && !entry->in_flight && send_get(entry)) {
+            count++;
+        }
+    }
+    connection_uncork();
+    g_strfreev(names);
+    debug_msg("prefetching %d resources", count);
+}
+
+
+/** \brief  Re-apply resources after a reconnect
+ *
+ * Sets the resources set through this module again, in case VICE was
+ * restarted, then invalidates the cache and prefetches, all in a single
+ * write.
+ */
+void resources_restore(void)
+{
+    GHashTableIter iter;
+    gpointer value;
+    GPtrArray *list = g_ptr_array_new();
+
+    /* send_set() replaces entries, so don't iterate the table itself */
+    g_hash_table_iter_init(&iter, ctx()->overrides);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        override_t *override = value;
+
+        g_ptr_array_add(list, override_new_copy(override));
+    }
+
+    connection_cork();
+    for (guint i = 0; i < list->len; i++) {
+        override_t *override = g_ptr_array_index(list, i);
+        gsize vlen;
+        const uint8_t *bytes = g_bytes_get_data(override->value, &vlen);
+
+        send_set(override->name, override->type, bytes, vlen, NULL, NULL);
+        override_free(override);
+    }
+    resources_invalidate_all();
+    resources_prefetch();
+    connection_uncork();
+    debug_msg("restored %u resources", list->len);
+    g_ptr_array_free(list, TRUE);
+}
+
+
+/** \brief  Get resource value
+ *
+ * Calls \a callback immediately when the value is cached. Without a
+ * callback the value is only fetched into the cache, the listeners are
+ * notified when it arrives.
+ *
+ * \param[in]   name        resource name
+ * \param[in]   callback    function to call with the value (optional)
+ * \param[in]   data        data for \a callback
+ *
+ * \return  false if the request could not be sent
+ */
+bool resources_get(const char *name, resources_get_cb callback, void *data)
+{
+    entry_t *entry = entry_get(name);
+    waiter_t *waiter;
+
+    if (entry->valid) {
+        if (callback != NULL) {
+            callback(entry->name, &entry->value, data);
+        }
+        return true;
+    }
+    if (!entry->in_flight && !send_get(entry)) {
+        return false;
+    }
+    waiter = g_malloc(sizeof *waiter);
+    waiter->callback = callback;
+    waiter->data = data;
+    entry->waiters = g_slist_append(entry->waiters, waiter);
+    return true;
+}
+
+
+/** \brief  Get cached resource value
+ *
+ * \param[in]   name    resource name
+ *
+ * \return  value or NULL when not cached
+ */
+const resource_value_t *resources_lookup(const char *name)
+{
+    entry_t *entry = entry_find(name);
+
+    return entry != NULL && entry->valid ? &entry->value : NULL;
+}
+
+
+/** \brief  Handler for MON_RESPONSE_RESOURCE_SET
+ *
+ * \param[in]   response    response
+ * \param[in]   data        setter
+ */
+static void on_set_response(const mon_response_t *response, void *data)
+{
+    setter_t *setter = data;
+    bool success = response->error_code == MON_ERR_OK;
+
+    if (!success) {
+        log_msg(LOG_WARN, "Failed to set resource '%s' (error $%02x).\n",
+                setter->name, response->error_code);
+    }
+    if (setter->callback != NULL) {
+        setter->callback(setter->name, success, setter->data);
+    }
+    g_free(setter->name);
+    g_free(setter);
+}
+
+
+/** \brief  Send MON_CMD_RESOURCE_SET
+ *
+ * \param[in]   name        resource name
+ * \param[in]   type        value type
+ * \param[in]   value       value bytes
+ * \param[in]   vlen        number of value bytes
+ * \param[in]   callback    function to call when done (optional)
+ * \param[in]   data        data for \a callback
+ *
+ * \return  false if the command could not be sent
+ */
+static bool send_set(const char *name,
+                     resource_type_t type,
+                     const uint8_t *value,
+                     size_t vlen,
+                     resources_set_cb callback,
+                     void *data)
+{
+    uint8_t body[3 + RESOURCE_STRING_MAX * 2];
+    size_t nlen = strlen(name);
+    setter_t *setter;
+    override_t *override;
+
+    if (nlen > RESOURCE_STRING_MAX || vlen > RESOURCE_STRING_MAX) {
+        return false;
+    }
+    body[0] = (uint8_t)type;
+    body[1] = (uint8_t)nlen;
+    memcpy(body + 2, name, nlen);
+    body[2 + nlen] = (uint8_t)vlen;
+    memcpy(body + 3 + nlen, value, vlen);
+
+    /* a GET sent after this SET sees the new value */
+    resources_invalidate(name);
+
+    override = g_malloc(sizeof *override);
+    override->name = g_strdup(name);
+    override->type = type;
+    override->value = g_bytes_new(value, vlen);
+    g_hash_table_replace(ctx()->overrides, g_ascii_strdown(name, -1), override);
+
+    setter = g_malloc(sizeof *setter);
+    setter->name = g_strdup(name);
+    setter->callback = callback;
+    setter->data = data;
+    if (connection_send_request_resume(MON_CMD_RESOURCE_SET,
+                                       body,
+                                       3 + nlen + vlen,
+                                       on_set_response,
+                                       setter) == 0) {
+        g_free(setter->name);
+        g_free(setter);
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Set integer resource
+ *
+ * \param[in]   name        resource name
+ * \param[in]   value       value
+ * \param[in]   callback    function to call when done (optional)
+ * \param[in]   data        data for \a callback
+ *
+ * \return  false if the command could not be sent
+ */
+bool resources_set_int(const char *name,
+                       int value,
+                       resources_set_cb callback,
+                       void *data)
+{
+    uint8_t bytes[4];
+
+    bytes[0] = (uint8_t)(value & 0xff);
+    bytes[1] = (uint8_t)((value >> 8) & 0xff);
+    bytes[2] = (uint8_t)((value >> 16) & 0xff);
+    bytes[3] = (uint8_t)((value >> 24) & 0xff);
+    return send_set(name, RESOURCE_TYPE_INT, bytes, sizeof(bytes),
+                    callback, data);
+}
+
+
+/** \brief  Set string resource
+ *
+ * \param[in]   name        resource name
+ * \param[in]   value       value
+ * \param[in]   callback    function to call when done (optional)
+ * \param[in]   data        data for \a callback
+ *
+ * \return  false if the command could not be sent
+ */
+bool resources_set_string(const char *name,
+                          const char *value,
+                          resources_set_cb callback,
+                          void *data)
+{
+    return send_set(name, RESOURCE_TYPE_STRING,
+                    (const uint8_t *)value, strlen(value),
+                    callback, data);
+}
+
+
+/** \brief  Invalidate cached resource
+ *
+ * \param[in]   name    resource name
+ */
+void resources_invalidate(const char *name)
+{
+    entry_t *entry;
+
+    if ((entry = entry_find(name)) == NULL) {
+        return;
+    }
+    if (entry->in_flight) {
+        entry->stale = true;
+    }
+    if (entry->valid) {
+        entry_clear_value(entry);
+        notify_listeners(entry->name);
+    }
+}
+
+
+/** \brief  Invalidate all cached resources
+ *
+ * Called when the machine is reset.
+ */
+void resources_invalidate_all(void)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, ctx()->cache);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        entry_t *entry = value;
+
+        if (entry->in_flight) {
+            entry->stale = true;
+        }
+        entry_clear_value(entry);
+    }
+    notify_listeners(NULL);
+}
+
+
+/** \brief  Notify listeners that another session was made active
+ *
+ * Call after session_set_active().
+ */
+void resources_session_changed(void)
+{
+    notify_listeners(NULL);
+}
+
+
+/** \brief  Register \a callback to be called on cache changes
+ *
+ * \param[in]   callback    function to call
+ * \param[in]   data        data for \a callback
+ */
+void resources_add_listener(resources_listener_cb callback, void *data)
+{
+    listener_t *listener = g_malloc(sizeof *listener);
+
+    listener->callback = callback;
+    listener->data = data;
+    listeners = g_slist_append(listeners, listener);
+}
+
+
+/** \brief  Unregister listener
+ *
+ * \param[in]   callback    function registered
+ * \param[in]   data        data registered
+ */
+void resources_remove_listener(resources_listener_cb callback, void *data)
+{
+    GSList *node;
+
+    for (node = listeners; node != NULL; node = node->next) {
+        listener_t *listener = node->data;
+
+        if (listener->callback == callback && listener->data == data) {
+            listeners = g_slist_delete_link(listeners, node);
+            g_free(listener);
+            return;
+        }
+    }
+}
@@ -0,0 +1,113 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   resources.h
+ * \brief   Resource cache - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#ifndef MON_RESOURCES_H_
+#define MON_RESOURCES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/** \brief  Resource cache of a session (opaque)
+ */
+typedef struct resources_ctx_s resources_ctx_t;
+
+
+/** \brief  Resource types as used by the binary monitor
+ */
+typedef enum resource_type_e {
+    RESOURCE_TYPE_STRING = 0x00,    /**< string */
+    RESOURCE_TYPE_INT = 0x01        /**< integer */
+} resource_type_t;
+
+
+/** \brief  Resource value
+ */
+typedef struct resource_value_s {
+    resource_type_t type;   /**< type */
+    int int_value;          /**< value for RESOURCE_TYPE_INT */
+    char *str_value;        /**< value for RESOURCE_TYPE_STRING */
+} resource_value_t;
+
+
+/** \brief  Callback for resources_get()
+ *
+ * \param[in]   name    resource name
+ * \param[in]   value   value, or NULL on failure; only valid during the call
+ * \param[in]   data    data passed to resources_get()
+ */
+typedef void (*resources_get_cb)(const char *name,
+                                 const resource_value_t *value,
+                                 void *data);
+
+/** \brief  Callback for resources_set_int() and resources_set_string()
+ *
+ * \param[in]   name    resource name
+ * \param[in]   success resource was set
+ * \param[in]   data    data passed when setting the resource
+ */
+typedef void (*resources_set_cb)(const char *name, bool success, void *data);
+
+/** \brief  Callback for resource cache changes
+ *
+ * \param[in]   name    resource updated or invalidated, NULL for all
+ * \param[in]   data    data passed to resources_add_listener()
+ */
+typedef void (*resources_listener_cb)(const char *name, void *data);
+
+
+void resources_exit(void);
+
+resources_ctx_t *resources_ctx_new(void);
+void resources_ctx_free(resources_ctx_t *res);
+
+void resources_prefetch(void);
+void resources_restore(void);
+bool resources_get(const char *name, resources_get_cb callback, void *data);
+const resource_value_t *resources_lookup(const char *name);
+bool resources_set_int(const char *name,
+                       int value,
+                       resources_set_cb callback,
+                       void *data);
+bool resources_set_string(const char *name,
+                          const char *value,
+                          resources_set_cb callback,
+                          void *data);
+void resources_invalidate(const char *name);
+void resources_invalidate_all(void);
+void resources_session_changed(void);
+
+void resources_add_listener(resources_listener_cb callback, void *data);
+void resources_remove_listener(resources_listener_cb callback, void *data);
+
+#endif
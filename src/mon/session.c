@@ -0,0 +1,239 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   session.c
+ * \brief   Debugging sessions
+ *
+ * A session bundles the connection to a single VICE instance with the state
+ * kept for it: the checkpoint table and the memory, register and resource
+ * caches. All sessions are served by the same GLib main loop.
+ *
+ * The modules keep working on the *current* session. That is the *active*
+ * session selected in the UI, unless another session was pushed with
+ * session_push(). The connection layer pushes the session a response
+ * arrived on before dispatching it, so response handlers and event
+ * handlers always update the tables of the right session. Code running
+ * from timers pushes the session it was started for.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "debug.h"
+#include "log.h"
+#include "settings.h"
+
+#include "session.h"
+
+
+/** \brief  Sessions, in order of creation
+ */
+static GPtrArray *sessions = NULL;
+
+/** \brief  Session selected in the UI
+ */
+static session_t *active = NULL;
+
+/** \brief  Stack of sessions pushed with session_push()
+ */
+static GSList *stack = NULL;
+
+/** \brief  ID for the next session
+ */
+static uint32_t next_id = 1;
+
+
+/** \brief  Create session
+ *
+ * The first session created becomes the active session. The session isn't
+ * connected yet.
+ *
+ * \param[in]   host    host, or NULL for the 'VICE/host' setting
+ * \param[in]   port    port, or 0 for the 'VICE/port' setting
+ *
+ * \return  new session
+ */
+session_t *session_new(const char *host, int port)
+{
+    session_t *session = g_malloc0(sizeof *session);
+
+    if (host == NULL && !settings_get_str("VICE", "host", &host)) {
+        host = "127.0.0.1";
+    }
+    if (port <= 0 && !settings_get_int("VICE", "port", &port)) {
+        port = 6502;
+    }
+
+    session->id = next_id++;
+    session->host = g_strdup(host);
+    session->port = port;
+    if (g_str_has_prefix(host, CONNECTION_UNIX_PREFIX)) {
+        session->name = g_strdup(host);
+    } else {
+        session->name = g_strdup_printf("%s:%d", host, port);
+    }
+    session->connection = connection_new(session);
+    session->checkpoint = checkpoint_ctx_new();
+    session->memcache = memcache_ctx_new();
+    session->registers = registers_ctx_new();
+    session->resources = resources_ctx_new();
+
+    if (sessions == NULL) {
+        sessions = g_ptr_array_new();
+    }
+    g_ptr_array_add(sessions, session);
+    if (active == NULL) {
+        active = session;
+    }
+    log_msg(LOG_INFO, "Created session %u (%s).\n",
+            session->id, session->name);
+    return session;
+}
+
+
+/** \brief  Close and free session
+ *
+ * \param[in]   session session
+ */
+void session_free(session_t *session)
+{
+    session_push(session);
+    connection_free(session->connection);
+    session_pop();
+
+    checkpoint_ctx_free(session->checkpoint);
+    memcache_ctx_free(session->memcache);
+    registers_ctx_free(session->registers);
+    resources_ctx_free(session->resources);
+
+    g_ptr_array_remove(sessions, session);
+    if (active == session) {
+        active = sessions->len > 0 ? g_ptr_array_index(sessions, 0) : NULL;
+    }
+    g_free(session->host);
+    g_free(session->name);
+    g_free(session);
+}
+
+
+/** \brief  Close and free all sessions
+ */
+void session_exit(void)
+{
+    while (sessions != NULL && sessions->len > 0) {
+        session_free(g_ptr_array_index(sessions, sessions->len - 1));
+    }
+    if (sessions != NULL) {
+        g_ptr_array_free(sessions, TRUE);
+        sessions = NULL;
+    }
+    g_slist_free(stack);
+    stack = NULL;
+}
+
+
+/** \brief  Get current session
+ *
+ * \return  session pushed last, or the active session
+ */
+session_t *session_current(void)
+{
+    return stack != NULL ? stack->data : active;
+}
+
+
+/** \brief  Get active session
+ *
+ * \return  session selected in the UI
+ */
+session_t *session_active(void)
+{
+    return active;
+}
+
+
+/** \brief  Set active session
+ *
+ * \param[in]   session session selected in the UI
+ */
+void session_set_active(session_t *session)
+{
+    if (session != active) {
+        debug_msg("active session: %u", session->id);
+        active = session;
+    }
+}
+
+
+/** \brief  Make \a session the current session until session_pop()
+ *
+ * Calls can be nested.
+ *
+ * \param[in]   session session
+ */
+void session_push(session_t *session)
+{
+    stack = g_slist_prepend(stack, session);
+}
+
+
+/** \brief  Undo the last session_push()
+ */
+void session_pop(void)
+{
+    if (stack != NULL) {
+        stack = g_slist_delete_link(stack, stack);
+    }
+}
+
+
+/** \brief  Get number of sessions
+ *
+ * \return  number of sessions
+ */
+size_t session_count(void)
+{
+    return sessions != NULL ? sessions->len : 0;
+}
+
+
+/** \brief  Call \a callback for each session, in order of creation
+ *
+ * \param[in]   callback    function to call
+ * \param[in]   data        data for \a callback
+ */
+void session_foreach(session_foreach_cb callback, void *data)
+{
+    for (guint i = 0; sessions != NULL && i < sessions->len; i++) {
+        callback(g_ptr_array_index(sessions, i), data);
+    }
+}
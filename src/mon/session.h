@@ -0,0 +1,84 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   session.h
+ * \brief   Debugging sessions - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#ifndef MON_SESSION_H_
+#define MON_SESSION_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "connection.h"
+#include "checkpoint.h"
+#include "memcache.h"
+#include "registers.h"
+#include "resources.h"
+
+
+/** \brief  Session with a single VICE instance
+ */
+typedef struct session_s {
+    uint32_t id;                    /**< session ID */
+    char *host;                     /**< host of the binary monitor */
+    int port;                       /**< port of the binary monitor */
+    char *name;                     /**< display name ("host:port") */
+    connection_t *connection;       /**< connection */
+    checkpoint_ctx_t *checkpoint;   /**< checkpoint table */
+    memcache_ctx_t *memcache;       /**< memory cache */
+    registers_ctx_t *registers;     /**< register cache */
+    resources_ctx_t *resources;     /**< resource cache */
+} session_t;
+
+
+/** \brief  Callback for session_foreach()
+ *
+ * \param[in]   session session
+ * \param[in]   data    data passed to session_foreach()
+ */
+typedef void (*session_foreach_cb)(session_t *session, void *data);
+
+
+session_t *session_new(const char *host, int port);
+void session_free(session_t *session);
+void session_exit(void);
+
+session_t *session_current(void);
+session_t *session_active(void);
+void session_set_active(session_t *session);
+void session_push(session_t *session);
+void session_pop(void);
+
+size_t session_count(void);
+void session_foreach(session_foreach_cb callback, void *data);
+
+#endif
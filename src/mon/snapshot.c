@@ -0,0 +1,378 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   snapshot.c
+ * \brief   Snapshots via MON_CMD_DUMP/MON_CMD_UNDUMP
+ *
+ * Snapshots are written and read by VICE itself, so the paths passed to
+ * snapshot_dump() and snapshot_undump() are paths on the machine running VICE.
+ *
+ * VICE snapshot files start with a header (magic, version, machine name and,
+ * since VICE 3.0, the VICE version), followed by modules, each with a header
+ * of a 16-byte name, major and minor version and a 32-bit size that includes
+ * the module header.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "log.h"
+#include "monitor.h"
+#include "vicemonapi.h"
+#include "connection.h"
+#include "memcache.h"
+
+#include "snapshot.h"
+
+
+/** \brief  Snapshot file magic
+ */
+#define SNAPSHOT_MAGIC      "VICE Snapshot File\032"
+
+/** \brief  Length of the snapshot file magic
+ */
+#define SNAPSHOT_MAGIC_LEN  19
+
+/** \brief  VICE version magic
+ */
+#define SNAPSHOT_VERSION_MAGIC      "VICE Version\032"
+
+/** \brief  Length of the VICE version magic
+ */
+#define SNAPSHOT_VERSION_MAGIC_LEN  13
+
+/** \brief  Size of the VICE version (version and SVN revision)
+ */
+#define SNAPSHOT_VERSION_SIZE       8
+
+
+/** \brief  Dump/undump request data
+ */
+typedef struct snapshot_request_s {
+    char *path;                 /**< snapshot file */
+    snapshot_done_cb callback;  /**< function to call when done */
+    void *data;                 /**< data for \a callback */
+} snapshot_request_t;
+
+
+/** \brief  Create request data
+ *
+ * \param[in]   path        snapshot file
+ * \param[in]   callback    function to call when done
+ * \param[in]   data        data for \a callback
+ *
+ * \return  request data
+ */
+static snapshot_request_t *request_new(const char *path,
+                                       snapshot_done_cb callback,
+                                       void *data)
+{
+    snapshot_request_t *req = g_malloc(sizeof *req);
+
+    req->path = g_strdup(path);
+    req->callback = callback;
+    req->data = data;
+    return req;
+}
+
+
+/** \brief  Finish request and free request data
+ *
+ * \param[in]   req     request data
+ * \param[in]   success command succeeded
+ */
+static void request_finish(snapshot_request_t *req, bool success)
+{
+    if (req->callback != NULL) {
+        req->callback(req->path, success, req->data);
+    }
+    g_free(req->path);
+    g_free(req);
+}
+
+
+/** \brief  Build body of the dump and undump commands
+ *
+ * \param[out]  body    body buffer
+ * \param[in]   prefix  bytes before the name
+ * \param[in]   plen    length of \a prefix
+ * \param[in]   path    snapshot file
+ *
+ * \return  body length, or 0 if \a path is too long
+ */
+static size_t build_body(uint8_t *body,
+                         const uint8_t *prefix,
+                         size_t plen,
+                         const char *path)
+{
+    size_t len = strlen(path);
+
+    if (len == 0 || len > 255) {
+        return 0;
+    }
+    if (plen > 0) {
+        memcpy(body, prefix, plen);
+    }
+    body[plen] = (uint8_t)len;
+    memcpy(body + plen + 1, path, len);
+    return plen + 1 + len;
+}
+
+
+/** \brief  Handler for the MON_CMD_DUMP response
+ *
+ * \param[in]   response    response
+ * \param[in]   data        request data
+ */
+static void on_dump_response(const mon_response_t *response, void *data)
+{
+    snapshot_request_t *req = data;
+
+    if (response->error_code != MON_ERR_OK) {
+        log_msg(LOG_ERR, "Failed to save snapshot '%s': error $%02x.\n",
+                req->path, response->error_code);
+        request_finish(req, false);
+        return;
+    }
+    log_msg(LOG_INFO, "Saved snapshot '%s'.\n", req->path);
+    request_finish(req, true);
+}
+
+
+/** \brief  Let VICE save a snapshot
+ *
+ * \param[in]   path        snapshot file (on the machine running VICE)
+ * \param[in]   save_roms   include ROMs
+ * \param[in]   save_disks  include disk images
+ * \param[in]   callback    function to call when done (optional)
+ * \param[in]   data        data for \a callback
+ *
+ * \return  true if the command was sent
+ */
+bool snapshot_dump(const char *path,
+                   bool save_roms,
+                   bool save_disks,
+                   snapshot_done_cb callback,
+                   void *data)
+{
+    uint8_t body[2 + 1 + 255];
+    uint8_t flags[2] = { save_roms, save_disks };
+    snapshot_request_t *req;
+    size_t len;
+
+    len = build_body(body, flags, sizeof(flags), path);
+    if (len == 0) {
+        return false;
+    }
+    req = request_new(path, callback, data);
+    if (connection_send_request_resume(MON_CMD_DUMP,
+                                       body,
+                                       len,
+                                       on_dump_response,
+                                       req) == 0) {
+        g_free(req->path);
+        g_free(req);
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Handler for the MON_CMD_UNDUMP response
+ *
+ * \param[in]   response    response
+ * \param[in]   data        request data
+ */
+static void on_undump_response(const mon_response_t *response, void *data)
+{
+    snapshot_request_t *req = data;
+
+    memcache_invalidate_all();
+    if (response->error_code != MON_ERR_OK
+            || response_get_body_len(response) < 2) {
+        log_msg(LOG_ERR, "Failed to load snapshot '%s': error $%02x.\n",
+                req->path, response->error_code);
+        request_finish(req, false);
+        return;
+    }
+    log_msg(LOG_INFO, "Loaded snapshot '%s', PC = $%04x.\n",
+            req->path, MON_GET_U16(response->body));
+    request_finish(req, true);
+}
+
+
+/** \brief  Let VICE load a snapshot
+ *
+ * \param[in]   path        snapshot file (on the machine running VICE)
+ * \param[in]   callback    function to call when done (optional)
+ * \param[in]   data        data for \a callback
+ *
+ * \return  true if the command was sent
+ */
+bool snapshot_undump(const char *path, snapshot_done_cb callback, void *data)
+{
+    uint8_t body[1 + 255];
+    snapshot_request_t *req;
+    size_t len;
+
+    len = build_body(body, NULL, 0, path);
+    if (len == 0) {
+        return false;
+    }
+    req = request_new(path, callback, data);
+    if (connection_send_request_resume(MON_CMD_UNDUMP,
+                                       body,
+                                       len,
+                                       on_undump_response,
+                                       req) == 0) {
+        g_free(req->path);
+        g_free(req);
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Copy name field of a snapshot file
+ *
+ * \param[out]  dest    destination, SNAPSHOT_NAME_LEN + 1 bytes
+ * \param[in]   src     name field, SNAPSHOT_NAME_LEN bytes
+ */
+static void copy_name(char *dest, const uint8_t *src)
+{
+    memcpy(dest, src, SNAPSHOT_NAME_LEN);
+    dest[SNAPSHOT_NAME_LEN] = '\0';
+}
+
+
+/** \brief  Index the modules of a snapshot file
+ *
+ * \param[in]   data    snapshot file contents
+ * \param[in]   len     length of \a data
+ * \param[out]  error   error (optional)
+ *
+ * \return  index, free with snapshot_index_free(), or `NULL` on error
+ */
+snapshot_index_t *snapshot_index_parse(const uint8_t *data,
+                                       size_t len,
+                                       GError **error)
+{
+    snapshot_index_t *index;
+    size_t pos;
+
+    pos = SNAPSHOT_MAGIC_LEN + 2 + SNAPSHOT_NAME_LEN;
+    if (len < pos || memcmp(data, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN) != 0) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "not a VICE snapshot file");
+        return NULL;
+    }
+
+    index = g_malloc0(sizeof *index);
+    index->major = data[SNAPSHOT_MAGIC_LEN];
+    index->minor = data[SNAPSHOT_MAGIC_LEN + 1];
+    copy_name(index->machine, data + SNAPSHOT_MAGIC_LEN + 2);
+    index->modules = g_array_new(FALSE, FALSE, sizeof(snapshot_module_t));
+
+    /* VICE 3.0+ stores its version after the machine name */
+    if (len >= pos + SNAPSHOT_VERSION_MAGIC_LEN + SNAPSHOT_VERSION_SIZE
+            && memcmp(data + pos,
+                      SNAPSHOT_VERSION_MAGIC,
+                      SNAPSHOT_VERSION_MAGIC_LEN) == 0) {
+        pos += SNAPSHOT_VERSION_MAGIC_LEN + SNAPSHOT_VERSION_SIZE;
+    }
+    index->header_size = pos;
+
+    while (pos + SNAPSHOT_MODULE_HEADER_SIZE <= len) {
+        snapshot_module_t module;
+
+        copy_name(module.name, data + pos);
+        module.major = data[pos + SNAPSHOT_NAME_LEN];
+        module.minor = data[pos + SNAPSHOT_NAME_LEN + 1];
+        module.size = MON_GET_U32(data + pos + SNAPSHOT_NAME_LEN + 2);
+        module.offset = pos;
+        if (module.size < SNAPSHOT_MODULE_HEADER_SIZE
+                || module.size > len - pos) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                        "invalid size of module '%s' at offset %zu",
+                        module.name, pos);
+            snapshot_index_free(index);
+            return NULL;
+        }
+        g_array_append_val(index->modules, module);
+        pos += module.size;
+    }
+    if (pos != len) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "truncated module at offset %zu", pos);
+        snapshot_index_free(index);
+        return NULL;
+    }
+    return index;
+}
+
+
+/** \brief  Free snapshot file index
+ *
+ * \param[in]   index   snapshot index
+ */
+void snapshot_index_free(snapshot_index_t *index)
+{
+    if (index != NULL) {
+        g_array_free(index->modules, TRUE);
+        g_free(index);
+    }
+}
+
+
+/** \brief  Find module by name
+ *
+ * \param[in]   index   snapshot index
+ * \param[in]   name    module name
+ *
+ * \return  module or `NULL` when not found
+ */
+const snapshot_module_t *snapshot_index_find(const snapshot_index_t *index,
+                                             const char *name)
+{
+    for (guint i = 0; i < index->modules->len; i++) {
+        const snapshot_module_t *module;
+
+        module = &g_array_index(index->modules, snapshot_module_t, i);
+        if (g_ascii_strcasecmp(module->name, name) == 0) {
+            return module;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,96 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   snapshot.h
+ * \brief   Snapshots via MON_CMD_DUMP/MON_CMD_UNDUMP - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#ifndef MON_SNAPSHOT_H_
+#define MON_SNAPSHOT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <glib.h>
+
+/** \brief  Maximum length of snapshot module and machine names
+ */
+#define SNAPSHOT_NAME_LEN   16
+
+/** \brief  Size of a snapshot module header
+ */
+#define SNAPSHOT_MODULE_HEADER_SIZE (SNAPSHOT_NAME_LEN + 1 + 1 + 4)
+
+
+/** \brief  Snapshot module
+ */
+typedef struct snapshot_module_s {
+    char name[SNAPSHOT_NAME_LEN + 1];   /**< module name */
+    uint8_t major;                      /**< module major version */
+    uint8_t minor;                      /**< module minor version */
+    size_t offset;                      /**< offset of header in file */
+    size_t size;                        /**< size including header */
+} snapshot_module_t;
+
+
+/** \brief  Snapshot file index
+ */
+typedef struct snapshot_index_s {
+    char machine[SNAPSHOT_NAME_LEN + 1];    /**< machine name */
+    uint8_t major;                          /**< snapshot major version */
+    uint8_t minor;                          /**< snapshot minor version */
+    size_t header_size;                     /**< offset of first module */
+    GArray *modules;                        /**< snapshot_module_t */
+} snapshot_index_t;
+
+
+/** \brief  Callback for finished dump/undump commands
+ *
+ * \param[in]   path    snapshot file
+ * \param[in]   success command succeeded
+ * \param[in]   data    data passed with the command
+ */
+typedef void (*snapshot_done_cb)(const char *path, bool success, void *data);
+
+
+bool snapshot_dump(const char *path,
+                   bool save_roms,
+                   bool save_disks,
+                   snapshot_done_cb callback,
+                   void *data);
+bool snapshot_undump(const char *path, snapshot_done_cb callback, void *data);
+
+snapshot_index_t *snapshot_index_parse(const uint8_t *data,
+                                       size_t len,
+                                       GError **error);
+void snapshot_index_free(snapshot_index_t *index);
+const snapshot_module_t *snapshot_index_find(const snapshot_index_t *index,
+                                             const char *name);
+
+#endif
@@ -0,0 +1,204 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   test-cpfile.c
+ * \brief   Tests for checkpoint import
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "vicemonapi.h"
+#include "connection.h"
+#include "checkpoint.h"
+#include "symtab.h"
+
+#include "cpfile.h"
+
+
+/** \brief  Checkpoint passed to checkpoint_set()
+ */
+typedef struct set_call_s {
+    uint8_t memspace;   /**< memspace */
+    uint16_t start;     /**< start address */
+    uint16_t end;       /**< end address */
+    uint8_t op;         /**< CPU operation(s) */
+    bool stop;          /**< stop when hit */
+} set_call_t;
+
+
+/** \brief  Checkpoints set by cpfile_import()
+ */
+static GArray *set_calls = NULL;
+
+
+/* Stubs for the functions cpfile.c uses from the rest of the program */
+
+bool checkpoint_set(uint8_t memspace,
+                    uint16_t start,
+                    uint16_t end,
+                    uint8_t op,
+                    bool stop,
+                    bool enabled,
+                    bool temporary,
+                    const char *condition)
+{
+    set_call_t call = { memspace, start, end, op, stop };
+
+    g_array_append_val(set_calls, call);
+    return true;
+}
+
+void checkpoint_foreach(checkpoint_foreach_cb callback, void *data)
+{
+}
+
+void connection_cork(void)
+{
+}
+
+void connection_uncork(void)
+{
+}
+
+bool symtab_lookup_name(const char *name, uint16_t *addr)
+{
+    return false;
+}
+
+void log_msg(log_level_t level, const char *msg, ...)
+{
+}
+
+
+/** \brief  Import \a contents from a temporary file with \a suffix
+ *
+ * \param[in]   contents    file contents
+ * \param[in]   suffix      file name suffix, selects the format
+ *
+ * \return  result of cpfile_import()
+ */
+static int import_text(const char *contents, const char *suffix)
+{
+    GError *err = NULL;
+    char *template = g_strdup_printf("test-cpfile-XXXXXX%s", suffix);
+    char *path = NULL;
+    int fd;
+    int result;
+
+    fd = g_file_open_tmp(template, &path, &err);
+    g_assert_no_error(err);
+    close(fd);
+    g_assert_true(g_file_set_contents(path, contents, -1, &err));
+    g_assert_no_error(err);
+
+    g_array_set_size(set_calls, 0);
+    result = cpfile_import(path, &err);
+    g_assert_no_error(err);
+
+    g_unlink(path);
+    g_free(path);
+    g_free(template);
+    return result;
+}
+
+
+/** \brief  Check checkpoint \a index set by the last import
+ *
+ * \param[in]   index       index
+ * \param[in]   memspace    expected memspace
+ * \param[in]   addr        expected address
+ * \param[in]   op          expected CPU operation(s)
+ */
+static void check_call(guint index, uint8_t memspace, uint16_t addr, uint8_t op)
+{
+    const set_call_t *call = &g_array_index(set_calls, set_call_t, index);
+
+    g_assert_cmpuint(call->memspace, ==, memspace);
+    g_assert_cmpuint(call->start, ==, addr);
+    g_assert_cmpuint(call->end, ==, addr);
+    g_assert_cmpuint(call->op, ==, op);
+    g_assert_true(call->stop);
+}
+
+
+/** \brief  Labels with checkpoint prefixes in a VICE label file
+ */
+static void test_vs_labels(void)
+{
+    const char *text =
+        "al C:0810 .bp_main\n"
+        "al 8:0500 .wp_buffer\n"
+        "al C:0830 .loop\n"
+        "break .loop\n";
+
+    g_assert_cmpint(import_text(text, ".vs"), ==, 3);
+    g_assert_cmpuint(set_calls->len, ==, 3);
+    check_call(0, MON_MEMSPACE_MAIN, 0x0810, MON_CPU_OP_EXEC);
+    check_call(1, MON_MEMSPACE_DRIVE8, 0x0500,
+               MON_CPU_OP_LOAD|MON_CPU_OP_STORE);
+    check_call(2, MON_MEMSPACE_MAIN, 0x0830, MON_CPU_OP_EXEC);
+}
+
+
+/** \brief  Labels with checkpoint prefixes in ca65 debug info
+ */
+static void test_dbg_labels(void)
+{
+    const char *text =
+        "sym\tid=0,name=\"bp_main\",addrsize=absolute,type=lab,val=0x810\n"
+        "sym\tid=1,name=\"wp_buffer\",addrsize=absolute,type=lab,val=0x900\n"
+        "sym\tid=2,name=\"loop\",addrsize=absolute,type=lab,val=0x830\n";
+
+    g_assert_cmpint(import_text(text, ".dbg"), ==, 2);
+    g_assert_cmpuint(set_calls->len, ==, 2);
+    check_call(0, MON_MEMSPACE_MAIN, 0x0810, MON_CPU_OP_EXEC);
+    check_call(1, MON_MEMSPACE_MAIN, 0x0900,
+               MON_CPU_OP_LOAD|MON_CPU_OP_STORE);
+}
+
+
+int main(int argc, char *argv[])
+{
+    int status;
+
+    g_test_init(&argc, &argv, NULL);
+    set_calls = g_array_new(FALSE, FALSE, sizeof(set_call_t));
+    g_test_add_func("/cpfile/vs-labels", test_vs_labels);
+    g_test_add_func("/cpfile/dbg-labels", test_dbg_labels);
+    status = g_test_run();
+    g_array_free(set_calls, TRUE);
+    return status;
+}
@@ -0,0 +1,246 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   viceinfo.c
+ * \brief   VICE version and capabilities
+ *
+ * Decodes the MON_RESPONSE_VICE_INFO sent in reply to the probe at connect
+ * time and derives a bitmap of supported commands from the version, so
+ * callers can pick a path without trying commands VICE doesn't know.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "monitor.h"
+#include "vicemonapi.h"
+
+#include "viceinfo.h"
+
+
+/** \brief  Command and the first VICE version supporting it
+ */
+typedef struct command_version_s {
+    uint8_t type;       /**< command type */
+    uint32_t version;   /**< first version, see VICEINFO_VERSION() */
+} command_version_t;
+
+
+/** \brief  Commands and the first VICE version supporting them
+ *
+ * The binary monitor appeared in VICE 3.5, MON_CMD_PALETTE_GET was added
+ * in 3.6.
+ */
+static const command_version_t command_versions[] = {
+    { MON_CMD_MEM_GET,              VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_MEM_SET,              VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_CHECKPOINT_GET,       VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_CHECKPOINT_SET,       VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_CHECKPOINT_DELETE,    VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_CHECKPOINT_LIST,      VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_CHECKPOINT_TOGGLE,    VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_CONDITION_SET,        VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_REGISTERS_GET,        VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_REGISTERS_SET,        VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_DUMP,                 VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_UNDUMP,               VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_RESOURCE_GET,         VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_RESOURCE_SET,         VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_ADVANCE_INSTRUCTIONS, VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_KEYBOARD_FEED,        VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_EXECUTE_UNTIL_RETURN, VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_PING,                 VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_BANKS_AVAILABLE,      VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_REGISTERS_AVAILABLE,  VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_DISPLAY_GET,          VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_VICE_INFO,            VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_PALETTE_GET,          VICEINFO_VERSION(3, 6, 0, 0) },
+    { MON_CMD_EXIT,                 VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_QUIT,                 VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_RESET,                VICEINFO_VERSION(3, 5, 0, 0) },
+    { MON_CMD_AUTOSTART,            VICEINFO_VERSION(3, 5, 0, 0) }
+};
+
+
+/** \brief  Set bit of \a type in the command bitmap
+ *
+ * \param[in,out]   info    VICE info
+ * \param[in]       type    command type
+ */
+static void set_command(viceinfo_t *info, uint8_t type)
+{
+    info->commands[type >> 6] |= (uint64_t)1 << (type & 63);
+}
+
+
+/** \brief  Reset to the unknown state
+ *
+ * All commands are assumed to work until the probe is answered.
+ *
+ * \param[out]  info    VICE info
+ */
+void viceinfo_reset(viceinfo_t *info)
+{
+    memset(info, 0, sizeof(*info));
+    info->state = VICEINFO_UNKNOWN;
+    info->mem_get_max = VICEINFO_MEM_GET_SAFE;
+}
+
+
+/** \brief  Decode MON_RESPONSE_VICE_INFO body
+ *
+ * The body holds the length of the version followed by the version bytes
+ * (major, minor, build, patch) and the length of the SVN revision followed
+ * by the revision as a little endian value.
+ *
+ * \param[out]  info        VICE info
+ * \param[in]   api_version API version of the response
+ * \param[in]   body        response body
+ * \param[in]   len         length of \a body
+ *
+ * \return  false if \a body is invalid, \a info is unchanged then
+ */
+bool viceinfo_decode(viceinfo_t *info,
+                     uint8_t api_version,
+                     const uint8_t *body,
+                     size_t len)
+{
+    uint8_t version[4] = { 0 };
+    uint32_t revision = 0;
+    size_t version_len;
+    size_t revision_len;
+
+    if (len < 1 || len < 1 + (size_t)body[0] + 1) {
+        return false;
+    }
+    version_len = body[0];
+    revision_len = body[1 + version_len];
+    if (len < 2 + version_len + revision_len) {
+        return false;
+    }
+    memcpy(version, body + 1, MIN(version_len, sizeof(version)));
+    for (size_t i = 0; i < MIN(revision_len, sizeof(revision)); i++) {
+        revision |= (uint32_t)body[2 + version_len + i] << (i * 8);
+    }
+
+    viceinfo_reset(info);
+    info->state = VICEINFO_KNOWN;
+    info->version = VICEINFO_VERSION(version[0], version[1],
+                                     version[2], version[3]);
+    info->svn_revision = revision;
+    info->api_version = api_version;
+    for (size_t i = 0; i < G_N_ELEMENTS(command_versions); i++) {
+        if (info->version >= command_versions[i].version) {
+            set_command(info, command_versions[i].type);
+        }
+    }
+    /* VICE_INFO itself proves the binary monitor is there */
+    set_command(info, MON_CMD_VICE_INFO);
+    info->mem_get_max = VICEINFO_MEM_GET_LARGE;
+    return true;
+}
+
+
+/** \brief  Set capabilities of a VICE that doesn't know MON_CMD_VICE_INFO
+ *
+ * Development builds predating the command: the commands of the first
+ * release of the binary monitor are assumed to work, except for
+ * MON_CMD_VICE_INFO and newer ones.
+ *
+ * \param[out]  info        VICE info
+ * \param[in]   api_version API version of the error response
+ */
+void viceinfo_set_legacy(viceinfo_t *info, uint8_t api_version)
+{
+    viceinfo_reset(info);
+    info->state = VICEINFO_LEGACY;
+    info->api_version = api_version;
+    for (size_t i = 0; i < G_N_ELEMENTS(command_versions); i++) {
+        if (command_versions[i].type != MON_CMD_VICE_INFO
+                && command_versions[i].version
+                   <= VICEINFO_VERSION(3, 5, 0, 0)) {
+            set_command(info, command_versions[i].type);
+        }
+    }
+}
+
+
+/** \brief  Check if VICE supports \a command
+ *
+ * \param[in]   info    VICE info
+ * \param[in]   command command type
+ *
+ * \return  true if supported, or when VICE hasn't been probed yet
+ */
+bool viceinfo_supports(const viceinfo_t *info, uint8_t command)
+{
+    if (info->state == VICEINFO_UNKNOWN) {
+        return true;
+    }
+    return (info->commands[command >> 6] >> (command & 63)) & 1;
+}
+
+
+/** \brief  Describe VICE version and API version
+ *
+ * \param[in]   info    VICE info
+ *
+ * \return  description, free with g_free()
+ */
+char *viceinfo_to_string(const viceinfo_t *info)
+{
+    switch (info->state) {
+        case VICEINFO_KNOWN:
+            if (info->svn_revision != 0) {
+                return g_strdup_printf("VICE %u.%u.%u.%u r%u, API %u",
+                                       info->version >> 24,
+                                       (info->version >> 16) & 0xff,
+                                       (info->version >> 8) & 0xff,
+                                       info->version & 0xff,
+                                       info->svn_revision,
+                                       info->api_version);
+            }
+            return g_strdup_printf("VICE %u.%u.%u.%u, API %u",
+                                   info->version >> 24,
+                                   (info->version >> 16) & 0xff,
+                                   (info->version >> 8) & 0xff,
+                                   info->version & 0xff,
+                                   info->api_version);
+        case VICEINFO_LEGACY:
+            return g_strdup_printf("VICE (version unknown), API %u",
+                                   info->api_version);
+        default:
+            return g_strdup("VICE (not probed)");
+    }
+}
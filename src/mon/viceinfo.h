@@ -0,0 +1,91 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   viceinfo.h
+ * \brief   VICE version and capabilities - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+
+#ifndef MON_VICEINFO_H_
+#define MON_VICEINFO_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/** \brief  Combine VICE version numbers for comparisons
+ */
+#define VICEINFO_VERSION(major, minor, build, patch) \
+    (((uint32_t)(major) << 24) | ((uint32_t)(minor) << 16) | \
+     ((uint32_t)(build) << 8) | (uint32_t)(patch))
+
+
+/** \brief  Bytes per MON_CMD_MEM_GET for a VICE that isn't identified yet
+ */
+#define VICEINFO_MEM_GET_SAFE   0x4000
+
+/** \brief  Bytes per MON_CMD_MEM_GET for a VICE that identified itself
+ *
+ * The largest multiple of 256 whose length fits in the 16-bit length of
+ * MON_RESPONSE_MEM_GET.
+ */
+#define VICEINFO_MEM_GET_LARGE  0xff00
+
+
+/** \brief  Probe state
+ */
+typedef enum viceinfo_state_e {
+    VICEINFO_UNKNOWN,   /**< not probed yet, assume everything works */
+    VICEINFO_LEGACY,    /**< MON_CMD_VICE_INFO not supported */
+    VICEINFO_KNOWN      /**< version decoded from MON_CMD_VICE_INFO */
+} viceinfo_state_t;
+
+
+/** \brief  VICE version and capabilities of a connection
+ */
+typedef struct viceinfo_s {
+    viceinfo_state_t state;     /**< probe state */
+    uint32_t version;           /**< version, see VICEINFO_VERSION() */
+    uint32_t svn_revision;      /**< SVN revision, 0 for release builds */
+    uint8_t api_version;        /**< binary monitor API version */
+    uint64_t commands[4];       /**< bitmap of supported command types */
+    size_t mem_get_max;         /**< bytes per MON_CMD_MEM_GET */
+} viceinfo_t;
+
+
+void viceinfo_reset(viceinfo_t *info);
+bool viceinfo_decode(viceinfo_t *info,
+                     uint8_t api_version,
+                     const uint8_t *body,
+                     size_t len);
+void viceinfo_set_legacy(viceinfo_t *info, uint8_t api_version);
+bool viceinfo_supports(const viceinfo_t *info, uint8_t command);
+char *viceinfo_to_string(const viceinfo_t *info);
+
+#endif
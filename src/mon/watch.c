@@ -0,0 +1,1042 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   watch.c
+ * \brief   Watch expressions
+ *
+ * Watch expressions are compiled once into a small stack-based bytecode.
+ *
+ * Syntax:
+ *   - numbers: `$fb` (hex), `%1010` (binary) or `251` (decimal)
+ *   - `.label`: address of a label in the symbol table
+ *   - register names as reported by VICE: `a`, `x`, `y`, `sp`, `pc` etc.
+ *   - `byte(expr)`/`b(expr)` and `word(expr)`/`w(expr)`: memory contents
+ *   - `(expr),y` and `(expr,x)`: byte at a 6502 indirect address
+ *   - operators, from low to high precedence: `|`, `^`, `&`, `+ -`, `*`,
+ *     unary `-`
+ *
+ * A watch is only evaluated again when a memory page it read during its last
+ * evaluation was invalidated in the memory cache, or when it uses registers
+ * and the registers were invalidated. Evaluation uses the memory cache;
+ * missing pages and registers are fetched and the evaluation is repeated,
+ * once for each level of indirection.
+ *
+ * Watches are updated when the emulation stops. They are evaluated against
+ * the active session, switching sessions evaluates all watches again.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "log.h"
+#include "vicemonapi.h"
+#include "connection.h"
+#include "memcache.h"
+#include "registers.h"
+#include "symtab.h"
+#include "session.h"
+
+#include "watch.h"
+
+
+/** \brief  Maximum depth of the evaluation stack
+ */
+#define WATCH_STACK_MAX     16
+
+/** \brief  Maximum number of fetch rounds per update
+ */
+#define WATCH_MAX_ROUNDS    8
+
+
+/** \brief  Bytecode instructions
+ */
+typedef enum watch_op_e {
+    OP_END,     /**< end of code */
+    OP_CONST,   /**< push 16-bit operand */
+    OP_REG,     /**< push register, 8-bit operand is the register ID */
+    OP_PEEK8,   /**< replace address with byte at address */
+    OP_PEEK16,  /**< replace address with word at address */
+    OP_PEEKZP,  /**< replace zero page address with word at address, the
+                     high byte wraps around to $00 like on the 6502 */
+    OP_ADD,     /**< add */
+    OP_SUB,     /**< subtract */
+    OP_MUL,     /**< multiply */
+    OP_AND,     /**< bitwise and */
+    OP_OR,      /**< bitwise or */
+    OP_XOR,     /**< bitwise exclusive or */
+    OP_NEG      /**< negate */
+} watch_op_t;
+
+
+/** \brief  Evaluation result
+ */
+typedef enum eval_result_e {
+    EVAL_OK,    /**< evaluated */
+    EVAL_NEED,  /**< memory or registers missing */
+    EVAL_ERROR  /**< invalid code */
+} eval_result_t;
+
+
+/** \brief  Compiler state
+ */
+typedef struct compiler_s {
+    const char *text;       /**< full text */
+    const char *pos;        /**< current position */
+    GByteArray *code;       /**< generated code */
+    int depth;              /**< current stack depth */
+    int max_depth;          /**< maximum stack depth */
+    bool uses_registers;    /**< code reads registers */
+    GError **error;         /**< error */
+    bool failed;            /**< compilation failed */
+} compiler_t;
+
+
+/** \brief  Listener
+ */
+typedef struct listener_s {
+    watch_listener_cb callback; /**< function to call */
+    void *data;                 /**< data for \a callback */
+} listener_t;
+
+
+/** \brief  Watches, in order of creation
+ */
+static GPtrArray *watches = NULL;
+
+/** \brief  ID for the next watch
+ */
+static uint32_t next_id = 1;
+
+/** \brief  List of listeners
+ */
+static GSList *listeners = NULL;
+
+/** \brief  Waiting for memory or registers
+ */
+static bool updating = false;
+
+/** \brief  Number of fetches in progress, plus one while sending
+ */
+static guint outstanding = 0;
+
+/** \brief  A fetch failed
+ */
+static bool fetch_failed = false;
+
+/** \brief  Number of fetch rounds of the current update
+ */
+static int rounds = 0;
+
+
+static void parse_expr(compiler_t *c);
+
+
+/** \brief  Set compile error
+ *
+ * \param[in,out]   c       compiler
+ * \param[in]       message message
+ */
+static void compile_error(compiler_t *c, const char *message)
+{
+    if (!c->failed) {
+        g_set_error(c->error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                    "%s at column %d", message, (int)(c->pos - c->text) + 1);
+        c->failed = true;
+    }
+}
+
+
+/** \brief  Skip whitespace
+ *
+ * \param[in,out]   c   compiler
+ */
+static void skip_space(compiler_t *c)
+{
+    while (g_ascii_isspace(*c->pos)) {
+        c->pos++;
+    }
+}
+
+
+/** \brief  Consume \a ch if it is the next character
+ *
+ * \param[in,out]   c   compiler
+ * \param[in]       ch  character
+ *
+ * \return  true if consumed
+ */
+static bool accept(compiler_t *c, char ch)
+{
+    skip_space(c);
+    if (*c->pos == ch) {
+        c->pos++;
+        return true;
+    }
+    return false;
+}
+
+
+/** \brief  Consume \a ch or fail
+ *
+ * \param[in,out]   c   compiler
+ * \param[in]       ch  character
+ */
+static void expect(compiler_t *c, char ch)
+{
+    if (!accept(c, ch)) {
+        char message[32];
+
+        g_snprintf(message, sizeof(message), "expected '%c'", ch);
+        compile_error(c, message);
+    }
+}
+
+
+/** \brief  Emit instruction
+ *
+ * \param[in,out]   c       compiler
+ * \param[in]       op      instruction
+ * \param[in]       effect  change of the stack depth
+ */
+static void emit(compiler_t *c, watch_op_t op, int effect)
+{
+    uint8_t byte = (uint8_t)op;
+
+    g_byte_array_append(c->code, &byte, 1);
+    c->depth += effect;
+    if (c->depth > c->max_depth) {
+        c->max_depth = c->depth;
+    }
+}
+
+
+/** \brief  Emit OP_CONST
+ *
+ * \param[in,out]   c       compiler
+ * \param[in]       value   value
+ */
+static void emit_const(compiler_t *c, uint16_t value)
+{
+    uint8_t operand[2] = { (uint8_t)(value & 0xff), (uint8_t)(value >> 8) };
+
+    emit(c, OP_CONST, 1);
+    g_byte_array_append(c->code, operand, 2);
+}
+
+
+/** \brief  Emit OP_REG for register \a name
+ *
+ * \param[in,out]   c       compiler
+ * \param[in]       name    register name
+ */
+static void emit_register(compiler_t *c, const char *name)
+{
+    uint8_t id;
+
+    if (!registers_lookup_name(name, &id)) {
+        compile_error(c, "unknown register");
+        return;
+    }
+    emit(c, OP_REG, 1);
+    g_byte_array_append(c->code, &id, 1);
+    c->uses_registers = true;
+}
+
+
+/** \brief  Parse identifier
+ *
+ * \param[in,out]   c   compiler
+ *
+ * \return  identifier, free with g_free()
+ */
+static char *parse_ident(compiler_t *c)
+{
+    const char *start = c->pos;
+
+    while (g_ascii_isalnum(*c->pos) || *c->pos == '_') {
+        c->pos++;
+    }
+    return g_strndup(start, (gsize)(c->pos - start));
+}
+
+
+/** \brief  Parse number
+ *
+ * \param[in,out]   c   compiler
+ */
+static void parse_number(compiler_t *c)
+{
+    const char *start = c->pos;
+    guint base = 10;
+    char *endptr;
+    guint64 value;
+
+    if (*c->pos == '$') {
+        base = 16;
+        c->pos++;
+    } else if (*c->pos == '%') {
+        base = 2;
+        c->pos++;
+    }
+    value = g_ascii_strtoull(c->pos, &endptr, base);
+    if (endptr == c->pos || value > 0xffff) {
+        c->pos = start;
+        compile_error(c, "invalid number");
+        return;
+    }
+    c->pos = endptr;
+    emit_const(c, (uint16_t)value);
+}
+
+
+/** \brief  Parse label reference
+ *
+ * \param[in,out]   c   compiler
+ */
+static void parse_label(compiler_t *c)
+{
+    char *name;
+    uint16_t addr;
+
+    c->pos++;   /* skip '.' */
+    name = parse_ident(c);
+    if (!symtab_lookup_name(name, &addr)) {
+        compile_error(c, "unknown label");
+    } else {
+        emit_const(c, addr);
+    }
+    g_free(name);
+}
+
+
+/** \brief  Parse parenthesized expression or 6502 indirect address
+ *
+ * \param[in,out]   c   compiler
+ */
+static void parse_parens(compiler_t *c)
+{
+    parse_expr(c);
+    if (accept(c, ',')) {
+        /* (zp,x) */
+        skip_space(c);
+        if (g_ascii_tolower(*c->pos) != 'x') {
+            compile_error(c, "expected 'x'");
+            return;
+        }
+        c->pos++;
+        expect(c, ')');
+        emit_register(c, "x");
+        emit(c, OP_ADD, -1);
+        emit_const(c, 0xff);
+        emit(c, OP_AND, -1);
+        emit(c, OP_PEEKZP, 0);
+        emit(c, OP_PEEK8, 0);
+        return;
+    }
+    expect(c, ')');
+
+    if (accept(c, ',')) {
+        /* (zp),y */
+        skip_space(c);
+        if (g_ascii_tolower(*c->pos) != 'y') {
+            compile_error(c, "expected 'y'");
+            return;
+        }
+        c->pos++;
+        emit(c, OP_PEEKZP, 0);
+        emit_register(c, "y");
+        emit(c, OP_ADD, -1);
+        emit(c, OP_PEEK8, 0);
+    }
+}
+
+
+/** \brief  Parse primary expression
+ *
+ * \param[in,out]   c   compiler
+ */
+static void parse_primary(compiler_t *c)
+{
+    skip_space(c);
+    if (*c->pos == '$' || *c->pos == '%' || g_ascii_isdigit(*c->pos)) {
+        parse_number(c);
+    } else if (*c->pos == '.') {
+        parse_label(c);
+    } else if (accept(c, '(')) {
+        parse_parens(c);
+    } else if (g_ascii_isalpha(*c->pos)) {
+        char *name = parse_ident(c);
+
+        if (accept(c, '(')) {
+            watch_op_t op = OP_END;
+
+            if (strcmp(name, "byte") == 0 || strcmp(name, "b") == 0) {
+                op = OP_PEEK8;
+            } else if (strcmp(name, "word") == 0 || strcmp(name, "w") == 0) {
+                op = OP_PEEK16;
+            } else {
+                compile_error(c, "unknown function");
+            }
+            parse_expr(c);
+            expect(c, ')');
+            if (op != OP_END) {
+                emit(c, op, 0);
+            }
+        } else {
+            emit_register(c, name);
+        }
+        g_free(name);
+    } else {
+        compile_error(c, "expected value");
+    }
+}
+
+
+/** \brief  Parse unary expression
+ *
+ * \param[in,out]   c   compiler
+ */
+static void parse_unary(compiler_t *c)
+{
+    if (accept(c, '-')) {
+        parse_unary(c);
+        emit(c, OP_NEG, 0);
+    } else {
+        parse_primary(c);
+    }
+}
+
+
+/** \brief  Parse multiplication
+ *
+ * \param[in,out]   c   compiler
+ */
+static void parse_mul(compiler_t *c)
+{
+    parse_unary(c);
+    while (!c->failed && accept(c, '*')) {
+        parse_unary(c);
+        emit(c, OP_MUL, -1);
+    }
+}
+
+
+/** \brief  Parse addition and subtraction
+ *
+ * \param[in,out]   c   compiler
+ */
+static void parse_add(compiler_t *c)
+{
+    parse_mul(c);
+    while (!c->failed) {
+        if (accept(c, '+')) {
+            parse_mul(c);
+            emit(c, OP_ADD, -1);
+        } else if (accept(c, '-')) {
+            parse_mul(c);
+            emit(c, OP_SUB, -1);
+        } else {
+            break;
+        }
+    }
+}
+
+
+/** \brief  Parse binary operator level
+ *
+ * \param[in,out]   c       compiler
+ * \param[in]       ch      operator character
+ * \param[in]       op      instruction
+ * \param[in]       operand parser for the operands
+ */
+static void parse_binary(compiler_t *c,
+                         char ch,
+                         watch_op_t op,
+                         void (*operand)(compiler_t *))
+{
+    operand(c);
+    while (!c->failed && accept(c, ch)) {
+        operand(c);
+        emit(c, op, -1);
+    }
+}
+
+
+/** \brief  Parse bitwise and
+ *
+ * \param[in,out]   c   compiler
+ */
+static void parse_and(compiler_t *c)
+{
+    parse_binary(c, '&', OP_AND, parse_add);
+}
+
+
+/** \brief  Parse bitwise exclusive or
+ *
+ * \param[in,out]   c   compiler
+ */
+static void parse_xor(compiler_t *c)
+{
+    parse_binary(c, '^', OP_XOR, parse_and);
+}
+
+
+/** \brief  Parse expression
+ *
+ * \param[in,out]   c   compiler
+ */
+static void parse_expr(compiler_t *c)
+{
+    parse_binary(c, '|', OP_OR, parse_xor);
+}
+
+
+/** \brief  Compile watch expression
+ *
+ * \param[in]   text            expression
+ * \param[out]  code            bytecode
+ * \param[out]  uses_registers  expression reads registers
+ * \param[out]  error           error (optional)
+ *
+ * \return  false on error
+ */
+bool watch_compile(const char *text,
+                   GByteArray *code,
+                   bool *uses_registers,
+                   GError **error)
+{
+    compiler_t c;
+
+    memset(&c, 0, sizeof c);
+    c.text = text;
+    c.pos = text;
+    c.code = code;
+    c.error = error;
+
+    parse_expr(&c);
+    skip_space(&c);
+    if (*c.pos != '\0') {
+        compile_error(&c, "unexpected input");
+    }
+    if (!c.failed && c.max_depth > WATCH_STACK_MAX) {
+        compile_error(&c, "expression too complex");
+    }
+    if (c.failed) {
+        return false;
+    }
+    emit(&c, OP_END, 0);
+    *uses_registers = c.uses_registers;
+    return true;
+}
+
+
+/** \brief  Read byte from the memory cache
+ *
+ * \param[in,out]   watch   watch, dependency is recorded
+ * \param[in]       addr    address
+ * \param[out]      need    missing pages
+ * \param[out]      value   byte
+ *
+ * \return  false if the page isn't valid
+ */
+static bool peek(watch_t *watch, uint16_t addr, uint64_t *need, int32_t *value)
+{
+    int page = addr / MEMCACHE_PAGE_SIZE;
+
+    watch->deps[page >> 6] |= (uint64_t)1 << (page & 63);
+    if (!memcache_is_valid(MON_MEMSPACE_MAIN, 0, addr, addr)) {
+        need[page >> 6] |= (uint64_t)1 << (page & 63);
+        return false;
+    }
+    *value = memcache_get(MON_MEMSPACE_MAIN, 0)[addr];
+    return true;
+}
+
+
+/** \brief  Evaluate watch
+ *
+ * \param[in,out]   watch       watch
+ * \param[out]      need        missing pages
+ * \param[out]      need_regs   registers missing
+ *
+ * \return  result
+ */
+static eval_result_t evaluate(watch_t *watch, uint64_t *need, bool *need_regs)
+{
+    int32_t stack[WATCH_STACK_MAX];
+    int sp = 0;
+    const uint8_t *pc = watch->code->data;
+
+    memset(watch->deps, 0, sizeof(watch->deps));
+    for (;;) {
+        int32_t lo;
+        int32_t hi;
+        uint16_t reg;
+
+        switch (*pc++) {
+            case OP_END:
+                if (sp != 1) {
+                    return EVAL_ERROR;
+                }
+                watch->value = stack[0];
+                return EVAL_OK;
+            case OP_CONST:
+                stack[sp++] = pc[0] | (pc[1] << 8);
+                pc += 2;
+                break;
+            case OP_REG:
+                if (!registers_get(*pc++, &reg)) {
+                    *need_regs = true;
+                    return EVAL_NEED;
+                }
+                stack[sp++] = reg;
+                break;
+            case OP_PEEK8:
+                if (!peek(watch, (uint16_t)stack[sp - 1], need, &lo)) {
+                    return EVAL_NEED;
+                }
+                stack[sp - 1] = lo;
+                break;
+            case OP_PEEK16:
+                if (!peek(watch, (uint16_t)stack[sp - 1], need, &lo)
+                        || !peek(watch, (uint16_t)(stack[sp - 1] + 1), need, &hi)) {
+                    return EVAL_NEED;
+                }
+                stack[sp - 1] = lo | (hi << 8);
+                break;
+            case OP_PEEKZP:
+                if (!peek(watch, (uint16_t)(stack[sp - 1] & 0xff), need, &lo)
+                        || !peek(watch, (uint16_t)((stack[sp - 1] + 1) & 0xff),
+                                 need, &hi)) {
+                    return EVAL_NEED;
+                }
+                stack[sp - 1] = lo | (hi << 8);
+                break;
+            case OP_ADD:
+                sp--;
+                stack[sp - 1] += stack[sp];
+                break;
+            case OP_SUB:
+                sp--;
+                stack[sp - 1] -= stack[sp];
+                break;
+            case OP_MUL:
+                sp--;
+                stack[sp - 1] *= stack[sp];
+                break;
+            case OP_AND:
+                sp--;
+                stack[sp - 1] &= stack[sp];
+                break;
+            case OP_OR:
+                sp--;
+                stack[sp - 1] |= stack[sp];
+                break;
+            case OP_XOR:
+                sp--;
+                stack[sp - 1] ^= stack[sp];
+                break;
+            case OP_NEG:
+                stack[sp - 1] = -stack[sp - 1];
+                break;
+            default:
+                return EVAL_ERROR;
+        }
+    }
+}
+
+
+/** \brief  Notify listeners of a change
+ */
+static void notify_listeners(void)
+{
+    GSList *node = listeners;
+
+    while (node != NULL) {
+        listener_t *listener = node->data;
+
+        node = node->next;
+        listener->callback(listener->data);
+    }
+}
+
+
+/** \brief  Check if the current session is the session watches use
+ *
+ * \return  true if current
+ */
+static bool is_watched_session(void)
+{
+    return session_current() == session_active();
+}
+
+
+/** \brief  Release a fetch, update again when all are done
+ *
+ * The active session may have changed while fetching, so the update is
+ * done for the active session.
+ */
+static void fetch_release(void)
+{
+    if (--outstanding > 0) {
+        return;
+    }
+    updating = false;
+    if (fetch_failed && is_watched_session()) {
+        rounds = 0;
+        return;
+    }
+    session_push(session_active());
+    watch_update();
+    session_pop();
+}
+
+
+/** \brief  Callback for fetched memory and registers
+ *
+ * \param[in]   success fetch succeeded
+ * \param[in]   data    unused
+ */
+static void on_fetched(bool success, void *data)
+{
+    if (!success) {
+        fetch_failed = true;
+    }
+    fetch_release();
+}
+
+
+/** \brief  Evaluate dirty watches
+ *
+ * Missing memory and registers are fetched, after which the watches are
+ * evaluated again. Nothing is done while the emulation is running.
+ */
+void watch_update(void)
+{
+    uint64_t need[MEMCACHE_BITMAP_WORDS] = { 0 };
+    bool need_regs = false;
+    bool pending = false;
+    bool changed = false;
+
+    if (watches == NULL || updating || connection_vice_running()) {
+        return;
+    }
+
+    for (guint i = 0; i < watches->len; i++) {
+        watch_t *watch = g_ptr_array_index(watches, i);
+        int32_t old = watch->value;
+
+        if (!watch->dirty) {
+            continue;
+        }
+        switch (evaluate(watch, need, &need_regs)) {
+            case EVAL_OK:
+                changed |= !watch->valid || watch->value != old;
+                watch->dirty = false;
+                watch->valid = true;
+                break;
+            case EVAL_NEED:
+                pending = true;
+                break;
+            default:
+                watch->dirty = false;
+                watch->valid = false;
+                changed = true;
+                break;
+        }
+    }
+    if (changed) {
+        notify_listeners();
+    }
+    if (!pending) {
+        rounds = 0;
+        return;
+    }
+    if (++rounds > WATCH_MAX_ROUNDS) {
+        log_msg(LOG_WARN, "Watches: too many levels of indirection.\n");
+        rounds = 0;
+        return;
+    }
+
+    updating = true;
+    fetch_failed = false;
+    outstanding = 1;
+    connection_cork();
+    if (need_regs) {
+        outstanding++;
+        if (!registers_fetch(on_fetched, NULL)) {
+            outstanding--;
+            fetch_failed = true;
+        }
+    }
+    outstanding++;
+    if (!memcache_fetch_pages(MON_MEMSPACE_MAIN, 0, need, on_fetched, NULL)) {
+        outstanding--;
+        fetch_failed = true;
+    }
+    connection_uncork();
+    fetch_release();
+}
+
+
+/** \brief  Handler for invalidated memory pages
+ *
+ * \param[in]   memspace    memspace
+ * \param[in]   bank        bank
+ * \param[in]   first_page  first page
+ * \param[in]   last_page   last page (inclusive)
+ * \param[in]   data        unused
+ */
+static void on_pages_invalidated(uint8_t memspace,
+                                 uint16_t bank,
+                                 int first_page,
+                                 int last_page,
+                                 void *data)
+{
+    if (memspace != MON_MEMSPACE_MAIN || bank != 0 || !is_watched_session()) {
+        return;
+    }
+    for (guint i = 0; i < watches->len; i++) {
+        watch_t *watch = g_ptr_array_index(watches, i);
+
+        for (int page = first_page; page <= last_page; page++) {
+            if ((watch->deps[page >> 6] >> (page & 63)) & 1) {
+                watch->dirty = true;
+                break;
+            }
+        }
+    }
+}
+
+
+/** \brief  Handler for register cache changes
+ *
+ * \param[in]   data    unused
+ */
+static void on_registers_changed(void *data)
+{
+    if (!is_watched_session() || registers_valid()) {
+        return;
+    }
+    for (guint i = 0; i < watches->len; i++) {
+        watch_t *watch = g_ptr_array_index(watches, i);
+
+        if (watch->uses_registers) {
+            watch->dirty = true;
+        }
+    }
+}
+
+
+/** \brief  Handler for MON_RESPONSE_STOPPED events
+ *
+ * \param[in]   response    response
+ * \param[in]   data        unused
+ */
+static void on_stopped_event(const mon_response_t *response, void *data)
+{
+    if (is_watched_session()) {
+        watch_update();
+    }
+}
+
+
+/** \brief  Free watch
+ *
+ * \param[in]   data    watch
+ */
+static void watch_free(gpointer data)
+{
+    watch_t *watch = data;
+
+    g_free(watch->text);
+    g_byte_array_unref(watch->code);
+    g_free(watch);
+}
+
+
+/** \brief  Initialize watches
+ *
+ * Must be called after memcache_init() and registers_init().
+ */
+void watch_init(void)
+{
+    watches = g_ptr_array_new_with_free_func(watch_free);
+    memcache_add_listener(on_pages_invalidated, NULL);
+    registers_add_listener(on_registers_changed, NULL);
+    connection_add_event_handler(MON_RESPONSE_STOPPED, on_stopped_event, NULL);
+}
+
+
+/** \brief  Free resources used by the watches
+ */
+void watch_exit(void)
+{
+    connection_remove_event_handler(MON_RESPONSE_STOPPED,
+                                    on_stopped_event,
+                                    NULL);
+    memcache_remove_listener(on_pages_invalidated, NULL);
+    registers_remove_listener(on_registers_changed, NULL);
+    if (watches != NULL) {
+        g_ptr_array_free(watches, TRUE);
+        watches = NULL;
+    }
+    g_slist_free_full(listeners, g_free);
+    listeners = NULL;
+}
+
+
+/** \brief  Add watch
+ *
+ * \param[in]   text    expression
+ * \param[out]  error   error (optional)
+ *
+ * \return  watch ID, or 0 on error
+ */
+uint32_t watch_add(const char *text, GError **error)
+{
+    watch_t *watch = g_malloc0(sizeof *watch);
+
+    watch->code = g_byte_array_new();
+    if (!watch_compile(text, watch->code, &watch->uses_registers, error)) {
+        g_byte_array_unref(watch->code);
+        g_free(watch);
+        return 0;
+    }
+    watch->id = next_id++;
+    watch->text = g_strdup(text);
+    watch->dirty = true;
+    g_ptr_array_add(watches, watch);
+    notify_listeners();
+    watch_update();
+    return watch->id;
+}
+
+
+/** \brief  Remove watch
+ *
+ * \param[in]   id  watch ID
+ *
+ * \return  false if not found
+ */
+bool watch_remove(uint32_t id)
+{
+    for (guint i = 0; i < watches->len; i++) {
+        watch_t *watch = g_ptr_array_index(watches, i);
+
+        if (watch->id == id) {
+            g_ptr_array_remove_index(watches, i);
+            notify_listeners();
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/** \brief  Evaluate all watches again for a newly activated session
+ *
+ * Call after session_set_active().
+ */
+void watch_session_changed(void)
+{
+    for (guint i = 0; watches != NULL && i < watches->len; i++) {
+        watch_t *watch = g_ptr_array_index(watches, i);
+
+        watch->dirty = true;
+    }
+    rounds = 0;
+    watch_update();
+}
+
+
+/** \brief  Get number of watches
+ *
+ * \return  number of watches
+ */
+size_t watch_count(void)
+{
+    return watches != NULL ? watches->len : 0;
+}
+
+
+/** \brief  Call \a callback for each watch, in order of creation
+ *
+ * \param[in]   callback    function to call
+ * \param[in]   data        data for \a callback
+ */
+void watch_foreach(watch_foreach_cb callback, void *data)
+{
+    for (guint i = 0; watches != NULL && i < watches->len; i++) {
+        callback(g_ptr_array_index(watches, i), data);
+    }
+}
+
+
+/** \brief  Register \a callback to be called when watches change
+ *
+ * \param[in]   callback    function to call
+ * \param[in]   data        data for \a callback
+ */
+void watch_add_listener(watch_listener_cb callback, void *data)
+{
+    listener_t *listener = g_malloc(sizeof *listener);
+
+    listener->callback = callback;
+    listener->data = data;
+    listeners = g_slist_append(listeners, listener);
+}
+
+
+/** \brief  Unregister listener
+ *
+ * \param[in]   callback    function registered
+ * \param[in]   data        data registered
+ */
+void watch_remove_listener(watch_listener_cb callback, void *data)
+{
+    GSList *node;
+
+    for (node = listeners; node != NULL; node = node->next) {
+        listener_t *listener = node->data;
+
+        if (listener->callback == callback && listener->data == data) {
+            listeners = g_slist_delete_link(listeners, node);
+            g_free(listener);
+            return;
+        }
+    }
+}
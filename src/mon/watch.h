@@ -0,0 +1,91 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   watch.h
+ * \brief   Watch expressions - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#ifndef MON_WATCH_H_
+#define MON_WATCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <glib.h>
+
+#include "memcache.h"
+
+
+/** \brief  Watch expression
+ */
+typedef struct watch_s {
+    uint32_t id;                            /**< watch ID */
+    char *text;                             /**< expression text */
+    GByteArray *code;                       /**< compiled expression */
+    bool uses_registers;                    /**< expression reads registers */
+    uint64_t deps[MEMCACHE_BITMAP_WORDS];   /**< pages read by last eval */
+    bool dirty;                             /**< needs to be evaluated */
+    bool valid;                             /**< \a value is current */
+    int32_t value;                          /**< value */
+} watch_t;
+
+
+/** \brief  Callback for watch changes
+ *
+ * \param[in]   data    data passed to watch_add_listener()
+ */
+typedef void (*watch_listener_cb)(void *data);
+
+/** \brief  Callback for watch_foreach()
+ *
+ * \param[in]   watch   watch
+ * \param[in]   data    data passed to watch_foreach()
+ */
+typedef void (*watch_foreach_cb)(const watch_t *watch, void *data);
+
+
+void watch_init(void);
+void watch_exit(void);
+
+uint32_t watch_add(const char *text, GError **error);
+bool watch_remove(uint32_t id);
+size_t watch_count(void);
+void watch_foreach(watch_foreach_cb callback, void *data);
+void watch_update(void);
+void watch_session_changed(void);
+
+bool watch_compile(const char *text,
+                   GByteArray *code,
+                   bool *uses_registers,
+                   GError **error);
+
+void watch_add_listener(watch_listener_cb callback, void *data);
+void watch_remove_listener(watch_listener_cb callback, void *data);
+
+#endif
@@ -0,0 +1,539 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   workspace.c
+ * \brief   Session workspace cache files
+ *
+ * On exit the memory mirrors and the symbol index of each session are
+ * written to a file in the settings dir, laid out so that it can be used
+ * directly when mapped into memory:
+ *
+ * \code
+ * header       "VMONWS", version, mirror count, symbol index size
+ * mirror 0     memspace, bank, valid page bitmap, page checksums, 64KiB
+ * ...
+ * symbols      index written by symtab_export()
+ * \endcode
+ *
+ * On the next attach a few of the valid pages, spread over all mirrors,
+ * are fetched from VICE and compared with the stored checksums. Only when
+ * all of them match are the pages and symbols imported, so a session
+ * doesn't have to fetch all memory and parse its symbol files again.
+ *
+ * The files are a cache for the host they were written on: values are
+ * stored in host byte order, a mismatch is caught by the version check.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "connection.h"
+#include "debug.h"
+#include "log.h"
+#include "memcache.h"
+#include "monitor.h"
+#include "session.h"
+#include "settings.h"
+#include "symtab.h"
+#include "vicemonapi.h"
+
+#include "workspace.h"
+
+
+/** \brief  Workspace file magic
+ */
+#define WORKSPACE_MAGIC     "VMONWS"
+
+/** \brief  Workspace file format version
+ */
+#define WORKSPACE_VERSION   2
+
+
+/** \brief  Workspace file header
+ */
+typedef struct header_s {
+    char magic[8];          /**< WORKSPACE_MAGIC, zero-padded */
+    uint32_t version;       /**< WORKSPACE_VERSION */
+    uint32_t mirror_count;  /**< number of mirrors following the header */
+    uint32_t symtab_size;   /**< size of the symbol index */
+    uint32_t reserved;      /**< reserved, 0 */
+} header_t;
+
+
+/** \brief  Mirror in a workspace file
+ */
+typedef struct mirror_rec_s {
+    uint8_t memspace;                               /**< memspace */
+    uint8_t reserved0;                              /**< reserved, 0 */
+    uint16_t bank;                                  /**< bank */
+    uint32_t reserved1;                             /**< reserved, 0 */
+    uint64_t valid[MEMCACHE_BITMAP_WORDS];          /**< valid pages */
+    uint32_t checksum[MEMCACHE_PAGE_COUNT];         /**< page checksums */
+    uint8_t mem[MEMCACHE_PAGE_SIZE * MEMCACHE_PAGE_COUNT];  /**< memory */
+} mirror_rec_t;
+
+
+/** \brief  Verification of a mapped workspace
+ */
+typedef struct verify_s {
+    GMappedFile *file;      /**< mapped workspace file */
+    guint remaining;        /**< number of MON_CMD_MEM_GET in flight */
+    bool mismatch;          /**< a page didn't match or couldn't be read */
+    uint32_t epoch;         /**< memory cache epoch when the probes were sent */
+} verify_t;
+
+
+/** \brief  Single page being verified
+ */
+typedef struct probe_s {
+    verify_t *verify;           /**< verification */
+    const mirror_rec_t *rec;    /**< mirror the page belongs to */
+    int page;                   /**< page number */
+} probe_t;
+
+
+/** \brief  Calculate checksum of a page
+ *
+ * 32-bit FNV-1a, good enough to tell a changed page from an unchanged one.
+ *
+ * \param[in]   mem     page
+ *
+ * \return  checksum
+ */
+static uint32_t page_checksum(const uint8_t *mem)
+{
+    uint32_t hash = 0x811c9dc5;
+
+    for (int i = 0; i < MEMCACHE_PAGE_SIZE; i++) {
+        hash = (hash ^ mem[i]) * 0x01000193;
+    }
+    return hash;
+}
+
+
+/** \brief  Test page bit
+ *
+ * \param[in]   bitmap  page bitmap
+ * \param[in]   page    page number
+ *
+ * \return  bit is set
+ */
+static inline bool page_bit(const uint64_t *bitmap, int page)
+{
+    return (bitmap[page >> 6] >> (page & 63)) & 1;
+}
+
+
+/** \brief  Get path of the workspace file of the current session
+ *
+ * \return  path in the settings dir, free with g_free()
+ */
+char *workspace_path(void)
+{
+    char *dir = settings_get_dir();
+    char *name = g_strdup(session_current()->name);
+    char *file;
+    char *path;
+
+    g_strcanon(name, G_CSET_A_2_Z G_CSET_a_2_z G_CSET_DIGITS "-.", '_');
+    file = g_strconcat(WORKSPACE_FILE_PREFIX, name, WORKSPACE_FILE_SUFFIX,
+                       NULL);
+    path = g_build_filename(dir, file, NULL);
+    g_free(file);
+    g_free(name);
+    g_free(dir);
+    return path;
+}
+
+
+/** \brief  Append mirror to the workspace being written
+ *
+ * \param[in]   memspace    memspace
+ * \param[in]   bank        bank
+ * \param[in]   valid       bitmap of valid pages
+ * \param[in]   mem         64KiB of memory
+ * \param[in]   data        byte array
+ */
+static void append_mirror(uint8_t memspace,
+                          uint16_t bank,
+                          const uint64_t *valid,
+                          const uint8_t *mem,
+                          void *data)
+{
+    GByteArray *out = data;
+    header_t *header = (header_t *)out->data;
+    mirror_rec_t *rec;
+    int page;
+
+    for (page = 0; page < MEMCACHE_PAGE_COUNT; page++) {
+        if (page_bit(valid, page)) {
+            break;
+        }
+    }
+    if (page == MEMCACHE_PAGE_COUNT) {
+        /* nothing worth keeping */
+        return;
+    }
+
+    rec = g_malloc0(sizeof *rec);
+    rec->memspace = memspace;
+    rec->bank = bank;
+    memcpy(rec->valid, valid, sizeof(rec->valid));
+    memcpy(rec->mem, mem, sizeof(rec->mem));
+    for (page = 0; page < MEMCACHE_PAGE_COUNT; page++) {
+        if (page_bit(valid, page)) {
+            rec->checksum[page] = page_checksum(mem + page * MEMCACHE_PAGE_SIZE);
+        }
+    }
+    header->mirror_count++;
+    g_byte_array_append(out, (const guint8 *)rec, sizeof(*rec));
+    g_free(rec);
+}
+
+
+/** \brief  Save workspace of the current session
+ *
+ * The file is replaced atomically, a crash while saving leaves the previous
+ * workspace intact.
+ *
+ * \param[out]  error   error (optional)
+ *
+ * \return  true on success
+ */
+bool workspace_save(GError **error)
+{
+    GByteArray *out = g_byte_array_new();
+    header_t header;
+    header_t *hdr;
+    guint symtab_offset;
+    char *path;
+    bool result;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, WORKSPACE_MAGIC, sizeof(WORKSPACE_MAGIC));
+    header.version = WORKSPACE_VERSION;
+    g_byte_array_append(out, (const guint8 *)&header, sizeof(header));
+
+    memcache_foreach_mirror(append_mirror, out);
+    symtab_offset = out->len;
+    symtab_export(out);
+    hdr = (header_t *)out->data;
+    hdr->symtab_size = out->len - symtab_offset;
+
+    path = workspace_path();
+    result = g_file_set_contents(path, (const gchar *)out->data, out->len,
+                                 error);
+    if (result) {
+        debug_msg("Saved workspace of %s: %u mirrors, %u bytes.",
+                  session_current()->name, hdr->mirror_count, out->len);
+    }
+    g_free(path);
+    g_byte_array_unref(out);
+    return result;
+}
+
+
+/** \brief  Save workspace of \a session
+ *
+ * \param[in]   session session
+ * \param[in]   data    extra data (unused)
+ */
+static void save_session(session_t *session, void *data)
+{
+    GError *err = NULL;
+
+    session_push(session);
+    if (!workspace_save(&err)) {
+        log_msg(LOG_WARN, "Failed to save workspace of %s: %s\n",
+                session->name, err->message);
+        g_error_free(err);
+    }
+    session_pop();
+}
+
+
+/** \brief  Save workspaces of all sessions
+ *
+ * To be called on exit, before the sessions are freed.
+ */
+void workspace_save_all(void)
+{
+    session_foreach(save_session, NULL);
+}
+
+
+/** \brief  Check header and size of a mapped workspace
+ *
+ * \param[in]   file    mapped workspace file
+ *
+ * \return  true if the file is usable
+ */
+static bool check_file(GMappedFile *file)
+{
+    const header_t *header = (const header_t *)g_mapped_file_get_contents(file);
+    gsize size = g_mapped_file_get_length(file);
+
+    if (header == NULL
+            || size < sizeof(*header)
+            || memcmp(header->magic, WORKSPACE_MAGIC,
+                      sizeof(WORKSPACE_MAGIC)) != 0
+            || header->version != WORKSPACE_VERSION
+            || header->mirror_count > MON_MEMSPACE_COUNT * 0x10000) {
+        return false;
+    }
+    return size == sizeof(*header)
+                   + header->mirror_count * sizeof(mirror_rec_t)
+                   + header->symtab_size;
+}
+
+
+/** \brief  Get mirrors of a mapped workspace
+ *
+ * \param[in]   file    mapped workspace file
+ *
+ * \return  first mirror
+ */
+static const mirror_rec_t *get_mirrors(GMappedFile *file)
+{
+    const char *data = g_mapped_file_get_contents(file);
+
+    return (const mirror_rec_t *)(data + sizeof(header_t));
+}
+
+
+/** \brief  Import pages and symbols of a verified workspace
+ *
+ * Symbols are only imported when none are loaded, symbols loaded from the
+ * command line or the menu take precedence.
+ *
+ * \param[in]   file    mapped workspace file
+ * \param[in]   epoch   memory cache epoch at which the pages matched
+ */
+static void import_workspace(GMappedFile *file, uint32_t epoch)
+{
+    const header_t *header = (const header_t *)g_mapped_file_get_contents(file);
+    const mirror_rec_t *recs = get_mirrors(file);
+    const uint8_t *symbols;
+    int count = 0;
+
+    for (uint32_t i = 0; i < header->mirror_count; i++) {
+        memcache_import(recs[i].memspace, recs[i].bank, recs[i].valid,
+                        recs[i].mem, epoch);
+    }
+    symbols = (const uint8_t *)(recs + header->mirror_count);
+    if (symtab_count() == 0 && header->symtab_size > 0) {
+        count = symtab_import(symbols, header->symtab_size);
+        if (count < 0) {
+            log_msg(LOG_WARN, "Invalid symbol index in workspace of %s.\n",
+                    session_current()->name);
+            count = 0;
+        }
+    }
+    log_msg(LOG_INFO, "Restored workspace of %s: %u mirrors, %d symbols.\n",
+            session_current()->name, header->mirror_count, count);
+}
+
+
+/** \brief  Finish verification when the last page has been checked
+ *
+ * \param[in]   verify  verification
+ */
+static void verify_finish(verify_t *verify)
+{
+    if (--verify->remaining > 0) {
+        return;
+    }
+    if (verify->mismatch) {
+        log_msg(LOG_INFO, "Workspace of %s is stale, not restored.\n",
+                session_current()->name);
+    } else {
+        import_workspace(verify->file, verify->epoch);
+    }
+    g_mapped_file_unref(verify->file);
+    g_free(verify);
+}
+
+
+/** \brief  Handler for MON_CMD_MEM_GET responses of verified pages
+ *
+ * \param[in]   response    response
+ * \param[in]   data        probe
+ */
+static void on_probe_response(const mon_response_t *response, void *data)
+{
+    probe_t *probe = data;
+    verify_t *verify = probe->verify;
+
+    if (response->error_code != MON_ERR_OK
+            || response_get_body_len(response) < 2 + MEMCACHE_PAGE_SIZE
+            || MON_GET_U16(response->body) != MEMCACHE_PAGE_SIZE
+            || page_checksum(response->body + 2)
+                    != probe->rec->checksum[probe->page]) {
+        debug_msg("Workspace page $%02x of memspace %d, bank %d differs.",
+                  probe->page, probe->rec->memspace, probe->rec->bank);
+        verify->mismatch = true;
+    }
+    g_free(probe);
+    verify_finish(verify);
+}
+
+
+/** \brief  Send MON_CMD_MEM_GET for a page to verify
+ *
+ * \param[in]   verify  verification
+ * \param[in]   rec     mirror
+ * \param[in]   page    page number
+ *
+ * \return  false if sending failed
+ */
+static bool send_probe(verify_t *verify, const mirror_rec_t *rec, int page)
+{
+    uint8_t body[8];
+    probe_t *probe;
+    uint16_t start = (uint16_t)(page * MEMCACHE_PAGE_SIZE);
+
+    probe = g_malloc(sizeof *probe);
+    probe->verify = verify;
+    probe->rec = rec;
+    probe->page = page;
+
+    body[0] = 0;    /* no side effects */
+    MON_SET_U16(body + 1, start);
+    MON_SET_U16(body + 3, start + MEMCACHE_PAGE_SIZE - 1);
+    body[5] = rec->memspace;
+    MON_SET_U16(body + 6, rec->bank);
+    if (connection_send_request(MON_CMD_MEM_GET, body, sizeof(body),
+                                on_probe_response, probe) == 0) {
+        g_free(probe);
+        return false;
+    }
+    verify->remaining++;
+    return true;
+}
+
+
+/** \brief  Restore the workspace of the current session
+ *
+ * To be called after connecting. Maps the workspace file and sends
+ * MON_CMD_MEM_GET for Workspace/verify_pages of its valid pages, spread
+ * evenly over all mirrors. The workspace is imported when all of them
+ * match, setting Workspace/verify_pages to 0 disables restoring.
+ *
+ * Pages are imported as valid, a running VICE invalidates them again on
+ * the next MON_RESPONSE_RESUMED like any other fetched page.
+ */
+void workspace_restore(void)
+{
+    GMappedFile *file;
+    GError *err = NULL;
+    const header_t *header;
+    const mirror_rec_t *recs;
+    verify_t *verify;
+    char *path;
+    int verify_pages = WORKSPACE_VERIFY_PAGES;
+    guint total = 0;
+    guint stride;
+    guint index = 0;
+    bool running;
+
+    settings_get_int("Workspace", "verify_pages", &verify_pages);
+    if (verify_pages <= 0) {
+        return;
+    }
+
+    path = workspace_path();
+    file = g_mapped_file_new(path, FALSE, &err);
+    if (file == NULL) {
+        if (!g_error_matches(err, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+            log_msg(LOG_WARN, "Failed to open workspace '%s': %s\n",
+                    path, err->message);
+        }
+        g_error_free(err);
+        g_free(path);
+        return;
+    }
+    if (!check_file(file)) {
+        log_msg(LOG_WARN, "Ignoring invalid workspace '%s'.\n", path);
+        g_mapped_file_unref(file);
+        g_free(path);
+        return;
+    }
+    g_free(path);
+
+    header = (const header_t *)g_mapped_file_get_contents(file);
+    recs = get_mirrors(file);
+    for (uint32_t i = 0; i < header->mirror_count; i++) {
+        for (int page = 0; page < MEMCACHE_PAGE_COUNT; page++) {
+            total += page_bit(recs[i].valid, page);
+        }
+    }
+    if (total == 0) {
+        /* nothing to verify, just the symbols */
+        import_workspace(file, memcache_get_epoch());
+        g_mapped_file_unref(file);
+        return;
+    }
+    stride = MAX(total / (guint)verify_pages, 1);
+
+    verify = g_malloc0(sizeof *verify);
+    verify->file = file;
+    verify->epoch = memcache_get_epoch();
+    /* hold a reference so responses can't finish verifying while sending */
+    verify->remaining = 1;
+
+    running = connection_vice_running();
+    connection_cork();
+    for (uint32_t i = 0; i < header->mirror_count && !verify->mismatch; i++) {
+        for (int page = 0; page < MEMCACHE_PAGE_COUNT; page++) {
+            if (!page_bit(recs[i].valid, page)) {
+                continue;
+            }
+            if (index++ % stride == 0
+                    && verify->remaining <= (guint)verify_pages
+                    && !send_probe(verify, &recs[i], page)) {
+                verify->mismatch = true;
+                break;
+            }
+        }
+    }
+    if (running && verify->remaining > 1) {
+        connection_send_request(MON_CMD_EXIT, NULL, 0, NULL, NULL);
+    }
+    connection_uncork();
+
+    debug_msg("Verifying %u of %u workspace pages of %s.",
+              verify->remaining - 1, total, session_current()->name);
+    /* drop our reference */
+    verify_finish(verify);
+}
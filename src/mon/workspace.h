@@ -0,0 +1,63 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   workspace.h
+ * \brief   Session workspace cache files - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+
+#ifndef MON_WORKSPACE_H_
+#define MON_WORKSPACE_H_
+
+#include <stdbool.h>
+#include <glib.h>
+
+/** \brief  Prefix of workspace files in the settings dir
+ *
+ * Followed by the session name, with characters unfit for a filename
+ * replaced, and WORKSPACE_FILE_SUFFIX.
+ */
+#define WORKSPACE_FILE_PREFIX   "workspace-"
+
+/** \brief  Suffix of workspace files
+ */
+#define WORKSPACE_FILE_SUFFIX   ".bin"
+
+/** \brief  Default number of pages checked against VICE before a workspace
+ *          is restored
+ */
+#define WORKSPACE_VERIFY_PAGES  8
+
+
+char *workspace_path(void);
+bool workspace_save(GError **error);
+void workspace_save_all(void);
+void workspace_restore(void);
+
+#endif
@@ -0,0 +1,84 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   petscii.c
+ * \brief   PETSCII and screen code conversion
+ *
+ * Conversion follows the C64's lower case character set: ASCII lower case
+ * letters map to unshifted PETSCII ($41-$5a), upper case letters to shifted
+ * PETSCII ($c1-$da).
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <stdint.h>
+
+#include "petscii.h"
+
+
+/** \brief  Convert ASCII character to PETSCII
+ *
+ * \param[in]   ch  ASCII character
+ *
+ * \return  PETSCII code
+ */
+uint8_t petscii_from_ascii(char ch)
+{
+    if (ch >= 'a' && ch <= 'z') {
+        return (uint8_t)(ch - 'a' + 0x41);
+    }
+    if (ch >= 'A' && ch <= 'Z') {
+        return (uint8_t)(ch - 'A' + 0xc1);
+    }
+    return (uint8_t)ch;
+}
+
+
+/** \brief  Convert PETSCII code to screen code
+ *
+ * \param[in]   petscii PETSCII code
+ *
+ * \return  screen code (not reversed)
+ */
+uint8_t petscii_to_screencode(uint8_t petscii)
+{
+    if (petscii >= 0x40 && petscii <= 0x5f) {
+        return petscii - 0x40;
+    }
+    if (petscii >= 0x60 && petscii <= 0x7f) {
+        return petscii - 0x20;
+    }
+    if (petscii >= 0xc0 && petscii <= 0xfe) {
+        return petscii - 0x80;
+    }
+    if (petscii == 0xff) {
+        return 0x5e;
+    }
+    return petscii;
+}
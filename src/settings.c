@@ -39,19 +39,222 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
 
 #include "debug.h"
 #include "app-resources.h"
 
 
+#include "log.h"
+#include "trace.h"
 #include "settings.h"
 
 
+/** \brief  Cached setting
+ */
+typedef struct setting_s {
+    const char *str;    /**< value (interned) */
+    int value;          /**< value as integer, if \a is_int */
+    bool is_int;        /**< value is a valid integer */
+} setting_t;
+
+
+/** \brief  Settings change listener
+ */
+typedef struct settings_listener_s {
+    const char *group;              /**< group (interned), NULL for any */
+    const char *key;                /**< key (interned), NULL for any */
+    settings_changed_cb callback;   /**< callback */
+    void *data;                     /**< data for \a callback */
+} settings_listener_t;
+
+
 /** \brief  Reference to the settings.ini file
  */
 static GKeyFile *keyfile;
 
+/** \brief  Settings cache
+ *
+ * Maps groups to tables mapping keys to setting_t objects. Groups and keys
+ * are interned, so lookups don't allocate.
+ */
+static GHashTable *cache = NULL;
+
+/** \brief  List of change listeners
+ */
+static GSList *listeners = NULL;
+
+/** \brief  Source ID of the pending (debounced) save
+ */
+static guint save_source = 0;
+
+/** \brief  Generation of the settings in memory, bumped on each change
+ */
+static guint64 generation = 0;
+
+/** \brief  Generation of the settings last written to disk
+ *
+ * Protected by \a save_lock.
+ */
+static guint64 saved_generation = 0;
+
+/** \brief  Lock serializing writes of settings.ini
+ */
+static GMutex save_lock;
+
+
+/** \brief  Settings to write in a background thread
+ */
+typedef struct save_job_s {
+    gchar *data;            /**< keyfile contents */
+    gsize length;           /**< length of \a data */
+    guint64 generation;     /**< generation of \a data */
+} save_job_t;
+
+
+/** \brief  Parse \a str as integer
+ *
+ * \param[in]   str     string
+ * \param[out]  value   integer value
+ *
+ * \return  true if \a str is a valid integer in the range of an int
+ */
+static bool parse_int(const char *str, int *value)
+{
+    char *endptr;
+    gint64 result;
+
+    while (g_ascii_isspace(*str)) {
+        str++;
+    }
+    if (*str == '\0') {
+        return false;
+    }
+    result = g_ascii_strtoll(str, &endptr, 10);
+    while (g_ascii_isspace(*endptr)) {
+        endptr++;
+    }
+    if (*endptr != '\0' || result < G_MININT || result > G_MAXINT) {
+        return false;
+    }
+    *value = (int)result;
+    return true;
+}
+
+
+/** \brief  Store \a value in the cache
+ *
+ * \param[in]   group   group
+ * \param[in]   key     key
+ * \param[in]   value   value
+ *
+ * \return  true if the cached value changed
+ */
+static bool cache_set(const char *group, const char *key, const char *value)
+{
+    GHashTable *keys;
+    setting_t *setting;
+    const char *str = g_intern_string(value);
+
+    keys = g_hash_table_lookup(cache, group);
+    if (keys == NULL) {
+        keys = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+        g_hash_table_insert(cache, (gpointer)g_intern_string(group), keys);
+    }
+    setting = g_hash_table_lookup(keys, key);
+    if (setting == NULL) {
+        setting = g_malloc0(sizeof *setting);
+        g_hash_table_insert(keys, (gpointer)g_intern_string(key), setting);
+    } else if (setting->str == str) {
+        return false;
+    }
+    setting->str = str;
+    setting->is_int = parse_int(str, &setting->value);
+    return true;
+}
+
+
+/** \brief  Look up setting in the cache
+ *
+ * \param[in]   group   group
+ * \param[in]   key     key
+ *
+ * \return  setting or `NULL` when not found
+ */
+static const setting_t *cache_get(const char *group, const char *key)
+{
+    GHashTable *keys;
+
+    if (cache == NULL) {
+        return NULL;
+    }
+    keys = g_hash_table_lookup(cache, group);
+    if (keys == NULL) {
+        return NULL;
+    }
+    return g_hash_table_lookup(keys, key);
+}
+
+
+/** \brief  (Re)build the cache from the keyfile
+ */
+static void cache_build(void)
+{
+    gchar **groups;
+    gsize g;
+
+    if (cache != NULL) {
+        g_hash_table_destroy(cache);
+    }
+    cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                  NULL, (GDestroyNotify)g_hash_table_destroy);
+
+    groups = g_key_file_get_groups(keyfile, NULL);
+    for (g = 0; groups[g] != NULL; g++) {
+        gchar **keys = g_key_file_get_keys(keyfile, groups[g], NULL, NULL);
+        gsize k;
+
+        for (k = 0; keys != NULL && keys[k] != NULL; k++) {
+            gchar *value = g_key_file_get_value(keyfile, groups[g], keys[k],
+                                                NULL);
+
+            if (value != NULL) {
+                cache_set(groups[g], keys[k], value);
+                g_free(value);
+            }
+        }
+        g_strfreev(keys);
+    }
+    g_strfreev(groups);
+}
+
+
+/** \brief  Call the listeners of \a group and \a key
+ *
+ * \param[in]   group   group
+ * \param[in]   key     key
+ */
+static void notify(const char *group, const char *key)
+{
+    GSList *node = listeners;
+
+    while (node != NULL) {
+        settings_listener_t *listener = node->data;
+
+        /* listener might remove itself */
+        node = node->next;
+        if ((listener->group == NULL || strcmp(listener->group, group) == 0)
+                && (listener->key == NULL || strcmp(listener->key, key) == 0)) {
+            listener->callback(group, key, listener->data);
+        }
+    }
+}
+
 
 /** \brief  Get XDG path to the application config dir
  *
@@ -172,6 +375,7 @@ gboolean settings_read(void)
 
     debug_msg("Attempting to load '%s'.", path);
     /* attempt to load setting file */
+    g_free(config);
     if (!g_key_file_load_from_file(
                 keyfile,
                 path,
@@ -182,6 +386,7 @@ gboolean settings_read(void)
         GError *err3 = NULL;
 
         debug_msg("error %d: %s", err->code, err->message);
+        g_error_free(err);
         /* use default settings */
         debug_msg("Attempting to load default settings from GResource.");
         GBytes *data = g_resources_lookup_data(
@@ -190,6 +395,8 @@ gboolean settings_read(void)
                 &err2);
         if (data == NULL) {
             error_msg("Data is null: %d: %s", err2->code, err2->message);
+            g_error_free(err2);
+            g_free(path);
             return FALSE;
         }
 
@@ -197,21 +404,245 @@ gboolean settings_read(void)
         if (!g_key_file_load_from_bytes(
                 keyfile,
                 data,
-                0,
+                G_KEY_FILE_KEEP_COMMENTS,
                 &err3)) {
             /* report error */
             error_msg("Failed to load default settings: %d: %s",
                     err3->code, err3->message);
+            g_error_free(err3);
+            g_bytes_unref(data);
+            g_free(path);
             return FALSE;
         }
+        g_bytes_unref(data);
     }
 
     g_free(path);
+    cache_build();
     return TRUE;
 }
 
 
+/** \brief  Get path to settings.ini
+ *
+ * \return  path, free with g_free()
+ */
+static char *get_settings_path(void)
+{
+    char *config = settings_get_dir();
+    char *path = g_build_filename(config, "settings.ini", NULL);
+
+    g_free(config);
+    return path;
+}
+
+
+/** \brief  Write \a data to settings.ini atomically
+ *
+ * Writes a temporary file in the settings dir, syncs it to disk and renames
+ * it over settings.ini, so a crash leaves either the old or the new file.
+ * Data older than the last data written is skipped, so out-of-order
+ * background writes can't revert newer settings.
+ *
+ * \param[in]   data    contents
+ * \param[in]   length  length of \a data
+ * \param[in]   gen     generation of \a data
+ * \param[out]  error   error (optional)
+ *
+ * \return  TRUE on success
+ */
+static gboolean write_file(const gchar *data,
+                           gsize length,
+                           guint64 gen,
+                           GError **error)
+{
+    char *path;
+    char *temp;
+    int fd;
+    gboolean result = FALSE;
+
+    g_mutex_lock(&save_lock);
+    if (gen <= saved_generation) {
+        g_mutex_unlock(&save_lock);
+        return TRUE;
+    }
+
+    path = get_settings_path();
+    temp = g_strconcat(path, ".XXXXXX", NULL);
+    fd = g_mkstemp(temp);
+    if (fd < 0) {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+                    "Failed to create '%s': %s", temp, g_strerror(errno));
+        goto out;
+    }
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+                        "Failed to write '%s': %s", temp, g_strerror(errno));
+            close(fd);
+            g_unlink(temp);
+            goto out;
+        }
+        data += written;
+        length -= (gsize)written;
+    }
+    if (fsync(fd) < 0 || close(fd) < 0) {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+                    "Failed to sync '%s': %s", temp, g_strerror(errno));
+        g_unlink(temp);
+        goto out;
+    }
+    if (g_rename(temp, path) < 0) {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+                    "Failed to rename '%s' to '%s': %s",
+                    temp, path, g_strerror(errno));
+        g_unlink(temp);
+        goto out;
+    }
+    saved_generation = gen;
+    result = TRUE;
+out:
+    g_mutex_unlock(&save_lock);
+    g_free(temp);
+    g_free(path);
+    return result;
+}
+
+
+/** \brief  Free save job
+ *
+ * \param[in]   data    save job
+ */
+static void save_job_free(gpointer data)
+{
+    save_job_t *job = data;
+
+    g_free(job->data);
+    g_free(job);
+}
+
+
+/** \brief  Write settings in a worker thread
+ *
+ * \param[in]   task            task
+ * \param[in]   source          source object (unused)
+ * \param[in]   data            save job
+ * \param[in]   cancellable     cancellable (unused)
+ */
+static void save_thread(GTask *task,
+                        gpointer source,
+                        gpointer data,
+                        GCancellable *cancellable)
+{
+    save_job_t *job = data;
+    GError *error = NULL;
+
+    if (write_file(job->data, job->length, job->generation, &error)) {
+        g_task_return_boolean(task, TRUE);
+    } else {
+        g_task_return_error(task, error);
+    }
+}
+
+
+/** \brief  Handle completion of a background save
+ *
+ * \param[in]   source  source object (unused)
+ * \param[in]   result  task
+ * \param[in]   data    extra data (unused)
+ */
+static void on_saved(GObject *source, GAsyncResult *result, gpointer data)
+{
+    GError *error = NULL;
+
+    if (!g_task_propagate_boolean(G_TASK(result), &error)) {
+        log_msg(LOG_ERR, "Failed to save settings: %s\n", error->message);
+        g_error_free(error);
+    }
+}
+
+
+/** \brief  Save the settings in a worker thread after the debounce delay
+ *
+ * \param[in]   data    extra data (unused)
+ *
+ * \return  G_SOURCE_REMOVE
+ */
+static gboolean on_save_timeout(gpointer data)
+{
+    save_job_t *job = g_malloc(sizeof *job);
+    GTask *task;
+
+    save_source = 0;
+    /* snapshot on the main thread, the keyfile isn't thread-safe */
+    job->data = g_key_file_to_data(keyfile, &job->length, NULL);
+    job->generation = generation;
+
+    task = g_task_new(NULL, NULL, on_saved, NULL);
+    g_task_set_task_data(task, job, save_job_free);
+    g_task_run_in_thread(task, save_thread);
+    g_object_unref(task);
+    return G_SOURCE_REMOVE;
+}
+
+
+/** \brief  Schedule saving the settings
+ *
+ * Restarts the debounce delay, so a burst of changes results in a single
+ * write, SETTINGS_SAVE_DELAY milliseconds after the last change.
+ */
+static void schedule_save(void)
+{
+    generation++;
+    if (save_source != 0) {
+        g_source_remove(save_source);
+    }
+    save_source = g_timeout_add(SETTINGS_SAVE_DELAY, on_save_timeout, NULL);
+}
+
+
+/** \brief  Write the settings to settings.ini now
+ *
+ * Cancels a pending debounced save. Blocks until a background save in
+ * progress has finished.
+ *
+ * \return  TRUE on success
+ */
+gboolean settings_write(void)
+{
+    gchar *data;
+    gsize length;
+    GError *error = NULL;
+    gboolean result;
+
+    if (keyfile == NULL) {
+        return FALSE;
+    }
+    if (save_source != 0) {
+        g_source_remove(save_source);
+        save_source = 0;
+    }
+    data = g_key_file_to_data(keyfile, &length, NULL);
+    result = write_file(data, length, generation, &error);
+    if (!result) {
+        log_msg(LOG_ERR, "Failed to save settings: %s\n", error->message);
+        g_error_free(error);
+    }
+    g_free(data);
+    return result;
+}
+
+
 /** \brief  Set a string setting at \a group -> \a key to \a value
+ *
+ * Updates the settings in memory and calls the listeners registered for
+ * the setting when the value changed. The settings are saved in the
+ * background after SETTINGS_SAVE_DELAY milliseconds without changes.
  *
  * \param[in]   group   group
  * \param[in]   key     key
@@ -221,31 +652,57 @@ gboolean settings_read(void)
  */
 gboolean settings_set_str(const char *group, const char *key, const char *value)
 {
-    debug_msg("This is supposed to set '%s/%s' to '%s'.", group, key, value);
+    if (keyfile == NULL || cache == NULL) {
+        return FALSE;
+    }
+    if (!cache_set(group, key, value)) {
+        return TRUE;
+    }
+    g_key_file_set_value(keyfile, group, key, value);
+    schedule_save();
+    notify(group, key);
     return TRUE;
 }
 
 
+/** \brief  Set an integer setting at \a group -> \a key to \a value
+ *
+ * \param[in]   group   group
+ * \param[in]   key     key
+ * \param[in]   value   new value
+ *
+ * \return  TRUE on success
+ */
+gboolean settings_set_int(const char *group, const char *key, int value)
+{
+    char buffer[32];
+
+    g_snprintf(buffer, sizeof buffer, "%d", value);
+    return settings_set_str(group, key, buffer);
+}
+
+
 /** \brief  Get a string setting from \a group with \a key
+ *
+ * The string is owned by the settings and stays valid until the program
+ * exits, even when the setting changes.
  *
  * \param[in]   group   group
  * \param[in]   key     key
- * \param[out]  value   result
+ * \param[out]  value   result (`NULL` when not found)
  *
  * \return  TRUE on success
  */
 gboolean settings_get_str(const char *group, const char *key, const char **value)
 {
-    gchar *s;
-    GError *err = NULL;
+    const setting_t *setting = cache_get(group, key);
 
-    s = g_key_file_get_value(keyfile, group, key, &err);
-    if (s == NULL) {
-        debug_msg("oops: %d: %s", err->code, err->message);
+    if (setting == NULL) {
+        trace(TRACE_LEVEL_DEBUG, "lookup failed");
         *value = NULL;
         return FALSE;
     }
-    *value = s;
+    *value = setting->str;
     return TRUE;
 }
 
@@ -255,25 +712,66 @@ gboolean settings_get_str(const char *group, const char *key, const char **value
  *
  * \param[in]   group   group
  * \param[in]   key     key
- * \param[out]  value   result
+ * \param[out]  value   result (unchanged on failure)
  *
- * \return  TRUE on success
+ * \return  TRUE on success, FALSE when not found or not an integer
  */
 gboolean settings_get_int(const char *group, const char *key, int *value)
 {
-    GError *err = NULL;
-    int i;
+    const setting_t *setting = cache_get(group, key);
 
-    i = g_key_file_get_integer(keyfile, group, key, &err);
-    if (i == 0 && err->code != 0) {
-        debug_msg("oops: %d: %s", err->code, err->message);
+    if (setting == NULL || !setting->is_int) {
+        trace(TRACE_LEVEL_DEBUG, "lookup failed");
         return FALSE;
     }
-    *value = i;
+    *value = setting->value;
     return TRUE;
 }
 
 
+/** \brief  Register \a callback to be called when a setting changes
+ *
+ * \param[in]   group       group, or `NULL` for any group
+ * \param[in]   key         key, or `NULL` for any key
+ * \param[in]   callback    function to call
+ * \param[in]   data        data for \a callback
+ */
+void settings_add_listener(const char *group,
+                           const char *key,
+                           settings_changed_cb callback,
+                           void *data)
+{
+    settings_listener_t *listener = g_malloc(sizeof *listener);
+
+    listener->group = group != NULL ? g_intern_string(group) : NULL;
+    listener->key = key != NULL ? g_intern_string(key) : NULL;
+    listener->callback = callback;
+    listener->data = data;
+    listeners = g_slist_append(listeners, listener);
+}
+
+
+/** \brief  Unregister \a callback with \a data
+ *
+ * \param[in]   callback    function
+ * \param[in]   data        data passed to settings_add_listener()
+ */
+void settings_remove_listener(settings_changed_cb callback, void *data)
+{
+    GSList *node;
+
+    for (node = listeners; node != NULL; node = node->next) {
+        settings_listener_t *listener = node->data;
+
+        if (listener->callback == callback && listener->data == data) {
+            listeners = g_slist_delete_link(listeners, node);
+            g_free(listener);
+            return;
+        }
+    }
+}
+
+
 /** \brief  Initialize the settings system
  *
  * Check/create the settings dir and file.
@@ -295,24 +793,28 @@ gboolean settings_init(void)
         error_msg("OOPS");
         return FALSE;
     }
-
-    gsize length = 0;
-    GError *err = NULL;
-    gchar **keys = g_key_file_get_keys(keyfile, "VICE", &length, &err);
-    debug_msg("Dumping section [VICE]:");
-    for (gsize i = 0; i < length; i++) {
-        g_print("%-10s-> %s\n", keys[i],
-                g_key_file_get_string(keyfile, "VICE", keys[i], &err));
-    }
-
     return TRUE;
 }
 
 
+/** \brief  Free the settings and the listeners
+ *
+ * Writes pending changes first.
+ */
 void settings_exit(void)
 {
+    if (save_source != 0) {
+        settings_write();
+    }
     if (keyfile != NULL) {
         g_key_file_free(keyfile);
+        keyfile = NULL;
+    }
+    if (cache != NULL) {
+        g_hash_table_destroy(cache);
+        cache = NULL;
     }
+    g_slist_free_full(listeners, g_free);
+    listeners = NULL;
 }
 
@@ -39,6 +39,21 @@
 
 #define SETTINGS_DIR    "~/.config/gtk3vicemon"
 
+/** \brief  Delay in milliseconds after the last change before saving
+ */
+#define SETTINGS_SAVE_DELAY 1000
+
+
+/** \brief  Callback for setting changes
+ *
+ * \param[in]   group   group of the setting
+ * \param[in]   key     key of the setting
+ * \param[in]   data    data passed to settings_add_listener()
+ */
+typedef void (*settings_changed_cb)(const char *group,
+                                    const char *key,
+                                    void *data);
+
 char *      settings_get_dir(void);
 gboolean    settings_create_dir(void);
 
@@ -48,6 +63,13 @@ gboolean    settings_write(void);
 gboolean    settings_get_str(const char *group, const char *key, const char **value);
 gboolean    settings_set_str(const char *group, const char *key, const char *value);
 gboolean    settings_get_int(const char *group, const char *key, int *value);
+gboolean    settings_set_int(const char *group, const char *key, int value);
+
+void        settings_add_listener(const char *group,
+                                  const char *key,
+                                  settings_changed_cb callback,
+                                  void *data);
+void        settings_remove_listener(settings_changed_cb callback, void *data);
 
 gboolean    settings_init(void);
 void        settings_exit(void);
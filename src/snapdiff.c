@@ -0,0 +1,461 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   snapdiff.c
+ * \brief   Snapshot memory diff
+ *
+ * Compares the modules of two snapshots, either from the snapshot store or
+ * snapshot files, and reports the ranges of bytes that changed.
+ *
+ * Module data is compared in pages with memcmp(), which the C library
+ * implements with vector instructions, so identical pages are skipped
+ * quickly; only pages that differ are scanned for the changed ranges. Ranges
+ * separated by fewer than SNAPDIFF_MERGE_GAP identical bytes are merged.
+ *
+ * Ranges in modules holding the machine's RAM get a memory address, so they
+ * can be annotated with symbols from the symbol table.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "snapshot.h"
+#include "snapstore.h"
+#include "symtab.h"
+
+#include "snapdiff.h"
+
+
+/** \brief  Size of the pages compared with memcmp()
+ */
+#define SNAPDIFF_PAGE_SIZE  256
+
+/** \brief  Minimum number of identical bytes separating two ranges
+ */
+#define SNAPDIFF_MERGE_GAP  4
+
+/** \brief  Maximum number of bytes shown by snapdiff_describe()
+ */
+#define SNAPDIFF_SHOW_BYTES 8
+
+
+/** \brief  Location of RAM in a snapshot module
+ */
+typedef struct ram_module_s {
+    const char *name;   /**< module name */
+    size_t offset;      /**< offset of RAM in the module data */
+    size_t size;        /**< size of RAM */
+} ram_module_t;
+
+
+/** \brief  Modules containing RAM
+ *
+ * VICE's C64MEM module stores the CPU port data and direction and the
+ * EXROM and GAME lines before the RAM.
+ */
+static const ram_module_t ram_modules[] = {
+    { "C64MEM", 4, 0x10000 }
+};
+
+
+/** \brief  Load snapshot from a file or the snapshot store
+ *
+ * \param[in]   name    path of a snapshot file, or name in the store
+ * \param[out]  error   error (optional)
+ *
+ * \return  snapshot contents or `NULL` on error
+ */
+static GBytes *load_snapshot(const char *name, GError **error)
+{
+    char *contents;
+    gsize len;
+
+    if (g_file_test(name, G_FILE_TEST_IS_REGULAR)) {
+        if (!g_file_get_contents(name, &contents, &len, error)) {
+            return NULL;
+        }
+        return g_bytes_new_take(contents, len);
+    }
+    return snapstore_load(name, error);
+}
+
+
+/** \brief  Find first differing byte
+ *
+ * \param[in]   a       old data
+ * \param[in]   b       new data
+ * \param[in]   pos     position to start
+ * \param[in]   end     end position
+ *
+ * \return  position of the first differing byte, or \a end
+ */
+static size_t find_diff(const uint8_t *a, const uint8_t *b, size_t pos, size_t end)
+{
+    /* skip identical pages */
+    while (pos < end) {
+        size_t n = MIN(end - pos, SNAPDIFF_PAGE_SIZE);
+
+        if (memcmp(a + pos, b + pos, n) != 0) {
+            break;
+        }
+        pos += n;
+    }
+    /* then identical words */
+    while (pos + sizeof(uint64_t) <= end) {
+        uint64_t wa;
+        uint64_t wb;
+
+        memcpy(&wa, a + pos, sizeof wa);
+        memcpy(&wb, b + pos, sizeof wb);
+        if (wa != wb) {
+            break;
+        }
+        pos += sizeof(uint64_t);
+    }
+    while (pos < end && a[pos] == b[pos]) {
+        pos++;
+    }
+    return pos;
+}
+
+
+/** \brief  Find end of a range of changed bytes
+ *
+ * \param[in]   a       old data
+ * \param[in]   b       new data
+ * \param[in]   pos     position of a differing byte
+ * \param[in]   end     end position
+ *
+ * \return  position after the last differing byte of the range
+ */
+static size_t find_range_end(const uint8_t *a,
+                             const uint8_t *b,
+                             size_t pos,
+                             size_t end)
+{
+    size_t last = pos;
+
+    while (pos < end && pos - last < SNAPDIFF_MERGE_GAP) {
+        if (a[pos] != b[pos]) {
+            last = pos + 1;
+        }
+        pos++;
+    }
+    return last;
+}
+
+
+/** \brief  Add range to the diff
+ *
+ * \param[in,out]   ranges  list of ranges
+ * \param[in]       module  module name
+ * \param[in]       offset  offset in module data
+ * \param[in]       length  length of the range
+ * \param[in]       address memory address of \a offset, or -1
+ * \param[in]       a       old module data, or `NULL`
+ * \param[in]       b       new module data, or `NULL`
+ */
+static void add_range(GArray *ranges,
+                      const char *module,
+                      size_t offset,
+                      size_t length,
+                      int32_t address,
+                      const uint8_t *a,
+                      const uint8_t *b)
+{
+    snapdiff_range_t range;
+
+    g_strlcpy(range.module, module, sizeof(range.module));
+    range.offset = offset;
+    range.length = length;
+    range.address = address;
+    range.old_data = a != NULL ? a + offset : NULL;
+    range.new_data = b != NULL ? b + offset : NULL;
+    g_array_append_val(ranges, range);
+}
+
+
+/** \brief  Compare segment of module data
+ *
+ * \param[in,out]   ranges  list of ranges
+ * \param[in]       module  module name
+ * \param[in]       a       old module data
+ * \param[in]       b       new module data
+ * \param[in]       start   start of segment
+ * \param[in]       end     end of segment
+ * \param[in]       base    memory address of \a start, or -1
+ */
+static void compare_segment(GArray *ranges,
+                            const char *module,
+                            const uint8_t *a,
+                            const uint8_t *b,
+                            size_t start,
+                            size_t end,
+                            int32_t base)
+{
+    size_t pos = start;
+
+    while ((pos = find_diff(a, b, pos, end)) < end) {
+        size_t range_end = find_range_end(a, b, pos, end);
+
+        add_range(ranges,
+                  module,
+                  pos,
+                  range_end - pos,
+                  base < 0 ? -1 : base + (int32_t)(pos - start),
+                  a,
+                  b);
+        pos = range_end;
+    }
+}
+
+
+/** \brief  Compare data of a module present in both snapshots
+ *
+ * \param[in,out]   ranges  list of ranges
+ * \param[in]       module  module name
+ * \param[in]       a       old module data
+ * \param[in]       alen    length of \a a
+ * \param[in]       b       new module data
+ * \param[in]       blen    length of \a b
+ */
+static void compare_module(GArray *ranges,
+                           const char *module,
+                           const uint8_t *a,
+                           size_t alen,
+                           const uint8_t *b,
+                           size_t blen)
+{
+    size_t len = MIN(alen, blen);
+    size_t ram_start = len;
+    size_t ram_end = len;
+
+    for (size_t i = 0; i < G_N_ELEMENTS(ram_modules); i++) {
+        if (strcmp(ram_modules[i].name, module) == 0) {
+            ram_start = MIN(ram_modules[i].offset, len);
+            ram_end = MIN(ram_modules[i].offset + ram_modules[i].size, len);
+            break;
+        }
+    }
+
+    compare_segment(ranges, module, a, b, 0, ram_start, -1);
+    compare_segment(ranges, module, a, b, ram_start, ram_end, 0);
+    compare_segment(ranges, module, a, b, ram_end, len, -1);
+    if (alen > len) {
+        add_range(ranges, module, len, alen - len, -1, a, NULL);
+    } else if (blen > len) {
+        add_range(ranges, module, len, blen - len, -1, NULL, b);
+    }
+}
+
+
+/** \brief  Get module data
+ *
+ * \param[in]   data    snapshot contents
+ * \param[in]   module  module
+ *
+ * \return  pointer to the module data
+ */
+static const uint8_t *module_data(const uint8_t *data,
+                                  const snapshot_module_t *module)
+{
+    return data + module->offset + SNAPSHOT_MODULE_HEADER_SIZE;
+}
+
+
+/** \brief  Compare two snapshots
+ *
+ * \param[in]   old_name    old snapshot, file or name in the snapshot store
+ * \param[in]   new_name    new snapshot, file or name in the snapshot store
+ * \param[out]  error       error (optional)
+ *
+ * \return  diff, free with snapdiff_free(), or `NULL` on error
+ */
+snapdiff_t *snapdiff_new(const char *old_name,
+                         const char *new_name,
+                         GError **error)
+{
+    snapdiff_t *diff;
+    const uint8_t *a;
+    const uint8_t *b;
+    gsize alen;
+    gsize blen;
+    snapshot_index_t *old_index = NULL;
+    snapshot_index_t *new_index = NULL;
+
+    diff = g_malloc0(sizeof *diff);
+    diff->old_snapshot = load_snapshot(old_name, error);
+    if (diff->old_snapshot == NULL) {
+        snapdiff_free(diff);
+        return NULL;
+    }
+    diff->new_snapshot = load_snapshot(new_name, error);
+    if (diff->new_snapshot == NULL) {
+        snapdiff_free(diff);
+        return NULL;
+    }
+    a = g_bytes_get_data(diff->old_snapshot, &alen);
+    b = g_bytes_get_data(diff->new_snapshot, &blen);
+    old_index = snapshot_index_parse(a, alen, error);
+    if (old_index != NULL) {
+        new_index = snapshot_index_parse(b, blen, error);
+    }
+    if (new_index == NULL) {
+        snapshot_index_free(old_index);
+        snapdiff_free(diff);
+        return NULL;
+    }
+
+    diff->ranges = g_array_new(FALSE, FALSE, sizeof(snapdiff_range_t));
+    for (guint i = 0; i < old_index->modules->len; i++) {
+        const snapshot_module_t *om;
+        const snapshot_module_t *nm;
+        size_t osize;
+
+        om = &g_array_index(old_index->modules, snapshot_module_t, i);
+        nm = snapshot_index_find(new_index, om->name);
+        osize = om->size - SNAPSHOT_MODULE_HEADER_SIZE;
+        if (nm == NULL) {
+            add_range(diff->ranges, om->name, 0, osize, -1,
+                      module_data(a, om), NULL);
+        } else {
+            compare_module(diff->ranges,
+                           om->name,
+                           module_data(a, om),
+                           osize,
+                           module_data(b, nm),
+                           nm->size - SNAPSHOT_MODULE_HEADER_SIZE);
+        }
+    }
+    for (guint i = 0; i < new_index->modules->len; i++) {
+        const snapshot_module_t *nm;
+
+        nm = &g_array_index(new_index->modules, snapshot_module_t, i);
+        if (snapshot_index_find(old_index, nm->name) == NULL) {
+            add_range(diff->ranges, nm->name, 0,
+                      nm->size - SNAPSHOT_MODULE_HEADER_SIZE, -1,
+                      NULL, module_data(b, nm));
+        }
+    }
+
+    snapshot_index_free(old_index);
+    snapshot_index_free(new_index);
+    return diff;
+}
+
+
+/** \brief  Free snapshot diff
+ *
+ * \param[in]   diff    snapshot diff
+ */
+void snapdiff_free(snapdiff_t *diff)
+{
+    if (diff == NULL) {
+        return;
+    }
+    if (diff->old_snapshot != NULL) {
+        g_bytes_unref(diff->old_snapshot);
+    }
+    if (diff->new_snapshot != NULL) {
+        g_bytes_unref(diff->new_snapshot);
+    }
+    if (diff->ranges != NULL) {
+        g_array_free(diff->ranges, TRUE);
+    }
+    g_free(diff);
+}
+
+
+/** \brief  Format bytes of a range as hex
+ *
+ * At most SNAPDIFF_SHOW_BYTES bytes are shown, followed by "..." if there
+ * are more.
+ *
+ * \param[in]   data    bytes, or `NULL`
+ * \param[in]   length  number of bytes
+ *
+ * \return  string, free with g_free()
+ */
+char *snapdiff_format_bytes(const uint8_t *data, size_t length)
+{
+    GString *s;
+
+    if (data == NULL) {
+        return g_strdup("-");
+    }
+    s = g_string_new(NULL);
+    for (size_t i = 0; i < MIN(length, SNAPDIFF_SHOW_BYTES); i++) {
+        g_string_append_printf(s, i == 0 ? "%02x" : " %02x", data[i]);
+    }
+    if (length > SNAPDIFF_SHOW_BYTES) {
+        g_string_append(s, " ...");
+    }
+    return g_string_free(s, FALSE);
+}
+
+
+/** \brief  Describe range in a single line
+ *
+ * \param[in]   range   range
+ *
+ * \return  string, free with g_free()
+ */
+char *snapdiff_describe(const snapdiff_range_t *range)
+{
+    GString *s;
+    char *old_bytes;
+    char *new_bytes;
+
+    s = g_string_new(NULL);
+    g_string_append_printf(s, "%-16s +$%05zx %6zu",
+                           range->module, range->offset, range->length);
+    if (range->address >= 0) {
+        char label[256];
+
+        g_string_append_printf(s, "  $%04x-$%04x  %s",
+                               (unsigned int)range->address,
+                               (unsigned int)(range->address
+                                              + (int32_t)range->length - 1),
+                               symtab_annotate((uint16_t)range->address,
+                                               label,
+                                               sizeof(label)));
+    }
+    old_bytes = snapdiff_format_bytes(range->old_data, range->length);
+    new_bytes = snapdiff_format_bytes(range->new_data, range->length);
+    g_string_append_printf(s, "  %s -> %s", old_bytes, new_bytes);
+    g_free(old_bytes);
+    g_free(new_bytes);
+    return g_string_free(s, FALSE);
+}
@@ -0,0 +1,73 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   snapdiff.h
+ * \brief   Snapshot memory diff - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#ifndef VICEMON_SNAPDIFF_H
+#define VICEMON_SNAPDIFF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <glib.h>
+
+#include "snapshot.h"
+
+
+/** \brief  Range of changed bytes in a snapshot module
+ */
+typedef struct snapdiff_range_s {
+    char module[SNAPSHOT_NAME_LEN + 1]; /**< module name */
+    size_t offset;                      /**< offset in the module data */
+    size_t length;                      /**< length of the range */
+    int32_t address;                    /**< memory address or -1 */
+    const uint8_t *old_data;            /**< old bytes, `NULL` if absent */
+    const uint8_t *new_data;            /**< new bytes, `NULL` if absent */
+} snapdiff_range_t;
+
+
+/** \brief  Snapshot diff
+ */
+typedef struct snapdiff_s {
+    GBytes *old_snapshot;   /**< old snapshot file contents */
+    GBytes *new_snapshot;   /**< new snapshot file contents */
+    GArray *ranges;         /**< snapdiff_range_t */
+} snapdiff_t;
+
+
+snapdiff_t *snapdiff_new(const char *old_name,
+                         const char *new_name,
+                         GError **error);
+void        snapdiff_free(snapdiff_t *diff);
+char       *snapdiff_format_bytes(const uint8_t *data, size_t length);
+char       *snapdiff_describe(const snapdiff_range_t *range);
+
+#endif
@@ -0,0 +1,637 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   snapstore.c
+ * \brief   Content-addressed snapshot store
+ *
+ * Snapshot files are split into pages at module boundaries: the file header,
+ * each module header and each SNAPSTORE_PAGE_SIZE bytes of module data. Pages
+ * are stored once, identified by their SHA-1 digest, so memory that didn't
+ * change between snapshots takes no extra space.
+ *
+ * The store lives in `$XDG_CONFIG_HOME/gtk3vicemon/snapshots`:
+ *   - `pages.pack`: page data, append-only
+ *   - `pages.idx`: records of digest (20), offset (8) and size (4), append-only
+ *   - `<name>.vsm`: manifest, "VSM1", page count (4) and the page digests
+ *
+ * Page data is flushed before its index records are written, so a crash can
+ * only leave unreferenced data in the pack.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "debug.h"
+#include "log.h"
+#include "monitor.h"
+#include "settings.h"
+#include "snapshot.h"
+
+#include "snapstore.h"
+
+
+/** \brief  Size of a page digest (SHA-1)
+ */
+#define DIGEST_SIZE         20
+
+/** \brief  Size of an index record
+ */
+#define INDEX_RECORD_SIZE   (DIGEST_SIZE + 8 + 4)
+
+/** \brief  Manifest magic
+ */
+#define MANIFEST_MAGIC      "VSM1"
+
+/** \brief  Size of the manifest header (magic and page count)
+ */
+#define MANIFEST_HEADER_SIZE    8
+
+/** \brief  Manifest file extension
+ */
+#define MANIFEST_EXT        ".vsm"
+
+
+/** \brief  Page in the pack file
+ */
+typedef struct page_s {
+    uint8_t digest[DIGEST_SIZE];    /**< SHA-1 of the data */
+    uint64_t offset;                /**< offset in the pack file */
+    uint32_t size;                  /**< size of the data */
+} page_t;
+
+
+/** \brief  Store directory
+ */
+static char *store_dir = NULL;
+
+/** \brief  Pages in the store, keyed by digest
+ */
+static GHashTable *pages = NULL;
+
+/** \brief  Pack file, opened for appending
+ */
+static FILE *pack_file = NULL;
+
+/** \brief  Index file, opened for appending
+ */
+static FILE *index_file = NULL;
+
+/** \brief  Size of the pack file
+ */
+static uint64_t pack_size = 0;
+
+
+/** \brief  Hash function for pages
+ *
+ * \param[in]   key page
+ *
+ * \return  hash
+ */
+static guint page_hash(gconstpointer key)
+{
+    const page_t *page = key;
+
+    return MON_GET_U32(page->digest);
+}
+
+
+/** \brief  Equal function for pages
+ *
+ * \param[in]   a   page
+ * \param[in]   b   page
+ *
+ * \return  TRUE if the digests of \a a and \a b are equal
+ */
+static gboolean page_equal(gconstpointer a, gconstpointer b)
+{
+    return memcmp(((const page_t *)a)->digest,
+                  ((const page_t *)b)->digest,
+                  DIGEST_SIZE) == 0;
+}
+
+
+/** \brief  Get path of a file in the store
+ *
+ * \param[in]   name    file name
+ *
+ * \return  path, free with g_free()
+ */
+static char *store_path(const char *name)
+{
+    return g_build_filename(store_dir, name, NULL);
+}
+
+
+/** \brief  Get path of a manifest
+ *
+ * \param[in]   name    snapshot name
+ *
+ * \return  path, free with g_free()
+ */
+static char *manifest_path(const char *name)
+{
+    char *filename = g_strconcat(name, MANIFEST_EXT, NULL);
+    char *path = store_path(filename);
+
+    g_free(filename);
+    return path;
+}
+
+
+/** \brief  Set \a error from errno
+ *
+ * \param[out]  error   error
+ * \param[in]   what    description of the failed operation
+ * \param[in]   path    path of the file involved
+ */
+static void set_errno_error(GError **error, const char *what, const char *path)
+{
+    int err = errno;
+
+    g_set_error(error, G_IO_ERROR, g_io_error_from_errno(err),
+                "%s '%s': %s", what, path, g_strerror(err));
+}
+
+
+/** \brief  Load the page index
+ *
+ * Records referring to data beyond the end of the pack file are dropped.
+ *
+ * \param[in]   path    index file
+ */
+static void load_index(const char *path)
+{
+    char *contents;
+    gsize len;
+    gsize count;
+
+    if (!g_file_get_contents(path, &contents, &len, NULL)) {
+        return;
+    }
+    count = len / INDEX_RECORD_SIZE;
+    for (gsize i = 0; i < count; i++) {
+        const uint8_t *rec = (const uint8_t *)contents + i * INDEX_RECORD_SIZE;
+        page_t *page = g_malloc(sizeof *page);
+
+        memcpy(page->digest, rec, DIGEST_SIZE);
+        page->offset = (uint64_t)MON_GET_U32(rec + DIGEST_SIZE)
+                     | ((uint64_t)MON_GET_U32(rec + DIGEST_SIZE + 4) << 32);
+        page->size = MON_GET_U32(rec + DIGEST_SIZE + 8);
+        if (page->offset + page->size > pack_size
+                || page->size > SNAPSTORE_PAGE_SIZE) {
+            g_free(page);
+            continue;
+        }
+        g_hash_table_add(pages, page);
+    }
+    if (count * INDEX_RECORD_SIZE != len) {
+        /* drop partial record so appended records stay aligned */
+        log_msg(LOG_WARN, "Snapshot store: truncating partial index record.\n");
+        g_file_set_contents(path, contents, (gssize)(count * INDEX_RECORD_SIZE),
+                            NULL);
+    }
+    g_free(contents);
+}
+
+
+/** \brief  Open the snapshot store
+ *
+ * Creates the store directory if needed and loads the page index. Calling
+ * this function when the store is already open does nothing.
+ *
+ * \param[out]  error   error (optional)
+ *
+ * \return  true on success
+ */
+bool snapstore_open(GError **error)
+{
+    char *config;
+    char *pack_path;
+    char *index_path;
+    GStatBuf st;
+
+    if (pages != NULL) {
+        return true;
+    }
+
+    config = settings_get_dir();
+    store_dir = g_build_filename(config, "snapshots", NULL);
+    g_free(config);
+    if (g_mkdir_with_parents(store_dir, 0755) < 0) {
+        set_errno_error(error, "Failed to create directory", store_dir);
+        g_free(store_dir);
+        store_dir = NULL;
+        return false;
+    }
+
+    pack_path = store_path("pages.pack");
+    index_path = store_path("pages.idx");
+    pack_size = g_stat(pack_path, &st) == 0 ? (uint64_t)st.st_size : 0;
+
+    pages = g_hash_table_new_full(page_hash, page_equal, g_free, NULL);
+    load_index(index_path);
+
+    pack_file = g_fopen(pack_path, "ab");
+    if (pack_file == NULL) {
+        set_errno_error(error, "Failed to open", pack_path);
+    } else {
+        index_file = g_fopen(index_path, "ab");
+        if (index_file == NULL) {
+            set_errno_error(error, "Failed to open", index_path);
+        }
+    }
+    g_free(pack_path);
+    g_free(index_path);
+    if (index_file == NULL) {
+        snapstore_close();
+        return false;
+    }
+    debug_msg("Opened snapshot store with %u pages.", g_hash_table_size(pages));
+    return true;
+}
+
+
+/** \brief  Close the snapshot store
+ */
+void snapstore_close(void)
+{
+    if (pack_file != NULL) {
+        fclose(pack_file);
+        pack_file = NULL;
+    }
+    if (index_file != NULL) {
+        fclose(index_file);
+        index_file = NULL;
+    }
+    if (pages != NULL) {
+        g_hash_table_destroy(pages);
+        pages = NULL;
+    }
+    g_free(store_dir);
+    store_dir = NULL;
+    pack_size = 0;
+}
+
+
+/** \brief  Snapshot being added
+ */
+typedef struct add_state_s {
+    GChecksum *checksum;        /**< checksum object, reused */
+    GByteArray *manifest;       /**< manifest being built */
+    GByteArray *records;        /**< index records of new pages */
+    snapstore_stats_t *stats;   /**< statistics */
+    bool failed;                /**< writing to the pack file failed */
+} add_state_t;
+
+
+/** \brief  Add page to the store and its digest to the manifest
+ *
+ * \param[in,out]   state   add state
+ * \param[in]       data    page data
+ * \param[in]       size    size of \a data
+ */
+static void add_page(add_state_t *state, const uint8_t *data, size_t size)
+{
+    page_t key;
+    page_t *page;
+    gsize digest_len = DIGEST_SIZE;
+    uint8_t rec[INDEX_RECORD_SIZE];
+
+    g_checksum_reset(state->checksum);
+    g_checksum_update(state->checksum, data, (gssize)size);
+    g_checksum_get_digest(state->checksum, key.digest, &digest_len);
+    g_byte_array_append(state->manifest, key.digest, DIGEST_SIZE);
+    state->stats->pages++;
+
+    if (g_hash_table_contains(pages, &key)) {
+        return;
+    }
+    if (fwrite(data, 1, size, pack_file) != size) {
+        state->failed = true;
+        return;
+    }
+
+    page = g_malloc(sizeof *page);
+    memcpy(page->digest, key.digest, DIGEST_SIZE);
+    page->offset = pack_size;
+    page->size = (uint32_t)size;
+    g_hash_table_add(pages, page);
+    pack_size += size;
+
+    memcpy(rec, page->digest, DIGEST_SIZE);
+    MON_SET_U32(rec + DIGEST_SIZE, (uint32_t)page->offset);
+    MON_SET_U32(rec + DIGEST_SIZE + 4, (uint32_t)(page->offset >> 32));
+    MON_SET_U32(rec + DIGEST_SIZE + 8, page->size);
+    g_byte_array_append(state->records, rec, sizeof(rec));
+
+    state->stats->new_pages++;
+    state->stats->new_bytes += size;
+}
+
+
+/** \brief  Add region of a snapshot file, split into pages
+ *
+ * \param[in,out]   state   add state
+ * \param[in]       data    region data
+ * \param[in]       size    size of \a data
+ */
+static void add_region(add_state_t *state, const uint8_t *data, size_t size)
+{
+    while (size > 0) {
+        size_t chunk = MIN(size, SNAPSTORE_PAGE_SIZE);
+
+        add_page(state, data, chunk);
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+
+/** \brief  Check snapshot name
+ *
+ * \param[in]   name    snapshot name
+ * \param[out]  error   error (optional)
+ *
+ * \return  true if \a name can be used as file name
+ */
+static bool check_name(const char *name, GError **error)
+{
+    if (*name == '\0' || *name == '.' || strchr(name, G_DIR_SEPARATOR) != NULL) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_FILENAME,
+                    "invalid snapshot name '%s'", name);
+        return false;
+    }
+    return true;
+}
+
+
+/** \brief  Add snapshot file to the store
+ *
+ * \param[in]   path    snapshot file
+ * \param[in]   name    name for the snapshot, replaces an existing snapshot
+ * \param[out]  stats   statistics (optional)
+ * \param[out]  error   error (optional)
+ *
+ * \return  true on success
+ */
+bool snapstore_add(const char *path,
+                   const char *name,
+                   snapstore_stats_t *stats,
+                   GError **error)
+{
+    GMappedFile *mapped;
+    const uint8_t *data;
+    size_t len;
+    snapshot_index_t *index;
+    snapstore_stats_t dummy;
+    add_state_t state;
+    char *mpath;
+    bool ok;
+
+    if (!check_name(name, error) || !snapstore_open(error)) {
+        return false;
+    }
+    mapped = g_mapped_file_new(path, FALSE, error);
+    if (mapped == NULL) {
+        return false;
+    }
+    data = (const uint8_t *)g_mapped_file_get_contents(mapped);
+    len = g_mapped_file_get_length(mapped);
+    index = snapshot_index_parse(data, len, error);
+    if (index == NULL) {
+        g_mapped_file_unref(mapped);
+        return false;
+    }
+
+    if (stats == NULL) {
+        stats = &dummy;
+    }
+    memset(stats, 0, sizeof *stats);
+    stats->bytes = len;
+    state.checksum = g_checksum_new(G_CHECKSUM_SHA1);
+    state.manifest = g_byte_array_new();
+    state.records = g_byte_array_new();
+    state.stats = stats;
+    state.failed = false;
+
+    g_byte_array_append(state.manifest, (const guint8 *)MANIFEST_MAGIC, 4);
+    g_byte_array_set_size(state.manifest, MANIFEST_HEADER_SIZE);
+
+    add_region(&state, data, index->header_size);
+    for (guint i = 0; i < index->modules->len; i++) {
+        const snapshot_module_t *module;
+
+        module = &g_array_index(index->modules, snapshot_module_t, i);
+        add_region(&state, data + module->offset, SNAPSHOT_MODULE_HEADER_SIZE);
+        add_region(&state,
+                   data + module->offset + SNAPSHOT_MODULE_HEADER_SIZE,
+                   module->size - SNAPSHOT_MODULE_HEADER_SIZE);
+    }
+    MON_SET_U32(state.manifest->data + 4, (uint32_t)stats->pages);
+
+    /* page data must be on disk before the index refers to it */
+    ok = !state.failed && fflush(pack_file) == 0;
+    if (ok && state.records->len > 0) {
+        ok = fwrite(state.records->data, 1, state.records->len, index_file)
+                == state.records->len
+            && fflush(index_file) == 0;
+    }
+    if (!ok) {
+        set_errno_error(error, "Failed to write to", store_dir);
+    } else {
+        mpath = manifest_path(name);
+        ok = g_file_set_contents(mpath,
+                                 (const char *)state.manifest->data,
+                                 (gssize)state.manifest->len,
+                                 error);
+        g_free(mpath);
+    }
+
+    g_checksum_free(state.checksum);
+    g_byte_array_unref(state.manifest);
+    g_byte_array_unref(state.records);
+    snapshot_index_free(index);
+    g_mapped_file_unref(mapped);
+    if (!ok) {
+        /* the in-memory index may refer to pages that never made it */
+        snapstore_close();
+    }
+    return ok;
+}
+
+
+/** \brief  Load snapshot from the store
+ *
+ * \param[in]   name    snapshot name
+ * \param[out]  error   error (optional)
+ *
+ * \return  snapshot file contents, or `NULL` on error
+ */
+GBytes *snapstore_load(const char *name, GError **error)
+{
+    char *mpath;
+    char *manifest;
+    gsize mlen;
+    uint32_t count;
+    char *pack_path;
+    FILE *fp;
+    GByteArray *result;
+
+    if (!check_name(name, error) || !snapstore_open(error)) {
+        return NULL;
+    }
+    mpath = manifest_path(name);
+    if (!g_file_get_contents(mpath, &manifest, &mlen, error)) {
+        g_free(mpath);
+        return NULL;
+    }
+    g_free(mpath);
+    count = mlen >= MANIFEST_HEADER_SIZE
+          ? MON_GET_U32((const uint8_t *)manifest + 4) : 0;
+    if (mlen < MANIFEST_HEADER_SIZE
+            || memcmp(manifest, MANIFEST_MAGIC, 4) != 0
+            || mlen != MANIFEST_HEADER_SIZE + (gsize)count * DIGEST_SIZE) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "invalid manifest for snapshot '%s'", name);
+        g_free(manifest);
+        return NULL;
+    }
+
+    pack_path = store_path("pages.pack");
+    fp = g_fopen(pack_path, "rb");
+    if (fp == NULL) {
+        set_errno_error(error, "Failed to open", pack_path);
+        g_free(pack_path);
+        g_free(manifest);
+        return NULL;
+    }
+    g_free(pack_path);
+
+    result = g_byte_array_sized_new(count * SNAPSTORE_PAGE_SIZE);
+    for (uint32_t i = 0; i < count; i++) {
+        page_t key;
+        const page_t *page;
+        uint8_t buffer[SNAPSTORE_PAGE_SIZE];
+
+        memcpy(key.digest,
+               manifest + MANIFEST_HEADER_SIZE + i * DIGEST_SIZE,
+               DIGEST_SIZE);
+        page = g_hash_table_lookup(pages, &key);
+        if (page == NULL
+                || fseeko(fp, (off_t)page->offset, SEEK_SET) != 0
+                || fread(buffer, 1, page->size, fp) != page->size) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                        "missing page %u of snapshot '%s'", i, name);
+            g_byte_array_unref(result);
+            result = NULL;
+            break;
+        }
+        g_byte_array_append(result, buffer, page->size);
+    }
+    fclose(fp);
+    g_free(manifest);
+    return result != NULL ? g_byte_array_free_to_bytes(result) : NULL;
+}
+
+
+/** \brief  Write snapshot from the store to a file
+ *
+ * \param[in]   name    snapshot name
+ * \param[in]   path    snapshot file to write
+ * \param[out]  error   error (optional)
+ *
+ * \return  true on success
+ */
+bool snapstore_extract(const char *name, const char *path, GError **error)
+{
+    GBytes *bytes;
+    gsize len;
+    const char *data;
+    bool ok;
+
+    bytes = snapstore_load(name, error);
+    if (bytes == NULL) {
+        return false;
+    }
+    data = g_bytes_get_data(bytes, &len);
+    ok = g_file_set_contents(path, data, (gssize)len, error);
+    g_bytes_unref(bytes);
+    return ok;
+}
+
+
+/** \brief  Compare function for sorting snapshot names
+ *
+ * \param[in]   a   pointer to name
+ * \param[in]   b   pointer to name
+ *
+ * \return  <0, 0 or >0
+ */
+static gint compare_names(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+
+/** \brief  Get names of the snapshots in the store
+ *
+ * \return  sorted `NULL`-terminated list of names, free with g_strfreev()
+ */
+char **snapstore_list(void)
+{
+    GPtrArray *names = g_ptr_array_new();
+    GDir *dir;
+    const char *filename;
+
+    if (snapstore_open(NULL)) {
+        dir = g_dir_open(store_dir, 0, NULL);
+        if (dir != NULL) {
+            while ((filename = g_dir_read_name(dir)) != NULL) {
+                if (g_str_has_suffix(filename, MANIFEST_EXT)) {
+                    g_ptr_array_add(names,
+                                    g_strndup(filename,
+                                              strlen(filename)
+                                              - strlen(MANIFEST_EXT)));
+                }
+            }
+            g_dir_close(dir);
+        }
+        g_ptr_array_sort(names, compare_names);
+    }
+    g_ptr_array_add(names, NULL);
+    return (char **)g_ptr_array_free(names, FALSE);
+}
@@ -0,0 +1,67 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   snapstore.h
+ * \brief   Content-addressed snapshot store - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#ifndef VICEMON_SNAPSTORE_H
+#define VICEMON_SNAPSTORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <glib.h>
+
+/** \brief  Maximum size of the pages snapshots are split into
+ */
+#define SNAPSTORE_PAGE_SIZE 256
+
+
+/** \brief  Statistics of adding a snapshot to the store
+ */
+typedef struct snapstore_stats_s {
+    size_t pages;       /**< number of pages in the snapshot */
+    size_t new_pages;   /**< number of pages not yet in the store */
+    size_t bytes;       /**< size of the snapshot */
+    size_t new_bytes;   /**< bytes added to the store */
+} snapstore_stats_t;
+
+
+bool    snapstore_open(GError **error);
+void    snapstore_close(void);
+
+bool    snapstore_add(const char *path,
+                      const char *name,
+                      snapstore_stats_t *stats,
+                      GError **error);
+GBytes *snapstore_load(const char *name, GError **error);
+bool    snapstore_extract(const char *name, const char *path, GError **error);
+char  **snapstore_list(void);
+
+#endif
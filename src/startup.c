@@ -0,0 +1,102 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   startup.c
+ * \brief   Startup time measurement
+ *
+ * Records the time from entering main() to milestones like the window being
+ * shown, the first frame being painted and the first session being
+ * connected. With the --startup-time command line option each milestone is
+ * printed on stderr as it is reached, milestones are always logged at the
+ * debug level.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdbool.h>
+
+#include "log.h"
+
+#include "startup.h"
+
+
+/** \brief  Monotonic time of startup_begin()
+ */
+static gint64 start_time = 0;
+
+/** \brief  Print milestones on stderr
+ */
+static bool report_enabled = false;
+
+
+/** \brief  Start measuring
+ *
+ * Call as early as possible in main().
+ */
+void startup_begin(void)
+{
+    start_time = g_get_monotonic_time();
+}
+
+
+/** \brief  Enable printing milestones on stderr
+ *
+ * \param[in]   report  print milestones
+ */
+void startup_set_report(bool report)
+{
+    report_enabled = report;
+}
+
+
+/** \brief  Get time since startup_begin()
+ *
+ * \return  microseconds
+ */
+gint64 startup_elapsed(void)
+{
+    return g_get_monotonic_time() - start_time;
+}
+
+
+/** \brief  Record reaching \a milestone
+ *
+ * \param[in]   milestone   name of the milestone
+ */
+void startup_mark(const char *milestone)
+{
+    double ms = (double)startup_elapsed() / 1000.0;
+
+    if (report_enabled) {
+        g_printerr("startup: %-16s %8.1f ms\n", milestone, ms);
+    }
+    log_msg(LOG_DEBUG, "startup: %s after %.1f ms\n", milestone, ms);
+}
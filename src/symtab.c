@@ -0,0 +1,845 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   symtab.c
+ * \brief   Symbol table
+ *
+ * Loads symbols from assembler output and provides address to label and
+ * label to address lookups.
+ *
+ * Symbols are stored in an array sorted on address, with the names in a single
+ * string pool, so looking up the nearest symbol below an address is a binary
+ * search. Names are indexed with a hash table pointing into the pool.
+ *
+ * Symbol files are memory mapped and parsed in place, so large files don't
+ * need to be copied into lines first.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "log.h"
+
+#include "symtab.h"
+
+
+/** \brief  Maximum offset for symtab_annotate() to use 'label+offset'
+ */
+#define ANNOTATE_MAX_OFFSET 0xff
+
+
+/** \brief  Size of an entry written by symtab_export()
+ *
+ * 32-bit name offset followed by the 16-bit address, without padding.
+ */
+#define EXPORT_ENTRY_SIZE   6
+
+
+/** \brief  Symbol table entry
+ */
+typedef struct symtab_entry_s {
+    uint32_t name;  /**< offset of name in the string pool */
+    uint16_t addr;  /**< address */
+} symtab_entry_t;
+
+
+/** \brief  Symbols, sorted on address
+ */
+static GArray *entries = NULL;
+
+/** \brief  String pool for symbol names
+ */
+static GString *pool = NULL;
+
+/** \brief  Name index (name -> address)
+ *
+ * Keys point into the string pool.
+ */
+static GHashTable *names = NULL;
+
+/** \brief  KickAssembler namespace prefix
+ */
+static GString *kick_namespace = NULL;
+
+
+/** \brief  Get name of \a entry
+ */
+#define ENTRY_NAME(entry)   (pool->str + (entry)->name)
+
+
+/** \brief  Check for space or tab
+ */
+#define IS_BLANK(c) ((c) == ' ' || (c) == '\t')
+
+
+/** \brief  Check for character valid in a symbol name
+ */
+#define IS_NAME_CHAR(c) \
+    (g_ascii_isalnum(c) || (c) == '_' || (c) == '.' || (c) == '@' || \
+     (c) == '$' || (c) == '+' || (c) == '-' || (c) == ':')
+
+
+/** \brief  Skip spaces and tabs
+ *
+ * \param[in]   p   pointer in line
+ * \param[in]   end end of line
+ *
+ * \return  pointer to first non-blank character or \a end
+ */
+static const char *skip_blanks(const char *p, const char *end)
+{
+    while (p < end && IS_BLANK(*p)) {
+        p++;
+    }
+    return p;
+}
+
+
+/** \brief  Parse hexadecimal digits
+ *
+ * \param[in,out]   pp      pointer in line, updated to point past the digits
+ * \param[in]       end     end of line
+ * \param[out]      value   value
+ *
+ * \return  true if at least one digit was parsed
+ */
+static bool parse_hex(const char **pp, const char *end, uint32_t *value)
+{
+    const char *p = *pp;
+    uint32_t v = 0;
+
+    while (p < end && g_ascii_isxdigit(*p)) {
+        v = (v << 4) | (uint32_t)g_ascii_xdigit_value(*p);
+        p++;
+    }
+    if (p == *pp) {
+        return false;
+    }
+    *pp = p;
+    *value = v;
+    return true;
+}
+
+
+/** \brief  Parse number in '$hex', '0xhex', '%binary' or decimal notation
+ *
+ * \param[in,out]   pp      pointer in line, updated to point past the number
+ * \param[in]       end     end of line
+ * \param[out]      value   value
+ *
+ * \return  true on success
+ */
+static bool parse_number(const char **pp, const char *end, uint32_t *value)
+{
+    const char *p = *pp;
+    uint32_t v = 0;
+
+    if (p < end && *p == '$') {
+        p++;
+        if (!parse_hex(&p, end, value)) {
+            return false;
+        }
+        *pp = p;
+        return true;
+    }
+    if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        p += 2;
+        if (!parse_hex(&p, end, value)) {
+            return false;
+        }
+        *pp = p;
+        return true;
+    }
+    if (p < end && *p == '%') {
+        p++;
+        while (p < end && (*p == '0' || *p == '1')) {
+            v = (v << 1) | (uint32_t)(*p - '0');
+            p++;
+        }
+    } else {
+        while (p < end && g_ascii_isdigit(*p)) {
+            v = v * 10 + (uint32_t)(*p - '0');
+            p++;
+        }
+    }
+    if (p == *pp) {
+        return false;
+    }
+    *pp = p;
+    *value = v;
+    return true;
+}
+
+
+/** \brief  Add symbol to the table
+ *
+ * \param[in]   prefix  prefix for name (can be `NULL`)
+ * \param[in]   name    name (not NUL-terminated)
+ * \param[in]   len     length of \a name
+ * \param[in]   value   address
+ *
+ * \return  true if added
+ */
+static bool add_symbol(const char *prefix,
+                       const char *name,
+                       size_t len,
+                       uint32_t value)
+{
+    symtab_entry_t entry;
+
+    if (len == 0 || value > 0xffff) {
+        return false;
+    }
+    entry.name = (uint32_t)pool->len;
+    entry.addr = (uint16_t)value;
+    if (prefix != NULL) {
+        g_string_append(pool, prefix);
+    }
+    g_string_append_len(pool, name, (gssize)len);
+    g_string_append_c(pool, '\0');
+    g_array_append_val(entries, entry);
+    return true;
+}
+
+
+/** \brief  Parse VICE label line: `al C:080d .label`
+ *
+ * Also accepts the `al 00080d .label` lines written by ld65 -Ln.
+ */
+static bool parse_vice_line(const char *p, const char *end)
+{
+    const char *name;
+    uint32_t value;
+
+    p = skip_blanks(p, end);
+    if (end - p < 3 || p[0] != 'a' || p[1] != 'l' || !IS_BLANK(p[2])) {
+        return false;
+    }
+    p = skip_blanks(p + 2, end);
+    if (end - p > 2 && p[1] == ':') {
+        p += 2;     /* memspace prefix */
+    }
+    if (!parse_hex(&p, end, &value)) {
+        return false;
+    }
+    p = skip_blanks(p, end);
+    if (p == end || *p != '.') {
+        return false;
+    }
+    name = ++p;
+    while (p < end && !IS_BLANK(*p) && *p != '\r') {
+        p++;
+    }
+    return add_symbol(NULL, name, (size_t)(p - name), value);
+}
+
+
+/** \brief  Find field \a key in a ca65 debug info line
+ *
+ * \param[in]   p       pointer in line
+ * \param[in]   end     end of line
+ * \param[in]   key     field name
+ * \param[out]  vend    end of value
+ *
+ * \return  start of value (without quotes) or `NULL` when not found
+ */
+static const char *dbg_field(const char *p, const char *end,
+                             const char *key, const char **vend)
+{
+    size_t keylen = strlen(key);
+
+    while (p < end) {
+        bool match;
+
+        while (p < end && (IS_BLANK(*p) || *p == ',')) {
+            p++;
+        }
+        match = (size_t)(end - p) > keylen
+            && memcmp(p, key, keylen) == 0
+            && p[keylen] == '=';
+        if (match) {
+            p += keylen + 1;
+            if (p < end && *p == '"') {
+                const char *q = memchr(p + 1, '"', (size_t)(end - p - 1));
+
+                *vend = q != NULL ? q : end;
+                return p + 1;
+            }
+            *vend = p;
+            while (*vend < end && **vend != ',' && **vend != '\r') {
+                (*vend)++;
+            }
+            return p;
+        }
+        /* skip field, minding quotes */
+        while (p < end && *p != ',') {
+            if (*p == '"') {
+                const char *q = memchr(p + 1, '"', (size_t)(end - p - 1));
+
+                if (q == NULL) {
+                    return NULL;
+                }
+                p = q;
+            }
+            p++;
+        }
+    }
+    return NULL;
+}
+
+
+/** \brief  Parse ca65 debug info line: `sym id=0,name="x",...,val=0x80D,...,type=lab`
+ */
+static bool parse_ca65_line(const char *p, const char *end)
+{
+    const char *name;
+    const char *name_end;
+    const char *val;
+    const char *val_end;
+    const char *type;
+    const char *type_end;
+    uint32_t value;
+
+    if (end - p < 4 || memcmp(p, "sym", 3) != 0 || !IS_BLANK(p[3])) {
+        return false;
+    }
+    p += 4;
+    name = dbg_field(p, end, "name", &name_end);
+    val = dbg_field(p, end, "val", &val_end);
+    type = dbg_field(p, end, "type", &type_end);
+    if (name == NULL || val == NULL || type == NULL
+            || type_end - type != 3 || memcmp(type, "lab", 3) != 0
+            || !parse_number(&val, val_end, &value)) {
+        return false;
+    }
+    return add_symbol(NULL, name, (size_t)(name_end - name), value);
+}
+
+
+/** \brief  Parse ACME symbol list line: `label = $1234 ; ?`
+ */
+static bool parse_acme_line(const char *p, const char *end)
+{
+    const char *name;
+    size_t len;
+    uint32_t value;
+
+    p = skip_blanks(p, end);
+    name = p;
+    while (p < end && IS_NAME_CHAR(*p)) {
+        p++;
+    }
+    len = (size_t)(p - name);
+    p = skip_blanks(p, end);
+    if (len == 0 || p == end || *p != '=') {
+        return false;
+    }
+    p = skip_blanks(p + 1, end);
+    if (!parse_number(&p, end, &value)) {
+        return false;
+    }
+    return add_symbol(NULL, name, len, value);
+}
+
+
+/** \brief  Parse KickAssembler symbol line: `.label name=$1234`
+ *
+ * Namespaces (`.namespace name {` ... `}`) are prepended to the names.
+ */
+static bool parse_kickass_line(const char *p, const char *end)
+{
+    const char *name;
+    size_t len;
+    uint32_t value;
+
+    p = skip_blanks(p, end);
+    if (p < end && *p == '}') {
+        /* end of namespace: strip last component */
+        const char *dot;
+
+        if (kick_namespace->len > 0) {
+            g_string_truncate(kick_namespace, kick_namespace->len - 1);
+            dot = strrchr(kick_namespace->str, '.');
+            g_string_truncate(kick_namespace,
+                    dot != NULL ? (gsize)(dot - kick_namespace->str) + 1 : 0);
+        }
+        return false;
+    }
+    if (end - p > 11
+            && memcmp(p, ".namespace", 10) == 0
+            && IS_BLANK(p[10])) {
+        p = skip_blanks(p + 10, end);
+        name = p;
+        while (p < end && IS_NAME_CHAR(*p)) {
+            p++;
+        }
+        g_string_append_len(kick_namespace, name, p - name);
+        g_string_append_c(kick_namespace, '.');
+        return false;
+    }
+    if (end - p < 7 || memcmp(p, ".label", 6) != 0 || !IS_BLANK(p[6])) {
+        return false;
+    }
+    p = skip_blanks(p + 6, end);
+    name = p;
+    while (p < end && IS_NAME_CHAR(*p)) {
+        p++;
+    }
+    len = (size_t)(p - name);
+    p = skip_blanks(p, end);
+    if (p == end || *p != '=') {
+        return false;
+    }
+    p = skip_blanks(p + 1, end);
+    if (!parse_number(&p, end, &value)) {
+        return false;
+    }
+    return add_symbol(kick_namespace->str, name, len, value);
+}
+
+
+/** \brief  Detect format of symbol file
+ *
+ * \param[in]   path    path to file
+ * \param[in]   data    file contents
+ * \param[in]   size    size of \a data
+ *
+ * \return  format
+ */
+static symtab_format_t detect_format(const char *path,
+                                     const char *data,
+                                     size_t size)
+{
+    const char *p = data;
+    const char *end = data + size;
+
+    if (g_str_has_suffix(path, ".dbg")) {
+        return SYMTAB_FORMAT_CA65;
+    }
+
+    /* check first non-empty line */
+    while (p < end && g_ascii_isspace(*p)) {
+        p++;
+    }
+    if (end - p >= 3 && memcmp(p, "al", 2) == 0 && IS_BLANK(p[2])) {
+        return SYMTAB_FORMAT_VICE;
+    }
+    if (end - p >= 7 && memcmp(p, "version", 7) == 0) {
+        return SYMTAB_FORMAT_CA65;
+    }
+    if (p < end && *p == '.') {
+        return SYMTAB_FORMAT_KICKASS;
+    }
+    return SYMTAB_FORMAT_ACME;
+}
+
+
+/** \brief  Compare symbols on address, then name
+ */
+static gint compare_entries(gconstpointer a, gconstpointer b)
+{
+    const symtab_entry_t *e1 = a;
+    const symtab_entry_t *e2 = b;
+
+    if (e1->addr != e2->addr) {
+        return e1->addr < e2->addr ? -1 : 1;
+    }
+    return strcmp(ENTRY_NAME(e1), ENTRY_NAME(e2));
+}
+
+
+/** \brief  Rebuild the name index
+ *
+ * The pool might have been reallocated, so all keys are rebuilt.
+ */
+static void rebuild_names(void)
+{
+    g_hash_table_remove_all(names);
+    for (guint i = 0; i < entries->len; i++) {
+        symtab_entry_t *entry = &g_array_index(entries, symtab_entry_t, i);
+
+        g_hash_table_replace(names, ENTRY_NAME(entry),
+                             GUINT_TO_POINTER(entry->addr));
+    }
+}
+
+
+/** \brief  Sort symbols, remove duplicates and rebuild the name index
+ */
+static void rebuild_index(void)
+{
+    guint i;
+    guint j = 0;
+
+    g_array_sort(entries, compare_entries);
+    for (i = 0; i < entries->len; i++) {
+        symtab_entry_t *entry = &g_array_index(entries, symtab_entry_t, i);
+
+        if (j > 0 && compare_entries(entry,
+                    &g_array_index(entries, symtab_entry_t, j - 1)) == 0) {
+            continue;
+        }
+        g_array_index(entries, symtab_entry_t, j++) = *entry;
+    }
+    g_array_set_size(entries, j);
+    rebuild_names();
+}
+
+
+/** \brief  Create the symbol table if it doesn't exist yet
+ */
+static void table_init(void)
+{
+    if (entries == NULL) {
+        entries = g_array_new(FALSE, FALSE, sizeof(symtab_entry_t));
+        pool = g_string_new(NULL);
+        names = g_hash_table_new(g_str_hash, g_str_equal);
+        kick_namespace = g_string_new(NULL);
+    }
+}
+
+
+/** \brief  Load symbols from \a path
+ *
+ * Symbols are added to the ones already loaded.
+ *
+ * \param[in]   path    path to symbol file
+ * \param[in]   format  file format
+ * \param[out]  error   error (optional)
+ *
+ * \return  number of symbols loaded, or -1 on error
+ */
+int symtab_load(const char *path, symtab_format_t format, GError **error)
+{
+    GMappedFile *file;
+    const char *data;
+    const char *p;
+    const char *end;
+    bool (*parse_line)(const char *, const char *);
+    int count = 0;
+
+    file = g_mapped_file_new(path, FALSE, error);
+    if (file == NULL) {
+        return -1;
+    }
+    data = g_mapped_file_get_contents(file);
+    if (data == NULL) {
+        /* empty file */
+        g_mapped_file_unref(file);
+        return 0;
+    }
+    p = data;
+    end = data + g_mapped_file_get_length(file);
+
+    table_init();
+
+    if (format == SYMTAB_FORMAT_AUTO) {
+        format = detect_format(path, data, (size_t)(end - data));
+    }
+    switch (format) {
+        case SYMTAB_FORMAT_CA65:
+            parse_line = parse_ca65_line;
+            break;
+        case SYMTAB_FORMAT_ACME:
+            parse_line = parse_acme_line;
+            break;
+        case SYMTAB_FORMAT_KICKASS:
+            parse_line = parse_kickass_line;
+            g_string_truncate(kick_namespace, 0);
+            break;
+        default:
+            parse_line = parse_vice_line;
+            break;
+    }
+
+    while (p < end) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+
+        if (eol == NULL) {
+            eol = end;
+        }
+        if (parse_line(p, eol)) {
+            count++;
+        }
+        p = eol + 1;
+    }
+    g_mapped_file_unref(file);
+
+    rebuild_index();
+    log_msg(LOG_INFO, "Loaded %d symbols from '%s'.\n", count, path);
+    return count;
+}
+
+
+/** \brief  Append the symbol index to \a out
+ *
+ * The index is stored in host byte order: a 32-bit entry count, a 32-bit
+ * pool size, the sorted entries and the string pool. Each entry is written
+ * field by field (EXPORT_ENTRY_SIZE bytes), so no struct padding ends up in
+ * the output. It's meant for caching on the same host only, symtab_import()
+ * skips parsing and sorting.
+ *
+ * \param[in,out]   out byte array
+ */
+void symtab_export(GByteArray *out)
+{
+    uint32_t count = (uint32_t)symtab_count();
+    uint32_t size = count > 0 ? (uint32_t)pool->len : 0;
+
+    g_byte_array_append(out, (const guint8 *)&count, sizeof(count));
+    g_byte_array_append(out, (const guint8 *)&size, sizeof(size));
+    for (uint32_t i = 0; i < count; i++) {
+        const symtab_entry_t *entry = &g_array_index(entries,
+                                                     symtab_entry_t, i);
+        uint8_t rec[EXPORT_ENTRY_SIZE];
+
+        memcpy(rec, &entry->name, sizeof(entry->name));
+        memcpy(rec + sizeof(entry->name), &entry->addr, sizeof(entry->addr));
+        g_byte_array_append(out, rec, sizeof(rec));
+    }
+    if (count > 0) {
+        g_byte_array_append(out, (const guint8 *)pool->str, size);
+    }
+}
+
+
+/** \brief  Replace symbols with an index created by symtab_export()
+ *
+ * \param[in]   data    index
+ * \param[in]   size    size of \a data
+ *
+ * \return  number of symbols imported, or -1 if \a data is invalid
+ */
+int symtab_import(const uint8_t *data, size_t size)
+{
+    uint32_t count;
+    uint32_t pool_size;
+
+    if (size < sizeof(uint32_t) * 2) {
+        return -1;
+    }
+    memcpy(&count, data, sizeof(count));
+    memcpy(&pool_size, data + sizeof(count), sizeof(pool_size));
+    data += sizeof(uint32_t) * 2;
+    size -= sizeof(uint32_t) * 2;
+    if (size < pool_size
+            || size - pool_size != (size_t)count * EXPORT_ENTRY_SIZE
+            || (count > 0 && data[size - 1] != '\0')) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t name;
+
+        memcpy(&name, data + i * EXPORT_ENTRY_SIZE, sizeof(name));
+        if (name >= pool_size) {
+            return -1;
+        }
+    }
+
+    table_init();
+    symtab_clear();
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t *rec = data + i * EXPORT_ENTRY_SIZE;
+        symtab_entry_t entry;
+
+        memcpy(&entry.name, rec, sizeof(entry.name));
+        memcpy(&entry.addr, rec + sizeof(entry.name), sizeof(entry.addr));
+        g_array_append_val(entries, entry);
+    }
+    g_string_append_len(pool,
+                        (const char *)data + count * EXPORT_ENTRY_SIZE,
+                        pool_size);
+    rebuild_names();
+    return (int)count;
+}
+
+
+/** \brief  Remove all symbols
+ */
+void symtab_clear(void)
+{
+    if (entries != NULL) {
+        g_hash_table_remove_all(names);
+        g_array_set_size(entries, 0);
+        g_string_truncate(pool, 0);
+    }
+}
+
+
+/** \brief  Free memory used by the symbol table
+ */
+void symtab_exit(void)
+{
+    if (entries != NULL) {
+        g_hash_table_destroy(names);
+        g_array_free(entries, TRUE);
+        g_string_free(pool, TRUE);
+        g_string_free(kick_namespace, TRUE);
+        entries = NULL;
+    }
+}
+
+
+/** \brief  Get number of symbols
+ *
+ * \return  number of symbols
+ */
+size_t symtab_count(void)
+{
+    return entries != NULL ? entries->len : 0;
+}
+
+
+/** \brief  Find index of the last symbol at or below \a addr
+ *
+ * \param[in]   addr    address
+ *
+ * \return  index or -1 when there's no symbol at or below \a addr
+ */
+static gssize find_below(uint16_t addr)
+{
+    gssize lo = 0;
+    gssize hi;
+
+    if (entries == NULL || entries->len == 0) {
+        return -1;
+    }
+    hi = (gssize)entries->len - 1;
+    if (g_array_index(entries, symtab_entry_t, 0).addr > addr) {
+        return -1;
+    }
+    /* invariant: entries[lo].addr <= addr */
+    while (lo < hi) {
+        gssize mid = lo + (hi - lo + 1) / 2;
+
+        if (g_array_index(entries, symtab_entry_t, mid).addr <= addr) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    /* use the first of multiple symbols at the same address */
+    while (lo > 0
+            && g_array_index(entries, symtab_entry_t, lo - 1).addr
+               == g_array_index(entries, symtab_entry_t, lo).addr) {
+        lo--;
+    }
+    return lo;
+}
+
+
+/** \brief  Look up symbol at \a addr
+ *
+ * \param[in]   addr    address
+ *
+ * \return  name or `NULL` when there's no symbol at \a addr
+ */
+const char *symtab_lookup_addr(uint16_t addr)
+{
+    gssize index = find_below(addr);
+    symtab_entry_t *entry;
+
+    if (index < 0) {
+        return NULL;
+    }
+    entry = &g_array_index(entries, symtab_entry_t, index);
+    return entry->addr == addr ? ENTRY_NAME(entry) : NULL;
+}
+
+
+/** \brief  Look up nearest symbol at or below \a addr
+ *
+ * \param[in]   addr    address
+ * \param[out]  offset  offset of \a addr from the symbol (optional)
+ *
+ * \return  name or `NULL` when there's no symbol at or below \a addr
+ */
+const char *symtab_nearest(uint16_t addr, uint16_t *offset)
+{
+    gssize index = find_below(addr);
+    symtab_entry_t *entry;
+
+    if (index < 0) {
+        return NULL;
+    }
+    entry = &g_array_index(entries, symtab_entry_t, index);
+    if (offset != NULL) {
+        *offset = (uint16_t)(addr - entry->addr);
+    }
+    return ENTRY_NAME(entry);
+}
+
+
+/** \brief  Look up address of symbol \a name
+ *
+ * \param[in]   name    symbol name
+ * \param[out]  addr    address
+ *
+ * \return  true if found
+ */
+bool symtab_lookup_name(const char *name, uint16_t *addr)
+{
+    gpointer value;
+
+    if (names == NULL
+            || !g_hash_table_lookup_extended(names, name, NULL, &value)) {
+        return false;
+    }
+    *addr = (uint16_t)GPOINTER_TO_UINT(value);
+    return true;
+}
+
+
+/** \brief  Format \a addr as 'label', 'label+$offset' or '$addr'
+ *
+ * \param[in]   addr    address
+ * \param[out]  buffer  buffer for the result
+ * \param[in]   size    size of \a buffer
+ *
+ * \return  \a buffer
+ */
+char *symtab_annotate(uint16_t addr, char *buffer, size_t size)
+{
+    uint16_t offset = 0;
+    const char *name = symtab_nearest(addr, &offset);
+
+    if (name == NULL || offset > ANNOTATE_MAX_OFFSET) {
+        g_snprintf(buffer, size, "$%04x", addr);
+    } else if (offset == 0) {
+        g_snprintf(buffer, size, "%s", name);
+    } else {
+        g_snprintf(buffer, size, "%s+$%02x", name, offset);
+    }
+    return buffer;
+}
@@ -0,0 +1,67 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   symtab.h
+ * \brief   Symbol table - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#ifndef VICEMON_SYMTAB_H
+#define VICEMON_SYMTAB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <glib.h>
+
+
+/** \brief  Symbol file formats
+ */
+typedef enum symtab_format_e {
+    SYMTAB_FORMAT_AUTO,     /**< detect from file name and contents */
+    SYMTAB_FORMAT_VICE,     /**< VICE labels (`al C:1234 .label`) */
+    SYMTAB_FORMAT_CA65,     /**< ca65/ld65 debug info (`.dbg`) */
+    SYMTAB_FORMAT_ACME,     /**< ACME symbol list (`label = $1234`) */
+    SYMTAB_FORMAT_KICKASS   /**< KickAssembler symbols (`.label x=$1234`) */
+} symtab_format_t;
+
+
+int  symtab_load(const char *path, symtab_format_t format, GError **error);
+void symtab_clear(void);
+void symtab_exit(void);
+
+size_t symtab_count(void);
+const char *symtab_lookup_addr(uint16_t addr);
+const char *symtab_nearest(uint16_t addr, uint16_t *offset);
+bool symtab_lookup_name(const char *name, uint16_t *addr);
+char *symtab_annotate(uint16_t addr, char *buffer, size_t size);
+
+void symtab_export(GByteArray *out);
+int  symtab_import(const uint8_t *data, size_t size);
+
+#endif
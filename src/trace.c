@@ -0,0 +1,414 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   trace.c
+ * \brief   Trace points
+ *
+ * Trace points record a pointer to their static site, a timestamp and their
+ * integer arguments in a ring buffer; nothing is formatted until the buffer
+ * is dumped. Slots are claimed with an atomic increment and published by
+ * writing their sequence number last, so recording takes no lock and a
+ * dump skips slots that are being overwritten.
+ *
+ * Sites are enabled unless they match one of the glob patterns in the
+ * 'Trace/disable' setting, matched against "file:function". The runtime
+ * level comes from 'Trace/level'.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "settings.h"
+
+#include "trace.h"
+
+
+/** \brief  Trace event
+ */
+typedef struct trace_event_s {
+    guint seq;                      /**< sequence number + 1, 0 while being
+                                         written */
+    trace_site_t *site;             /**< trace point site */
+    gint64 time;                    /**< monotonic time (usec) */
+    guint nargs;                    /**< number of arguments */
+    guint64 args[TRACE_MAX_ARGS];   /**< arguments */
+} trace_event_t;
+
+
+/** \brief  Runtime trace level
+ */
+gint trace_level = TRACE_LEVEL_OFF;
+
+/** \brief  Ring buffer of events
+ */
+static trace_event_t events[TRACE_BUFFER_SIZE];
+
+/** \brief  Sequence number of the next event
+ */
+static guint next_seq = 0;
+
+/** \brief  Registered sites
+ */
+static GPtrArray *sites = NULL;
+
+/** \brief  Glob patterns of disabled sites
+ */
+static GPtrArray *disabled = NULL;
+
+/** \brief  Lock for \a sites and \a disabled
+ */
+static GMutex sites_lock;
+
+
+/** \brief  Check if \a site matches \a pattern
+ *
+ * \param[in]   site    trace point site
+ * \param[in]   pattern glob pattern matched against "file:function"
+ *
+ * \return  bool
+ */
+static bool site_matches(const trace_site_t *site, const char *pattern)
+{
+    char *name = g_strdup_printf("%s:%s", site->file, site->func);
+    bool result = g_pattern_match_simple(pattern, name);
+
+    g_free(name);
+    return result;
+}
+
+
+/** \brief  Register \a site
+ *
+ * Called by trace points when first hit, applies the disabled patterns.
+ *
+ * \param[in,out]   site    trace point site
+ */
+void trace_register(trace_site_t *site)
+{
+    guint i;
+
+    g_mutex_lock(&sites_lock);
+    if (!site->registered) {
+        if (sites == NULL) {
+            sites = g_ptr_array_new();
+        }
+        g_ptr_array_add(sites, site);
+        for (i = 0; disabled != NULL && i < disabled->len; i++) {
+            if (site_matches(site, g_ptr_array_index(disabled, i))) {
+                g_atomic_int_set(&site->enabled, 0);
+            }
+        }
+        g_atomic_int_set(&site->registered, 1);
+    }
+    g_mutex_unlock(&sites_lock);
+}
+
+
+/** \brief  Record event of \a site
+ *
+ * \param[in]   site    trace point site
+ * \param[in]   args    arguments
+ * \param[in]   nargs   number of \a args (excess ones are dropped)
+ */
+void trace_record(trace_site_t *site, const guint64 *args, size_t nargs)
+{
+    guint seq = (guint)g_atomic_int_add((gint *)&next_seq, 1);
+    trace_event_t *event = &events[seq & (TRACE_BUFFER_SIZE - 1)];
+
+    g_atomic_int_set((gint *)&event->seq, 0);
+    event->site = site;
+    event->time = g_get_monotonic_time();
+    event->nargs = (guint)MIN(nargs, TRACE_MAX_ARGS);
+    memcpy(event->args, args, event->nargs * sizeof *args);
+    g_atomic_int_set((gint *)&event->seq, (gint)(seq + 1));
+}
+
+
+/** \brief  Handler for changes of 'Trace/level'
+ *
+ * \param[in]   group   group
+ * \param[in]   key     key
+ * \param[in]   data    extra data (unused)
+ */
+static void on_level_changed(const char *group, const char *key, void *data)
+{
+    int level;
+
+    if (settings_get_int(group, key, &level)) {
+        trace_set_level(level);
+    }
+}
+
+
+/** \brief  Initialize tracing from the settings
+ *
+ * Call after settings_init().
+ */
+void trace_init(void)
+{
+    const char *patterns;
+
+    on_level_changed("Trace", "level", NULL);
+    settings_add_listener("Trace", "level", on_level_changed, NULL);
+    if (settings_get_str("Trace", "disable", &patterns)) {
+        char **list = g_strsplit(patterns, ",", -1);
+        char **p;
+
+        for (p = list; *p != NULL; p++) {
+            g_strstrip(*p);
+            if (**p != '\0') {
+                trace_set_enabled(*p, false);
+            }
+        }
+        g_strfreev(list);
+    }
+}
+
+
+/** \brief  Free resources used by tracing
+ */
+void trace_exit(void)
+{
+    g_atomic_int_set(&trace_level, TRACE_LEVEL_OFF);
+    g_mutex_lock(&sites_lock);
+    if (sites != NULL) {
+        g_ptr_array_free(sites, TRUE);
+        sites = NULL;
+    }
+    if (disabled != NULL) {
+        g_ptr_array_free(disabled, TRUE);
+        disabled = NULL;
+    }
+    g_mutex_unlock(&sites_lock);
+}
+
+
+/** \brief  Set runtime trace level
+ *
+ * \param[in]   level   trace level, clamped to TRACE_LEVEL_MAX
+ */
+void trace_set_level(int level)
+{
+    g_atomic_int_set(&trace_level, CLAMP(level, TRACE_LEVEL_OFF, TRACE_LEVEL_MAX));
+}
+
+
+/** \brief  Get runtime trace level
+ *
+ * \return  trace level
+ */
+int trace_get_level(void)
+{
+    return g_atomic_int_get(&trace_level);
+}
+
+
+/** \brief  Enable or disable sites matching \a pattern
+ *
+ * Also applies to sites registered later.
+ *
+ * \param[in]   pattern glob pattern matched against "file:function"
+ * \param[in]   enabled enable sites
+ */
+void trace_set_enabled(const char *pattern, bool enabled)
+{
+    guint i;
+
+    g_mutex_lock(&sites_lock);
+    if (disabled == NULL) {
+        disabled = g_ptr_array_new_with_free_func(g_free);
+    }
+    for (i = 0; i < disabled->len; i++) {
+        if (strcmp(g_ptr_array_index(disabled, i), pattern) == 0) {
+            g_ptr_array_remove_index(disabled, i);
+            break;
+        }
+    }
+    if (!enabled) {
+        g_ptr_array_add(disabled, g_strdup(pattern));
+    }
+    for (i = 0; sites != NULL && i < sites->len; i++) {
+        trace_site_t *site = g_ptr_array_index(sites, i);
+
+        if (site_matches(site, pattern)) {
+            g_atomic_int_set(&site->enabled, enabled ? 1 : 0);
+        }
+    }
+    g_mutex_unlock(&sites_lock);
+}
+
+
+/** \brief  Format trace point arguments
+ *
+ * Supports the integer conversions `d`, `i`, `u`, `x`, `X` and `c` with
+ * optional flags and width (e.g. `%02x`, `%-5d`) and `%%`. Length
+ * modifiers are ignored, every argument is a 64-bit integer. Missing
+ * arguments are printed as "?".
+ *
+ * \param[in]   fmt     format
+ * \param[in]   args    arguments
+ * \param[in]   nargs   number of \a args
+ *
+ * \return  formatted text, free with g_free()
+ */
+char *trace_format(const char *fmt, const guint64 *args, size_t nargs)
+{
+    GString *text = g_string_new(NULL);
+    size_t arg = 0;
+
+    while (*fmt != '\0') {
+        const char *spec;
+        char *conv;
+
+        if (*fmt != '%') {
+            g_string_append_c(text, *fmt++);
+            continue;
+        }
+        spec = fmt++;
+        if (*fmt == '%') {
+            g_string_append_c(text, '%');
+            fmt++;
+            continue;
+        }
+        while (*fmt != '\0' && strchr("-+ #0123456789", *fmt) != NULL) {
+            fmt++;
+        }
+        conv = g_strndup(spec, (gsize)(fmt - spec));
+        while (*fmt != '\0' && strchr("hlzjt", *fmt) != NULL) {
+            fmt++;
+        }
+        if (*fmt == '\0') {
+            g_string_append(text, conv);
+            g_free(conv);
+            break;
+        }
+        if (arg >= nargs) {
+            g_string_append_c(text, '?');
+        } else {
+            char *full;
+
+            switch (*fmt) {
+                case 'd':   /* fall through */
+                case 'i':
+                    full = g_strconcat(conv, G_GINT64_MODIFIER, "d", NULL);
+                    g_string_append_printf(text, full, (gint64)args[arg]);
+                    break;
+                case 'u':   /* fall through */
+                case 'x':   /* fall through */
+                case 'X':
+                    full = g_strdup_printf("%s%s%c",
+                                           conv, G_GINT64_MODIFIER, *fmt);
+                    g_string_append_printf(text, full, args[arg]);
+                    break;
+                case 'c':
+                    full = g_strconcat(conv, "c", NULL);
+                    g_string_append_printf(text, full, (int)args[arg]);
+                    break;
+                default:
+                    full = NULL;
+                    g_string_append_printf(text, "<%c?>", *fmt);
+                    break;
+            }
+            g_free(full);
+            arg++;
+        }
+        g_free(conv);
+        fmt++;
+    }
+    return g_string_free(text, FALSE);
+}
+
+
+/** \brief  Format the events in the trace buffer, oldest first
+ *
+ * \return  text, free with g_free()
+ */
+char *trace_dump(void)
+{
+    GString *text = g_string_new(NULL);
+    guint end = (guint)g_atomic_int_get((gint *)&next_seq);
+    guint seq = end > TRACE_BUFFER_SIZE ? end - TRACE_BUFFER_SIZE : 0;
+
+    for (; seq != end; seq++) {
+        const trace_event_t *event = &events[seq & (TRACE_BUFFER_SIZE - 1)];
+        trace_event_t copy = *event;
+        char *msg;
+
+        /* skip slots that are being written or were overwritten */
+        if (copy.seq != seq + 1
+                || (guint)g_atomic_int_get((gint *)&event->seq) != seq + 1) {
+            continue;
+        }
+        msg = trace_format(copy.site->fmt, copy.args, copy.nargs);
+        g_string_append_printf(text,
+                "%" G_GINT64_FORMAT ".%06d %s:%d::%s(): %s\n",
+                copy.time / G_USEC_PER_SEC,
+                (int)(copy.time % G_USEC_PER_SEC),
+                copy.site->file, copy.site->line, copy.site->func, msg);
+        g_free(msg);
+    }
+    return g_string_free(text, FALSE);
+}
+
+
+/** \brief  Write the trace buffer to \a path
+ *
+ * \param[in]   path    path to file
+ * \param[out]  error   error (optional)
+ *
+ * \return  true on success
+ */
+bool trace_dump_write(const char *path, GError **error)
+{
+    char *text = trace_dump();
+    bool result;
+
+    result = g_file_set_contents(path, text, -1, error);
+    g_free(text);
+    return result;
+}
+
+
+/** \brief  Get default path of the trace dump
+ *
+ * \return  path in the settings dir, free with g_free()
+ */
+char *trace_dump_default_path(void)
+{
+    char *dir = settings_get_dir();
+    char *path = g_build_filename(dir, TRACE_DUMP_FILE, NULL);
+
+    g_free(dir);
+    return path;
+}
@@ -0,0 +1,172 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   trace.h
+ * \brief   Trace points - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <glib.h>
+
+/** \brief  Trace levels
+ */
+#define TRACE_LEVEL_OFF     0   /**< no tracing */
+#define TRACE_LEVEL_ERROR   1   /**< errors */
+#define TRACE_LEVEL_INFO    2   /**< infrequent events */
+#define TRACE_LEVEL_DEBUG   3   /**< per request/response */
+#define TRACE_LEVEL_VERBOSE 4   /**< per read/write */
+
+/** \def TRACE_LEVEL_MAX
+ * \brief  Highest trace level compiled in
+ *
+ * Trace points above this level expand to nothing. Set with the configure
+ * option --with-trace-level.
+ */
+#ifndef TRACE_LEVEL_MAX
+# define TRACE_LEVEL_MAX    TRACE_LEVEL_DEBUG
+#endif
+
+/** \brief  Maximum number of arguments of a trace point
+ */
+#define TRACE_MAX_ARGS      4
+
+/** \brief  Number of events kept in the trace buffer (power of two)
+ */
+#define TRACE_BUFFER_SIZE   4096
+
+/** \brief  Filename of the trace dump in the settings dir
+ */
+#define TRACE_DUMP_FILE     "trace.log"
+
+
+/** \brief  Trace point site
+ *
+ * One static instance per trace point, registered when first hit.
+ */
+typedef struct trace_site_s {
+    const char *file;       /**< source file */
+    int line;               /**< line number */
+    const char *func;       /**< function */
+    const char *fmt;        /**< format, see trace_format() */
+    int level;              /**< trace level */
+    gint enabled;           /**< site is enabled */
+    gint registered;        /**< site has been registered */
+} trace_site_t;
+
+
+/** \brief  Runtime trace level, use trace_set_level() to change
+ */
+extern gint trace_level;
+
+
+void trace_register(trace_site_t *site);
+void trace_record(trace_site_t *site, const guint64 *args, size_t nargs);
+
+
+/** \brief  Check if \a site should record
+ *
+ * \param[in,out]   site    trace point site
+ *
+ * \return  true when the site is enabled at the current trace level
+ */
+static inline bool trace_site_active(trace_site_t *site)
+{
+    if (site->level > g_atomic_int_get(&trace_level)) {
+        return false;
+    }
+    if (G_UNLIKELY(!g_atomic_int_get(&site->registered))) {
+        trace_register(site);
+    }
+    return g_atomic_int_get(&site->enabled) != 0;
+}
+
+
+/* Cast each argument of trace() to guint64, so signed arguments don't trigger
+ * -Wsign-conversion at the call sites. Supports up to TRACE_MAX_ARGS
+ * arguments. */
+#define TRACE_ARG0_()
+#define TRACE_ARG1_(a)          , (guint64)(a)
+#define TRACE_ARG2_(a, b)       TRACE_ARG1_(a) TRACE_ARG1_(b)
+#define TRACE_ARG3_(a, b, c)    TRACE_ARG2_(a, b) TRACE_ARG1_(c)
+#define TRACE_ARG4_(a, b, c, d) TRACE_ARG3_(a, b, c) TRACE_ARG1_(d)
+#define TRACE_ARGN_(_0, _1, _2, _3, _4, name, ...) name
+#define TRACE_ARGS_(...) \
+    TRACE_ARGN_(_, ##__VA_ARGS__, \
+                TRACE_ARG4_, TRACE_ARG3_, TRACE_ARG2_, TRACE_ARG1_, \
+                TRACE_ARG0_)(__VA_ARGS__)
+
+
+/** \def trace
+ * \brief  Trace point
+ *
+ * Records \a fmt with up to TRACE_MAX_ARGS integer arguments in the trace
+ * buffer. Formatting is deferred until the buffer is dumped, so only
+ * integer conversions are supported (see trace_format()); strings would not
+ * outlive the call. When \a level is above TRACE_LEVEL_MAX the trace point
+ * is compiled out, otherwise it costs one comparison while tracing is off.
+ *
+ * \param[in]   level   trace level
+ * \param[in]   fmt     format string literal
+ */
+#define trace(level, fmt, ...) \
+    do { \
+        if ((level) <= TRACE_LEVEL_MAX) { \
+            static trace_site_t trace_site_ = { \
+                __FILE__, __LINE__, __func__, fmt, level, 1, 0 \
+            }; \
+            if (trace_site_active(&trace_site_)) { \
+                const guint64 trace_args_[] = { \
+                    0 TRACE_ARGS_(__VA_ARGS__) \
+                }; \
+                trace_record(&trace_site_, \
+                             trace_args_ + 1, \
+                             G_N_ELEMENTS(trace_args_) - 1); \
+            } \
+        } \
+    } while (0)
+
+
+void trace_init(void);
+void trace_exit(void);
+void trace_set_level(int level);
+int trace_get_level(void);
+void trace_set_enabled(const char *pattern, bool enabled);
+char *trace_format(const char *fmt, const guint64 *args, size_t nargs);
+char *trace_dump(void);
+bool trace_dump_write(const char *path, GError **error);
+char *trace_dump_default_path(void);
+
+#endif
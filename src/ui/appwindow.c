@@ -31,19 +31,50 @@
     Public License instead of this License.
 */
 
+
 #include "config.h"
 #include <gtk/gtk.h>
 #include <stdbool.h>
 
 #include "debug.h"
 #include "log.h"
+#include "startup.h"
 #include "statusbar.h"
+#include "frameprof.h"
 #include "connection.h"
+#include "checkpoint.h"
+#include "memcache.h"
+#include "registers.h"
+#include "resources.h"
+#include "session.h"
+#include "watch.h"
+#include "workspace.h"
 #include "logview.h"
+#include "displayview.h"
+#include "searchview.h"
+#include "watchview.h"
 
 #include "appwindow.h"
 
 
+/** \brief  Notebook with the log, the watches and a page per session
+ */
+static GtkWidget *notebook = NULL;
+
+
+/** \brief  Close the connection of \a session
+ *
+ * \param[in]   session session
+ * \param[in]   data    extra data (unused)
+ */
+static void close_session(session_t *session, void *data)
+{
+    session_push(session);
+    connection_close();
+    session_pop();
+}
+
+
 /** \brief  Handler for the 'destroy 'even of the main application window
  *
  * Disconnects from the binary monitor.
@@ -55,8 +86,226 @@ static void on_destroy(GtkWidget *window, gpointer data)
 {
     debug_msg("Destroy caught, disconnecting from binary monitor.");
     log_msg(LOG_INFO, "Exiting application.\n");
+    workspace_save_all();
+    /* fails the pending requests, so do this while the modules still run */
+    session_foreach(close_session, NULL);
     log_exit();
-    connection_close();
+    checkpoint_exit();
+    watch_exit();
+    registers_exit();
+    resources_exit();
+    memcache_exit();
+    session_exit();
+    connection_exit();
+    notebook = NULL;
+}
+
+
+/** \brief  Fetch the initial state of the current session
+ *
+ * Called on the first successful connect of a session, whether that was the
+ * initial attempt or a later reconnect.
+ */
+static void session_setup(void)
+{
+    if (session_count() == 1) {
+        connection_send_gio_reset();
+    }
+    connection_probe_vice();
+    checkpoint_sync();
+    registers_sync();
+    resources_prefetch();
+    workspace_restore();
+}
+
+
+/** \brief  Handler for connection state changes
+ *
+ * Fetches the initial state of a session on its first connect. After a
+ * reconnect the session state is restored in VICE instead: the checkpoints,
+ * the resources set by us and the memory and register caches are all
+ * re-applied in a single write. Responses are already being dispatched when
+ * this is called.
+ *
+ * \param[in]   state   connection state
+ * \param[in]   data    extra data (unused)
+ */
+static void on_connection_state(connection_state_t state, void *data)
+{
+    if (state != CONNECTION_CONNECTED) {
+        return;
+    }
+    if (!connection_is_reconnect()) {
+        session_setup();
+        return;
+    }
+    log_msg(LOG_INFO, "Restoring state of session %s.\n",
+            session_current()->name);
+    connection_cork();
+    connection_probe_vice();
+    checkpoint_restore();
+    resources_restore();
+    memcache_revalidate();
+    registers_invalidate();
+    registers_sync();
+    connection_uncork();
+}
+
+
+/** \brief  Handler for the 'switch-page' event of the notebook
+ *
+ * Makes the session of the page the active session.
+ *
+ * \param[in]   widget  notebook
+ * \param[in]   page    page switched to
+ * \param[in]   num     page number
+ * \param[in]   data    extra data (unused)
+ */
+static void on_switch_page(GtkWidget *widget,
+                           GtkWidget *page,
+                           guint num,
+                           gpointer data)
+{
+    session_t *session = g_object_get_data(G_OBJECT(page), "session");
+
+    if (session != NULL && session != session_active()) {
+        session_set_active(session);
+        watch_session_changed();
+        resources_session_changed();
+    }
+}
+
+
+/** \brief  Handle the initial connection attempt of a session
+ *
+ * Starts reconnecting if the connection failed. The initial state of the
+ * session is fetched by on_connection_state(). Called with the session as
+ * the current session.
+ *
+ * \param[in]   success connected
+ * \param[in]   data    extra data (unused)
+ */
+static void on_session_connected(bool success, void *data)
+{
+    static bool first = true;
+
+    if (first) {
+        first = false;
+        startup_mark("connected");
+    }
+    if (!success) {
+        connection_start_reconnect();
+    }
+}
+
+
+/** \brief  Handler for the 'map' event of a lazy page
+ *
+ * Creates the content of the page when it's shown for the first time.
+ *
+ * \param[in]   page    placeholder
+ * \param[in]   data    function creating the content
+ */
+static void on_lazy_page_map(GtkWidget *page, gpointer data)
+{
+    GtkWidget *(*create)(void) = (GtkWidget *(*)(void))data;
+    session_t *session = g_object_get_data(G_OBJECT(page), "session");
+    GtkWidget *content;
+    gint64 start = startup_elapsed();
+
+    g_signal_handlers_disconnect_by_func(page, G_CALLBACK(on_lazy_page_map),
+                                         data);
+    if (session != NULL) {
+        session_push(session);
+    }
+    content = create();
+    if (session != NULL) {
+        session_pop();
+    }
+    gtk_container_add(GTK_CONTAINER(page), content);
+    gtk_widget_show_all(content);
+    debug_msg("Created lazy page in %.1f ms.",
+              (double)(startup_elapsed() - start) / 1000.0);
+}
+
+
+/** \brief  Create page whose content is created when first shown
+ *
+ * \param[in]   create  function creating the content
+ * \param[in]   session session to create the content for, or `NULL`
+ *
+ * \return  GtkBox placeholder
+ */
+static GtkWidget *lazy_page_new(GtkWidget *(*create)(void), session_t *session)
+{
+    GtkWidget *page = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+
+    gtk_widget_set_hexpand(page, TRUE);
+    gtk_widget_set_vexpand(page, TRUE);
+    g_object_set_data(G_OBJECT(page), "session", session);
+    g_signal_connect(page, "map", G_CALLBACK(on_lazy_page_map),
+                     (gpointer)create);
+    return page;
+}
+
+
+/** \brief  Create the page of the current session
+ *
+ * The display and search views are created when first shown.
+ *
+ * \return  GtkGrid
+ */
+static GtkWidget *session_page_create(void)
+{
+    GtkWidget *grid;
+    GtkWidget *views;
+    GtkWidget *statusbar;
+    session_t *session = session_current();
+
+    grid = gtk_grid_new();
+    g_object_set_data(G_OBJECT(grid), "session", session);
+
+    views = gtk_notebook_new();
+    gtk_widget_set_hexpand(views, TRUE);
+    gtk_widget_set_vexpand(views, TRUE);
+    gtk_notebook_append_page(GTK_NOTEBOOK(views),
+                             lazy_page_new(displayview_create, session),
+                             gtk_label_new("Display"));
+    gtk_notebook_append_page(GTK_NOTEBOOK(views),
+                             lazy_page_new(searchview_create, session),
+                             gtk_label_new("Search"));
+    gtk_grid_attach(GTK_GRID(grid), views, 0, 0, 1, 1);
+
+    statusbar = statusbar_create(false);
+    gtk_grid_attach(GTK_GRID(grid), statusbar, 0, 1, 1, 1);
+    return grid;
+}
+
+
+/** \brief  Open a session with a VICE instance and add a page for it
+ *
+ * The page is added right away, the connection is made in the background.
+ *
+ * \param[in]   host    host, or NULL for the 'VICE/host' setting
+ * \param[in]   port    port, or 0 for the 'VICE/port' setting
+ */
+void appwindow_add_session(const char *host, int port)
+{
+    session_t *session;
+    GtkWidget *page;
+    int num;
+
+    session = session_new(host, port);
+    session_push(session);
+    page = session_page_create();
+    connection_connect_async(on_session_connected, NULL);
+    session_pop();
+
+    num = gtk_notebook_append_page(GTK_NOTEBOOK(notebook),
+                                   page,
+                                   gtk_label_new(session->name));
+    gtk_widget_show_all(page);
+    gtk_notebook_set_current_page(GTK_NOTEBOOK(notebook), num);
 }
 
 
@@ -71,31 +320,44 @@ static void on_destroy(GtkWidget *window, gpointer data)
 GtkWidget *appwindow_create(GtkApplication *app)
 {
     GtkWidget *window;
-    GtkWidget *grid;
+    GtkWidget *overlay;
+    GtkWidget *profiler;
     GtkWidget *logview;
-    GtkWidget *statusbar;
-    bool conn_res;
+    GtkWidget *watchview;
 
     window = gtk_application_window_new(app);
     gtk_window_set_default_size(GTK_WINDOW(window), 640, 480);
     gtk_window_set_title(GTK_WINDOW(window), "Gtk3 VICE Monitor");
 
-    grid = gtk_grid_new();
-
+    notebook = gtk_notebook_new();
+    gtk_notebook_set_scrollable(GTK_NOTEBOOK(notebook), TRUE);
+    gtk_widget_set_hexpand(notebook, TRUE);
+    gtk_widget_set_vexpand(notebook, TRUE);
 
     logview = logview_create();
-    gtk_grid_attach(GTK_GRID(grid), logview, 0, 0, 1, 1);
-
-    conn_res = connect_gio();
-    statusbar = statusbar_create(conn_res);
-    gtk_grid_attach(GTK_GRID(grid), statusbar, 0, 1, 1, 1);
+    gtk_notebook_append_page(GTK_NOTEBOOK(notebook),
+                             logview,
+                             gtk_label_new("Log"));
+    watchview = lazy_page_new(watchview_create, NULL);
+    gtk_notebook_append_page(GTK_NOTEBOOK(notebook),
+                             watchview,
+                             gtk_label_new("Watches"));
+    overlay = gtk_overlay_new();
+    gtk_container_add(GTK_CONTAINER(overlay), notebook);
+    profiler = frameprof_create(window);
+    gtk_overlay_add_overlay(GTK_OVERLAY(overlay), profiler);
+    /* don't let the profiler overlay eat clicks */
+    gtk_overlay_set_overlay_pass_through(GTK_OVERLAY(overlay), profiler, TRUE);
+    gtk_container_add(GTK_CONTAINER(window), overlay);
 
-    gtk_container_add(GTK_CONTAINER(window), grid);
+    checkpoint_init();
+    memcache_init();
+    registers_init();
+    watch_init();
+    connection_add_state_listener(on_connection_state, NULL);
+    g_signal_connect(notebook, "switch-page", G_CALLBACK(on_switch_page), NULL);
 
-    if (conn_res) {
-        connection_send_gio_reset();
-        connection_get_vice_version();
-    }
+    appwindow_add_session(NULL, 0);
 
     g_signal_connect(window, "destroy", G_CALLBACK(on_destroy), NULL);
 
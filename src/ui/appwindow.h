@@ -37,5 +37,6 @@
 #include <gtk/gtk.h>
 
 GtkWidget *appwindow_create(GtkApplication *app);
+void appwindow_add_session(const char *host, int port);
 
 #endif
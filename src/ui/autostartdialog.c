@@ -0,0 +1,106 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   autostartdialog.c
+ * \brief   Autostart dialog
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+#include <gtk/gtk.h>
+#include <stdint.h>
+#include "autostart.h"
+#include "basicdialog.h"
+#include "logview.h"
+#include "symtab.h"
+
+#include "autostartdialog.h"
+
+
+/** \brief  Callback for finished autostarts
+ *
+ * \param[in]   result  result
+ * \param[in]   pc      program counter
+ * \param[in]   data    unused
+ */
+static void on_autostarted(autostart_result_t result, uint16_t pc, void *data)
+{
+    char symbol[256];
+
+    switch (result) {
+        case AUTOSTART_STOPPED:
+            logview_add("ok", "Stopped at %s.\n",
+                        symtab_annotate(pc, symbol, sizeof(symbol)));
+            break;
+        case AUTOSTART_STARTED:
+            logview_add("ok", "Autostarted.\n");
+            break;
+        case AUTOSTART_JAM:
+            logview_add("err", "CPU jammed at $%04x before the break.\n", pc);
+            break;
+        case AUTOSTART_TIMEOUT_EXPIRED:
+            logview_add("err", "Break address not reached in time.\n");
+            break;
+        default:
+            logview_add("err", "Autostart failed.\n");
+            break;
+    }
+}
+
+
+/** \brief  Let the user autostart a file and break at an address
+ *
+ * Asks for a file and a break address, then autostarts the file and stops
+ * at the address.
+ *
+ * \param[in]   parent  parent window
+ */
+void autostart_dialog_show(GtkWidget *parent)
+{
+    char *path;
+    int address;
+    GError *err = NULL;
+
+    path = basic_dialog_choose_file(parent,
+                                    "Autostart",
+                                    GTK_FILE_CHOOSER_ACTION_OPEN);
+    if (path == NULL) {
+        return;
+    }
+    address = basic_dialog_ask_address(parent, "Break address");
+    if (address < 0) {
+        g_free(path);
+        return;
+    }
+    if (!autostart_and_break(path, 0, address, on_autostarted, NULL, &err)) {
+        logview_add("err", "Failed to autostart '%s': %s\n",
+                    path, err->message);
+        g_error_free(err);
+    }
+    g_free(path);
+}
@@ -0,0 +1,122 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   basicdialog.c
+ * \brief   Basic input dialogs
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+#include <gtk/gtk.h>
+#include "logview.h"
+
+#include "basicdialog.h"
+
+
+/** \brief  Show file chooser dialog
+ *
+ * \param[in]   parent  parent window
+ * \param[in]   title   dialog title
+ * \param[in]   action  file chooser action
+ *
+ * \return  path to file, free with g_free(), or `NULL` when canceled
+ */
+char *basic_dialog_choose_file(GtkWidget *parent,
+                               const char *title,
+                               GtkFileChooserAction action)
+{
+    GtkWidget *dialog;
+    char *path = NULL;
+
+    dialog = gtk_file_chooser_dialog_new(
+            title,
+            GTK_WINDOW(parent),
+            action,
+            "Cancel", GTK_RESPONSE_CANCEL,
+            action == GTK_FILE_CHOOSER_ACTION_SAVE ? "Save" : "Open",
+            GTK_RESPONSE_ACCEPT,
+            NULL);
+    gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dialog),
+                                                   TRUE);
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+    }
+    gtk_widget_destroy(dialog);
+    return path;
+}
+
+
+/** \brief  Ask the user for a hexadecimal address
+ *
+ * \param[in]   parent  parent window
+ * \param[in]   title   dialog title
+ *
+ * \return  address, or -1 when canceled or invalid
+ */
+int basic_dialog_ask_address(GtkWidget *parent, const char *title)
+{
+    GtkWidget *dialog;
+    GtkWidget *content;
+    GtkWidget *entry;
+    int address = -1;
+
+    dialog = gtk_dialog_new_with_buttons(
+            title,
+            GTK_WINDOW(parent),
+            GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+            "Cancel", GTK_RESPONSE_REJECT,
+            "OK", GTK_RESPONSE_ACCEPT,
+            NULL);
+    content = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(entry), "$0801");
+    gtk_entry_set_activates_default(GTK_ENTRY(entry), TRUE);
+    gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_ACCEPT);
+    g_object_set(entry, "margin", 16, NULL);
+    gtk_box_pack_start(GTK_BOX(content), entry, TRUE, TRUE, 0);
+    gtk_widget_show_all(dialog);
+
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        const char *text = gtk_entry_get_text(GTK_ENTRY(entry));
+        char *endptr;
+        guint64 value;
+
+        if (*text == '$') {
+            text++;
+        }
+        value = g_ascii_strtoull(text, &endptr, 16);
+        if (endptr != text && *endptr == '\0' && value <= 0xffff) {
+            address = (int)value;
+        } else {
+            logview_add("err", "Invalid address '%s'.\n",
+                        gtk_entry_get_text(GTK_ENTRY(entry)));
+        }
+    }
+    gtk_widget_destroy(dialog);
+    return address;
+}
@@ -37,20 +37,24 @@
 #include <gtk/gtk.h>
 #include "settings.h"
 #include "debug.h"
+#include "connection.h"
+#include "session.h"
+#include "frameprof.h"
 
 #include "connection-widget.h"
 
 
 
-static int connect_state = 0;
-
-
-
 static gboolean on_led_draw(GtkWidget *widget, cairo_t *cr, gpointer data)
 {
     gint width;
     gint height;
     GtkStyleContext *context;
+    int connect_state;
+    gint64 prof = frameprof_begin();
+
+    connect_state = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(widget),
+                                                      "state"));
 
     context = gtk_widget_get_style_context(widget);
     width = gtk_widget_get_allocated_width(widget);
@@ -60,11 +64,14 @@ static gboolean on_led_draw(GtkWidget *widget, cairo_t *cr, gpointer data)
     gtk_render_background(context, cr, 0, 0, width, height);
 
 
-   if (connect_state == 0) {
+    if (connect_state == CONNECTION_CONNECTED) {
+        cairo_set_source_rgb(cr, 0.0, 1.0, 0.0);
+    } else if (connect_state == CONNECTION_CONNECTING) {
+        /* reconnecting */
+        cairo_set_source_rgb(cr, 1.0, 0.75, 0.0);
+    } else {
         /* not connected */
         cairo_set_source_rgb(cr, 1.0, 0.0, 0.0);
-    } else {
-        cairo_set_source_rgb(cr, 0.0, 1.0, 0.0);
     }
     /* render rectangle */
     cairo_rectangle(cr, 4.0, 10.0, 16.0, 8.0);
@@ -78,21 +85,53 @@ static gboolean on_led_draw(GtkWidget *widget, cairo_t *cr, gpointer data)
 #endif
     cairo_fill (cr);
 
+    frameprof_end(FRAMEPROF_LED_DRAW, prof);
     return FALSE;
 }
 
 
+/** \brief  Update the LED on connection state changes of its session
+ *
+ * \param[in]   state   connection state
+ * \param[in]   data    LED widget
+ */
+static void on_connection_state(connection_state_t state, void *data)
+{
+    if (g_object_get_data(G_OBJECT(data), "session") != session_current()) {
+        return;
+    }
+    g_object_set_data(G_OBJECT(data), "state", GINT_TO_POINTER(state));
+    gtk_widget_queue_draw(GTK_WIDGET(data));
+}
+
+
+/** \brief  Handler for the 'destroy' event of the LED
+ *
+ * \param[in]   widget  LED widget
+ * \param[in]   data    extra data (unused)
+ */
+static void on_led_destroy(GtkWidget *widget, gpointer data)
+{
+    connection_remove_state_listener(on_connection_state, widget);
+}
+
+
 static GtkWidget *led_create(int state)
 {
     GtkWidget *draw;
 
 
     debug_msg("Connection state = %s", state ? "true" : "fqlse");
-    connect_state = state;
 
     draw = gtk_drawing_area_new();
+    g_object_set_data(G_OBJECT(draw), "session", session_current());
+    g_object_set_data(G_OBJECT(draw), "state",
+            GINT_TO_POINTER(state ? CONNECTION_CONNECTED
+                                  : CONNECTION_DISCONNECTED));
     gtk_widget_set_size_request(draw, 32, 32);
     g_signal_connect(draw, "draw", G_CALLBACK(on_led_draw), NULL);
+    g_signal_connect(draw, "destroy", G_CALLBACK(on_led_destroy), NULL);
+    connection_add_state_listener(on_connection_state, draw);
     return draw;
 }
 
@@ -104,20 +143,9 @@ GtkWidget *connection_widget_create(int state)
     GtkWidget *led;
     GtkWidget *label;
 
-    const char *host = NULL;
-    int port = 0;
-
-    gchar buffer[1024];
-
-    settings_get_str("VICE", "host", &host);
-    settings_get_int("VICE", "port", &port);
-
     grid = gtk_grid_new();
 
-    g_snprintf(buffer, sizeof(buffer), "%s:%d", host, port);
-    label = gtk_label_new(buffer);
-
-    connect_state = state;
+    label = gtk_label_new(session_current()->name);
 
     led = led_create(state);
 
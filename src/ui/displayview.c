@@ -0,0 +1,659 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   displayview.c
+ * \brief   Display view
+ *
+ * Shows the emulated screen, captured with MON_CMD_DISPLAY_GET.
+ *
+ * The palette indexes are converted into a Cairo image surface that is kept
+ * for as long as the display size doesn't change. Only the tiles whose hash
+ * changed since the previous frame are converted and redrawn.
+ *
+ * In 'live' mode the display is refreshed periodically, the interval is
+ * stretched so the transferred frames stay within the bandwidth budget set
+ * with 'Display/bandwidth' (KiB/s), with 'Display/interval' (ms) as minimum.
+ * While the display doesn't change the interval is doubled each frame, up
+ * to 'Display/max_interval' (ms).
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+#include <gtk/gtk.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "log.h"
+#include "settings.h"
+#include "display.h"
+#include "session.h"
+#include "frameprof.h"
+#include "vicemonapi.h"
+
+#include "displayview.h"
+
+
+/** \brief  Default minimum refresh interval in milliseconds
+ */
+#define DEFAULT_INTERVAL    100
+
+/** \brief  Default bandwidth budget in KiB/s
+ */
+#define DEFAULT_BANDWIDTH   1024
+
+/** \brief  Default maximum refresh interval in milliseconds
+ */
+#define DEFAULT_MAX_INTERVAL    2000
+
+/** \brief  Width and height of the tiles used to detect changes
+ */
+#define TILE_SIZE   8
+
+/** \brief  Size of the DISPLAY_GET response besides the pixels
+ */
+#define FRAME_OVERHEAD      (12 + 4 + 13 + 4)
+
+
+/** \brief  Display view state
+ */
+typedef struct displayview_s {
+    session_t *session;         /**< session shown */
+    GtkWidget *area;            /**< drawing area */
+    GtkWidget *live_button;     /**< 'Live' check button */
+    cairo_surface_t *surface;   /**< converted display */
+    uint8_t *prev;              /**< previous frame (palette indexes) */
+    int width;                  /**< width of the display */
+    int height;                 /**< height of the display */
+    int tiles_x;                /**< number of tile columns */
+    int tiles_y;                /**< number of tile rows */
+    uint64_t *tile_hashes;      /**< hashes of the tiles */
+    uint32_t palette[256];      /**< palette as 0x00RRGGBB */
+    bool palette_requested;     /**< palette has been requested */
+    bool live;                  /**< refresh periodically */
+    bool in_flight;             /**< frame requested, no response yet */
+    bool palette_in_flight;     /**< palette requested, no response yet */
+    bool destroyed;             /**< widget has been destroyed */
+    guint timeout_id;           /**< refresh timeout source ID */
+    int interval;               /**< minimum refresh interval (ms) */
+    int max_interval;           /**< maximum refresh interval (ms) */
+    int idle_interval;          /**< current interval (ms) when idle */
+    int bandwidth;              /**< bandwidth budget (bytes/s) */
+    size_t frame_size;          /**< bytes transferred for the last frame */
+} displayview_t;
+
+
+static void request_frame(displayview_t *view);
+static void on_live_toggled(GtkWidget *button, gpointer data);
+
+
+/** \brief  Convert \a count palette indexes to RGB values
+ *
+ * The loop is unrolled so the independent table lookups can overlap.
+ *
+ * \param[out]  dst     destination pixels
+ * \param[in]   src     palette indexes
+ * \param[in]   count   number of pixels
+ * \param[in]   lut     palette (256 entries)
+ */
+static void convert_pixels(uint32_t *restrict dst,
+                           const uint8_t *restrict src,
+                           int count,
+                           const uint32_t *restrict lut)
+{
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        dst[i + 0] = lut[src[i + 0]];
+        dst[i + 1] = lut[src[i + 1]];
+        dst[i + 2] = lut[src[i + 2]];
+        dst[i + 3] = lut[src[i + 3]];
+        dst[i + 4] = lut[src[i + 4]];
+        dst[i + 5] = lut[src[i + 5]];
+        dst[i + 6] = lut[src[i + 6]];
+        dst[i + 7] = lut[src[i + 7]];
+    }
+    for (; i < count; i++) {
+        dst[i] = lut[src[i]];
+    }
+}
+
+
+/** \brief  Convert rectangle of the previous frame into the surface
+ *
+ * \param[in]   view    display view
+ * \param[in]   x       left
+ * \param[in]   y       top
+ * \param[in]   w       width
+ * \param[in]   h       height
+ */
+static void convert_rect(displayview_t *view, int x, int y, int w, int h)
+{
+    uint8_t *data;
+    int stride;
+
+    cairo_surface_flush(view->surface);
+    data = cairo_image_surface_get_data(view->surface);
+    stride = cairo_image_surface_get_stride(view->surface);
+
+    for (int row = y; row < y + h; row++) {
+        convert_pixels((uint32_t *)(void *)(data + row * stride) + x,
+                       view->prev + row * view->width + x,
+                       w,
+                       view->palette);
+    }
+    cairo_surface_mark_dirty_rectangle(view->surface, x, y, w, h);
+}
+
+
+/** \brief  Get scale and offset to fit the display in the widget
+ *
+ * \param[in]   view    display view
+ * \param[out]  scale   scale factor
+ * \param[out]  ox      X offset
+ * \param[out]  oy      Y offset
+ */
+static void get_transform(displayview_t *view,
+                          double *scale,
+                          double *ox,
+                          double *oy)
+{
+    double aw = gtk_widget_get_allocated_width(view->area);
+    double ah = gtk_widget_get_allocated_height(view->area);
+
+    *scale = MIN(aw / view->width, ah / view->height);
+    *ox = (aw - view->width * *scale) / 2.0;
+    *oy = (ah - view->height * *scale) / 2.0;
+}
+
+
+/** \brief  Queue redraw of a rectangle of the display
+ *
+ * \param[in]   view    display view
+ * \param[in]   x       left
+ * \param[in]   y       top
+ * \param[in]   w       width
+ * \param[in]   h       height
+ */
+static void queue_draw_rect(displayview_t *view, int x, int y, int w, int h)
+{
+    double scale;
+    double ox;
+    double oy;
+    int x0;
+    int y0;
+
+    get_transform(view, &scale, &ox, &oy);
+    x0 = (int)(ox + x * scale);
+    y0 = (int)(oy + y * scale);
+    gtk_widget_queue_draw_area(view->area,
+                               x0,
+                               y0,
+                               (int)(ox + (x + w) * scale + 1.0) - x0,
+                               (int)(oy + (y + h) * scale + 1.0) - y0);
+}
+
+
+/** \brief  Handler for the 'draw' event of the drawing area
+ *
+ * \param[in]   widget  drawing area
+ * \param[in]   cr      cairo context
+ * \param[in]   data    display view
+ *
+ * \return  FALSE
+ */
+static gboolean on_draw(GtkWidget *widget, cairo_t *cr, gpointer data)
+{
+    displayview_t *view = data;
+    double scale;
+    double ox;
+    double oy;
+    gint64 prof;
+
+    if (view->surface == NULL) {
+        return FALSE;
+    }
+    prof = frameprof_begin();
+    get_transform(view, &scale, &ox, &oy);
+    cairo_translate(cr, ox, oy);
+    cairo_scale(cr, scale, scale);
+    cairo_set_source_surface(cr, view->surface, 0, 0);
+    cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_NEAREST);
+    cairo_paint(cr);
+    frameprof_end(FRAMEPROF_DISPLAY_DRAW, prof);
+    return FALSE;
+}
+
+
+/** \brief  Hash a tile of a frame
+ *
+ * \param[in]   pixels  top-left pixel of the tile
+ * \param[in]   stride  width of the frame
+ * \param[in]   w       width of the tile
+ * \param[in]   h       height of the tile
+ *
+ * \return  hash
+ */
+static uint64_t hash_tile(const uint8_t *pixels, int stride, int w, int h)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (int y = 0; y < h; y++) {
+        uint64_t row = 0;
+
+        memcpy(&row, pixels + y * stride, (size_t)w);
+        hash = (hash ^ row) * 0x100000001b3ULL;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+
+/** \brief  Convert and redraw a run of tiles in a row of tiles
+ *
+ * \param[in]   view    display view
+ * \param[in]   first   first tile of the run
+ * \param[in]   count   number of tiles in the run
+ * \param[in]   ty      row of tiles
+ */
+static void update_tiles(displayview_t *view, int first, int count, int ty)
+{
+    int x = first * TILE_SIZE;
+    int y = ty * TILE_SIZE;
+    int w = MIN(count * TILE_SIZE, view->width - x);
+    int h = MIN(TILE_SIZE, view->height - y);
+
+    convert_rect(view, x, y, w, h);
+    queue_draw_rect(view, x, y, w, h);
+}
+
+
+/** \brief  Store \a frame and update the changed tiles of the surface
+ *
+ * The frame is divided into tiles of TILE_SIZE x TILE_SIZE pixels, of which
+ * a hash is kept. Only tiles with a different hash are stored, converted and
+ * redrawn.
+ *
+ * \param[in]   view    display view
+ * \param[in]   frame   new frame
+ *
+ * \return  number of changed tiles
+ */
+static int update_frame(displayview_t *view, const display_frame_t *frame)
+{
+    int w = frame->debug_width;
+    int h = frame->debug_height;
+    int changed = 0;
+
+    if (view->surface == NULL || w != view->width || h != view->height) {
+        /* (re)create surface, convert everything */
+        if (view->surface != NULL) {
+            cairo_surface_destroy(view->surface);
+        }
+        view->surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, w, h);
+        view->width = w;
+        view->height = h;
+        view->tiles_x = (w + TILE_SIZE - 1) / TILE_SIZE;
+        view->tiles_y = (h + TILE_SIZE - 1) / TILE_SIZE;
+        g_free(view->prev);
+        view->prev = g_malloc((gsize)w * (gsize)h);
+        memcpy(view->prev, frame->pixels, (size_t)w * (size_t)h);
+        g_free(view->tile_hashes);
+        view->tile_hashes = g_malloc_n((gsize)(view->tiles_x * view->tiles_y),
+                                       sizeof *view->tile_hashes);
+        for (int ty = 0; ty < view->tiles_y; ty++) {
+            for (int tx = 0; tx < view->tiles_x; tx++) {
+                int x = tx * TILE_SIZE;
+                int y = ty * TILE_SIZE;
+
+                view->tile_hashes[ty * view->tiles_x + tx] = hash_tile(
+                        frame->pixels + y * w + x,
+                        w,
+                        MIN(TILE_SIZE, w - x),
+                        MIN(TILE_SIZE, h - y));
+            }
+        }
+        convert_rect(view, 0, 0, w, h);
+        gtk_widget_queue_draw(view->area);
+        return view->tiles_x * view->tiles_y;
+    }
+
+    for (int ty = 0; ty < view->tiles_y; ty++) {
+        int y = ty * TILE_SIZE;
+        int th = MIN(TILE_SIZE, h - y);
+        int run = -1;
+
+        for (int tx = 0; tx < view->tiles_x; tx++) {
+            int x = tx * TILE_SIZE;
+            int tw = MIN(TILE_SIZE, w - x);
+            uint64_t *tile_hash = &view->tile_hashes[ty * view->tiles_x + tx];
+            uint64_t hash = hash_tile(frame->pixels + y * w + x, w, tw, th);
+
+            if (hash == *tile_hash) {
+                if (run >= 0) {
+                    update_tiles(view, run, tx - run, ty);
+                    run = -1;
+                }
+                continue;
+            }
+            *tile_hash = hash;
+            for (int row = y; row < y + th; row++) {
+                memcpy(view->prev + row * w + x,
+                       frame->pixels + row * w + x,
+                       (size_t)tw);
+            }
+            if (run < 0) {
+                run = tx;
+            }
+            changed++;
+        }
+        if (run >= 0) {
+            update_tiles(view, run, view->tiles_x - run, ty);
+        }
+    }
+    return changed;
+}
+
+
+/** \brief  Handler for the refresh timeout
+ *
+ * \param[in]   data    display view
+ *
+ * \return  G_SOURCE_REMOVE
+ */
+static gboolean on_refresh_timeout(gpointer data)
+{
+    displayview_t *view = data;
+    gint64 prof = frameprof_begin();
+
+    view->timeout_id = 0;
+    request_frame(view);
+    frameprof_end(FRAMEPROF_TIMEOUT, prof);
+    return G_SOURCE_REMOVE;
+}
+
+
+/** \brief  Schedule the next refresh in live mode
+ *
+ * The interval is the minimum interval, or longer when the last frame size
+ * would exceed the bandwidth budget. When the display didn't change the
+ * interval is doubled each frame, up to the maximum interval.
+ *
+ * \param[in]   view    display view
+ * \param[in]   changed display changed
+ */
+static void schedule_refresh(displayview_t *view, bool changed)
+{
+    guint interval;
+
+    if (changed) {
+        view->idle_interval = view->interval;
+    } else {
+        view->idle_interval = MIN(view->idle_interval * 2, view->max_interval);
+    }
+    interval = (guint)MAX(view->idle_interval, view->interval);
+
+    if (!view->live || view->timeout_id != 0) {
+        return;
+    }
+    if (view->bandwidth > 0) {
+        guint budget = (guint)(view->frame_size * 1000 / (size_t)view->bandwidth);
+
+        interval = MAX(interval, budget);
+    }
+    view->timeout_id = g_timeout_add(interval, on_refresh_timeout, view);
+}
+
+
+/** \brief  Free the view state of a destroyed view
+ *
+ * Does nothing while a frame or palette request is outstanding, the handler
+ * of the last response frees the state.
+ *
+ * \param[in]   view    display view
+ */
+static void release_view(displayview_t *view)
+{
+    if (!view->in_flight && !view->palette_in_flight) {
+        g_free(view);
+    }
+}
+
+
+/** \brief  Leave live mode after a failed refresh
+ *
+ * Called when a frame couldn't be requested or received.
+ *
+ * \param[in]   view    display view
+ */
+static void stop_live(displayview_t *view)
+{
+    view->live = false;
+    g_signal_handlers_block_by_func(view->live_button,
+                                    G_CALLBACK(on_live_toggled), view);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(view->live_button), FALSE);
+    g_signal_handlers_unblock_by_func(view->live_button,
+                                      G_CALLBACK(on_live_toggled), view);
+}
+
+
+/** \brief  Handler for frames
+ *
+ * \param[in]   frame   frame or `NULL` on error
+ * \param[in]   data    display view
+ */
+static void on_frame(const display_frame_t *frame, void *data)
+{
+    displayview_t *view = data;
+    int changed;
+
+    view->in_flight = false;
+    if (view->destroyed) {
+        release_view(view);
+        return;
+    }
+    if (frame == NULL) {
+        stop_live(view);
+        return;
+    }
+    if (frame->bpp != 8) {
+        log_msg(LOG_WARN, "Unsupported display depth %d.\n", frame->bpp);
+        stop_live(view);
+        return;
+    }
+    view->frame_size = FRAME_OVERHEAD + frame->pixels_len;
+    changed = update_frame(view, frame);
+    schedule_refresh(view, changed > 0);
+}
+
+
+/** \brief  Handler for the palette
+ *
+ * \param[in]   palette palette, or `NULL` when not available
+ * \param[in]   count   number of entries in \a palette
+ * \param[in]   data    display view
+ */
+static void on_palette(const uint32_t *palette, size_t count, void *data)
+{
+    displayview_t *view = data;
+
+    view->palette_in_flight = false;
+    if (view->destroyed) {
+        release_view(view);
+        return;
+    }
+    if (palette == NULL) {
+        return;
+    }
+    memset(view->palette, 0, sizeof(view->palette));
+    memcpy(view->palette, palette, count * sizeof(uint32_t));
+    if (view->surface != NULL) {
+        convert_rect(view, 0, 0, view->width, view->height);
+        gtk_widget_queue_draw(view->area);
+    }
+}
+
+
+/** \brief  Request a frame, unless one is already on its way
+ *
+ * Leaves live mode when the request can't be sent.
+ *
+ * \param[in]   view    display view
+ */
+static void request_frame(displayview_t *view)
+{
+    if (view->in_flight) {
+        return;
+    }
+    session_push(view->session);
+    if (!view->palette_requested) {
+        if (connection_supports(MON_CMD_PALETTE_GET)) {
+            view->palette_requested = display_request_palette(TRUE, on_palette,
+                                                              view);
+            view->palette_in_flight = view->palette_requested;
+        } else {
+            /* keep the default palette */
+            view->palette_requested = true;
+        }
+    }
+    view->in_flight = display_request_frame(TRUE, on_frame, view);
+    session_pop();
+    if (!view->in_flight && view->live) {
+        /* no response will schedule the next refresh */
+        stop_live(view);
+    }
+}
+
+
+/** \brief  Handler for the 'clicked' event of the refresh button
+ *
+ * \param[in]   button  button
+ * \param[in]   data    display view
+ */
+static void on_refresh_clicked(GtkWidget *button, gpointer data)
+{
+    request_frame(data);
+}
+
+
+/** \brief  Handler for the 'toggled' event of the live check button
+ *
+ * \param[in]   button  check button
+ * \param[in]   data    display view
+ */
+static void on_live_toggled(GtkWidget *button, gpointer data)
+{
+    displayview_t *view = data;
+
+    view->live = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+    if (view->live) {
+        request_frame(view);
+    } else if (view->timeout_id != 0) {
+        g_source_remove(view->timeout_id);
+        view->timeout_id = 0;
+    }
+}
+
+
+/** \brief  Handler for the 'destroy' event of the view
+ *
+ * The view state is kept alive until the outstanding requests have finished.
+ *
+ * \param[in]   widget  view
+ * \param[in]   data    display view
+ */
+static void on_destroy(GtkWidget *widget, gpointer data)
+{
+    displayview_t *view = data;
+
+    view->destroyed = true;
+    if (view->timeout_id != 0) {
+        g_source_remove(view->timeout_id);
+    }
+    if (view->surface != NULL) {
+        cairo_surface_destroy(view->surface);
+    }
+    g_free(view->prev);
+    g_free(view->tile_hashes);
+    release_view(view);
+}
+
+
+/** \brief  Create display view of the current session
+ *
+ * \return  GtkGrid
+ */
+GtkWidget *displayview_create(void)
+{
+    displayview_t *view;
+    GtkWidget *grid;
+    GtkWidget *button;
+    GtkWidget *live;
+    const uint32_t *palette;
+    size_t count;
+
+    view = g_malloc0(sizeof *view);
+    view->session = session_current();
+    palette = display_default_palette(&count);
+    memcpy(view->palette, palette, count * sizeof(uint32_t));
+    if (!settings_get_int("Display", "interval", &view->interval)) {
+        view->interval = DEFAULT_INTERVAL;
+    }
+    if (!settings_get_int("Display", "max_interval", &view->max_interval)) {
+        view->max_interval = DEFAULT_MAX_INTERVAL;
+    }
+    view->max_interval = MAX(view->max_interval, view->interval);
+    view->idle_interval = view->interval;
+    if (!settings_get_int("Display", "bandwidth", &view->bandwidth)) {
+        view->bandwidth = DEFAULT_BANDWIDTH;
+    }
+    view->bandwidth *= 1024;
+
+    grid = gtk_grid_new();
+    gtk_grid_set_column_spacing(GTK_GRID(grid), 8);
+
+    button = gtk_button_new_with_label("Refresh");
+    g_signal_connect(button, "clicked", G_CALLBACK(on_refresh_clicked), view);
+    gtk_grid_attach(GTK_GRID(grid), button, 0, 0, 1, 1);
+
+    live = gtk_check_button_new_with_label("Live");
+    g_signal_connect(live, "toggled", G_CALLBACK(on_live_toggled), view);
+    view->live_button = live;
+    gtk_grid_attach(GTK_GRID(grid), live, 1, 0, 1, 1);
+
+    view->area = gtk_drawing_area_new();
+    gtk_widget_set_hexpand(view->area, TRUE);
+    gtk_widget_set_vexpand(view->area, TRUE);
+    gtk_widget_set_size_request(view->area, 384, 272);
+    g_signal_connect(view->area, "draw", G_CALLBACK(on_draw), view);
+    gtk_grid_attach(GTK_GRID(grid), view->area, 0, 1, 3, 1);
+
+    g_signal_connect(grid, "destroy", G_CALLBACK(on_destroy), view);
+    return grid;
+}
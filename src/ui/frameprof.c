@@ -0,0 +1,316 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   frameprof.c
+ * \brief   Frame-time profiler overlay
+ *
+ * Shows the frame interval and paint time of the main window, taken from
+ * its GdkFrameClock, and the time per frame spent in our draw handlers,
+ * the log view, timeouts and response dispatching. Sections are timed with
+ * frameprof_begin() and frameprof_end(), which cost a single check when the
+ * profiler is disabled.
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+
+#include "config.h"
+
+#include <gtk/gtk.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "frameprof.h"
+
+
+/** \brief  Names of the sections in the overlay
+ */
+static const char *section_names[FRAMEPROF_SECTION_COUNT] = {
+    "display",
+    "led",
+    "log",
+    "timeouts",
+    "dispatch"
+};
+
+
+/** \brief  Profiler is enabled
+ */
+static bool enabled = false;
+
+/** \brief  Overlay label
+ */
+static GtkWidget *label = NULL;
+
+/** \brief  Frame clock of the main window
+ */
+static GdkFrameClock *frame_clock = NULL;
+
+/** \brief  Signal handler IDs on \a frame_clock
+ */
+static gulong clock_handlers[2];
+
+/** \brief  Frame time of the previous frame (usec)
+ */
+static gint64 last_frame_time = 0;
+
+/** \brief  Start time of the current paint (usec)
+ */
+static gint64 paint_start = 0;
+
+/** \brief  Start of the current update interval (usec)
+ */
+static gint64 interval_start = 0;
+
+/** \brief  Frames in the current update interval
+ */
+static guint frames = 0;
+
+/** \brief  Sum of frame intervals in the current update interval (usec)
+ */
+static gint64 frame_sum = 0;
+
+/** \brief  Largest frame interval in the current update interval (usec)
+ */
+static gint64 frame_max = 0;
+
+/** \brief  Sum of paint times in the current update interval (usec)
+ */
+static gint64 paint_sum = 0;
+
+/** \brief  Time spent per section in the current update interval (usec)
+ */
+static gint64 section_sum[FRAMEPROF_SECTION_COUNT];
+
+
+/** \brief  Reset the statistics of the update interval
+ *
+ * \param[in]   now     current time
+ */
+static void reset_interval(gint64 now)
+{
+    interval_start = now;
+    frames = 0;
+    frame_sum = 0;
+    frame_max = 0;
+    paint_sum = 0;
+    memset(section_sum, 0, sizeof section_sum);
+}
+
+
+/** \brief  Update the overlay with the statistics of the update interval
+ */
+static void update_label(void)
+{
+    GString *text = g_string_new(NULL);
+    double n = frames > 0 ? frames : 1;
+    int i;
+
+    g_string_append_printf(text,
+            "frame %5.1fms (max %5.1f)  paint %5.2fms",
+            (double)frame_sum / n / 1000.0, (double)frame_max / 1000.0,
+            (double)paint_sum / n / 1000.0);
+    for (i = 0; i < FRAMEPROF_SECTION_COUNT; i++) {
+        g_string_append_printf(text, "\n%-9s%6.2fms",
+                               section_names[i],
+                               (double)section_sum[i] / n / 1000.0);
+    }
+    gtk_label_set_text(GTK_LABEL(label), text->str);
+    g_string_free(text, TRUE);
+}
+
+
+/** \brief  Handler for the 'before-paint' signal of the frame clock
+ *
+ * \param[in]   clock   frame clock
+ * \param[in]   data    extra data (unused)
+ */
+static void on_before_paint(GdkFrameClock *clock, gpointer data)
+{
+    paint_start = g_get_monotonic_time();
+}
+
+
+/** \brief  Handler for the 'after-paint' signal of the frame clock
+ *
+ * \param[in]   clock   frame clock
+ * \param[in]   data    extra data (unused)
+ */
+static void on_after_paint(GdkFrameClock *clock, gpointer data)
+{
+    gint64 now = g_get_monotonic_time();
+    gint64 frame_time = gdk_frame_clock_get_frame_time(clock);
+
+    if (!enabled) {
+        return;
+    }
+    if (paint_start > 0) {
+        paint_sum += now - paint_start;
+    }
+    if (last_frame_time > 0) {
+        gint64 interval = frame_time - last_frame_time;
+
+        frame_sum += interval;
+        frame_max = MAX(frame_max, interval);
+        frames++;
+    }
+    last_frame_time = frame_time;
+
+    if (now - interval_start >= FRAMEPROF_UPDATE_INTERVAL * 1000) {
+        update_label();
+        reset_interval(now);
+    }
+}
+
+
+/** \brief  Handler for the 'realize' event of the main window
+ *
+ * Connects to the frame clock, which only exists once the window is
+ * realized.
+ *
+ * \param[in]   window  main window
+ * \param[in]   data    extra data (unused)
+ */
+static void on_realize(GtkWidget *window, gpointer data)
+{
+    frame_clock = gtk_widget_get_frame_clock(window);
+    clock_handlers[0] = g_signal_connect(frame_clock, "before-paint",
+                                         G_CALLBACK(on_before_paint), NULL);
+    clock_handlers[1] = g_signal_connect(frame_clock, "after-paint",
+                                         G_CALLBACK(on_after_paint), NULL);
+}
+
+
+/** \brief  Handler for the 'unrealize' event of the main window
+ *
+ * \param[in]   window  main window
+ * \param[in]   data    extra data (unused)
+ */
+static void on_unrealize(GtkWidget *window, gpointer data)
+{
+    if (frame_clock != NULL) {
+        g_signal_handler_disconnect(frame_clock, clock_handlers[0]);
+        g_signal_handler_disconnect(frame_clock, clock_handlers[1]);
+        frame_clock = NULL;
+    }
+}
+
+
+/** \brief  Handler for the 'destroy' event of the overlay label
+ *
+ * \param[in]   widget  label
+ * \param[in]   data    extra data (unused)
+ */
+static void on_label_destroy(GtkWidget *widget, gpointer data)
+{
+    label = NULL;
+    enabled = false;
+}
+
+
+/** \brief  Create the profiler overlay for \a window
+ *
+ * The overlay is hidden until the profiler is enabled.
+ *
+ * \param[in]   window  main window
+ *
+ * \return  GtkLabel to add to a GtkOverlay
+ */
+GtkWidget *frameprof_create(GtkWidget *window)
+{
+    label = gtk_label_new(NULL);
+    gtk_widget_set_halign(label, GTK_ALIGN_END);
+    gtk_widget_set_valign(label, GTK_ALIGN_START);
+    gtk_widget_set_margin_top(label, 32);
+    gtk_widget_set_margin_end(label, 8);
+    gtk_label_set_xalign(GTK_LABEL(label), 0.0);
+    gtk_style_context_add_class(gtk_widget_get_style_context(label), "osd");
+    gtk_style_context_add_class(gtk_widget_get_style_context(label),
+                                "monospace");
+    /* keep gtk_widget_show_all() from showing it */
+    gtk_widget_set_no_show_all(label, TRUE);
+    g_signal_connect(label, "destroy", G_CALLBACK(on_label_destroy), NULL);
+
+    g_signal_connect(window, "realize", G_CALLBACK(on_realize), NULL);
+    g_signal_connect(window, "unrealize", G_CALLBACK(on_unrealize), NULL);
+    return label;
+}
+
+
+/** \brief  Enable or disable the profiler and its overlay
+ *
+ * \param[in]   state   enable profiler
+ */
+void frameprof_set_enabled(bool state)
+{
+    if (label == NULL) {
+        return;
+    }
+    enabled = state;
+    last_frame_time = 0;
+    paint_start = 0;
+    reset_interval(g_get_monotonic_time());
+    if (enabled) {
+        gtk_label_set_text(GTK_LABEL(label), "profiling ...");
+        gtk_widget_show(label);
+    } else {
+        gtk_widget_hide(label);
+    }
+}
+
+
+/** \brief  Check if the profiler is enabled
+ *
+ * \return  bool
+ */
+bool frameprof_get_enabled(void)
+{
+    return enabled;
+}
+
+
+/** \brief  Start timing a section
+ *
+ * \return  start time to pass to frameprof_end(), 0 when disabled
+ */
+gint64 frameprof_begin(void)
+{
+    return enabled ? g_get_monotonic_time() : 0;
+}
+
+
+/** \brief  Stop timing a section
+ *
+ * \param[in]   section section
+ * \param[in]   start   value returned by frameprof_begin()
+ */
+void frameprof_end(frameprof_section_t section, gint64 start)
+{
+    if (start > 0 && enabled) {
+        section_sum[section] += g_get_monotonic_time() - start;
+    }
+}
@@ -0,0 +1,65 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   frameprof.h
+ * \brief   Frame-time profiler overlay - header
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+
+#ifndef UI_FRAMEPROF_H_
+#define UI_FRAMEPROF_H_
+
+#include <stdbool.h>
+#include <gtk/gtk.h>
+
+/** \brief  Interval in milliseconds between updates of the overlay
+ */
+#define FRAMEPROF_UPDATE_INTERVAL   500
+
+
+/** \brief  Profiled sections
+ */
+typedef enum frameprof_section_e {
+    FRAMEPROF_DISPLAY_DRAW,     /**< display view draw handler */
+    FRAMEPROF_LED_DRAW,         /**< connection LED draw handler */
+    FRAMEPROF_LOGVIEW,          /**< adding text to the log view */
+    FRAMEPROF_TIMEOUT,          /**< UI timeout callbacks */
+    FRAMEPROF_DISPATCH,         /**< dispatching monitor responses */
+
+    FRAMEPROF_SECTION_COUNT     /**< number of sections */
+} frameprof_section_t;
+
+
+GtkWidget *frameprof_create(GtkWidget *window);
+void frameprof_set_enabled(bool enabled);
+bool frameprof_get_enabled(void);
+gint64 frameprof_begin(void);
+void frameprof_end(frameprof_section_t section, gint64 start);
+
+#endif
@@ -0,0 +1,118 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   kbdfeeddialog.c
+ * \brief   Keyboard feed dialog
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+#include <gtk/gtk.h>
+#include <stdbool.h>
+#include "kbdfeed.h"
+#include "logview.h"
+
+#include "kbdfeeddialog.h"
+
+
+/** \brief  Callback for finished keyboard feeds
+ *
+ * \param[in]   success all text was sent
+ * \param[in]   data    unused
+ */
+static void on_keyboard_fed(bool success, void *data)
+{
+    if (success) {
+        logview_add("ok", "Typed text.\n");
+    } else {
+        logview_add("err", "Failed to type text.\n");
+    }
+}
+
+
+/** \brief  Ask the user for text to type into the emulated machine
+ *
+ * \param[in]   parent  parent window
+ */
+void kbdfeed_dialog_show(GtkWidget *parent)
+{
+    GtkWidget *dialog;
+    GtkWidget *content;
+    GtkWidget *scrolled;
+    GtkWidget *textview;
+    GtkWidget *drain;
+
+    dialog = gtk_dialog_new_with_buttons(
+            "Type text",
+            GTK_WINDOW(parent),
+            GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+            "Cancel", GTK_RESPONSE_REJECT,
+            "Type", GTK_RESPONSE_ACCEPT,
+            NULL);
+    gtk_window_set_default_size(GTK_WINDOW(dialog), 480, 320);
+    content = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+
+    textview = gtk_text_view_new();
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(textview), TRUE);
+    gtk_widget_set_tooltip_text(textview,
+            "Use {clr}, {home}, {down}, {f1}, {$93} etc. for control codes");
+    scrolled = gtk_scrolled_window_new(NULL, NULL);
+    gtk_container_add(GTK_CONTAINER(scrolled), textview);
+    g_object_set(scrolled, "margin", 16, NULL);
+    gtk_box_pack_start(GTK_BOX(content), scrolled, TRUE, TRUE, 0);
+
+    drain = gtk_check_button_new_with_label(
+            "Wait for the program to read the keyboard buffer");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(drain), TRUE);
+    g_object_set(drain, "margin", 16, NULL);
+    gtk_box_pack_start(GTK_BOX(content), drain, FALSE, FALSE, 0);
+    gtk_widget_show_all(dialog);
+
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        GtkTextBuffer *buffer;
+        GtkTextIter start;
+        GtkTextIter end;
+        char *text;
+        GError *err = NULL;
+
+        buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(textview));
+        gtk_text_buffer_get_bounds(buffer, &start, &end);
+        text = gtk_text_buffer_get_text(buffer, &start, &end, FALSE);
+        if (!kbdfeed_text(text,
+                          gtk_toggle_button_get_active(
+                              GTK_TOGGLE_BUTTON(drain)),
+                          on_keyboard_fed,
+                          NULL,
+                          &err)) {
+            logview_add("err", "Cannot type text: %s\n", err->message);
+            g_error_free(err);
+        }
+        g_free(text);
+    }
+    gtk_widget_destroy(dialog);
+}
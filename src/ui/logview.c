@@ -40,6 +40,7 @@
 #include "debug.h"
 #include "connection.h"
 #include "log.h"
+#include "frameprof.h"
 #include "logview.h"
 
 
@@ -95,6 +96,7 @@ void logview_add(const char *tag, const char *msg, ...)
     va_list ap;
     GtkTextIter start;
     GtkTextIter end;
+    gint64 prof = frameprof_begin();
 
     buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(log_textview));
     va_start(ap, msg);
@@ -112,4 +114,5 @@ void logview_add(const char *tag, const char *msg, ...)
             tag,
             NULL);
     g_free(temp);
+    frameprof_end(FRAMEPROF_LOGVIEW, prof);
 }
@@ -0,0 +1,99 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   memuploaddialog.c
+ * \brief   Memory upload dialog
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+#include <gtk/gtk.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "basicdialog.h"
+#include "logview.h"
+#include "memupload.h"
+#include "vicemonapi.h"
+
+#include "memuploaddialog.h"
+
+
+/** \brief  Callback for finished uploads
+ *
+ * \param[in]   success upload succeeded
+ * \param[in]   start   start address
+ * \param[in]   length  number of bytes
+ * \param[in]   data    unused
+ */
+static void on_memory_uploaded(bool success,
+                               uint16_t start,
+                               size_t length,
+                               void *data)
+{
+    if (success) {
+        logview_add("ok", "Uploaded and verified $%04x-$%04x.\n",
+                    start, (unsigned int)(start + length - 1));
+    } else {
+        logview_add("err", "Upload to $%04x failed.\n", start);
+    }
+}
+
+
+/** \brief  Let the user upload a file to memory
+ *
+ * PRG files are loaded at the address in their header, for other files the
+ * user is asked for an address.
+ *
+ * \param[in]   parent  parent window
+ */
+void memupload_dialog_show(GtkWidget *parent)
+{
+    char *path;
+    int address = MEMUPLOAD_PRG;
+    GError *err = NULL;
+
+    path = basic_dialog_choose_file(parent,
+                                    "Upload to memory",
+                                    GTK_FILE_CHOOSER_ACTION_OPEN);
+    if (path == NULL) {
+        return;
+    }
+    if (!g_str_has_suffix(path, ".prg") && !g_str_has_suffix(path, ".PRG")) {
+        address = basic_dialog_ask_address(parent, "Load address");
+        if (address < 0) {
+            g_free(path);
+            return;
+        }
+    }
+    if (!memupload_file(path, address, MON_MEMSPACE_MAIN, true,
+                        on_memory_uploaded, NULL, &err)) {
+        logview_add("err", "Failed to upload '%s': %s\n", path, err->message);
+        g_error_free(err);
+    }
+    g_free(path);
+}
@@ -0,0 +1,297 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   searchview.c
+ * \brief   Memory search view
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+#include <gtk/gtk.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "debug.h"
+#include "vicemonapi.h"
+#include "memcache.h"
+#include "memsearch.h"
+#include "symtab.h"
+#include "logview.h"
+#include "session.h"
+
+#include "searchview.h"
+
+
+/** \brief  Maximum number of results shown
+ */
+#define MAX_ROWS    1000
+
+
+/** \brief  Columns of the results list store
+ */
+enum {
+    COL_ADDRESS,    /**< address */
+    COL_SYMBOL,     /**< symbol */
+    COL_BYTES,      /**< bytes at the address */
+    NUM_COLUMNS
+};
+
+
+/** \brief  Search view state
+ */
+typedef struct searchview_s {
+    session_t *session;     /**< session searched */
+    GtkWidget *type_combo;  /**< pattern type */
+    GtkWidget *entry;       /**< pattern */
+    GtkWidget *status;      /**< status label */
+    GtkListStore *store;    /**< results */
+    memsearch_t *search;    /**< search */
+} searchview_t;
+
+
+/** \brief  Fill the results list
+ *
+ * \param[in]   view    search view
+ */
+static void show_results(searchview_t *view)
+{
+    memsearch_t *search = view->search;
+    const uint8_t *mem = memcache_get(search->memspace, search->bank);
+    size_t count = memsearch_count(search);
+    char text[64];
+
+    gtk_list_store_clear(view->store);
+    for (size_t i = 0; i < count && i < MAX_ROWS; i++) {
+        uint16_t addr = memsearch_result(search, i);
+        GtkTreeIter iter;
+        char address[8];
+        char symbol[256] = "";
+        GString *bytes = g_string_new(NULL);
+
+        g_snprintf(address, sizeof(address), "$%04x", addr);
+        if (symtab_count() > 0) {
+            symtab_annotate(addr, symbol, sizeof(symbol));
+        }
+        for (size_t b = 0; b < search->length && addr + b <= 0xffff; b++) {
+            g_string_append_printf(bytes, b == 0 ? "%02x" : " %02x",
+                                   mem[addr + b]);
+        }
+        gtk_list_store_append(view->store, &iter);
+        gtk_list_store_set(view->store, &iter,
+                           COL_ADDRESS, address,
+                           COL_SYMBOL, symbol,
+                           COL_BYTES, bytes->str,
+                           -1);
+        g_string_free(bytes, TRUE);
+    }
+    if (count > MAX_ROWS) {
+        g_snprintf(text, sizeof(text), "%zu matches, showing %d.",
+                   count, MAX_ROWS);
+    } else {
+        g_snprintf(text, sizeof(text), "%zu matches.", count);
+    }
+    gtk_label_set_text(GTK_LABEL(view->status), text);
+}
+
+
+/** \brief  Callback for finished searches
+ *
+ * \param[in]   search  search
+ * \param[in]   success memory could be fetched
+ * \param[in]   data    search view
+ */
+static void on_search_done(memsearch_t *search, bool success, void *data)
+{
+    searchview_t *view = data;
+
+    if (!success) {
+        gtk_label_set_text(GTK_LABEL(view->status), "Failed to read memory.");
+        return;
+    }
+    show_results(view);
+}
+
+
+/** \brief  Handler for the 'clicked' event of the find button
+ *
+ * Also triggered by activating the entry.
+ *
+ * \param[in]   widget  button
+ * \param[in]   data    search view
+ */
+static void on_find_clicked(GtkWidget *widget, gpointer data)
+{
+    searchview_t *view = data;
+    memsearch_type_t type;
+    GError *err = NULL;
+
+    type = (memsearch_type_t)gtk_combo_box_get_active(
+            GTK_COMBO_BOX(view->type_combo));
+    if (!memsearch_set_pattern(view->search,
+                               type,
+                               gtk_entry_get_text(GTK_ENTRY(view->entry)),
+                               &err)) {
+        gtk_label_set_text(GTK_LABEL(view->status), err->message);
+        g_error_free(err);
+        return;
+    }
+    session_push(view->session);
+    if (!memsearch_run(view->search, on_search_done, view)) {
+        gtk_label_set_text(GTK_LABEL(view->status), "Search failed.");
+    }
+    session_pop();
+}
+
+
+/** \brief  Handler for the 'clicked' event of the refine button
+ *
+ * \param[in]   widget  button
+ * \param[in]   data    search view
+ */
+static void on_refine_clicked(GtkWidget *widget, gpointer data)
+{
+    searchview_t *view = data;
+
+    session_push(view->session);
+    if (!memsearch_refine(view->search, on_search_done, view)) {
+        gtk_label_set_text(GTK_LABEL(view->status), "Search failed.");
+    }
+    session_pop();
+}
+
+
+/** \brief  Handler for the 'destroy' event of the view
+ *
+ * \param[in]   widget  view
+ * \param[in]   data    search view
+ */
+static void on_destroy(GtkWidget *widget, gpointer data)
+{
+    searchview_t *view = data;
+
+    /* a search in progress is freed when its memory arrives */
+    view->search->callback = NULL;
+    memsearch_free(view->search);
+    g_object_unref(view->store);
+    g_free(view);
+}
+
+
+/** \brief  Create results view
+ *
+ * \param[in]   view    search view
+ *
+ * \return  GtkScrolledWindow
+ */
+static GtkWidget *create_results(searchview_t *view)
+{
+    static const char *titles[NUM_COLUMNS] = { "Address", "Symbol", "Bytes" };
+    GtkWidget *scrolled;
+    GtkWidget *tree;
+
+    view->store = gtk_list_store_new(NUM_COLUMNS,
+                                     G_TYPE_STRING,
+                                     G_TYPE_STRING,
+                                     G_TYPE_STRING);
+    tree = gtk_tree_view_new_with_model(GTK_TREE_MODEL(view->store));
+    for (int col = 0; col < NUM_COLUMNS; col++) {
+        GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
+
+        g_object_set(renderer, "family", "monospace", NULL);
+        gtk_tree_view_append_column(
+                GTK_TREE_VIEW(tree),
+                gtk_tree_view_column_new_with_attributes(titles[col],
+                                                         renderer,
+                                                         "text", col,
+                                                         NULL));
+    }
+    scrolled = gtk_scrolled_window_new(NULL, NULL);
+    gtk_widget_set_hexpand(scrolled, TRUE);
+    gtk_widget_set_vexpand(scrolled, TRUE);
+    gtk_container_add(GTK_CONTAINER(scrolled), tree);
+    return scrolled;
+}
+
+
+/** \brief  Create memory search view of the current session
+ *
+ * \return  GtkGrid
+ */
+GtkWidget *searchview_create(void)
+{
+    searchview_t *view;
+    GtkWidget *grid;
+    GtkWidget *button;
+
+    view = g_malloc0(sizeof *view);
+    view->session = session_current();
+    view->search = memsearch_new(MON_MEMSPACE_MAIN, 0, 0x0000, 0xffff);
+
+    grid = gtk_grid_new();
+    gtk_grid_set_column_spacing(GTK_GRID(grid), 8);
+    gtk_grid_set_row_spacing(GTK_GRID(grid), 8);
+
+    /* order must match memsearch_type_t */
+    view->type_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(view->type_combo),
+                                   "Bytes");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(view->type_combo),
+                                   "PETSCII");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(view->type_combo),
+                                   "Screen codes");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(view->type_combo),
+                                   "Word");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(view->type_combo), MEMSEARCH_BYTES);
+    gtk_grid_attach(GTK_GRID(grid), view->type_combo, 0, 0, 1, 1);
+
+    view->entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(view->entry), "a9 ?? 8d 20 d0");
+    gtk_widget_set_hexpand(view->entry, TRUE);
+    g_signal_connect(view->entry, "activate",
+                     G_CALLBACK(on_find_clicked), view);
+    gtk_grid_attach(GTK_GRID(grid), view->entry, 1, 0, 1, 1);
+
+    button = gtk_button_new_with_label("Find");
+    g_signal_connect(button, "clicked", G_CALLBACK(on_find_clicked), view);
+    gtk_grid_attach(GTK_GRID(grid), button, 2, 0, 1, 1);
+
+    button = gtk_button_new_with_label("Refine");
+    gtk_widget_set_tooltip_text(button,
+            "Search again, keeping only the previous matches");
+    g_signal_connect(button, "clicked", G_CALLBACK(on_refine_clicked), view);
+    gtk_grid_attach(GTK_GRID(grid), button, 3, 0, 1, 1);
+
+    gtk_grid_attach(GTK_GRID(grid), create_results(view), 0, 1, 4, 1);
+
+    view->status = gtk_label_new(NULL);
+    gtk_widget_set_halign(view->status, GTK_ALIGN_START);
+    gtk_grid_attach(GTK_GRID(grid), view->status, 0, 2, 4, 1);
+
+    g_signal_connect(grid, "destroy", G_CALLBACK(on_destroy), view);
+    return grid;
+}
@@ -0,0 +1,110 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   sessiondialog.c
+ * \brief   New session dialog
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+#include <gtk/gtk.h>
+#include <string.h>
+#include "appwindow.h"
+#include "connection.h"
+#include "logview.h"
+
+#include "sessiondialog.h"
+
+
+/** \brief  Parse "host:port" or "unix:/path" and add a session for it
+ *
+ * An empty host uses the host from the settings.
+ *
+ * \param[in]   text    address
+ */
+static void add_session(const char *text)
+{
+    const char *colon = strrchr(text, ':');
+    char *host;
+    int port = 0;
+
+    if (g_str_has_prefix(text, CONNECTION_UNIX_PREFIX)) {
+        /* unix:/path, no port */
+        colon = NULL;
+    }
+    if (colon != NULL) {
+        char *endptr;
+        guint64 value = g_ascii_strtoull(colon + 1, &endptr, 10);
+
+        if (endptr == colon + 1 || *endptr != '\0'
+                || value == 0 || value > 0xffff) {
+            logview_add("err", "Invalid port in '%s'.\n", text);
+            return;
+        }
+        port = (int)value;
+        host = g_strndup(text, (gsize)(colon - text));
+    } else {
+        host = g_strdup(text);
+    }
+    appwindow_add_session(*host != '\0' ? host : NULL, port);
+    g_free(host);
+}
+
+
+/** \brief  Ask for the address of another VICE instance and connect to it
+ *
+ * \param[in]   parent  parent window
+ */
+void session_dialog_show(GtkWidget *parent)
+{
+    GtkWidget *dialog;
+    GtkWidget *content;
+    GtkWidget *entry;
+
+    dialog = gtk_dialog_new_with_buttons(
+            "New session",
+            GTK_WINDOW(parent),
+            GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+            "Cancel", GTK_RESPONSE_REJECT,
+            "Connect", GTK_RESPONSE_ACCEPT,
+            NULL);
+    content = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(entry),
+                                   "127.0.0.1:6502 or unix:/path");
+    gtk_entry_set_activates_default(GTK_ENTRY(entry), TRUE);
+    gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_ACCEPT);
+    g_object_set(entry, "margin", 16, NULL);
+    gtk_box_pack_start(GTK_BOX(content), entry, TRUE, TRUE, 0);
+    gtk_widget_show_all(dialog);
+
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        add_session(gtk_entry_get_text(GTK_ENTRY(entry)));
+    }
+    gtk_widget_destroy(dialog);
+}
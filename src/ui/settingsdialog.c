@@ -65,6 +65,28 @@ static GtkWidget *logfile_button;
 static GtkWidget *loglevel_widget;
 
 
+/** \brief  Store the values of the widgets in the settings
+ *
+ * The settings are written to disk in the background.
+ */
+static void save_settings(void)
+{
+    int loglevel;
+
+    settings_set_str("VICE", "host",
+                     gtk_entry_get_text(GTK_ENTRY(host_widget)));
+    settings_set_int("VICE", "port",
+                     gtk_spin_button_get_value_as_int(
+                         GTK_SPIN_BUTTON(port_widget)));
+    settings_set_str("Monitor", "logfile",
+                     gtk_entry_get_text(GTK_ENTRY(logfile_entry)));
+    loglevel = gtk_combo_box_get_active(GTK_COMBO_BOX(loglevel_widget));
+    if (loglevel >= 0) {
+        settings_set_int("Monitor", "loglevel", loglevel);
+    }
+}
+
+
 /** \brief  Handler for the 'response' event of the settings dialog
  *
  * \param[in]   dialog      dialog
@@ -75,7 +97,7 @@ static void on_response(GtkDialog *dialog, int response_id, gpointer data)
 {
     switch (response_id) {
         case GTK_RESPONSE_ACCEPT:
-            debug_msg("TODO: Save settings.");
+            save_settings();
             gtk_widget_destroy(GTK_WIDGET(dialog));
             break;
         case GTK_RESPONSE_REJECT:
@@ -125,9 +147,11 @@ static int create_vice_section(GtkWidget *grid, int row)
 {
     GtkWidget *label;
     const char *host;
-    int port;
+    int port = 6502;
 
-    settings_get_str("VICE", "host", &host);
+    if (!settings_get_str("VICE", "host", &host)) {
+        host = "127.0.0.1";
+    }
     settings_get_int("VICE", "port", &port);
 
     label = gtk_label_new(NULL);
@@ -163,9 +187,11 @@ static int create_monitor_section(GtkWidget *grid, int row)
 {
     GtkWidget *label;
     const char *logfile;
-    int loglevel;
+    int loglevel = LOG_INFO;
 
-    settings_get_str("Monitor", "logfile", &logfile);
+    if (!settings_get_str("Monitor", "logfile", &logfile)) {
+        logfile = "";
+    }
     settings_get_int("Monitor", "loglevel", &loglevel);
 
     label = gtk_label_new(NULL);
@@ -185,6 +211,7 @@ static int create_monitor_section(GtkWidget *grid, int row)
 
     label = create_indented_label("Log level:");
     loglevel_widget = create_loglevel_widget();
+    gtk_combo_box_set_active(GTK_COMBO_BOX(loglevel_widget), loglevel);
     gtk_grid_attach(GTK_GRID(grid), label, 0, row, 1, 1);
     gtk_grid_attach(GTK_GRID(grid), loglevel_widget, 1, row, 1, 1);
     row++;
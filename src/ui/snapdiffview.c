@@ -0,0 +1,172 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   snapdiffview.c
+ * \brief   Snapshot diff view
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+#include <gtk/gtk.h>
+#include <stdint.h>
+
+#include "debug.h"
+#include "snapdiff.h"
+#include "symtab.h"
+
+#include "snapdiffview.h"
+
+
+/** \brief  Columns of the list store
+ */
+enum {
+    COL_MODULE,     /**< module name */
+    COL_OFFSET,     /**< offset in module */
+    COL_ADDRESS,    /**< address range */
+    COL_LENGTH,     /**< number of bytes */
+    COL_SYMBOL,     /**< symbol */
+    COL_OLD,        /**< old bytes */
+    COL_NEW,        /**< new bytes */
+    NUM_COLUMNS
+};
+
+
+/** \brief  Column titles
+ */
+static const char *column_titles[NUM_COLUMNS] = {
+    "Module", "Offset", "Address", "Length", "Symbol", "Old", "New"
+};
+
+
+/** \brief  Create list store with the ranges of \a diff
+ *
+ * \param[in]   diff    snapshot diff
+ *
+ * \return  GtkListStore
+ */
+static GtkListStore *create_store(const snapdiff_t *diff)
+{
+    GtkListStore *store;
+
+    store = gtk_list_store_new(NUM_COLUMNS,
+                               G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
+                               G_TYPE_UINT, G_TYPE_STRING, G_TYPE_STRING,
+                               G_TYPE_STRING);
+
+    for (guint i = 0; i < diff->ranges->len; i++) {
+        const snapdiff_range_t *range;
+        GtkTreeIter iter;
+        char offset[16];
+        char address[16] = "";
+        char symbol[256] = "";
+        char *old_bytes;
+        char *new_bytes;
+
+        range = &g_array_index(diff->ranges, snapdiff_range_t, i);
+        g_snprintf(offset, sizeof(offset), "+$%05zx", range->offset);
+        if (range->address >= 0) {
+            g_snprintf(address, sizeof(address), "$%04x-$%04x",
+                       (unsigned int)range->address,
+                       (unsigned int)(range->address
+                                      + (int32_t)range->length - 1));
+            symtab_annotate((uint16_t)range->address, symbol, sizeof(symbol));
+        }
+        old_bytes = snapdiff_format_bytes(range->old_data, range->length);
+        new_bytes = snapdiff_format_bytes(range->new_data, range->length);
+
+        gtk_list_store_append(store, &iter);
+        gtk_list_store_set(store, &iter,
+                           COL_MODULE, range->module,
+                           COL_OFFSET, offset,
+                           COL_ADDRESS, address,
+                           COL_LENGTH, (guint)range->length,
+                           COL_SYMBOL, symbol,
+                           COL_OLD, old_bytes,
+                           COL_NEW, new_bytes,
+                           -1);
+        g_free(old_bytes);
+        g_free(new_bytes);
+    }
+    return store;
+}
+
+
+/** \brief  Create tree view for \a diff
+ *
+ * \param[in]   diff    snapshot diff
+ *
+ * \return  GtkTreeView
+ */
+static GtkWidget *create_view(const snapdiff_t *diff)
+{
+    GtkWidget *view;
+    GtkListStore *store;
+
+    store = create_store(diff);
+    view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+    g_object_unref(store);
+
+    for (int col = 0; col < NUM_COLUMNS; col++) {
+        GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
+        GtkTreeViewColumn *column;
+
+        g_object_set(renderer, "family", "monospace", NULL);
+        column = gtk_tree_view_column_new_with_attributes(column_titles[col],
+                                                          renderer,
+                                                          "text", col,
+                                                          NULL);
+        gtk_tree_view_column_set_resizable(column, TRUE);
+        gtk_tree_view_append_column(GTK_TREE_VIEW(view), column);
+    }
+    return view;
+}
+
+
+/** \brief  Show snapshot diff in a window
+ *
+ * \param[in]   parent  parent window
+ * \param[in]   title   window title
+ * \param[in]   diff    snapshot diff
+ */
+void snapdiff_view_show(GtkWidget *parent,
+                        const char *title,
+                        const snapdiff_t *diff)
+{
+    GtkWidget *window;
+    GtkWidget *scrolled;
+
+    window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(window), title);
+    gtk_window_set_transient_for(GTK_WINDOW(window), GTK_WINDOW(parent));
+    gtk_window_set_default_size(GTK_WINDOW(window), 800, 480);
+
+    scrolled = gtk_scrolled_window_new(NULL, NULL);
+    gtk_container_add(GTK_CONTAINER(scrolled), create_view(diff));
+    gtk_container_add(GTK_CONTAINER(window), scrolled);
+    gtk_widget_show_all(window);
+}
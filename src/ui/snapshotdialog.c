@@ -0,0 +1,183 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   snapshotdialog.c
+ * \brief   Snapshot selection dialog
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+#include <gtk/gtk.h>
+#include <stdbool.h>
+#include "debug.h"
+#include "snapstore.h"
+
+#include "snapshotdialog.h"
+
+
+/** \brief  Create combo box with the snapshots in the store
+ *
+ * The most recent snapshot (last in sort order) is selected.
+ *
+ * \param[in]   names   snapshot names
+ *
+ * \return  GtkComboBoxText
+ */
+static GtkWidget *create_snapshot_combo(char **names)
+{
+    GtkWidget *combo;
+    int count;
+
+    combo = gtk_combo_box_text_new();
+    for (count = 0; names[count] != NULL; count++) {
+        gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(combo),
+                                  names[count],
+                                  names[count]);
+    }
+    gtk_combo_box_set_active(GTK_COMBO_BOX(combo), count - 1);
+    gtk_widget_set_hexpand(combo, TRUE);
+    return combo;
+}
+
+
+/** \brief  Create modal dialog with OK and Cancel buttons
+ *
+ * \param[in]   parent  parent window
+ * \param[in]   title   dialog title
+ *
+ * \return  GtkDialog
+ */
+static GtkWidget *create_dialog(GtkWidget *parent, const char *title)
+{
+    return gtk_dialog_new_with_buttons(
+            title,
+            GTK_WINDOW(parent),
+            GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+            "Cancel", GTK_RESPONSE_REJECT,
+            "OK", GTK_RESPONSE_ACCEPT,
+            NULL);
+}
+
+
+/** \brief  Let the user choose a snapshot from the store
+ *
+ * \param[in]   parent  parent window
+ * \param[in]   title   dialog title
+ *
+ * \return  snapshot name, free with g_free(), or `NULL` when canceled
+ */
+char *snapshot_dialog_choose(GtkWidget *parent, const char *title)
+{
+    GtkWidget *dialog;
+    GtkWidget *content;
+    GtkWidget *combo;
+    char **names;
+    char *name = NULL;
+
+    names = snapstore_list();
+    if (names[0] == NULL) {
+        debug_msg("No snapshots in the store.");
+        g_strfreev(names);
+        return NULL;
+    }
+
+    dialog = create_dialog(parent, title);
+    content = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    combo = create_snapshot_combo(names);
+    g_object_set(combo, "margin", 16, NULL);
+    gtk_box_pack_start(GTK_BOX(content), combo, TRUE, TRUE, 0);
+    gtk_widget_show_all(dialog);
+
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        name = g_strdup(gtk_combo_box_get_active_id(GTK_COMBO_BOX(combo)));
+    }
+    gtk_widget_destroy(dialog);
+    g_strfreev(names);
+    return name;
+}
+
+
+/** \brief  Let the user choose two snapshots from the store
+ *
+ * The old snapshot defaults to the one before the most recent, the new
+ * snapshot to the most recent.
+ *
+ * \param[in]   parent      parent window
+ * \param[in]   title       dialog title
+ * \param[out]  old_name    old snapshot name, free with g_free()
+ * \param[out]  new_name    new snapshot name, free with g_free()
+ *
+ * \return  false when canceled or when there are less than two snapshots
+ */
+bool snapshot_dialog_choose_pair(GtkWidget *parent,
+                                 const char *title,
+                                 char **old_name,
+                                 char **new_name)
+{
+    GtkWidget *dialog;
+    GtkWidget *content;
+    GtkWidget *grid;
+    GtkWidget *old_combo;
+    GtkWidget *new_combo;
+    char **names;
+    bool result = false;
+
+    names = snapstore_list();
+    if (names[0] == NULL || names[1] == NULL) {
+        debug_msg("Need at least two snapshots in the store.");
+        g_strfreev(names);
+        return false;
+    }
+
+    dialog = create_dialog(parent, title);
+    content = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    grid = gtk_grid_new();
+    gtk_grid_set_column_spacing(GTK_GRID(grid), 8);
+    gtk_grid_set_row_spacing(GTK_GRID(grid), 8);
+    g_object_set(grid, "margin", 16, NULL);
+
+    old_combo = create_snapshot_combo(names);
+    gtk_combo_box_set_active(GTK_COMBO_BOX(old_combo),
+                             (int)g_strv_length(names) - 2);
+    new_combo = create_snapshot_combo(names);
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("Old:"), 0, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), old_combo, 1, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), gtk_label_new("New:"), 0, 1, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), new_combo, 1, 1, 1, 1);
+    gtk_box_pack_start(GTK_BOX(content), grid, TRUE, TRUE, 0);
+    gtk_widget_show_all(dialog);
+
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        *old_name = g_strdup(gtk_combo_box_get_active_id(GTK_COMBO_BOX(old_combo)));
+        *new_name = g_strdup(gtk_combo_box_get_active_id(GTK_COMBO_BOX(new_combo)));
+        result = true;
+    }
+    gtk_widget_destroy(dialog);
+    g_strfreev(names);
+    return result;
+}
@@ -37,22 +37,277 @@
 #include <gtk/gtk.h>
 
 #include "settings.h"
+#include "connection.h"
 #include "connection-widget.h"
+#include "frameprof.h"
+#include "resources.h"
+#include "session.h"
 
 #include "statusbar.h"
 
 
+/** \brief  Connection statistics label state
+ */
+typedef struct stats_label_s {
+    GtkWidget *label;               /**< label */
+    session_t *session;             /**< session of the label */
+    connstats_sample_t previous;    /**< previous sample, for the rates */
+    guint source;                   /**< timeout source ID */
+} stats_label_t;
+
+
+/** \brief  Machine label state
+ */
+typedef struct machine_label_s {
+    GtkWidget *label;   /**< label */
+    session_t *session; /**< session of the label */
+    guint refetch;      /**< idle source ID for refetching resources */
+} machine_label_t;
+
+
+/** \brief  Names of the MachineVideoStandard values
+ */
+static const char *video_standards[] = {
+    NULL, "PAL", "NTSC", "NTSC-old", "PAL-N"
+};
+
+
+/** \brief  Format a byte rate
+ *
+ * \param[out]  buffer  buffer
+ * \param[in]   size    size of \a buffer
+ * \param[in]   rate    bytes per second
+ */
+static void format_rate(char *buffer, size_t size, double rate)
+{
+    if (rate >= 1024.0 * 1024.0) {
+        g_snprintf(buffer, size, "%.1fMB/s", rate / (1024.0 * 1024.0));
+    } else if (rate >= 1024.0) {
+        g_snprintf(buffer, size, "%.1fKB/s", rate / 1024.0);
+    } else {
+        g_snprintf(buffer, size, "%.0fB/s", rate);
+    }
+}
+
+
+/** \brief  Sample the connection statistics and update the label
+ *
+ * \param[in]   data    stats label state
+ *
+ * \return  G_SOURCE_CONTINUE
+ */
+static gboolean on_stats_timeout(gpointer data)
+{
+    stats_label_t *stats = data;
+    connstats_sample_t sample;
+    char in[32];
+    char out[32];
+    char *text;
+    gint64 prof = frameprof_begin();
+
+    session_push(stats->session);
+    connection_get_stats(&sample);
+    session_pop();
+
+    format_rate(in, sizeof in,
+                connstats_rate(sample.bytes_in, stats->previous.bytes_in,
+                               sample.time, stats->previous.time));
+    format_rate(out, sizeof out,
+                connstats_rate(sample.bytes_out, stats->previous.bytes_out,
+                               sample.time, stats->previous.time));
+    text = g_strdup_printf(
+            "RTT p50 %.2fms p99 %.2fms | in %s out %s | in flight %d queued %d",
+            sample.rtt_p50 / 1000.0, sample.rtt_p99 / 1000.0,
+            in, out, sample.in_flight, sample.queued);
+    gtk_label_set_text(GTK_LABEL(stats->label), text);
+    g_free(text);
+    stats->previous = sample;
+    frameprof_end(FRAMEPROF_TIMEOUT, prof);
+    return G_SOURCE_CONTINUE;
+}
+
+
+/** \brief  Handler for the 'destroy' event of the statistics label
+ *
+ * \param[in]   widget  label
+ * \param[in]   data    stats label state
+ */
+static void on_stats_destroy(GtkWidget *widget, gpointer data)
+{
+    stats_label_t *stats = data;
+
+    g_source_remove(stats->source);
+    g_free(stats);
+}
+
+
+/** \brief  Create label showing the connection statistics of the session
+ *
+ * The statistics are sampled every 'Statusbar/stats_interval' milliseconds.
+ *
+ * \return  GtkLabel
+ */
+static GtkWidget *stats_label_create(void)
+{
+    stats_label_t *stats = g_malloc0(sizeof *stats);
+    int interval;
+
+    if (!settings_get_int("Statusbar", "stats_interval", &interval)
+            || interval <= 0) {
+        interval = STATUSBAR_STATS_INTERVAL;
+    }
+
+    stats->label = gtk_label_new(NULL);
+    stats->session = session_current();
+    gtk_widget_set_hexpand(stats->label, TRUE);
+    gtk_widget_set_halign(stats->label, GTK_ALIGN_END);
+    gtk_widget_set_margin_start(stats->label, 16);
+    gtk_widget_set_margin_end(stats->label, 8);
+    connection_get_stats(&stats->previous);
+    stats->source = g_timeout_add((guint)interval, on_stats_timeout, stats);
+    g_signal_connect(stats->label, "destroy",
+                     G_CALLBACK(on_stats_destroy), stats);
+    on_stats_timeout(stats);
+    return stats->label;
+}
+
+
+/** \brief  Update machine label from the resource cache
+ *
+ * \param[in]   machine machine label state
+ */
+static void machine_label_update(machine_label_t *machine)
+{
+    const resource_value_t *video;
+    const resource_value_t *warp;
+    const char *standard = "?";
+    char *text;
+
+    session_push(machine->session);
+    video = resources_lookup("MachineVideoStandard");
+    warp = resources_lookup("WarpMode");
+    session_pop();
+
+    if (video != NULL && video->type == RESOURCE_TYPE_INT
+            && video->int_value > 0
+            && video->int_value < (int)G_N_ELEMENTS(video_standards)) {
+        standard = video_standards[video->int_value];
+    }
+    text = g_strdup_printf("%s%s", standard,
+                           warp != NULL && warp->type == RESOURCE_TYPE_INT
+                           && warp->int_value != 0 ? " | warp" : "");
+    gtk_label_set_text(GTK_LABEL(machine->label), text);
+    g_free(text);
+}
+
+
+/** \brief  Fetch the resources shown that aren't cached
+ *
+ * Deferred to an idle callback, the cache can be invalidated while
+ * commands can't be sent.
+ *
+ * \param[in]   data    machine label state
+ *
+ * \return  G_SOURCE_REMOVE
+ */
+static gboolean on_machine_refetch(gpointer data)
+{
+    machine_label_t *machine = data;
+
+    machine->refetch = 0;
+    session_push(machine->session);
+    if (connection_get_state() == CONNECTION_CONNECTED) {
+        /* the listener updates the label when the values arrive */
+        resources_get("MachineVideoStandard", NULL, NULL);
+        resources_get("WarpMode", NULL, NULL);
+    }
+    session_pop();
+    return G_SOURCE_REMOVE;
+}
+
+
+/** \brief  Handler for resource cache changes
+ *
+ * \param[in]   name    resource name, or NULL for all
+ * \param[in]   data    machine label state
+ */
+static void on_machine_resources_changed(const char *name, void *data)
+{
+    machine_label_t *machine = data;
+
+    if (session_current() != machine->session
+            || (name != NULL
+                && g_ascii_strcasecmp(name, "MachineVideoStandard") != 0
+                && g_ascii_strcasecmp(name, "WarpMode") != 0)) {
+        return;
+    }
+    machine_label_update(machine);
+    if (machine->refetch == 0
+            && (resources_lookup("MachineVideoStandard") == NULL
+                || resources_lookup("WarpMode") == NULL)) {
+        machine->refetch = g_idle_add(on_machine_refetch, machine);
+    }
+}
+
+
+/** \brief  Handler for the 'destroy' event of the machine label
+ *
+ * \param[in]   widget  label
+ * \param[in]   data    machine label state
+ */
+static void on_machine_destroy(GtkWidget *widget, gpointer data)
+{
+    machine_label_t *machine = data;
+
+    resources_remove_listener(on_machine_resources_changed, machine);
+    if (machine->refetch != 0) {
+        g_source_remove(machine->refetch);
+    }
+    g_free(machine);
+}
+
+
+/** \brief  Create label showing video standard and warp mode of the session
+ *
+ * The values come from the resource cache, which prefetches them on
+ * connect, so the label doesn't send queries of its own.
+ *
+ * \return  GtkLabel
+ */
+static GtkWidget *machine_label_create(void)
+{
+    machine_label_t *machine = g_malloc0(sizeof *machine);
+
+    machine->label = gtk_label_new(NULL);
+    machine->session = session_current();
+    gtk_widget_set_margin_start(machine->label, 16);
+    resources_add_listener(on_machine_resources_changed, machine);
+    g_signal_connect(machine->label, "destroy",
+                     G_CALLBACK(on_machine_destroy), machine);
+    machine_label_update(machine);
+    return machine->label;
+}
+
+
+/** \brief  Create statusbar for the current session
+ *
+ * \param[in]   state   session is connected
+ *
+ * \return  GtkGrid
+ */
 GtkWidget *statusbar_create(int state)
 {
     GtkWidget *grid;
     GtkWidget *connection;
 
     grid = gtk_grid_new();
-    gtk_widget_set_hexpand(grid, FALSE);
+    gtk_widget_set_hexpand(grid, TRUE);
     gtk_widget_set_valign(grid, GTK_ALIGN_END);
 
     connection = connection_widget_create(state);
     gtk_grid_attach(GTK_GRID(grid), connection, 0, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), machine_label_create(), 1, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), stats_label_create(), 2, 0, 1, 1);
 
     gtk_widget_show_all(grid);
     return grid;
@@ -36,6 +36,10 @@
 
 #include <gtk/gtk.h>
 
+/** \brief  Default interval in milliseconds for sampling connection statistics
+ */
+#define STATUSBAR_STATS_INTERVAL    250
+
 
 GtkWidget *statusbar_create(int state);
 
@@ -0,0 +1,247 @@
+/* vim: set et ts=4 sw=4 sts=4 syntax=c.doxygen: */
+
+/** \file   watchview.c
+ * \brief   Watch expressions view
+ *
+ * \author  Bas Wassink <b.wassink@ziggo.nl>
+ */
+
+/*
+    Gtk3 VICE Monitor
+    Copyright (C) 2021  Bas Wassink
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+    This General Public License does not permit incorporating your program into
+    proprietary programs.  If your program is a subroutine library, you may
+    consider it more useful to permit linking proprietary applications with the
+    library.  If this is what you want to do, use the GNU Lesser General
+    Public License instead of this License.
+*/
+
+#include "config.h"
+#include <gtk/gtk.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "debug.h"
+#include "watch.h"
+
+#include "watchview.h"
+
+
+/** \brief  Columns of the watches list store
+ */
+enum {
+    COL_ID,         /**< watch ID (hidden) */
+    COL_EXPRESSION, /**< expression */
+    COL_HEX,        /**< value in hex */
+    COL_DECIMAL,    /**< value in decimal */
+    NUM_COLUMNS
+};
+
+
+/** \brief  Watch view state
+ */
+typedef struct watchview_s {
+    GtkWidget *entry;       /**< expression */
+    GtkWidget *tree;        /**< watches */
+    GtkWidget *status;      /**< status label */
+    GtkListStore *store;    /**< watches */
+} watchview_t;
+
+
+/** \brief  Add row for \a watch
+ *
+ * \param[in]   watch   watch
+ * \param[in]   data    watch view
+ */
+static void add_row(const watch_t *watch, void *data)
+{
+    watchview_t *view = data;
+    GtkTreeIter iter;
+    char hex[16] = "?";
+    char decimal[16] = "?";
+
+    if (watch->valid) {
+        if (watch->value >= 0 && watch->value <= 0xff) {
+            g_snprintf(hex, sizeof(hex), "$%02x", (unsigned int)watch->value);
+        } else {
+            g_snprintf(hex, sizeof(hex), "$%04x",
+                       (unsigned int)watch->value & 0xffffu);
+        }
+        g_snprintf(decimal, sizeof(decimal), "%d", (int)watch->value);
+    }
+    gtk_list_store_append(view->store, &iter);
+    gtk_list_store_set(view->store, &iter,
+                       COL_ID, watch->id,
+                       COL_EXPRESSION, watch->text,
+                       COL_HEX, hex,
+                       COL_DECIMAL, decimal,
+                       -1);
+}
+
+
+/** \brief  Refill the list when watches change
+ *
+ * \param[in]   data    watch view
+ */
+static void on_watches_changed(void *data)
+{
+    watchview_t *view = data;
+
+    gtk_list_store_clear(view->store);
+    watch_foreach(add_row, view);
+}
+
+
+/** \brief  Handler for the 'clicked' event of the add button
+ *
+ * Also triggered by activating the entry.
+ *
+ * \param[in]   widget  button
+ * \param[in]   data    watch view
+ */
+static void on_add_clicked(GtkWidget *widget, gpointer data)
+{
+    watchview_t *view = data;
+    GError *err = NULL;
+
+    if (watch_add(gtk_entry_get_text(GTK_ENTRY(view->entry)), &err) == 0) {
+        gtk_label_set_text(GTK_LABEL(view->status), err->message);
+        g_error_free(err);
+        return;
+    }
+    gtk_label_set_text(GTK_LABEL(view->status), NULL);
+    gtk_entry_set_text(GTK_ENTRY(view->entry), "");
+}
+
+
+/** \brief  Handler for the 'clicked' event of the remove button
+ *
+ * \param[in]   widget  button
+ * \param[in]   data    watch view
+ */
+static void on_remove_clicked(GtkWidget *widget, gpointer data)
+{
+    watchview_t *view = data;
+    GtkTreeSelection *selection;
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    guint id;
+
+    selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(view->tree));
+    if (gtk_tree_selection_get_selected(selection, &model, &iter)) {
+        gtk_tree_model_get(model, &iter, COL_ID, &id, -1);
+        watch_remove(id);
+    }
+}
+
+
+/** \brief  Handler for the 'destroy' event of the view
+ *
+ * \param[in]   widget  view
+ * \param[in]   data    watch view
+ */
+static void on_destroy(GtkWidget *widget, gpointer data)
+{
+    watchview_t *view = data;
+
+    watch_remove_listener(on_watches_changed, view);
+    g_object_unref(view->store);
+    g_free(view);
+}
+
+
+/** \brief  Create watches list
+ *
+ * \param[in]   view    watch view
+ *
+ * \return  GtkScrolledWindow
+ */
+static GtkWidget *create_list(watchview_t *view)
+{
+    static const char *titles[NUM_COLUMNS] = {
+        NULL, "Expression", "Hex", "Decimal"
+    };
+    GtkWidget *scrolled;
+
+    view->store = gtk_list_store_new(NUM_COLUMNS,
+                                     G_TYPE_UINT,
+                                     G_TYPE_STRING,
+                                     G_TYPE_STRING,
+                                     G_TYPE_STRING);
+    view->tree = gtk_tree_view_new_with_model(GTK_TREE_MODEL(view->store));
+    for (int col = COL_EXPRESSION; col < NUM_COLUMNS; col++) {
+        GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
+
+        g_object_set(renderer, "family", "monospace", NULL);
+        gtk_tree_view_append_column(
+                GTK_TREE_VIEW(view->tree),
+                gtk_tree_view_column_new_with_attributes(titles[col],
+                                                         renderer,
+                                                         "text", col,
+                                                         NULL));
+    }
+    scrolled = gtk_scrolled_window_new(NULL, NULL);
+    gtk_widget_set_hexpand(scrolled, TRUE);
+    gtk_widget_set_vexpand(scrolled, TRUE);
+    gtk_container_add(GTK_CONTAINER(scrolled), view->tree);
+    return scrolled;
+}
+
+
+/** \brief  Create watch expressions view
+ *
+ * \return  GtkGrid
+ */
+GtkWidget *watchview_create(void)
+{
+    watchview_t *view;
+    GtkWidget *grid;
+    GtkWidget *button;
+
+    view = g_malloc0(sizeof *view);
+
+    grid = gtk_grid_new();
+    gtk_grid_set_column_spacing(GTK_GRID(grid), 8);
+    gtk_grid_set_row_spacing(GTK_GRID(grid), 8);
+
+    view->entry = gtk_entry_new();
+    gtk_entry_set_placeholder_text(GTK_ENTRY(view->entry), "($fb),y");
+    gtk_widget_set_hexpand(view->entry, TRUE);
+    g_signal_connect(view->entry, "activate",
+                     G_CALLBACK(on_add_clicked), view);
+    gtk_grid_attach(GTK_GRID(grid), view->entry, 0, 0, 1, 1);
+
+    button = gtk_button_new_with_label("Add");
+    g_signal_connect(button, "clicked", G_CALLBACK(on_add_clicked), view);
+    gtk_grid_attach(GTK_GRID(grid), button, 1, 0, 1, 1);
+
+    button = gtk_button_new_with_label("Remove");
+    g_signal_connect(button, "clicked", G_CALLBACK(on_remove_clicked), view);
+    gtk_grid_attach(GTK_GRID(grid), button, 2, 0, 1, 1);
+
+    gtk_grid_attach(GTK_GRID(grid), create_list(view), 0, 1, 3, 1);
+
+    view->status = gtk_label_new(NULL);
+    gtk_widget_set_halign(view->status, GTK_ALIGN_START);
+    gtk_grid_attach(GTK_GRID(grid), view->status, 0, 2, 3, 1);
+
+    watch_add_listener(on_watches_changed, view);
+    on_watches_changed(view);
+    g_signal_connect(grid, "destroy", G_CALLBACK(on_destroy), view);
+    return grid;
+}
@@ -70,6 +70,8 @@ typedef enum vicemon_command_e {
     MON_CMD_DISPLAY_GET = 0x84,
     MON_CMD_VICE_INFO = 0x85,
 
+    MON_CMD_PALETTE_GET = 0x91,
+
     MON_CMD_EXIT = 0xaa,
     MON_CMD_QUIT = 0xbb,
     MON_CMD_RESET = 0xcc,
@@ -113,6 +115,8 @@ typedef enum vicemon_response {
     MON_RESPONSE_DISPLAY_GET = 0x84,
     MON_RESPONSE_VICE_INFO = 0x85,
 
+    MON_RESPONSE_PALETTE_GET = 0x91,
+
     MON_RESPONSE_EXIT = 0xaa,
     MON_RESPONSE_QUIT = 0xbb,
     MON_RESPONSE_RESET = 0xcc,
@@ -134,6 +138,30 @@ typedef enum vicemon_error_e {
 } vicemon_error_t;
 
 
+/** \brief  Binary monitor memspaces
+ */
+typedef enum vicemon_memspace_e {
+    MON_MEMSPACE_MAIN = 0x00,
+    MON_MEMSPACE_DRIVE8 = 0x01,
+    MON_MEMSPACE_DRIVE9 = 0x02,
+    MON_MEMSPACE_DRIVE10 = 0x03,
+    MON_MEMSPACE_DRIVE11 = 0x04,
+} vicemon_memspace_t;
+
+/** \brief  Number of memspaces supported by the binary monitor
+ */
+#define MON_MEMSPACE_COUNT  5
+
+
+/** \brief  Checkpoint CPU operations (can be OR'ed)
+ */
+typedef enum vicemon_cpu_op_e {
+    MON_CPU_OP_LOAD = 0x01,
+    MON_CPU_OP_STORE = 0x02,
+    MON_CPU_OP_EXEC = 0x04,
+} vicemon_cpu_op_t;
+
+
 /* Binary monitor command structure field offsets/sizes
  */
 
@@ -142,5 +170,14 @@ typedef enum vicemon_error_e {
 #define MON_CMD_LEN_OFFSET  0x02
 #define MON_CMD_LEN_SIZE    0x04
 
+/* Binary monitor response structure sizes
+ */
+
+#define MON_RESPONSE_HEADER_SIZE    0x0c
+
+/** \brief  Request ID used by VICE for unsolicited responses (events)
+ */
+#define MON_EVENT_REQUEST_ID    0xffffffffU
+
 #endif
 